@@ -4,6 +4,10 @@
 
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
@@ -11,10 +15,23 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <stdio.h>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 
+#if defined(CORE_WITH_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(CORE_WITH_LZMA)
+#include <lzma.h>
+#endif
+#if defined(CORE_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
 /// ------------------
 /// Defer
 /// source: https://www.gingerbill.org/article/2015/08/19/defer-in-cpp/
@@ -160,6 +177,29 @@ inline isize os_page_size() {
 
 #define popcount64(value) __popcnt64(value)
 
+inline i32 ctz64(u64 value) {
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (i32)index;
+}
+
+inline i32 clz64(u64 value) {
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - (i32)index;
+}
+
+// High 64 bits of the 128 bit product
+inline u64 mul_hi64(u64 a, u64 b) {
+    return __umulh(a, b);
+}
+
+#if defined(_M_ARM64)
+#define core_prefetch(ptr) __prefetch(ptr)
+#else
+#define core_prefetch(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#endif
+
 // source:
 // https://learn.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
 static void* vm_alloc_ring_buffer(isize size) {
@@ -288,14 +328,41 @@ static void vm_free_ring_buffer(void* buffer, isize size) {
 }
 
 #else
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+// io_uring is used when the kernel headers are recent enough for
+// IORING_OP_READ (Linux 5.6, which also added IORING_FEAT_RW_CUR_POS).
+// Otherwise file_read_many only uses its pread threads.
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#if defined(__linux__) && defined(IORING_FEAT_RW_CUR_POS)
+#define CORE_IO_URING 1
+#include <sys/syscall.h>
+#else
+#define CORE_IO_URING 0
+#endif
 
 static isize os_page_size() {
     return getpagesize();
 }
 
 #define popcount64(value) __builtin_popcountll(value)
+#define ctz64(value) __builtin_ctzll(value)
+#define clz64(value) __builtin_clzll(value)
+
+// __extension__ keeps -Wpedantic quiet about the non-standard type
+__extension__ typedef unsigned __int128 u128;
+
+// High 64 bits of the 128 bit product
+inline u64 mul_hi64(u64 a, u64 b) {
+    return (u64)(((u128)a * b) >> 64);
+}
+
+#define core_prefetch(ptr) __builtin_prefetch(ptr)
 
 static void* vm_alloc_ring_buffer(isize size) {
     core_assert(size > 0);
@@ -332,6 +399,105 @@ static void vm_free_ring_buffer(void* buffer, isize size) {
 }
 #endif
 
+/// ------------------
+/// CPU features
+/// ------------------
+
+// SIMD kernels are compiled for their instruction set with CORE_TARGET and
+// selected at runtime with cpu_has_feature, so a binary built for baseline
+// x86-64 still uses AVX2/AVX-512 where the machine supports it. On other
+// architectures only the portable code paths are compiled.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CORE_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CORE_TARGET(features)
+#else
+#include <cpuid.h>
+#define CORE_TARGET(features) __attribute__((target(features)))
+#endif
+#else
+#define CORE_X86_SIMD 0
+#endif
+
+enum class CpuFeature : u32 {
+    Popcnt = 1 << 0,
+    Bmi2 = 1 << 1,
+    Avx2 = 1 << 2,
+    // AVX-512 F, BW and VL
+    Avx512 = 1 << 3,
+    // AVX-512 VPOPCNTDQ
+    Avx512Popcnt = 1 << 4,
+};
+
+inline u32 cpu_detect_features() {
+    u32 features = 0;
+#if CORE_X86_SIMD
+    int regs[4] = {};
+    int extended[4] = {};
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuid(regs, 1);
+    __cpuidex(extended, 7, 0);
+#else
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+    __cpuid_count(7, 0, extended[0], extended[1], extended[2], extended[3]);
+#endif
+    bool has_osxsave = (regs[2] >> 27) & 1;
+    u64 xcr0 = 0;
+    if (has_osxsave) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        xcr0 = _xgetbv(0);
+#else
+        u32 eax, edx;
+        __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        xcr0 = ((u64)edx << 32) | eax;
+#endif
+    }
+    // The OS has to save the ymm (and for AVX-512 the zmm/opmask) registers
+    bool os_avx = (xcr0 & 0x6) == 0x6;
+    bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    if ((regs[2] >> 23) & 1) {
+        features |= (u32)CpuFeature::Popcnt;
+    }
+    if ((extended[1] >> 8) & 1) {
+        features |= (u32)CpuFeature::Bmi2;
+    }
+    if (os_avx && ((extended[1] >> 5) & 1)) {
+        features |= (u32)CpuFeature::Avx2;
+    }
+    bool avx512f = (extended[1] >> 16) & 1;
+    bool avx512bw = (extended[1] >> 30) & 1;
+    bool avx512vl = (extended[1] >> 31) & 1;
+    if (os_avx512 && avx512f && avx512bw && avx512vl) {
+        features |= (u32)CpuFeature::Avx512;
+        if ((extended[2] >> 14) & 1) {
+            features |= (u32)CpuFeature::Avx512Popcnt;
+        }
+    }
+#endif
+    return features;
+}
+
+inline u32* cpu_features_storage() {
+    static u32 features = cpu_detect_features();
+    return &features;
+}
+
+inline u32 cpu_get_features() {
+    return *cpu_features_storage();
+}
+
+// Restricts the kernels to the given features. Used by tests and benchmarks to
+// exercise every code path on a single machine.
+inline void cpu_set_features(u32 features) {
+    *cpu_features_storage() = features & cpu_detect_features();
+}
+
+inline bool cpu_has_feature(CpuFeature feature) {
+    return (*cpu_features_storage() & (u32)feature) != 0;
+}
+
 /// ------------------
 /// Memory allocation
 /// ------------------
@@ -342,8 +508,12 @@ enum class AllocationMode : u8 {
     Alloc,
     Free,
     Resize,
+    // Like Alloc, but the memory may hold garbage. For buffers that are
+    // overwritten right away, where zeroing would be a wasted pass.
+    AllocNonZeroed,
 };
 
+// Procs may handle AllocNonZeroed exactly like Alloc
 using AllocatorProc = void* (*)(void* allocator, AllocationMode mode,
                                 isize size, isize alignment, void* old_memory,
                                 isize old_size);
@@ -366,6 +536,19 @@ inline T* core_alloc(Allocator allocator, isize count = 1,
                                count * sizeof(T), alignment, nullptr, 0);
 }
 
+template <typename T>
+#if defined(_MSC_VER)
+#else
+__attribute__((malloc)) __attribute__((returns_nonnull))
+#endif
+inline T* core_alloc_non_zeroed(Allocator allocator, isize count = 1,
+                                isize alignment = alignof(T)) {
+    core_assert_msg((alignment & (alignment - 1)) == 0,
+                    "Alignment must be a power of 2");
+    return (T*)allocator.alloc(allocator.data, AllocationMode::AllocNonZeroed,
+                               count * sizeof(T), alignment, nullptr, 0);
+}
+
 inline void core_free(Allocator allocator, void* memory) {
     allocator.alloc(allocator.data, AllocationMode::Free, 0, 0, memory, 0);
 }
@@ -389,6 +572,12 @@ static void* c_allocator_proc(void* allocator, AllocationMode mode, isize size,
         core_assert(data != nullptr);
         return data;
     }
+    case AllocationMode::AllocNonZeroed: {
+        // malloc(0) may return null
+        void* data = malloc(std::max(size, (isize)1));
+        core_assert(data != nullptr);
+        return data;
+    }
     case AllocationMode::Free: {
         free(old_memory);
         return nullptr;
@@ -644,7 +833,9 @@ static void* arena_alloc_proc(void* allocator, AllocationMode mode, isize size,
     Arena* arena = (Arena*)allocator;
 
     switch (mode) {
-    case AllocationMode::Alloc: {
+    // Arena memory is zeroed on reset already
+    case AllocationMode::Alloc:
+    case AllocationMode::AllocNonZeroed: {
         return arena_alloc(arena, size, alignment);
     }
     case AllocationMode::Free: {
@@ -723,7 +914,8 @@ dynamic_arena_make(isize block_size_min = DEFAULT_BLOCK_SIZE_MIN,
 }
 
 inline u8* dynamic_arena_alloc(DynamicArena* arena, isize size,
-                               isize alignment = DEFAULT_ALIGNMENT) {
+                               isize alignment = DEFAULT_ALIGNMENT,
+                               bool zero = true) {
     u8* result = arena->current->data + arena->current->size;
 
     // Align forward to minimum alignment
@@ -733,7 +925,9 @@ inline u8* dynamic_arena_alloc(DynamicArena* arena, isize size,
 
     if (new_size <= arena->current->capacity) {
         arena->current->size = new_size;
-        memset(result, 0, size);
+        if (zero) {
+            memset(result, 0, size);
+        }
         return result;
     }
 
@@ -744,7 +938,9 @@ inline u8* dynamic_arena_alloc(DynamicArena* arena, isize size,
     arena->current = new_block;
     arena->current->size = size;
 
-    memset(new_block->data, 0, size);
+    if (zero) {
+        memset(new_block->data, 0, size);
+    }
     return new_block->data;
 }
 
@@ -824,6 +1020,9 @@ static void* dynamic_arena_alloc_proc(void* allocator, AllocationMode mode,
     case AllocationMode::Alloc: {
         return dynamic_arena_alloc(arena, size, alignment);
     }
+    case AllocationMode::AllocNonZeroed: {
+        return dynamic_arena_alloc(arena, size, alignment, false);
+    }
     case AllocationMode::Free: {
         return nullptr;
     }
@@ -922,6 +1121,8 @@ struct RuneDetails {
     isize size;
 };
 
+// Expects valid UTF-8, untrusted input has to be checked with
+// string_validate_utf8 first
 inline RuneDetails cstr_read_utf8_codepoint(const char* cstr) {
     unsigned char c = *cstr;
     i32 codepoint = 0;
@@ -1054,15 +1255,517 @@ inline String string_substr(String str, isize start, isize count) {
     return String{str.data + start, count};
 }
 
-inline isize string_utf8_size(String str) {
-    char* s = (char*)str.data;
-    size_t count = 0;
-    while (*s) {
-        count += (*s++ & 0xC0) != 0x80;
+// Counts the bytes that aren't continuation bytes (10xxxxxx)
+inline isize string_rune_count_scalar(const u8* data, isize size) {
+    isize continuations = 0;
+    isize i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, sizeof(word));
+        // Bit 7 set and bit 6 cleared
+        continuations +=
+            popcount64(word & ~(word << 1) & 0x8080808080808080);
+    }
+    for (; i < size; i++) {
+        continuations += (data[i] & 0xC0) == 0x80;
+    }
+    return size - continuations;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline isize string_rune_count_avx2(const u8* data, isize size) {
+    // Continuation bytes are the signed bytes below -64
+    const __m256i threshold = _mm256_set1_epi8(-64);
+    isize continuations = 0;
+    isize i = 0;
+    while (i + 32 <= size) {
+        // Byte counters overflow after 255 blocks
+        __m256i counts = _mm256_setzero_si256();
+        isize end = std::min(size - 31, i + 255 * 32);
+        for (; i < end; i += 32) {
+            __m256i input = _mm256_loadu_si256((const __m256i*)(data + i));
+            // The mask is -1 for continuations, subtracting it counts them
+            counts = _mm256_sub_epi8(counts,
+                                     _mm256_cmpgt_epi8(threshold, input));
+        }
+        u64 lanes[4];
+        _mm256_storeu_si256((__m256i*)lanes,
+                            _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+        continuations += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return i - continuations + string_rune_count_scalar(data + i, size - i);
+}
+#endif
+
+// Number of code points in valid UTF-8
+inline isize string_rune_count(String str) {
+    const u8* data = (const u8*)str.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_rune_count_avx2(data, str.size);
+    }
+#endif
+    return string_rune_count_scalar(data, str.size);
+}
+
+static_assert(sizeof(rune) == sizeof(i32));
+
+const i32 UTF8_REPLACEMENT_CODEPOINT = 0xFFFD;
+
+// Decodes one non ASCII sequence at `data[*index]`. A sequence cut off by
+// the end of the buffer decodes as U+FFFD and consumes the rest.
+inline rune utf8_decode_sequence(const u8* data, isize size, isize* index) {
+    u8 c = data[*index];
+    isize length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+    if (length > size - *index) {
+        *index = size;
+        return rune{UTF8_REPLACEMENT_CODEPOINT};
+    }
+
+    i32 codepoint = c & (0x7F >> length);
+    for (isize j = 1; j < length; j++) {
+        codepoint = (codepoint << 6) | (data[*index + j] & 0x3F);
+    }
+    *index += length;
+    return rune{codepoint};
+}
+
+inline isize string_decode_runes_scalar(const u8* data, isize size,
+                                        isize start, rune* out,
+                                        isize out_start) {
+    isize i = start;
+    isize count = out_start;
+    while (i < size) {
+        // Widen runs of ASCII 8 bytes at a time
+        if (i + 8 <= size) {
+            u64 word;
+            memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080) == 0) {
+                for (isize j = 0; j < 8; j++) {
+                    out[count + j] = rune{data[i + j]};
+                }
+                i += 8;
+                count += 8;
+                continue;
+            }
+        }
+        if (data[i] < 0x80) {
+            out[count++] = rune{data[i++]};
+        } else {
+            out[count++] = utf8_decode_sequence(data, size, &i);
+        }
     }
     return count;
 }
 
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline isize string_decode_runes_avx2(const u8* data, isize size, rune* out) {
+    isize i = 0;
+    isize count = 0;
+    while (i + 16 <= size) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(data + i));
+        u32 non_ascii = (u32)_mm_movemask_epi8(input);
+        if (non_ascii == 0) {
+            _mm256_storeu_si256((__m256i*)(out + count),
+                                _mm256_cvtepu8_epi32(input));
+            _mm256_storeu_si256(
+                (__m256i*)(out + count + 8),
+                _mm256_cvtepu8_epi32(_mm_srli_si128(input, 8)));
+            i += 16;
+            count += 16;
+            continue;
+        }
+
+        // Widen the ASCII prefix, then decode sequences one by one until the
+        // end of the block
+        isize ascii = ctz64(non_ascii);
+        for (isize j = 0; j < ascii; j++) {
+            out[count++] = rune{data[i + j]};
+        }
+        i += ascii;
+        isize block_end = i + 16;
+        while (i < block_end && i < size) {
+            if (data[i] < 0x80) {
+                out[count++] = rune{data[i++]};
+            } else {
+                out[count++] = utf8_decode_sequence(data, size, &i);
+            }
+        }
+    }
+    return string_decode_runes_scalar(data, size, i, out, count);
+}
+#endif
+
+// Decodes valid UTF-8 into `out`, which needs room for string_rune_count
+// runes (str.size is always enough). Returns the number of runes written.
+inline isize string_decode_runes(String str, Slice<rune> out) {
+    const u8* data = (const u8*)str.data;
+    core_assert_msg(out.size >= str.size ||
+                        out.size >= string_rune_count(str),
+                    "%ld < %ld", out.size, string_rune_count(str));
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_decode_runes_avx2(data, str.size, out.data);
+    }
+#endif
+    return string_decode_runes_scalar(data, str.size, 0, out.data, 0);
+}
+
+// Number of bytes the runes take encoded as UTF-8
+inline isize runes_utf8_size(Slice<rune> runes) {
+    isize size = 0;
+    for (rune r : runes) {
+        size += 1 + (r.codepoint >= 0x80) + (r.codepoint >= 0x800) +
+                (r.codepoint >= 0x10000);
+    }
+    return size;
+}
+
+inline isize runes_encode_utf8_scalar(const rune* runes, isize count,
+                                      isize start, u8* out, isize out_start) {
+    isize size = out_start;
+    for (isize i = start; i < count; i++) {
+        i32 c = runes[i].codepoint;
+        if (c < 0x80) {
+            out[size++] = (u8)c;
+        } else if (c < 0x800) {
+            out[size++] = (u8)(0xC0 | (c >> 6));
+            out[size++] = (u8)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out[size++] = (u8)(0xE0 | (c >> 12));
+            out[size++] = (u8)(0x80 | ((c >> 6) & 0x3F));
+            out[size++] = (u8)(0x80 | (c & 0x3F));
+        } else {
+            out[size++] = (u8)(0xF0 | (c >> 18));
+            out[size++] = (u8)(0x80 | ((c >> 12) & 0x3F));
+            out[size++] = (u8)(0x80 | ((c >> 6) & 0x3F));
+            out[size++] = (u8)(0x80 | (c & 0x3F));
+        }
+    }
+    return size;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline isize runes_encode_utf8_avx2(const rune* runes, isize count, u8* out) {
+    const __m256i ascii_max = _mm256_set1_epi32(0x7F);
+    // Low byte of every rune, gathered into the low 4 bytes of each lane
+    const __m256i low_bytes = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8,
+        12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+    isize i = 0;
+    isize size = 0;
+    while (i + 8 <= count) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(runes + i));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(input, ascii_max)) != 0) {
+            // Encode up to the next block boundary one by one
+            size = runes_encode_utf8_scalar(runes, i + 8, i, out, size);
+            i += 8;
+            continue;
+        }
+        __m256i packed = _mm256_permutevar8x32_epi32(
+            _mm256_shuffle_epi8(input, low_bytes), lanes);
+        _mm_storel_epi64((__m128i*)(out + size),
+                         _mm256_castsi256_si128(packed));
+        i += 8;
+        size += 8;
+    }
+    return runes_encode_utf8_scalar(runes, count, i, out, size);
+}
+#endif
+
+// Encodes the runes into `out`, which needs room for runes_utf8_size bytes
+// (4 per rune is always enough). Returns the number of bytes written.
+inline isize runes_encode_utf8(Slice<rune> runes, Slice<u8> out) {
+    core_assert_msg(out.size >= runes.size * 4 ||
+                        out.size >= runes_utf8_size(runes),
+                    "%ld < %ld", out.size, runes_utf8_size(runes));
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return runes_encode_utf8_avx2(runes.data, runes.size, out.data);
+    }
+#endif
+    return runes_encode_utf8_scalar(runes.data, runes.size, 0, out.data, 0);
+}
+
+// Number of code points in valid UTF-8, same as string_rune_count
+inline isize string_utf8_size(String str) {
+    return string_rune_count(str);
+}
+
+struct Utf8Validation {
+    bool is_valid;
+    // Offset of the first byte of the first invalid sequence, -1 if valid
+    isize error_offset;
+};
+
+// Returns the offset of the first invalid sequence at or after `start`, or -1.
+// `start` has to be at the beginning of a sequence.
+inline isize utf8_validate_scalar(const u8* data, isize size, isize start) {
+    isize i = start;
+    while (i < size) {
+        // Skip ASCII 8 bytes at a time
+        if (i + 8 <= size) {
+            u64 word;
+            memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        u8 c = data[i];
+        if (c < 0x80) {
+            i += 1;
+            continue;
+        }
+
+        isize length;
+        // Allowed range of the second byte, it excludes overlong encodings,
+        // surrogates and code points above U+10FFFF
+        u8 low = 0x80;
+        u8 high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            low = c == 0xE0 ? 0xA0 : 0x80;
+            high = c == 0xED ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            low = c == 0xF0 ? 0x90 : 0x80;
+            high = c == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            return i;
+        }
+
+        if (i + length > size || data[i + 1] < low || data[i + 1] > high) {
+            return i;
+        }
+        for (isize j = 2; j < length; j++) {
+            if ((data[i + j] & 0xC0) != 0x80) {
+                return i;
+            }
+        }
+        i += length;
+    }
+    return -1;
+}
+
+#if CORE_X86_SIMD
+// Bits of the error classes the lookup tables flag. A pair of bytes is
+// invalid when all three tables (high and low nibble of the first byte, high
+// nibble of the second) agree on a class.
+const u8 UTF8_TOO_SHORT = 1 << 0;
+const u8 UTF8_TOO_LONG = 1 << 1;
+const u8 UTF8_OVERLONG_3 = 1 << 2;
+const u8 UTF8_TOO_LARGE = 1 << 3;
+const u8 UTF8_SURROGATE = 1 << 4;
+const u8 UTF8_OVERLONG_2 = 1 << 5;
+const u8 UTF8_TOO_LARGE_1000 = 1 << 6;
+const u8 UTF8_OVERLONG_4 = 1 << 6;
+const u8 UTF8_TWO_CONTS = 1 << 7;
+const u8 UTF8_CARRY = UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS;
+
+CORE_TARGET("avx2")
+inline __m256i utf8_lookup16_avx2(__m256i nibbles, const u8 table[16]) {
+    __m128i lanes = _mm_loadu_si128((const __m128i*)table);
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(lanes), nibbles);
+}
+
+// The input shifted by N bytes, with the end of the previous block shifted in
+template <i32 N>
+CORE_TARGET("avx2")
+inline __m256i utf8_prev_avx2(__m256i input, __m256i prev_input) {
+    return _mm256_alignr_epi8(
+        input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+}
+
+CORE_TARGET("avx2")
+inline __m256i utf8_check_block_avx2(__m256i input, __m256i prev_input) {
+    static const u8 byte_1_high[16] = {
+        // 0_______ ASCII
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        // 10______ continuation
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        // 1100____ two byte lead
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        // 1101____ two byte lead
+        UTF8_TOO_SHORT,
+        // 1110____ three byte lead
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        // 1111____ four byte lead
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+            UTF8_OVERLONG_4,
+    };
+    static const u8 byte_1_low[16] = {
+        // ____0000
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        // ____0001
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        // ____001_
+        UTF8_CARRY,
+        UTF8_CARRY,
+        // ____0100
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        // ____0101 and above
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        // ____1101
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    };
+    static const u8 byte_2_high[16] = {
+        // 0_______ ASCII
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        // 1000____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+            UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        // 1001____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+            UTF8_TOO_LARGE,
+        // 101_____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+            UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+            UTF8_TOO_LARGE,
+        // 11______ lead
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    };
+
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = utf8_prev_avx2<1>(input, prev_input);
+    __m256i special_cases = _mm256_and_si256(
+        _mm256_and_si256(
+            utf8_lookup16_avx2(
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble),
+                byte_1_high),
+            utf8_lookup16_avx2(_mm256_and_si256(prev1, low_nibble),
+                               byte_1_low)),
+        utf8_lookup16_avx2(
+            _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble),
+            byte_2_high));
+
+    // Third and fourth bytes of 3 and 4 byte sequences have to be
+    // continuations, which the pair tables can't see
+    __m256i prev2 = utf8_prev_avx2<2>(input, prev_input);
+    __m256i prev3 = utf8_prev_avx2<3>(input, prev_input);
+    __m256i is_third_byte =
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i is_fourth_byte =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_be_continuation =
+        _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte),
+                         _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+// Non zero when the block ends in the middle of a sequence
+CORE_TARGET("avx2")
+inline __m256i utf8_is_incomplete_avx2(__m256i input) {
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+        (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_value);
+}
+
+// Returns the offset of the first 32 byte block containing, or following, an
+// error, or -1 if there is none.
+// source: Keiser, Lemire - Validating UTF-8 In Less Than One Instruction Per
+// Byte
+CORE_TARGET("avx2")
+inline isize utf8_find_error_block_avx2(const u8* data, isize size) {
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+
+    isize i = 0;
+    // The ASCII fast path works on 128 bytes. Deciding per 32 byte block
+    // mispredicts too often on text mixing ASCII with other characters.
+    for (; i + 128 <= size; i += 128) {
+        __m256i input[4];
+        for (isize j = 0; j < 4; j++) {
+            input[j] = _mm256_loadu_si256((const __m256i*)(data + i + j * 32));
+        }
+        __m256i any = _mm256_or_si256(_mm256_or_si256(input[0], input[1]),
+                                      _mm256_or_si256(input[2], input[3]));
+        if (_mm256_movemask_epi8(any) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            for (isize j = 0; j < 4; j++) {
+                error = _mm256_or_si256(
+                    error, utf8_check_block_avx2(input[j], prev_input));
+                prev_input = input[j];
+            }
+            prev_incomplete = utf8_is_incomplete_avx2(input[3]);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            return i;
+        }
+        prev_input = input[3];
+    }
+
+    // The last block is padded with zeros, so a sequence cut off by the end
+    // of the input is reported like one followed by ASCII
+    for (; i <= size; i += 32) {
+        __m256i input;
+        if (i + 32 <= size) {
+            input = _mm256_loadu_si256((const __m256i*)(data + i));
+        } else {
+            u8 buffer[32] = {};
+            memcpy(buffer, data + i, size - i);
+            input = _mm256_loadu_si256((const __m256i*)buffer);
+        }
+
+        error =
+            _mm256_or_si256(error, utf8_check_block_avx2(input, prev_input));
+        if (!_mm256_testz_si256(error, error)) {
+            return i;
+        }
+        prev_input = input;
+    }
+    return -1;
+}
+#endif
+
+inline Utf8Validation string_validate_utf8(String str) {
+    const u8* data = (const u8*)str.data;
+    isize start = 0;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        isize block = utf8_find_error_block_avx2(data, str.size);
+        if (block == -1) {
+            return Utf8Validation{true, -1};
+        }
+        // The error may belong to a sequence started up to 3 bytes before the
+        // block. Everything before is valid, so stepping back over
+        // continuation bytes finds the start of a sequence.
+        start = std::max(std::min(block, str.size) - 3, (isize)0);
+        while (start > 0 && (data[start] & 0xC0) == 0x80) {
+            start -= 1;
+        }
+    }
+#endif
+    isize error = utf8_validate_scalar(data, str.size, start);
+    return Utf8Validation{error == -1, error};
+}
+
 namespace std {
 template <> struct hash<String> {
     std::size_t operator()(String str) const {
@@ -1101,499 +1804,3445 @@ inline bool rune_iter_done(RuneIterator* it) {
 }
 
 /// ------------------
-/// Array
+/// Hashing
 /// ------------------
 
-template <typename T> struct Array {
-    Allocator alloc;
-    Slice<T> items;
-    isize capacity;
-};
+// Fast non cryptographic hashes, meant for hash tables and filters. Not stable
+// across versions of this library, don't persist them.
 
-template <typename T>
-inline void array_init(Array<T>* list, Allocator alloc, isize capacity = 0) {
-    core_assert(list != nullptr);
-    core_assert(alloc.alloc != nullptr);
-    core_assert(capacity > 0);
+// Finalizer of splitmix64, every input bit affects every output bit
+inline u64 hash_u64(u64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
 
-    list->alloc = alloc;
-    if (capacity > 0) {
-        list->items.data = core_alloc<T>(alloc, capacity);
-        list->items.size = 0;
-    }
-    list->capacity = capacity;
+// Multiplies and folds the 128 bit product
+inline u64 hash_mix(u64 a, u64 b) {
+    return (a * b) ^ mul_hi64(a, b);
 }
 
-template <typename T>
-inline Array<T> array_make(Allocator alloc, isize capacity = 0) {
-    Array<T> list;
-    array_init(&list, alloc, capacity);
-    return list;
+inline u64 hash_read_u64(const u8* p) {
+    u64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-template <typename T> inline void array_push(Array<T>* array, T item) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size >= 0);
-    core_assert(array->items.size <= array->capacity);
+inline u64 hash_read_u32(const u8* p) {
+    u32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
 
-    if (array->items.size + 1 > array->capacity) {
-        isize new_capacity = std::max(array->capacity * 2, (isize)4);
-        array->items.data = core_realloc<T>(array->alloc, array->items.data,
-                                            array->capacity * sizeof(T),
-                                            new_capacity * sizeof(T));
-        array->capacity = new_capacity;
+// Reads the input 8 bytes at a time. Short inputs are read with overlapping
+// loads instead of a byte loop. `fold` maps every 8 byte word before mixing,
+// it has to work bytewise, mapping zero bytes to zero.
+// source: wyhash (https://github.com/wangyi-fudan/wyhash)
+template <typename F>
+inline u64 hash_bytes_folded(const void* data, isize size, u64 seed, F fold) {
+    const u64 P0 = 0xa0761d6478bd642f;
+    const u64 P1 = 0xe7037ed1a0b428db;
+    const u64 P2 = 0x8ebc6af09c88c6e3;
+    const u64 P3 = 0x589965cc75374cc3;
+
+    const u8* p = (const u8*)data;
+    seed ^= hash_mix(seed ^ P0, P1);
+
+    u64 a = 0;
+    u64 b = 0;
+    if (size <= 16) {
+        if (size >= 4) {
+            isize middle = (size >> 3) << 2;
+            a = (hash_read_u32(p) << 32) | hash_read_u32(p + middle);
+            b = (hash_read_u32(p + size - 4) << 32) |
+                hash_read_u32(p + size - 4 - middle);
+        } else if (size > 0) {
+            a = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+        }
+        a = fold(a);
+        b = fold(b);
+    } else {
+        isize remaining = size;
+        if (remaining > 48) {
+            u64 seed1 = seed;
+            u64 seed2 = seed;
+            do {
+                seed = hash_mix(fold(hash_read_u64(p)) ^ P1,
+                                fold(hash_read_u64(p + 8)) ^ seed);
+                seed1 = hash_mix(fold(hash_read_u64(p + 16)) ^ P2,
+                                 fold(hash_read_u64(p + 24)) ^ seed1);
+                seed2 = hash_mix(fold(hash_read_u64(p + 32)) ^ P3,
+                                 fold(hash_read_u64(p + 40)) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = hash_mix(fold(hash_read_u64(p)) ^ P1,
+                            fold(hash_read_u64(p + 8)) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = fold(hash_read_u64(p + remaining - 16));
+        b = fold(hash_read_u64(p + remaining - 8));
     }
 
-    array->items[array->items.size++] = item;
+    return hash_mix(hash_mix(a ^ P1, b ^ seed) ^ P0 ^ (u64)size, P1);
 }
 
-template <typename T> inline void array_push_if_new(Array<T>* array, T item) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size >= 0);
-    core_assert(array->items.size <= array->capacity);
+inline u64 hash_bytes(const void* data, isize size, u64 seed = 0) {
+    return hash_bytes_folded(data, size, seed, [](u64 x) { return x; });
+}
 
-    if (!array_contains(array, item)) {
-        array_push(array, item);
-    }
+inline u64 hash_string(String str, u64 seed = 0) {
+    return hash_bytes(str.data, str.size, seed);
 }
 
-template <typename T>
-inline void array_push_slice(Array<T>* array, Slice<T> slice) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size >= 0);
-    core_assert(array->items.size <= array->capacity);
+/// ------------------
+/// ASCII case folding
+/// ------------------
 
-    isize new_size = array->items.size + slice.size;
-    if (new_size > array->capacity) {
-        isize new_capacity = std::max(array->capacity * 2, new_size);
-        array->items.data = core_realloc<T>(array->alloc, array->items.data,
-                                            array->capacity * sizeof(T),
-                                            new_capacity * sizeof(T));
-        array->capacity = new_capacity;
-    }
+// Case insensitive comparison and lowering for ASCII letters only. Other
+// bytes, including UTF-8 sequences, have to match exactly.
 
-    memcpy(array->items.data + array->items.size, slice.data,
-           sizeof(T) * slice.size);
-    array->items.size += slice.size;
+inline u8 ascii_to_lower(u8 c) {
+    return (u8)(c - 'A') < 26 ? c | 0x20 : c;
 }
 
-template <typename T> inline T array_pop(Array<T>* array) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
-
-    T item = array->items[array->items.size - 1];
-    array->items.size--;
-    return item;
+// Lowers the 8 bytes of `x` at once. Adding to the low 7 bits of each byte
+// can't carry into the next one, the sums tell which are in ['A', 'Z'].
+// source: http://0x80.pl/notesen/2016-01-06-swar-swap-case.html
+inline u64 ascii_to_lower_u64(u64 x) {
+    const u64 high_bits = 0x8080808080808080;
+    u64 low = x & ~high_bits;
+    u64 at_least_a = low + 0x3F3F3F3F3F3F3F3F; // 0x80 - 'A'
+    u64 above_z = low + 0x2525252525252525;    // 0x7F - 'Z'
+    u64 upper = (at_least_a ^ above_z) & ~x & high_bits;
+    return x | (upper >> 2);
 }
 
-template <typename T> inline void array_clear(Array<T>* array) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size <= array->capacity);
-
-    array->items.size = 0;
+inline void ascii_to_lower_scalar(u8* dst, const u8* src, isize size,
+                                  isize start) {
+    isize i = start;
+    for (; i + 8 <= size; i += 8) {
+        u64 value = ascii_to_lower_u64(hash_read_u64(src + i));
+        memcpy(dst + i, &value, sizeof(value));
+    }
+    for (; i < size; i++) {
+        dst[i] = ascii_to_lower(src[i]);
+    }
 }
 
-template <typename T>
-inline T array_remove_at_unordered(Array<T>* array, isize index) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index < array->items.size, "%ld >= %ld", index,
-                    array->items.size);
-
-    T value = array->items[index];
-    array->items[index] = array->items[array->items.size - 1];
-    array->items.size -= 1;
+inline bool ascii_equals_ignore_case_scalar(const u8* a, const u8* b,
+                                            isize size, isize start) {
+    isize i = start;
+    for (; i + 8 <= size; i += 8) {
+        if (ascii_to_lower_u64(hash_read_u64(a + i)) !=
+            ascii_to_lower_u64(hash_read_u64(b + i))) {
+            return false;
+        }
+    }
+    for (; i < size; i++) {
+        if (ascii_to_lower(a[i]) != ascii_to_lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    return value;
+#if CORE_X86_SIMD
+// Signed compares, bytes from 0x80 are negative and never letters
+CORE_TARGET("avx2")
+inline __m256i ascii_to_lower_avx2_block(__m256i x) {
+    __m256i at_least_a = _mm256_cmpgt_epi8(x, _mm256_set1_epi8('A' - 1));
+    __m256i above_z = _mm256_cmpgt_epi8(x, _mm256_set1_epi8('Z'));
+    __m256i upper = _mm256_andnot_si256(above_z, at_least_a);
+    return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
 }
 
-template <typename T>
-inline bool array_remove_unordered(Array<T>* array, T value) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
+CORE_TARGET("avx2")
+inline void ascii_to_lower_avx2(u8* dst, const u8* src, isize size) {
+    isize i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), ascii_to_lower_avx2_block(x));
+    }
+    ascii_to_lower_scalar(dst, src, size, i);
+}
 
-    for (isize i = 0; i < array->items.size; i++) {
-        if (array->items[i] == value) {
-            array_remove_at_unordered(array, i);
-            return true;
+CORE_TARGET("avx2")
+inline bool ascii_equals_ignore_case_avx2(const u8* a, const u8* b,
+                                          isize size) {
+    isize i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        // Equal bytes fold to equal bytes, only compare lowered differences
+        __m256i eq = _mm256_cmpeq_epi8(ascii_to_lower_avx2_block(x),
+                                       ascii_to_lower_avx2_block(y));
+        if ((u32)_mm256_movemask_epi8(eq) != 0xFFFFFFFF) {
+            return false;
         }
     }
-    return false;
+    return ascii_equals_ignore_case_scalar(a, b, size, i);
 }
+#endif
 
-template <typename T> inline isize array_index_of(Array<T>* array, T value) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
+// Lowers `size` bytes from `src` to `dst`, which may be the same buffer
+inline void ascii_to_lower(char* dst, const char* src, isize size) {
+    core_assert(size >= 0);
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        ascii_to_lower_avx2((u8*)dst, (const u8*)src, size);
+        return;
+    }
+#endif
+    ascii_to_lower_scalar((u8*)dst, (const u8*)src, size, 0);
+}
 
-    for (isize i = 0; i < array->items.size; i++) {
-        if (array->items[i] == value) {
-            return i;
-        }
+// Lowered copy of `str`, free with core_free or reset the arena
+inline String string_to_lower_ascii(String str, Allocator alloc) {
+    char* data = core_alloc<char>(alloc, str.size + 1);
+    ascii_to_lower(data, str.data, str.size);
+    data[str.size] = '\0';
+    return String{data, str.size};
+}
+
+inline bool string_equals_ignore_case_ascii(String a, String b) {
+    if (a.size != b.size) {
+        return false;
     }
-    return -1;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return ascii_equals_ignore_case_avx2((const u8*)a.data,
+                                             (const u8*)b.data, a.size);
+    }
+#endif
+    return ascii_equals_ignore_case_scalar((const u8*)a.data,
+                                           (const u8*)b.data, a.size, 0);
 }
 
-template <typename T> inline T array_remove_at(Array<T>* array, isize index) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index < array->items.size, "%ld >= %ld", index,
-                    array->items.size);
+// Same as hash_string of the lowered string, without making it
+inline u64 hash_string_ignore_case(String str, u64 seed = 0) {
+    return hash_bytes_folded(str.data, str.size, seed, ascii_to_lower_u64);
+}
 
-    T value = array->items[index];
-    memmove(array->items.data + index, array->items.data + index + 1,
-            (array->items.size - index - 1) * sizeof(T));
+// Hash container key comparing and hashing ASCII case insensitively, e.g.
+// HashMap<IgnoreCaseString, V>. Lookups don't allocate lowered copies.
+struct IgnoreCaseString {
+    String str;
+};
 
-    return value;
+inline IgnoreCaseString ignore_case(String str) {
+    return IgnoreCaseString{str};
 }
 
-template <typename T> inline void array_remove(Array<T>* array, T value) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
+inline bool operator==(IgnoreCaseString a, IgnoreCaseString b) {
+    return string_equals_ignore_case_ascii(a.str, b.str);
+}
 
-    for (isize i = 0; i < array->items.size; i++) {
-        if (array->items[i] == value) {
-            array_remove_at(array, i);
-            return;
-        }
-    }
+inline bool operator!=(IgnoreCaseString a, IgnoreCaseString b) {
+    return !(a == b);
 }
 
-template <typename T>
-inline void array_insert(Array<T>* array, isize index, T value) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index <= array->size, "%ld > %ld", index, array->size);
+namespace std {
+template <> struct hash<IgnoreCaseString> {
+    std::size_t operator()(IgnoreCaseString key) const {
+        return hash_string_ignore_case(key.str);
+    }
+};
+} // namespace std
 
-    array_push(array, value);
+/// ------------------
+/// Inline string
+/// ------------------
 
-    for (isize i = array->size - 1; i > index; i--) {
-        array->data[i] = array->data[i - 1];
+// Owning string that keeps up to N bytes inside the struct and only
+// allocates longer ones, for the many short names and keys. With the default
+// N = 22 it is 24 bytes, the size of a String plus a byte. The last byte is
+// the inline size, or INLINE_STRING_ON_HEAP when the bytes live in `heap`.
+// The contents are always null terminated. The allocator isn't stored,
+// pass the same one to inline_string_free. Copies share the heap bytes, free
+// only one of them. Zeroed memory is an empty string.
+const u8 INLINE_STRING_ON_HEAP = 0xFF;
+
+template <isize N = 22> struct InlineString {
+    static_assert(N >= 15 && N < INLINE_STRING_ON_HEAP,
+                  "The heap fields and the tag have to fit");
+
+    union {
+        char bytes[N + 2];
+        struct {
+            char* data;
+            isize size;
+        } heap;
+    };
+};
+
+template <isize N>
+inline bool inline_string_is_inline(const InlineString<N>* str) {
+    return (u8)str->bytes[N + 1] != INLINE_STRING_ON_HEAP;
+}
+
+template <isize N>
+inline void inline_string_init(InlineString<N>* str, String value,
+                               Allocator alloc) {
+    core_assert(str != nullptr);
+    if (value.size <= N) {
+        memcpy(str->bytes, value.data, value.size);
+        memset(str->bytes + value.size, 0, N + 1 - value.size);
+        str->bytes[N + 1] = (char)value.size;
+        return;
     }
+    char* data = core_alloc<char>(alloc, value.size + 1);
+    memcpy(data, value.data, value.size);
+    data[value.size] = '\0';
+    str->heap.data = data;
+    str->heap.size = value.size;
+    str->bytes[N + 1] = (char)INLINE_STRING_ON_HEAP;
+}
 
-    array->data[index] = value;
+template <isize N = 22>
+inline InlineString<N> inline_string_make(String value, Allocator alloc) {
+    InlineString<N> str;
+    inline_string_init(&str, value, alloc);
+    return str;
 }
 
-template <typename T>
-inline void array_swap(Array<T>* array, isize index_a, isize index_b) {
-    core_assert_msg(index_a >= 0, "%ld < 0", index_a);
-    core_assert_msg(index_b >= 0, "%ld < 0", index_b);
-    core_assert_msg(index_a < array->size, "%ld >= %ld", index_a, array->size);
-    core_assert_msg(index_b < array->size, "%ld >= %ld", index_b, array->size);
+template <isize N> inline isize inline_string_size(const InlineString<N>* str) {
+    if (inline_string_is_inline(str)) {
+        return (u8)str->bytes[N + 1];
+    }
+    return str->heap.size;
+}
 
-    T temp = array->items[index_a];
-    array->items[index_a] = array->items[index_b];
-    array->items[index_b] = temp;
+template <isize N>
+inline const char* inline_string_cstr(const InlineString<N>* str) {
+    return inline_string_is_inline(str) ? str->bytes : str->heap.data;
 }
 
-template <typename T> inline bool array_contains(Array<T>* array, T value) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
+// View of the contents, valid until `str` moves or is freed
+template <isize N>
+inline String inline_string_to_string(const InlineString<N>* str) {
+    if (inline_string_is_inline(str)) {
+        return String{str->bytes, (u8)str->bytes[N + 1]};
+    }
+    return String{str->heap.data, str->heap.size};
+}
 
-    for (isize i = 0; i < array->items.size; i++) {
-        if (array->items[i] == value) {
-            return true;
-        }
+template <isize N>
+inline void inline_string_free(InlineString<N>* str, Allocator alloc) {
+    core_assert(str != nullptr);
+    if (!inline_string_is_inline(str)) {
+        core_free(alloc, str->heap.data);
     }
-    return false;
+    memset(str->bytes, 0, sizeof(str->bytes));
 }
 
-template <typename T> inline T array_last(Array<T>* array) {
-    core_assert(array != nullptr);
-    core_assert(array->alloc.alloc != nullptr);
-    core_assert(array->items.data != nullptr);
-    core_assert(array->items.size > 0);
-    core_assert(array->items.size <= array->capacity);
+template <isize N>
+inline bool operator==(const InlineString<N>& a, const InlineString<N>& b) {
+    return inline_string_to_string(&a) == inline_string_to_string(&b);
+}
 
-    return array->items[array->items.size - 1];
+template <isize N>
+inline bool operator!=(const InlineString<N>& a, const InlineString<N>& b) {
+    return !(a == b);
+}
+
+template <isize N>
+inline bool operator==(const InlineString<N>& a, String b) {
+    return inline_string_to_string(&a) == b;
 }
 
+namespace std {
+template <isize N> struct hash<InlineString<N>> {
+    std::size_t operator()(const InlineString<N>& str) const {
+        return hash_string(inline_string_to_string(&str));
+    }
+};
+} // namespace std
+
 /// ------------------
-/// Ring buffer
+/// Number parsing and formatting
 /// ------------------
 
-inline isize mod_by_power_of_two(isize x, isize m) {
-    core_assert_msg((m & (m - 1)) == 0, "m must be a power of 2");
+// Parsers consume the longest valid prefix of the string and advance it past
+// the number. Nothing is skipped before the number, there is no locale and
+// the input doesn't have to be null terminated.
+enum class ParseError {
+    InvalidNumber,
+    Overflow,
+};
 
-    return x & (m - 1);
+inline bool parse_is_digit(u8 c) {
+    return (u8)(c - '0') < 10;
 }
 
-template <typename T> struct RingBuffer {
-    Allocator alloc;
-    T* data;
-    isize capacity;
-    // This is a position. Not an index. It can be larger than capacity.
-    // To get the index, do start_pos % capacity
-    isize start_pos;
-    // This is a position. Not an index. It can be larger than capacity.
-    // To get the index, do end_pos % capacity
-    isize end_pos;
+// Value of 8 digits, already minus '0', with the first one in the lowest byte.
+// Combines pairs, then quads, then halves inside one register.
+// source: https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+inline u64 parse_8_digits(u64 v) {
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FF) * 0x000F424000000064) +
+         (((v >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >>
+        32;
+    return v;
+}
 
-    T& operator[](isize index) {
-        core_assert(index >= 0);
-        core_assert(index < ring_buffer_size(this));
+// Accumulates digits into `value` until the first non digit, wrapping on
+// overflow. Callers count the digits to detect it.
+inline u64 parse_digits(const u8** cursor, const u8* end, u64 value) {
+    static const u64 POWERS_OF_TEN[9] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    };
 
-        isize real_index = mod_by_power_of_two((start_pos + index), capacity);
-        return this->data[real_index];
+    const u8* p = *cursor;
+    while (end - p >= 8) {
+        u64 v;
+        memcpy(&v, p, sizeof(v));
+        // Borrows and carries only move to later bytes, so the lowest flagged
+        // byte is the first non digit
+        u64 digits = v - 0x3030303030303030;
+        u64 non_digits =
+            ((v + 0x4646464646464646) | digits) & 0x8080808080808080;
+        if (non_digits == 0) {
+            value = value * 100000000 + parse_8_digits(digits);
+            p += 8;
+            continue;
+        }
+
+        // Move the n digits to the top, the zeros below act as leading zeros.
+        // Shifting in two steps keeps n = 0 defined.
+        isize n = ctz64(non_digits) >> 3;
+        digits = (digits << (63 - 8 * n)) << 1;
+        value = value * POWERS_OF_TEN[n] + parse_8_digits(digits);
+        *cursor = p + n;
+        return value;
     }
 
-    const T& operator[](isize index) const {
-        core_assert(index >= 0);
-        core_assert(index < ring_buffer_size(this));
+    while (p < end && parse_is_digit(*p)) {
+        value = value * 10 + (u64)(*p - '0');
+        p++;
+    }
+    *cursor = p;
+    return value;
+}
 
-        isize real_index = mod_by_power_of_two((start_pos + index), capacity);
-        return this->data[real_index];
+inline void parse_advance(String* str, const u8* p) {
+    isize consumed = p - (const u8*)str->data;
+    str->data += consumed;
+    str->size -= consumed;
+}
+
+// Parses the digits after an optional sign into a magnitude
+inline Result<u64, ParseError> parse_magnitude(const u8** cursor,
+                                               const u8* end) {
+    const u8* p = *cursor;
+    const u8* digits_start = p;
+    while (p < end && *p == '0') {
+        p++;
+    }
+    const u8* significant = p;
+    u64 value = parse_digits(&p, end, 0);
+    if (p == digits_start) {
+        return result_err(ParseError::InvalidNumber);
     }
-};
 
-template <typename T> inline isize ring_buffer_size(RingBuffer<T>* rb) {
-    return rb->end_pos - rb->start_pos;
+    // 20 digits only fit when the first one is 1 and the sum didn't wrap
+    isize digit_count = p - significant;
+    if (digit_count > 20 ||
+        (digit_count == 20 &&
+         (*significant != '1' || value < 10000000000000000000ull))) {
+        return result_err(ParseError::Overflow);
+    }
+
+    *cursor = p;
+    return result_ok(value);
 }
 
-template <typename T>
-inline void ring_buffer_init(RingBuffer<T>* ring_buffer, isize capacity,
-                             Allocator alloc) {
-    core_assert(ring_buffer != nullptr);
-    core_assert(capacity > 0);
-    core_assert_msg((capacity & (capacity - 1)) == 0,
-                    "Capacity must be a power of 2");
-    ring_buffer->alloc = alloc;
-    ring_buffer->data = core_alloc<T>(alloc, capacity);
-    ring_buffer->capacity = capacity;
-    ring_buffer->start_pos = 0;
-    ring_buffer->end_pos = 0;
+// Accepts an optional '+'
+inline Result<u64, ParseError> string_parse_u64(String* str) {
+    core_assert(str != nullptr);
+    const u8* p = (const u8*)str->data;
+    const u8* end = p + str->size;
+    if (p < end && *p == '+') {
+        p++;
+    }
+
+    Result<u64, ParseError> result = parse_magnitude(&p, end);
+    if (result.is_ok) {
+        parse_advance(str, p);
+    }
+    return result;
 }
 
-template <typename T>
-inline RingBuffer<T> ring_buffer_make(isize capacity, Allocator alloc) {
-    RingBuffer<T> buffer = {};
-    ring_buffer_init(&buffer, capacity, alloc);
-    return buffer;
+// Accepts an optional '+' or '-'
+inline Result<i64, ParseError> string_parse_i64(String* str) {
+    core_assert(str != nullptr);
+    const u8* p = (const u8*)str->data;
+    const u8* end = p + str->size;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+
+    Result<u64, ParseError> magnitude = parse_magnitude(&p, end);
+    if (!magnitude.is_ok) {
+        return result_err(magnitude.error);
+    }
+    if (magnitude.value > (u64)INT64_MAX + negative) {
+        return result_err(ParseError::Overflow);
+    }
+
+    parse_advance(str, p);
+    i64 value = negative ? (i64)(0 - magnitude.value) : (i64)magnitude.value;
+    return result_ok(value);
 }
 
-template <typename T>
-inline void ring_buffer_push_end(RingBuffer<T>* ring_buffer, T value) {
-    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
-    core_assert(ring_buffer->capacity > 0);
-    core_assert(ring_buffer->data);
+// Truncated 128 bit powers of five from 5^-342 to 5^308, normalized so the
+// top bit is set. Negative powers are rounded up.
+// source: fast_float (https://github.com/fastfloat/fast_float)
+const isize PARSE_SMALLEST_POWER_OF_TEN = -342;
+const isize PARSE_LARGEST_POWER_OF_TEN = 308;
 
-    isize size = ring_buffer_size(ring_buffer);
+struct ParsePowerOfFive {
+    u64 high;
+    u64 low;
+};
 
-    // Grow
-    if (size == ring_buffer->capacity) {
-        isize new_capacity = ring_buffer->capacity * 2;
-        T* new_data = core_alloc<T>(ring_buffer->alloc, new_capacity);
+static const ParsePowerOfFive PARSE_POWERS_OF_FIVE[] = {
+    {0xeef453d6923bd65a, 0x113faa2906a13b3f},
+    {0x9558b4661b6565f8, 0x4ac7ca59a424c507},
+    {0xbaaee17fa23ebf76, 0x5d79bcf00d2df649},
+    {0xe95a99df8ace6f53, 0xf4d82c2c107973dc},
+    {0x91d8a02bb6c10594, 0x79071b9b8a4be869},
+    {0xb64ec836a47146f9, 0x9748e2826cdee284},
+    {0xe3e27a444d8d98b7, 0xfd1b1b2308169b25},
+    {0x8e6d8c6ab0787f72, 0xfe30f0f5e50e20f7},
+    {0xb208ef855c969f4f, 0xbdbd2d335e51a935},
+    {0xde8b2b66b3bc4723, 0xad2c788035e61382},
+    {0x8b16fb203055ac76, 0x4c3bcb5021afcc31},
+    {0xaddcb9e83c6b1793, 0xdf4abe242a1bbf3d},
+    {0xd953e8624b85dd78, 0xd71d6dad34a2af0d},
+    {0x87d4713d6f33aa6b, 0x8672648c40e5ad68},
+    {0xa9c98d8ccb009506, 0x680efdaf511f18c2},
+    {0xd43bf0effdc0ba48, 0x0212bd1b2566def2},
+    {0x84a57695fe98746d, 0x014bb630f7604b57},
+    {0xa5ced43b7e3e9188, 0x419ea3bd35385e2d},
+    {0xcf42894a5dce35ea, 0x52064cac828675b9},
+    {0x818995ce7aa0e1b2, 0x7343efebd1940993},
+    {0xa1ebfb4219491a1f, 0x1014ebe6c5f90bf8},
+    {0xca66fa129f9b60a6, 0xd41a26e077774ef6},
+    {0xfd00b897478238d0, 0x8920b098955522b4},
+    {0x9e20735e8cb16382, 0x55b46e5f5d5535b0},
+    {0xc5a890362fddbc62, 0xeb2189f734aa831d},
+    {0xf712b443bbd52b7b, 0xa5e9ec7501d523e4},
+    {0x9a6bb0aa55653b2d, 0x47b233c92125366e},
+    {0xc1069cd4eabe89f8, 0x999ec0bb696e840a},
+    {0xf148440a256e2c76, 0xc00670ea43ca250d},
+    {0x96cd2a865764dbca, 0x380406926a5e5728},
+    {0xbc807527ed3e12bc, 0xc605083704f5ecf2},
+    {0xeba09271e88d976b, 0xf7864a44c633682e},
+    {0x93445b8731587ea3, 0x7ab3ee6afbe0211d},
+    {0xb8157268fdae9e4c, 0x5960ea05bad82964},
+    {0xe61acf033d1a45df, 0x6fb92487298e33bd},
+    {0x8fd0c16206306bab, 0xa5d3b6d479f8e056},
+    {0xb3c4f1ba87bc8696, 0x8f48a4899877186c},
+    {0xe0b62e2929aba83c, 0x331acdabfe94de87},
+    {0x8c71dcd9ba0b4925, 0x9ff0c08b7f1d0b14},
+    {0xaf8e5410288e1b6f, 0x07ecf0ae5ee44dd9},
+    {0xdb71e91432b1a24a, 0xc9e82cd9f69d6150},
+    {0x892731ac9faf056e, 0xbe311c083a225cd2},
+    {0xab70fe17c79ac6ca, 0x6dbd630a48aaf406},
+    {0xd64d3d9db981787d, 0x092cbbccdad5b108},
+    {0x85f0468293f0eb4e, 0x25bbf56008c58ea5},
+    {0xa76c582338ed2621, 0xaf2af2b80af6f24e},
+    {0xd1476e2c07286faa, 0x1af5af660db4aee1},
+    {0x82cca4db847945ca, 0x50d98d9fc890ed4d},
+    {0xa37fce126597973c, 0xe50ff107bab528a0},
+    {0xcc5fc196fefd7d0c, 0x1e53ed49a96272c8},
+    {0xff77b1fcbebcdc4f, 0x25e8e89c13bb0f7a},
+    {0x9faacf3df73609b1, 0x77b191618c54e9ac},
+    {0xc795830d75038c1d, 0xd59df5b9ef6a2417},
+    {0xf97ae3d0d2446f25, 0x4b0573286b44ad1d},
+    {0x9becce62836ac577, 0x4ee367f9430aec32},
+    {0xc2e801fb244576d5, 0x229c41f793cda73f},
+    {0xf3a20279ed56d48a, 0x6b43527578c1110f},
+    {0x9845418c345644d6, 0x830a13896b78aaa9},
+    {0xbe5691ef416bd60c, 0x23cc986bc656d553},
+    {0xedec366b11c6cb8f, 0x2cbfbe86b7ec8aa8},
+    {0x94b3a202eb1c3f39, 0x7bf7d71432f3d6a9},
+    {0xb9e08a83a5e34f07, 0xdaf5ccd93fb0cc53},
+    {0xe858ad248f5c22c9, 0xd1b3400f8f9cff68},
+    {0x91376c36d99995be, 0x23100809b9c21fa1},
+    {0xb58547448ffffb2d, 0xabd40a0c2832a78a},
+    {0xe2e69915b3fff9f9, 0x16c90c8f323f516c},
+    {0x8dd01fad907ffc3b, 0xae3da7d97f6792e3},
+    {0xb1442798f49ffb4a, 0x99cd11cfdf41779c},
+    {0xdd95317f31c7fa1d, 0x40405643d711d583},
+    {0x8a7d3eef7f1cfc52, 0x482835ea666b2572},
+    {0xad1c8eab5ee43b66, 0xda3243650005eecf},
+    {0xd863b256369d4a40, 0x90bed43e40076a82},
+    {0x873e4f75e2224e68, 0x5a7744a6e804a291},
+    {0xa90de3535aaae202, 0x711515d0a205cb36},
+    {0xd3515c2831559a83, 0x0d5a5b44ca873e03},
+    {0x8412d9991ed58091, 0xe858790afe9486c2},
+    {0xa5178fff668ae0b6, 0x626e974dbe39a872},
+    {0xce5d73ff402d98e3, 0xfb0a3d212dc8128f},
+    {0x80fa687f881c7f8e, 0x7ce66634bc9d0b99},
+    {0xa139029f6a239f72, 0x1c1fffc1ebc44e80},
+    {0xc987434744ac874e, 0xa327ffb266b56220},
+    {0xfbe9141915d7a922, 0x4bf1ff9f0062baa8},
+    {0x9d71ac8fada6c9b5, 0x6f773fc3603db4a9},
+    {0xc4ce17b399107c22, 0xcb550fb4384d21d3},
+    {0xf6019da07f549b2b, 0x7e2a53a146606a48},
+    {0x99c102844f94e0fb, 0x2eda7444cbfc426d},
+    {0xc0314325637a1939, 0xfa911155fefb5308},
+    {0xf03d93eebc589f88, 0x793555ab7eba27ca},
+    {0x96267c7535b763b5, 0x4bc1558b2f3458de},
+    {0xbbb01b9283253ca2, 0x9eb1aaedfb016f16},
+    {0xea9c227723ee8bcb, 0x465e15a979c1cadc},
+    {0x92a1958a7675175f, 0x0bfacd89ec191ec9},
+    {0xb749faed14125d36, 0xcef980ec671f667b},
+    {0xe51c79a85916f484, 0x82b7e12780e7401a},
+    {0x8f31cc0937ae58d2, 0xd1b2ecb8b0908810},
+    {0xb2fe3f0b8599ef07, 0x861fa7e6dcb4aa15},
+    {0xdfbdcece67006ac9, 0x67a791e093e1d49a},
+    {0x8bd6a141006042bd, 0xe0c8bb2c5c6d24e0},
+    {0xaecc49914078536d, 0x58fae9f773886e18},
+    {0xda7f5bf590966848, 0xaf39a475506a899e},
+    {0x888f99797a5e012d, 0x6d8406c952429603},
+    {0xaab37fd7d8f58178, 0xc8e5087ba6d33b83},
+    {0xd5605fcdcf32e1d6, 0xfb1e4a9a90880a64},
+    {0x855c3be0a17fcd26, 0x5cf2eea09a55067f},
+    {0xa6b34ad8c9dfc06f, 0xf42faa48c0ea481e},
+    {0xd0601d8efc57b08b, 0xf13b94daf124da26},
+    {0x823c12795db6ce57, 0x76c53d08d6b70858},
+    {0xa2cb1717b52481ed, 0x54768c4b0c64ca6e},
+    {0xcb7ddcdda26da268, 0xa9942f5dcf7dfd09},
+    {0xfe5d54150b090b02, 0xd3f93b35435d7c4c},
+    {0x9efa548d26e5a6e1, 0xc47bc5014a1a6daf},
+    {0xc6b8e9b0709f109a, 0x359ab6419ca1091b},
+    {0xf867241c8cc6d4c0, 0xc30163d203c94b62},
+    {0x9b407691d7fc44f8, 0x79e0de63425dcf1d},
+    {0xc21094364dfb5636, 0x985915fc12f542e4},
+    {0xf294b943e17a2bc4, 0x3e6f5b7b17b2939d},
+    {0x979cf3ca6cec5b5a, 0xa705992ceecf9c42},
+    {0xbd8430bd08277231, 0x50c6ff782a838353},
+    {0xece53cec4a314ebd, 0xa4f8bf5635246428},
+    {0x940f4613ae5ed136, 0x871b7795e136be99},
+    {0xb913179899f68584, 0x28e2557b59846e3f},
+    {0xe757dd7ec07426e5, 0x331aeada2fe589cf},
+    {0x9096ea6f3848984f, 0x3ff0d2c85def7621},
+    {0xb4bca50b065abe63, 0x0fed077a756b53a9},
+    {0xe1ebce4dc7f16dfb, 0xd3e8495912c62894},
+    {0x8d3360f09cf6e4bd, 0x64712dd7abbbd95c},
+    {0xb080392cc4349dec, 0xbd8d794d96aacfb3},
+    {0xdca04777f541c567, 0xecf0d7a0fc5583a0},
+    {0x89e42caaf9491b60, 0xf41686c49db57244},
+    {0xac5d37d5b79b6239, 0x311c2875c522ced5},
+    {0xd77485cb25823ac7, 0x7d633293366b828b},
+    {0x86a8d39ef77164bc, 0xae5dff9c02033197},
+    {0xa8530886b54dbdeb, 0xd9f57f830283fdfc},
+    {0xd267caa862a12d66, 0xd072df63c324fd7b},
+    {0x8380dea93da4bc60, 0x4247cb9e59f71e6d},
+    {0xa46116538d0deb78, 0x52d9be85f074e608},
+    {0xcd795be870516656, 0x67902e276c921f8b},
+    {0x806bd9714632dff6, 0x00ba1cd8a3db53b6},
+    {0xa086cfcd97bf97f3, 0x80e8a40eccd228a4},
+    {0xc8a883c0fdaf7df0, 0x6122cd128006b2cd},
+    {0xfad2a4b13d1b5d6c, 0x796b805720085f81},
+    {0x9cc3a6eec6311a63, 0xcbe3303674053bb0},
+    {0xc3f490aa77bd60fc, 0xbedbfc4411068a9c},
+    {0xf4f1b4d515acb93b, 0xee92fb5515482d44},
+    {0x991711052d8bf3c5, 0x751bdd152d4d1c4a},
+    {0xbf5cd54678eef0b6, 0xd262d45a78a0635d},
+    {0xef340a98172aace4, 0x86fb897116c87c34},
+    {0x9580869f0e7aac0e, 0xd45d35e6ae3d4da0},
+    {0xbae0a846d2195712, 0x8974836059cca109},
+    {0xe998d258869facd7, 0x2bd1a438703fc94b},
+    {0x91ff83775423cc06, 0x7b6306a34627ddcf},
+    {0xb67f6455292cbf08, 0x1a3bc84c17b1d542},
+    {0xe41f3d6a7377eeca, 0x20caba5f1d9e4a93},
+    {0x8e938662882af53e, 0x547eb47b7282ee9c},
+    {0xb23867fb2a35b28d, 0xe99e619a4f23aa43},
+    {0xdec681f9f4c31f31, 0x6405fa00e2ec94d4},
+    {0x8b3c113c38f9f37e, 0xde83bc408dd3dd04},
+    {0xae0b158b4738705e, 0x9624ab50b148d445},
+    {0xd98ddaee19068c76, 0x3badd624dd9b0957},
+    {0x87f8a8d4cfa417c9, 0xe54ca5d70a80e5d6},
+    {0xa9f6d30a038d1dbc, 0x5e9fcf4ccd211f4c},
+    {0xd47487cc8470652b, 0x7647c3200069671f},
+    {0x84c8d4dfd2c63f3b, 0x29ecd9f40041e073},
+    {0xa5fb0a17c777cf09, 0xf468107100525890},
+    {0xcf79cc9db955c2cc, 0x7182148d4066eeb4},
+    {0x81ac1fe293d599bf, 0xc6f14cd848405530},
+    {0xa21727db38cb002f, 0xb8ada00e5a506a7c},
+    {0xca9cf1d206fdc03b, 0xa6d90811f0e4851c},
+    {0xfd442e4688bd304a, 0x908f4a166d1da663},
+    {0x9e4a9cec15763e2e, 0x9a598e4e043287fe},
+    {0xc5dd44271ad3cdba, 0x40eff1e1853f29fd},
+    {0xf7549530e188c128, 0xd12bee59e68ef47c},
+    {0x9a94dd3e8cf578b9, 0x82bb74f8301958ce},
+    {0xc13a148e3032d6e7, 0xe36a52363c1faf01},
+    {0xf18899b1bc3f8ca1, 0xdc44e6c3cb279ac1},
+    {0x96f5600f15a7b7e5, 0x29ab103a5ef8c0b9},
+    {0xbcb2b812db11a5de, 0x7415d448f6b6f0e7},
+    {0xebdf661791d60f56, 0x111b495b3464ad21},
+    {0x936b9fcebb25c995, 0xcab10dd900beec34},
+    {0xb84687c269ef3bfb, 0x3d5d514f40eea742},
+    {0xe65829b3046b0afa, 0x0cb4a5a3112a5112},
+    {0x8ff71a0fe2c2e6dc, 0x47f0e785eaba72ab},
+    {0xb3f4e093db73a093, 0x59ed216765690f56},
+    {0xe0f218b8d25088b8, 0x306869c13ec3532c},
+    {0x8c974f7383725573, 0x1e414218c73a13fb},
+    {0xafbd2350644eeacf, 0xe5d1929ef90898fa},
+    {0xdbac6c247d62a583, 0xdf45f746b74abf39},
+    {0x894bc396ce5da772, 0x6b8bba8c328eb783},
+    {0xab9eb47c81f5114f, 0x066ea92f3f326564},
+    {0xd686619ba27255a2, 0xc80a537b0efefebd},
+    {0x8613fd0145877585, 0xbd06742ce95f5f36},
+    {0xa798fc4196e952e7, 0x2c48113823b73704},
+    {0xd17f3b51fca3a7a0, 0xf75a15862ca504c5},
+    {0x82ef85133de648c4, 0x9a984d73dbe722fb},
+    {0xa3ab66580d5fdaf5, 0xc13e60d0d2e0ebba},
+    {0xcc963fee10b7d1b3, 0x318df905079926a8},
+    {0xffbbcfe994e5c61f, 0xfdf17746497f7052},
+    {0x9fd561f1fd0f9bd3, 0xfeb6ea8bedefa633},
+    {0xc7caba6e7c5382c8, 0xfe64a52ee96b8fc0},
+    {0xf9bd690a1b68637b, 0x3dfdce7aa3c673b0},
+    {0x9c1661a651213e2d, 0x06bea10ca65c084e},
+    {0xc31bfa0fe5698db8, 0x486e494fcff30a62},
+    {0xf3e2f893dec3f126, 0x5a89dba3c3efccfa},
+    {0x986ddb5c6b3a76b7, 0xf89629465a75e01c},
+    {0xbe89523386091465, 0xf6bbb397f1135823},
+    {0xee2ba6c0678b597f, 0x746aa07ded582e2c},
+    {0x94db483840b717ef, 0xa8c2a44eb4571cdc},
+    {0xba121a4650e4ddeb, 0x92f34d62616ce413},
+    {0xe896a0d7e51e1566, 0x77b020baf9c81d17},
+    {0x915e2486ef32cd60, 0x0ace1474dc1d122e},
+    {0xb5b5ada8aaff80b8, 0x0d819992132456ba},
+    {0xe3231912d5bf60e6, 0x10e1fff697ed6c69},
+    {0x8df5efabc5979c8f, 0xca8d3ffa1ef463c1},
+    {0xb1736b96b6fd83b3, 0xbd308ff8a6b17cb2},
+    {0xddd0467c64bce4a0, 0xac7cb3f6d05ddbde},
+    {0x8aa22c0dbef60ee4, 0x6bcdf07a423aa96b},
+    {0xad4ab7112eb3929d, 0x86c16c98d2c953c6},
+    {0xd89d64d57a607744, 0xe871c7bf077ba8b7},
+    {0x87625f056c7c4a8b, 0x11471cd764ad4972},
+    {0xa93af6c6c79b5d2d, 0xd598e40d3dd89bcf},
+    {0xd389b47879823479, 0x4aff1d108d4ec2c3},
+    {0x843610cb4bf160cb, 0xcedf722a585139ba},
+    {0xa54394fe1eedb8fe, 0xc2974eb4ee658828},
+    {0xce947a3da6a9273e, 0x733d226229feea32},
+    {0x811ccc668829b887, 0x0806357d5a3f525f},
+    {0xa163ff802a3426a8, 0xca07c2dcb0cf26f7},
+    {0xc9bcff6034c13052, 0xfc89b393dd02f0b5},
+    {0xfc2c3f3841f17c67, 0xbbac2078d443ace2},
+    {0x9d9ba7832936edc0, 0xd54b944b84aa4c0d},
+    {0xc5029163f384a931, 0x0a9e795e65d4df11},
+    {0xf64335bcf065d37d, 0x4d4617b5ff4a16d5},
+    {0x99ea0196163fa42e, 0x504bced1bf8e4e45},
+    {0xc06481fb9bcf8d39, 0xe45ec2862f71e1d6},
+    {0xf07da27a82c37088, 0x5d767327bb4e5a4c},
+    {0x964e858c91ba2655, 0x3a6a07f8d510f86f},
+    {0xbbe226efb628afea, 0x890489f70a55368b},
+    {0xeadab0aba3b2dbe5, 0x2b45ac74ccea842e},
+    {0x92c8ae6b464fc96f, 0x3b0b8bc90012929d},
+    {0xb77ada0617e3bbcb, 0x09ce6ebb40173744},
+    {0xe55990879ddcaabd, 0xcc420a6a101d0515},
+    {0x8f57fa54c2a9eab6, 0x9fa946824a12232d},
+    {0xb32df8e9f3546564, 0x47939822dc96abf9},
+    {0xdff9772470297ebd, 0x59787e2b93bc56f7},
+    {0x8bfbea76c619ef36, 0x57eb4edb3c55b65a},
+    {0xaefae51477a06b03, 0xede622920b6b23f1},
+    {0xdab99e59958885c4, 0xe95fab368e45eced},
+    {0x88b402f7fd75539b, 0x11dbcb0218ebb414},
+    {0xaae103b5fcd2a881, 0xd652bdc29f26a119},
+    {0xd59944a37c0752a2, 0x4be76d3346f0495f},
+    {0x857fcae62d8493a5, 0x6f70a4400c562ddb},
+    {0xa6dfbd9fb8e5b88e, 0xcb4ccd500f6bb952},
+    {0xd097ad07a71f26b2, 0x7e2000a41346a7a7},
+    {0x825ecc24c873782f, 0x8ed400668c0c28c8},
+    {0xa2f67f2dfa90563b, 0x728900802f0f32fa},
+    {0xcbb41ef979346bca, 0x4f2b40a03ad2ffb9},
+    {0xfea126b7d78186bc, 0xe2f610c84987bfa8},
+    {0x9f24b832e6b0f436, 0x0dd9ca7d2df4d7c9},
+    {0xc6ede63fa05d3143, 0x91503d1c79720dbb},
+    {0xf8a95fcf88747d94, 0x75a44c6397ce912a},
+    {0x9b69dbe1b548ce7c, 0xc986afbe3ee11aba},
+    {0xc24452da229b021b, 0xfbe85badce996168},
+    {0xf2d56790ab41c2a2, 0xfae27299423fb9c3},
+    {0x97c560ba6b0919a5, 0xdccd879fc967d41a},
+    {0xbdb6b8e905cb600f, 0x5400e987bbc1c920},
+    {0xed246723473e3813, 0x290123e9aab23b68},
+    {0x9436c0760c86e30b, 0xf9a0b6720aaf6521},
+    {0xb94470938fa89bce, 0xf808e40e8d5b3e69},
+    {0xe7958cb87392c2c2, 0xb60b1d1230b20e04},
+    {0x90bd77f3483bb9b9, 0xb1c6f22b5e6f48c2},
+    {0xb4ecd5f01a4aa828, 0x1e38aeb6360b1af3},
+    {0xe2280b6c20dd5232, 0x25c6da63c38de1b0},
+    {0x8d590723948a535f, 0x579c487e5a38ad0e},
+    {0xb0af48ec79ace837, 0x2d835a9df0c6d851},
+    {0xdcdb1b2798182244, 0xf8e431456cf88e65},
+    {0x8a08f0f8bf0f156b, 0x1b8e9ecb641b58ff},
+    {0xac8b2d36eed2dac5, 0xe272467e3d222f3f},
+    {0xd7adf884aa879177, 0x5b0ed81dcc6abb0f},
+    {0x86ccbb52ea94baea, 0x98e947129fc2b4e9},
+    {0xa87fea27a539e9a5, 0x3f2398d747b36224},
+    {0xd29fe4b18e88640e, 0x8eec7f0d19a03aad},
+    {0x83a3eeeef9153e89, 0x1953cf68300424ac},
+    {0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7},
+    {0xcdb02555653131b6, 0x3792f412cb06794d},
+    {0x808e17555f3ebf11, 0xe2bbd88bbee40bd0},
+    {0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4},
+    {0xc8de047564d20a8b, 0xf245825a5a445275},
+    {0xfb158592be068d2e, 0xeed6e2f0f0d56712},
+    {0x9ced737bb6c4183d, 0x55464dd69685606b},
+    {0xc428d05aa4751e4c, 0xaa97e14c3c26b886},
+    {0xf53304714d9265df, 0xd53dd99f4b3066a8},
+    {0x993fe2c6d07b7fab, 0xe546a8038efe4029},
+    {0xbf8fdb78849a5f96, 0xde98520472bdd033},
+    {0xef73d256a5c0f77c, 0x963e66858f6d4440},
+    {0x95a8637627989aad, 0xdde7001379a44aa8},
+    {0xbb127c53b17ec159, 0x5560c018580d5d52},
+    {0xe9d71b689dde71af, 0xaab8f01e6e10b4a6},
+    {0x9226712162ab070d, 0xcab3961304ca70e8},
+    {0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22},
+    {0xe45c10c42a2b3b05, 0x8cb89a7db77c506a},
+    {0x8eb98a7a9a5b04e3, 0x77f3608e92adb242},
+    {0xb267ed1940f1c61c, 0x55f038b237591ed3},
+    {0xdf01e85f912e37a3, 0x6b6c46dec52f6688},
+    {0x8b61313bbabce2c6, 0x2323ac4b3b3da015},
+    {0xae397d8aa96c1b77, 0xabec975e0a0d081a},
+    {0xd9c7dced53c72255, 0x96e7bd358c904a21},
+    {0x881cea14545c7575, 0x7e50d64177da2e54},
+    {0xaa242499697392d2, 0xdde50bd1d5d0b9e9},
+    {0xd4ad2dbfc3d07787, 0x955e4ec64b44e864},
+    {0x84ec3c97da624ab4, 0xbd5af13bef0b113e},
+    {0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e},
+    {0xcfb11ead453994ba, 0x67de18eda5814af2},
+    {0x81ceb32c4b43fcf4, 0x80eacf948770ced7},
+    {0xa2425ff75e14fc31, 0xa1258379a94d028d},
+    {0xcad2f7f5359a3b3e, 0x096ee45813a04330},
+    {0xfd87b5f28300ca0d, 0x8bca9d6e188853fc},
+    {0x9e74d1b791e07e48, 0x775ea264cf55347e},
+    {0xc612062576589dda, 0x95364afe032a819e},
+    {0xf79687aed3eec551, 0x3a83ddbd83f52205},
+    {0x9abe14cd44753b52, 0xc4926a9672793543},
+    {0xc16d9a0095928a27, 0x75b7053c0f178294},
+    {0xf1c90080baf72cb1, 0x5324c68b12dd6339},
+    {0x971da05074da7bee, 0xd3f6fc16ebca5e04},
+    {0xbce5086492111aea, 0x88f4bb1ca6bcf585},
+    {0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6},
+    {0x9392ee8e921d5d07, 0x3aff322e62439fd0},
+    {0xb877aa3236a4b449, 0x09befeb9fad487c3},
+    {0xe69594bec44de15b, 0x4c2ebe687989a9b4},
+    {0x901d7cf73ab0acd9, 0x0f9d37014bf60a11},
+    {0xb424dc35095cd80f, 0x538484c19ef38c95},
+    {0xe12e13424bb40e13, 0x2865a5f206b06fba},
+    {0x8cbccc096f5088cb, 0xf93f87b7442e45d4},
+    {0xafebff0bcb24aafe, 0xf78f69a51539d749},
+    {0xdbe6fecebdedd5be, 0xb573440e5a884d1c},
+    {0x89705f4136b4a597, 0x31680a88f8953031},
+    {0xabcc77118461cefc, 0xfdc20d2b36ba7c3e},
+    {0xd6bf94d5e57a42bc, 0x3d32907604691b4d},
+    {0x8637bd05af6c69b5, 0xa63f9a49c2c1b110},
+    {0xa7c5ac471b478423, 0x0fcf80dc33721d54},
+    {0xd1b71758e219652b, 0xd3c36113404ea4a9},
+    {0x83126e978d4fdf3b, 0x645a1cac083126ea},
+    {0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4},
+    {0xcccccccccccccccc, 0xcccccccccccccccd},
+    {0x8000000000000000, 0x0000000000000000},
+    {0xa000000000000000, 0x0000000000000000},
+    {0xc800000000000000, 0x0000000000000000},
+    {0xfa00000000000000, 0x0000000000000000},
+    {0x9c40000000000000, 0x0000000000000000},
+    {0xc350000000000000, 0x0000000000000000},
+    {0xf424000000000000, 0x0000000000000000},
+    {0x9896800000000000, 0x0000000000000000},
+    {0xbebc200000000000, 0x0000000000000000},
+    {0xee6b280000000000, 0x0000000000000000},
+    {0x9502f90000000000, 0x0000000000000000},
+    {0xba43b74000000000, 0x0000000000000000},
+    {0xe8d4a51000000000, 0x0000000000000000},
+    {0x9184e72a00000000, 0x0000000000000000},
+    {0xb5e620f480000000, 0x0000000000000000},
+    {0xe35fa931a0000000, 0x0000000000000000},
+    {0x8e1bc9bf04000000, 0x0000000000000000},
+    {0xb1a2bc2ec5000000, 0x0000000000000000},
+    {0xde0b6b3a76400000, 0x0000000000000000},
+    {0x8ac7230489e80000, 0x0000000000000000},
+    {0xad78ebc5ac620000, 0x0000000000000000},
+    {0xd8d726b7177a8000, 0x0000000000000000},
+    {0x878678326eac9000, 0x0000000000000000},
+    {0xa968163f0a57b400, 0x0000000000000000},
+    {0xd3c21bcecceda100, 0x0000000000000000},
+    {0x84595161401484a0, 0x0000000000000000},
+    {0xa56fa5b99019a5c8, 0x0000000000000000},
+    {0xcecb8f27f4200f3a, 0x0000000000000000},
+    {0x813f3978f8940984, 0x4000000000000000},
+    {0xa18f07d736b90be5, 0x5000000000000000},
+    {0xc9f2c9cd04674ede, 0xa400000000000000},
+    {0xfc6f7c4045812296, 0x4d00000000000000},
+    {0x9dc5ada82b70b59d, 0xf020000000000000},
+    {0xc5371912364ce305, 0x6c28000000000000},
+    {0xf684df56c3e01bc6, 0xc732000000000000},
+    {0x9a130b963a6c115c, 0x3c7f400000000000},
+    {0xc097ce7bc90715b3, 0x4b9f100000000000},
+    {0xf0bdc21abb48db20, 0x1e86d40000000000},
+    {0x96769950b50d88f4, 0x1314448000000000},
+    {0xbc143fa4e250eb31, 0x17d955a000000000},
+    {0xeb194f8e1ae525fd, 0x5dcfab0800000000},
+    {0x92efd1b8d0cf37be, 0x5aa1cae500000000},
+    {0xb7abc627050305ad, 0xf14a3d9e40000000},
+    {0xe596b7b0c643c719, 0x6d9ccd05d0000000},
+    {0x8f7e32ce7bea5c6f, 0xe4820023a2000000},
+    {0xb35dbf821ae4f38b, 0xdda2802c8a800000},
+    {0xe0352f62a19e306e, 0xd50b2037ad200000},
+    {0x8c213d9da502de45, 0x4526f422cc340000},
+    {0xaf298d050e4395d6, 0x9670b12b7f410000},
+    {0xdaf3f04651d47b4c, 0x3c0cdd765f114000},
+    {0x88d8762bf324cd0f, 0xa5880a69fb6ac800},
+    {0xab0e93b6efee0053, 0x8eea0d047a457a00},
+    {0xd5d238a4abe98068, 0x72a4904598d6d880},
+    {0x85a36366eb71f041, 0x47a6da2b7f864750},
+    {0xa70c3c40a64e6c51, 0x999090b65f67d924},
+    {0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d},
+    {0x82818f1281ed449f, 0xbff8f10e7a8921a4},
+    {0xa321f2d7226895c7, 0xaff72d52192b6a0d},
+    {0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490},
+    {0xfee50b7025c36a08, 0x02f236d04753d5b4},
+    {0x9f4f2726179a2245, 0x01d762422c946590},
+    {0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5},
+    {0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2},
+    {0x9b934c3b330c8577, 0x63cc55f49f88eb2f},
+    {0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb},
+    {0xf316271c7fc3908a, 0x8bef464e3945ef7a},
+    {0x97edd871cfda3a56, 0x97758bf0e3cbb5ac},
+    {0xbde94e8e43d0c8ec, 0x3d52eeed1cbea317},
+    {0xed63a231d4c4fb27, 0x4ca7aaa863ee4bdd},
+    {0x945e455f24fb1cf8, 0x8fe8caa93e74ef6a},
+    {0xb975d6b6ee39e436, 0xb3e2fd538e122b44},
+    {0xe7d34c64a9c85d44, 0x60dbbca87196b616},
+    {0x90e40fbeea1d3a4a, 0xbc8955e946fe31cd},
+    {0xb51d13aea4a488dd, 0x6babab6398bdbe41},
+    {0xe264589a4dcdab14, 0xc696963c7eed2dd1},
+    {0x8d7eb76070a08aec, 0xfc1e1de5cf543ca2},
+    {0xb0de65388cc8ada8, 0x3b25a55f43294bcb},
+    {0xdd15fe86affad912, 0x49ef0eb713f39ebe},
+    {0x8a2dbf142dfcc7ab, 0x6e3569326c784337},
+    {0xacb92ed9397bf996, 0x49c2c37f07965404},
+    {0xd7e77a8f87daf7fb, 0xdc33745ec97be906},
+    {0x86f0ac99b4e8dafd, 0x69a028bb3ded71a3},
+    {0xa8acd7c0222311bc, 0xc40832ea0d68ce0c},
+    {0xd2d80db02aabd62b, 0xf50a3fa490c30190},
+    {0x83c7088e1aab65db, 0x792667c6da79e0fa},
+    {0xa4b8cab1a1563f52, 0x577001b891185938},
+    {0xcde6fd5e09abcf26, 0xed4c0226b55e6f86},
+    {0x80b05e5ac60b6178, 0x544f8158315b05b4},
+    {0xa0dc75f1778e39d6, 0x696361ae3db1c721},
+    {0xc913936dd571c84c, 0x03bc3a19cd1e38e9},
+    {0xfb5878494ace3a5f, 0x04ab48a04065c723},
+    {0x9d174b2dcec0e47b, 0x62eb0d64283f9c76},
+    {0xc45d1df942711d9a, 0x3ba5d0bd324f8394},
+    {0xf5746577930d6500, 0xca8f44ec7ee36479},
+    {0x9968bf6abbe85f20, 0x7e998b13cf4e1ecb},
+    {0xbfc2ef456ae276e8, 0x9e3fedd8c321a67e},
+    {0xefb3ab16c59b14a2, 0xc5cfe94ef3ea101e},
+    {0x95d04aee3b80ece5, 0xbba1f1d158724a12},
+    {0xbb445da9ca61281f, 0x2a8a6e45ae8edc97},
+    {0xea1575143cf97226, 0xf52d09d71a3293bd},
+    {0x924d692ca61be758, 0x593c2626705f9c56},
+    {0xb6e0c377cfa2e12e, 0x6f8b2fb00c77836c},
+    {0xe498f455c38b997a, 0x0b6dfb9c0f956447},
+    {0x8edf98b59a373fec, 0x4724bd4189bd5eac},
+    {0xb2977ee300c50fe7, 0x58edec91ec2cb657},
+    {0xdf3d5e9bc0f653e1, 0x2f2967b66737e3ed},
+    {0x8b865b215899f46c, 0xbd79e0d20082ee74},
+    {0xae67f1e9aec07187, 0xecd8590680a3aa11},
+    {0xda01ee641a708de9, 0xe80e6f4820cc9495},
+    {0x884134fe908658b2, 0x3109058d147fdcdd},
+    {0xaa51823e34a7eede, 0xbd4b46f0599fd415},
+    {0xd4e5e2cdc1d1ea96, 0x6c9e18ac7007c91a},
+    {0x850fadc09923329e, 0x03e2cf6bc604ddb0},
+    {0xa6539930bf6bff45, 0x84db8346b786151c},
+    {0xcfe87f7cef46ff16, 0xe612641865679a63},
+    {0x81f14fae158c5f6e, 0x4fcb7e8f3f60c07e},
+    {0xa26da3999aef7749, 0xe3be5e330f38f09d},
+    {0xcb090c8001ab551c, 0x5cadf5bfd3072cc5},
+    {0xfdcb4fa002162a63, 0x73d9732fc7c8f7f6},
+    {0x9e9f11c4014dda7e, 0x2867e7fddcdd9afa},
+    {0xc646d63501a1511d, 0xb281e1fd541501b8},
+    {0xf7d88bc24209a565, 0x1f225a7ca91a4226},
+    {0x9ae757596946075f, 0x3375788de9b06958},
+    {0xc1a12d2fc3978937, 0x0052d6b1641c83ae},
+    {0xf209787bb47d6b84, 0xc0678c5dbd23a49a},
+    {0x9745eb4d50ce6332, 0xf840b7ba963646e0},
+    {0xbd176620a501fbff, 0xb650e5a93bc3d898},
+    {0xec5d3fa8ce427aff, 0xa3e51f138ab4cebe},
+    {0x93ba47c980e98cdf, 0xc66f336c36b10137},
+    {0xb8a8d9bbe123f017, 0xb80b0047445d4184},
+    {0xe6d3102ad96cec1d, 0xa60dc059157491e5},
+    {0x9043ea1ac7e41392, 0x87c89837ad68db2f},
+    {0xb454e4a179dd1877, 0x29babe4598c311fb},
+    {0xe16a1dc9d8545e94, 0xf4296dd6fef3d67a},
+    {0x8ce2529e2734bb1d, 0x1899e4a65f58660c},
+    {0xb01ae745b101e9e4, 0x5ec05dcff72e7f8f},
+    {0xdc21a1171d42645d, 0x76707543f4fa1f73},
+    {0x899504ae72497eba, 0x6a06494a791c53a8},
+    {0xabfa45da0edbde69, 0x0487db9d17636892},
+    {0xd6f8d7509292d603, 0x45a9d2845d3c42b6},
+    {0x865b86925b9bc5c2, 0x0b8a2392ba45a9b2},
+    {0xa7f26836f282b732, 0x8e6cac7768d7141e},
+    {0xd1ef0244af2364ff, 0x3207d795430cd926},
+    {0x8335616aed761f1f, 0x7f44e6bd49e807b8},
+    {0xa402b9c5a8d3a6e7, 0x5f16206c9c6209a6},
+    {0xcd036837130890a1, 0x36dba887c37a8c0f},
+    {0x802221226be55a64, 0xc2494954da2c9789},
+    {0xa02aa96b06deb0fd, 0xf2db9baa10b7bd6c},
+    {0xc83553c5c8965d3d, 0x6f92829494e5acc7},
+    {0xfa42a8b73abbf48c, 0xcb772339ba1f17f9},
+    {0x9c69a97284b578d7, 0xff2a760414536efb},
+    {0xc38413cf25e2d70d, 0xfef5138519684aba},
+    {0xf46518c2ef5b8cd1, 0x7eb258665fc25d69},
+    {0x98bf2f79d5993802, 0xef2f773ffbd97a61},
+    {0xbeeefb584aff8603, 0xaafb550ffacfd8fa},
+    {0xeeaaba2e5dbf6784, 0x95ba2a53f983cf38},
+    {0x952ab45cfa97a0b2, 0xdd945a747bf26183},
+    {0xba756174393d88df, 0x94f971119aeef9e4},
+    {0xe912b9d1478ceb17, 0x7a37cd5601aab85d},
+    {0x91abb422ccb812ee, 0xac62e055c10ab33a},
+    {0xb616a12b7fe617aa, 0x577b986b314d6009},
+    {0xe39c49765fdf9d94, 0xed5a7e85fda0b80b},
+    {0x8e41ade9fbebc27d, 0x14588f13be847307},
+    {0xb1d219647ae6b31c, 0x596eb2d8ae258fc8},
+    {0xde469fbd99a05fe3, 0x6fca5f8ed9aef3bb},
+    {0x8aec23d680043bee, 0x25de7bb9480d5854},
+    {0xada72ccc20054ae9, 0xaf561aa79a10ae6a},
+    {0xd910f7ff28069da4, 0x1b2ba1518094da04},
+    {0x87aa9aff79042286, 0x90fb44d2f05d0842},
+    {0xa99541bf57452b28, 0x353a1607ac744a53},
+    {0xd3fa922f2d1675f2, 0x42889b8997915ce8},
+    {0x847c9b5d7c2e09b7, 0x69956135febada11},
+    {0xa59bc234db398c25, 0x43fab9837e699095},
+    {0xcf02b2c21207ef2e, 0x94f967e45e03f4bb},
+    {0x8161afb94b44f57d, 0x1d1be0eebac278f5},
+    {0xa1ba1ba79e1632dc, 0x6462d92a69731732},
+    {0xca28a291859bbf93, 0x7d7b8f7503cfdcfe},
+    {0xfcb2cb35e702af78, 0x5cda735244c3d43e},
+    {0x9defbf01b061adab, 0x3a0888136afa64a7},
+    {0xc56baec21c7a1916, 0x088aaa1845b8fdd0},
+    {0xf6c69a72a3989f5b, 0x8aad549e57273d45},
+    {0x9a3c2087a63f6399, 0x36ac54e2f678864b},
+    {0xc0cb28a98fcf3c7f, 0x84576a1bb416a7dd},
+    {0xf0fdf2d3f3c30b9f, 0x656d44a2a11c51d5},
+    {0x969eb7c47859e743, 0x9f644ae5a4b1b325},
+    {0xbc4665b596706114, 0x873d5d9f0dde1fee},
+    {0xeb57ff22fc0c7959, 0xa90cb506d155a7ea},
+    {0x9316ff75dd87cbd8, 0x09a7f12442d588f2},
+    {0xb7dcbf5354e9bece, 0x0c11ed6d538aeb2f},
+    {0xe5d3ef282a242e81, 0x8f1668c8a86da5fa},
+    {0x8fa475791a569d10, 0xf96e017d694487bc},
+    {0xb38d92d760ec4455, 0x37c981dcc395a9ac},
+    {0xe070f78d3927556a, 0x85bbe253f47b1417},
+    {0x8c469ab843b89562, 0x93956d7478ccec8e},
+    {0xaf58416654a6babb, 0x387ac8d1970027b2},
+    {0xdb2e51bfe9d0696a, 0x06997b05fcc0319e},
+    {0x88fcf317f22241e2, 0x441fece3bdf81f03},
+    {0xab3c2fddeeaad25a, 0xd527e81cad7626c3},
+    {0xd60b3bd56a5586f1, 0x8a71e223d8d3b074},
+    {0x85c7056562757456, 0xf6872d5667844e49},
+    {0xa738c6bebb12d16c, 0xb428f8ac016561db},
+    {0xd106f86e69d785c7, 0xe13336d701beba52},
+    {0x82a45b450226b39c, 0xecc0024661173473},
+    {0xa34d721642b06084, 0x27f002d7f95d0190},
+    {0xcc20ce9bd35c78a5, 0x31ec038df7b441f4},
+    {0xff290242c83396ce, 0x7e67047175a15271},
+    {0x9f79a169bd203e41, 0x0f0062c6e984d386},
+    {0xc75809c42c684dd1, 0x52c07b78a3e60868},
+    {0xf92e0c3537826145, 0xa7709a56ccdf8a82},
+    {0x9bbcc7a142b17ccb, 0x88a66076400bb691},
+    {0xc2abf989935ddbfe, 0x6acff893d00ea435},
+    {0xf356f7ebf83552fe, 0x0583f6b8c4124d43},
+    {0x98165af37b2153de, 0xc3727a337a8b704a},
+    {0xbe1bf1b059e9a8d6, 0x744f18c0592e4c5c},
+    {0xeda2ee1c7064130c, 0x1162def06f79df73},
+    {0x9485d4d1c63e8be7, 0x8addcb5645ac2ba8},
+    {0xb9a74a0637ce2ee1, 0x6d953e2bd7173692},
+    {0xe8111c87c5c1ba99, 0xc8fa8db6ccdd0437},
+    {0x910ab1d4db9914a0, 0x1d9c9892400a22a2},
+    {0xb54d5e4a127f59c8, 0x2503beb6d00cab4b},
+    {0xe2a0b5dc971f303a, 0x2e44ae64840fd61d},
+    {0x8da471a9de737e24, 0x5ceaecfed289e5d2},
+    {0xb10d8e1456105dad, 0x7425a83e872c5f47},
+    {0xdd50f1996b947518, 0xd12f124e28f77719},
+    {0x8a5296ffe33cc92f, 0x82bd6b70d99aaa6f},
+    {0xace73cbfdc0bfb7b, 0x636cc64d1001550b},
+    {0xd8210befd30efa5a, 0x3c47f7e05401aa4e},
+    {0x8714a775e3e95c78, 0x65acfaec34810a71},
+    {0xa8d9d1535ce3b396, 0x7f1839a741a14d0d},
+    {0xd31045a8341ca07c, 0x1ede48111209a050},
+    {0x83ea2b892091e44d, 0x934aed0aab460432},
+    {0xa4e4b66b68b65d60, 0xf81da84d5617853f},
+    {0xce1de40642e3f4b9, 0x36251260ab9d668e},
+    {0x80d2ae83e9ce78f3, 0xc1d72b7c6b426019},
+    {0xa1075a24e4421730, 0xb24cf65b8612f81f},
+    {0xc94930ae1d529cfc, 0xdee033f26797b627},
+    {0xfb9b7cd9a4a7443c, 0x169840ef017da3b1},
+    {0x9d412e0806e88aa5, 0x8e1f289560ee864e},
+    {0xc491798a08a2ad4e, 0xf1a6f2bab92a27e2},
+    {0xf5b5d7ec8acb58a2, 0xae10af696774b1db},
+    {0x9991a6f3d6bf1765, 0xacca6da1e0a8ef29},
+    {0xbff610b0cc6edd3f, 0x17fd090a58d32af3},
+    {0xeff394dcff8a948e, 0xddfc4b4cef07f5b0},
+    {0x95f83d0a1fb69cd9, 0x4abdaf101564f98e},
+    {0xbb764c4ca7a4440f, 0x9d6d1ad41abe37f1},
+    {0xea53df5fd18d5513, 0x84c86189216dc5ed},
+    {0x92746b9be2f8552c, 0x32fd3cf5b4e49bb4},
+    {0xb7118682dbb66a77, 0x3fbc8c33221dc2a1},
+    {0xe4d5e82392a40515, 0x0fabaf3feaa5334a},
+    {0x8f05b1163ba6832d, 0x29cb4d87f2a7400e},
+    {0xb2c71d5bca9023f8, 0x743e20e9ef511012},
+    {0xdf78e4b2bd342cf6, 0x914da9246b255416},
+    {0x8bab8eefb6409c1a, 0x1ad089b6c2f7548e},
+    {0xae9672aba3d0c320, 0xa184ac2473b529b1},
+    {0xda3c0f568cc4f3e8, 0xc9e5d72d90a2741e},
+    {0x8865899617fb1871, 0x7e2fa67c7a658892},
+    {0xaa7eebfb9df9de8d, 0xddbb901b98feeab7},
+    {0xd51ea6fa85785631, 0x552a74227f3ea565},
+    {0x8533285c936b35de, 0xd53a88958f87275f},
+    {0xa67ff273b8460356, 0x8a892abaf368f137},
+    {0xd01fef10a657842c, 0x2d2b7569b0432d85},
+    {0x8213f56a67f6b29b, 0x9c3b29620e29fc73},
+    {0xa298f2c501f45f42, 0x8349f3ba91b47b8f},
+    {0xcb3f2f7642717713, 0x241c70a936219a73},
+    {0xfe0efb53d30dd4d7, 0xed238cd383aa0110},
+    {0x9ec95d1463e8a506, 0xf4363804324a40aa},
+    {0xc67bb4597ce2ce48, 0xb143c6053edcd0d5},
+    {0xf81aa16fdc1b81da, 0xdd94b7868e94050a},
+    {0x9b10a4e5e9913128, 0xca7cf2b4191c8326},
+    {0xc1d4ce1f63f57d72, 0xfd1c2f611f63a3f0},
+    {0xf24a01a73cf2dccf, 0xbc633b39673c8cec},
+    {0x976e41088617ca01, 0xd5be0503e085d813},
+    {0xbd49d14aa79dbc82, 0x4b2d8644d8a74e18},
+    {0xec9c459d51852ba2, 0xddf8e7d60ed1219e},
+    {0x93e1ab8252f33b45, 0xcabb90e5c942b503},
+    {0xb8da1662e7b00a17, 0x3d6a751f3b936243},
+    {0xe7109bfba19c0c9d, 0x0cc512670a783ad4},
+    {0x906a617d450187e2, 0x27fb2b80668b24c5},
+    {0xb484f9dc9641e9da, 0xb1f9f660802dedf6},
+    {0xe1a63853bbd26451, 0x5e7873f8a0396973},
+    {0x8d07e33455637eb2, 0xdb0b487b6423e1e8},
+    {0xb049dc016abc5e5f, 0x91ce1a9a3d2cda62},
+    {0xdc5c5301c56b75f7, 0x7641a140cc7810fb},
+    {0x89b9b3e11b6329ba, 0xa9e904c87fcb0a9d},
+    {0xac2820d9623bf429, 0x546345fa9fbdcd44},
+    {0xd732290fbacaf133, 0xa97c177947ad4095},
+    {0x867f59a9d4bed6c0, 0x49ed8eabcccc485d},
+    {0xa81f301449ee8c70, 0x5c68f256bfff5a74},
+    {0xd226fc195c6a2f8c, 0x73832eec6fff3111},
+    {0x83585d8fd9c25db7, 0xc831fd53c5ff7eab},
+    {0xa42e74f3d032f525, 0xba3e7ca8b77f5e55},
+    {0xcd3a1230c43fb26f, 0x28ce1bd2e55f35eb},
+    {0x80444b5e7aa7cf85, 0x7980d163cf5b81b3},
+    {0xa0555e361951c366, 0xd7e105bcc332621f},
+    {0xc86ab5c39fa63440, 0x8dd9472bf3fefaa7},
+    {0xfa856334878fc150, 0xb14f98f6f0feb951},
+    {0x9c935e00d4b9d8d2, 0x6ed1bf9a569f33d3},
+    {0xc3b8358109e84f07, 0x0a862f80ec4700c8},
+    {0xf4a642e14c6262c8, 0xcd27bb612758c0fa},
+    {0x98e7e9cccfbd7dbd, 0x8038d51cb897789c},
+    {0xbf21e44003acdd2c, 0xe0470a63e6bd56c3},
+    {0xeeea5d5004981478, 0x1858ccfce06cac74},
+    {0x95527a5202df0ccb, 0x0f37801e0c43ebc8},
+    {0xbaa718e68396cffd, 0xd30560258f54e6ba},
+    {0xe950df20247c83fd, 0x47c6b82ef32a2069},
+    {0x91d28b7416cdd27e, 0x4cdc331d57fa5441},
+    {0xb6472e511c81471d, 0xe0133fe4adf8e952},
+    {0xe3d8f9e563a198e5, 0x58180fddd97723a6},
+    {0x8e679c2f5e44ff8f, 0x570f09eaa7ea7648},
+};
 
-        isize start_index =
-            mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
-        isize end_index =
-            mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+// Binary significand (implicit bit removed) and biased exponent
+struct ParseAdjustedMantissa {
+    u64 mantissa;
+    i32 power2;
+};
 
-        if (start_index < end_index) {
-            memcpy(new_data, ring_buffer->data + start_index, sizeof(T) * size);
-        } else {
-            isize first_size = ring_buffer->capacity - start_index;
-            memcpy(new_data, ring_buffer->data + start_index,
-                   sizeof(T) * first_size);
-            memcpy(new_data + first_size, ring_buffer->data,
-                   sizeof(T) * end_index);
+const i32 PARSE_F64_MANTISSA_BITS = 52;
+const i32 PARSE_F64_MIN_EXPONENT = -1023;
+const i32 PARSE_F64_INFINITE_POWER = 0x7FF;
+
+// Rounds w * 10^q to the nearest f64. The 128 bit product is always enough
+// for a w with at most 19 digits, see "Fast number parsing without fallback"
+// (Mushtak, Lemire).
+// source: Eisel-Lemire as implemented by fast_float
+inline ParseAdjustedMantissa parse_eisel_lemire(i64 q, u64 w) {
+    if (w == 0 || q < PARSE_SMALLEST_POWER_OF_TEN) {
+        return {0, 0};
+    }
+    if (q > PARSE_LARGEST_POWER_OF_TEN) {
+        return {0, PARSE_F64_INFINITE_POWER};
+    }
+
+    i32 lz = clz64(w);
+    w <<= lz;
+
+    // Only the top 55 bits of the product are needed, the second half of the
+    // power is only used when the first one leaves them undecided
+    const ParsePowerOfFive& power =
+        PARSE_POWERS_OF_FIVE[q - PARSE_SMALLEST_POWER_OF_TEN];
+    const u64 precision_mask = 0xFFFFFFFFFFFFFFFF >>
+                               (PARSE_F64_MANTISSA_BITS + 3);
+    u64 low = w * power.high;
+    u64 high = mul_hi64(w, power.high);
+    if ((high & precision_mask) == precision_mask) {
+        u64 second_high = mul_hi64(w, power.low);
+        low += second_high;
+        high += second_high > low;
+    }
+
+    i32 upper_bit = (i32)(high >> 63);
+    i32 shift = upper_bit + 64 - PARSE_F64_MANTISSA_BITS - 3;
+    ParseAdjustedMantissa answer;
+    answer.mantissa = high >> shift;
+    // floor(log2(10^q)) + 63
+    i32 power2 = (i32)(((152170 + 65536) * q) >> 16) + 63;
+    answer.power2 = power2 + upper_bit - lz - PARSE_F64_MIN_EXPONENT;
+
+    if (answer.power2 <= 0) {
+        // Subnormal
+        if (-answer.power2 + 1 >= 64) {
+            return {0, 0};
         }
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        answer.power2 =
+            answer.mantissa < ((u64)1 << PARSE_F64_MANTISSA_BITS) ? 0 : 1;
+        return answer;
+    }
 
-        core_free(ring_buffer->alloc, ring_buffer->data);
-        ring_buffer->data = new_data;
-        ring_buffer->capacity = new_capacity;
-        ring_buffer->start_pos = 0;
-        ring_buffer->end_pos = size;
+    // Exactly halfway between two floats: round to even. Only possible for
+    // small exponents, where the product is exact.
+    if (low <= 1 && q >= -4 && q <= 23 && (answer.mantissa & 3) == 1 &&
+        (answer.mantissa << shift) == high) {
+        answer.mantissa &= ~(u64)1;
     }
 
-    isize new_index =
-        mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
-    ring_buffer->data[new_index] = value;
-    ring_buffer->end_pos += 1;
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    if (answer.mantissa >= ((u64)2 << PARSE_F64_MANTISSA_BITS)) {
+        answer.mantissa = (u64)1 << PARSE_F64_MANTISSA_BITS;
+        answer.power2++;
+    }
+    answer.mantissa &= ~((u64)1 << PARSE_F64_MANTISSA_BITS);
+
+    if (answer.power2 >= PARSE_F64_INFINITE_POWER) {
+        return {0, PARSE_F64_INFINITE_POWER};
+    }
+    return answer;
 }
 
-template <typename T>
-inline void ring_buffer_push_front(RingBuffer<T>* ring_buffer, T value) {
-    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
-    core_assert(ring_buffer->capacity > 0);
-    core_assert(ring_buffer->data);
+inline f64 parse_f64_from_parts(ParseAdjustedMantissa am, bool negative) {
+    u64 bits = am.mantissa | ((u64)am.power2 << PARSE_F64_MANTISSA_BITS) |
+               ((u64)negative << 63);
+    f64 value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
 
-    isize size = ring_buffer_size(ring_buffer);
+// Case insensitive match of a lowercase ASCII word
+inline bool parse_match_word(const u8* p, const u8* end, const char* word) {
+    isize size = (isize)strlen(word);
+    if (end - p < size) {
+        return false;
+    }
+    for (isize i = 0; i < size; i++) {
+        if ((p[i] | 0x20) != (u8)word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Grow
-    if (size == ring_buffer->capacity) {
-        isize new_capacity = ring_buffer->capacity * 2;
-        T* new_data = core_alloc<T>(ring_buffer->alloc, new_capacity);
+// Accepts [+-]digits[.digits][(e|E)[+-]digits], ".5" and "5." as well as
+// "inf", "infinity" and "nan". Values out of range round to infinity or zero
+// like strtod does.
+inline Result<f64, ParseError> string_parse_f64(String* str) {
+    core_assert(str != nullptr);
+    const u8* p = (const u8*)str->data;
+    const u8* end = p + str->size;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+
+    if (p < end && ((*p | 0x20) == 'i' || (*p | 0x20) == 'n')) {
+        f64 value = 0;
+        if (parse_match_word(p, end, "infinity")) {
+            value = INFINITY;
+            p += 8;
+        } else if (parse_match_word(p, end, "inf")) {
+            value = INFINITY;
+            p += 3;
+        } else if (parse_match_word(p, end, "nan")) {
+            value = NAN;
+            p += 3;
+        } else {
+            return result_err(ParseError::InvalidNumber);
+        }
+        parse_advance(str, p);
+        return result_ok(negative ? -value : value);
+    }
+
+    const u8* integer_start = p;
+    u64 w = parse_digits(&p, end, 0);
+    const u8* integer_end = p;
+    isize digit_count = integer_end - integer_start;
+    i64 exponent = 0;
+
+    const u8* fraction_start = nullptr;
+    const u8* fraction_end = nullptr;
+    if (p < end && *p == '.') {
+        p++;
+        fraction_start = p;
+        w = parse_digits(&p, end, w);
+        fraction_end = p;
+        exponent = fraction_start - fraction_end;
+        digit_count += fraction_end - fraction_start;
+    }
+    if (digit_count == 0) {
+        return result_err(ParseError::InvalidNumber);
+    }
+
+    // The exponent is only consumed when it has digits, "1e" parses as 1
+    i64 explicit_exponent = 0;
+    if (p < end && (*p | 0x20) == 'e') {
+        const u8* e = p + 1;
+        bool negative_exponent = e < end && *e == '-';
+        if (e < end && (*e == '-' || *e == '+')) {
+            e++;
+        }
+        if (e < end && parse_is_digit(*e)) {
+            while (e < end && parse_is_digit(*e)) {
+                // Saturate, anything this large is zero or infinity anyway
+                if (explicit_exponent < 0x10000000) {
+                    explicit_exponent = explicit_exponent * 10 + (*e - '0');
+                }
+                e++;
+            }
+            if (negative_exponent) {
+                explicit_exponent = -explicit_exponent;
+            }
+            exponent += explicit_exponent;
+            p = e;
+        }
+    }
+    const u8* number_end = p;
 
-        isize start_index =
-            mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
-        isize end_index =
-            mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+    // More than 19 digits don't fit, leading zeros don't count though
+    bool truncated = false;
+    if (digit_count > 19) {
+        const u8* start = integer_start;
+        while (start < number_end && (*start == '0' || *start == '.')) {
+            digit_count -= *start == '0';
+            start++;
+        }
 
-        if (start_index < end_index) {
-            memcpy(new_data + 1, ring_buffer->data + start_index,
-                   sizeof(T) * size);
-        } else {
-            isize first_size = ring_buffer->capacity - start_index;
-            memcpy(new_data + 1, ring_buffer->data + start_index,
-                   sizeof(T) * first_size);
-            memcpy(new_data + 1 + first_size, ring_buffer->data,
-                   sizeof(T) * end_index);
+        if (digit_count > 19) {
+            // Keep the first 19 significant digits
+            truncated = true;
+            const u64 min_19_digits = 1000000000000000000;
+            w = 0;
+            const u8* digit = integer_start;
+            while (w < min_19_digits && digit < integer_end) {
+                w = w * 10 + (u64)(*digit - '0');
+                digit++;
+            }
+            if (w >= min_19_digits) {
+                exponent = (integer_end - digit) + explicit_exponent;
+            } else {
+                digit = fraction_start;
+                while (w < min_19_digits && digit < fraction_end) {
+                    w = w * 10 + (u64)(*digit - '0');
+                    digit++;
+                }
+                exponent = (fraction_start - digit) + explicit_exponent;
+            }
+        }
+    }
+
+    f64 value;
+    if (!truncated && exponent == 0 && w <= ((u64)1 << 53)) {
+        // Exact integer
+        value = negative ? -(f64)w : (f64)w;
+    } else {
+        ParseAdjustedMantissa am = parse_eisel_lemire(exponent, w);
+        // The dropped digits lie between w and w + 1, when both round the
+        // same way that is the answer
+        if (truncated) {
+            ParseAdjustedMantissa next = parse_eisel_lemire(exponent, w + 1);
+            if (next.mantissa != am.mantissa || next.power2 != am.power2) {
+                // Rare, the standard library has an exact slow path
+#if defined(__cpp_lib_to_chars)
+                std::from_chars_result result =
+                    std::from_chars((const char*)integer_start,
+                                    (const char*)number_end, value);
+                core_assert(result.ptr == (const char*)number_end);
+                if (result.ec == std::errc::result_out_of_range) {
+                    value = exponent > 0 ? INFINITY : 0.0;
+                }
+#else
+                // No floating point from_chars (older libc++), strtod
+                // needs a null terminated copy
+                isize length = number_end - integer_start;
+                char small[128];
+                char* copy = length < (isize)sizeof(small)
+                                 ? small
+                                 : core_alloc_non_zeroed<char>(c_allocator(),
+                                                               length + 1);
+                memcpy(copy, integer_start, length);
+                copy[length] = '\0';
+                value = strtod(copy, nullptr);
+                if (copy != small) {
+                    core_free(c_allocator(), copy);
+                }
+#endif
+                if (negative) {
+                    value = -value;
+                }
+                parse_advance(str, number_end);
+                return result_ok(value);
+            }
         }
+        value = parse_f64_from_parts(am, negative);
+    }
+
+    parse_advance(str, number_end);
+    return result_ok(value);
+}
+
+// Number of characters needed for the formatters below
+const isize FORMAT_U64_MAX_SIZE = 20;
+const isize FORMAT_I64_MAX_SIZE = 20;
+const isize FORMAT_F64_MAX_SIZE = 24;
+const isize FORMAT_F32_MAX_SIZE = 16;
+
+static const char FORMAT_DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+inline isize u64_digit_count(u64 value) {
+    // First entry is 0 so that 0 has one digit
+    static const u64 POWERS_OF_TEN[20] = {
+        0,
+        10,
+        100,
+        1000,
+        10000,
+        100000,
+        1000000,
+        10000000,
+        100000000,
+        1000000000,
+        10000000000,
+        100000000000,
+        1000000000000,
+        10000000000000,
+        100000000000000,
+        1000000000000000,
+        10000000000000000,
+        100000000000000000,
+        1000000000000000000,
+        10000000000000000000ull,
+    };
+    // floor(log10(2^bits)), then one more if above the power of ten
+    isize bits = 64 - clz64(value | 1);
+    isize digits = (bits * 1233) >> 12;
+    return digits + (value >= POWERS_OF_TEN[digits]);
+}
+
+// Writes the decimal digits to `out` without a terminator, returns how many.
+// Digits are written in pairs from the end, the length is known upfront.
+inline isize format_u64(u64 value, char* out) {
+    isize size = u64_digit_count(value);
+    char* p = out + size;
+    while (value >= 100) {
+        u64 pair = value % 100;
+        value /= 100;
+        p -= 2;
+        memcpy(p, FORMAT_DIGIT_PAIRS + pair * 2, 2);
+    }
+    if (value >= 10) {
+        memcpy(out, FORMAT_DIGIT_PAIRS + value * 2, 2);
+    } else {
+        out[0] = (char)('0' + value);
+    }
+    return size;
+}
 
-        core_free(ring_buffer->alloc, ring_buffer->data);
-        ring_buffer->data = new_data;
-        ring_buffer->capacity = new_capacity;
-        ring_buffer->start_pos = 1;
-        ring_buffer->end_pos = size + 1;
+inline isize format_i64(i64 value, char* out) {
+    u64 magnitude = (u64)value;
+    if (value < 0) {
+        *out = '-';
+        return 1 + format_u64(0 - magnitude, out + 1);
     }
+    return format_u64(magnitude, out);
+}
 
-    ring_buffer->start_pos -= 1;
-    isize new_index =
-        mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
-    ring_buffer->data[new_index] = value;
+// Shortest representation that parses back to the same value. The standard
+// library already implements this (Ryu in libstdc++ and MSVC), without
+// locale or stdio.
+inline isize format_f64(f64 value, char* out) {
+    std::to_chars_result result =
+        std::to_chars(out, out + FORMAT_F64_MAX_SIZE, value);
+    core_assert(result.ec == std::errc());
+    return result.ptr - out;
 }
 
-template <typename T>
-inline T ring_buffer_pop_front(RingBuffer<T>* ring_buffer) {
-    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
-    core_assert(ring_buffer->capacity > 0);
-    core_assert(ring_buffer->data);
+// Shortest representation that parses back to the same f32, so 0.1f prints
+// as "0.1" rather than its widened double value
+inline isize format_f32(f32 value, char* out) {
+    std::to_chars_result result =
+        std::to_chars(out, out + FORMAT_F32_MAX_SIZE, value);
+    core_assert(result.ec == std::errc());
+    return result.ptr - out;
+}
 
-    core_assert_msg(ring_buffer->start_pos != ring_buffer->end_pos,
-                    "ring_buffer is empty");
+/// ------------------
+/// String builder
+/// ------------------
 
-    isize start_index =
-        mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
-    T value = ring_buffer->data[start_index];
-    ring_buffer->start_pos += 1;
+// Appends into one growable buffer. Growing goes through core_realloc, so with
+// an arena the buffer is extended in place while it is the last allocation.
+// One byte past size is always reserved for the null terminator.
+struct StringBuilder {
+    Allocator alloc;
+    char* data;
+    isize size;
+    isize capacity;
+};
 
-    return value;
+const isize STRING_BUILDER_MIN_CAPACITY = 32;
+
+inline void string_builder_init(StringBuilder* sb, Allocator alloc,
+                                isize capacity = 0) {
+    core_assert(sb != nullptr);
+    core_assert(alloc.alloc != nullptr);
+    core_assert(capacity >= 0);
+
+    sb->alloc = alloc;
+    sb->data = nullptr;
+    sb->size = 0;
+    sb->capacity = 0;
+    if (capacity > 0) {
+        sb->data = core_alloc<char>(alloc, capacity + 1);
+        sb->capacity = capacity;
+    }
 }
 
-template <typename T> inline T ring_buffer_pop_end(RingBuffer<T>* ring_buffer) {
-    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
-    core_assert(ring_buffer->capacity > 0);
-    core_assert(ring_buffer->data);
+inline StringBuilder string_builder_make(Allocator alloc, isize capacity = 0) {
+    StringBuilder sb;
+    string_builder_init(&sb, alloc, capacity);
+    return sb;
+}
 
-    core_assert_msg(ring_buffer->start_pos != ring_buffer->end_pos,
-                    "ring_buffer is empty");
+inline void string_builder_free(StringBuilder* sb) {
+    core_assert(sb != nullptr);
+    if (sb->data != nullptr) {
+        core_free(sb->alloc, sb->data);
+    }
+    sb->data = nullptr;
+    sb->size = 0;
+    sb->capacity = 0;
+}
 
-    ring_buffer->end_pos -= 1;
-    isize end_index =
-        mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
-    T value = ring_buffer->data[end_index];
+// Makes room for at least `count` more bytes
+inline void string_builder_reserve(StringBuilder* sb, isize count) {
+    core_assert(sb != nullptr);
+    core_assert(count >= 0);
 
-    return value;
+    isize needed = sb->size + count;
+    if (needed <= sb->capacity && sb->data != nullptr) {
+        return;
+    }
+
+    isize new_capacity = std::max(
+        std::max(sb->capacity * 2, needed), STRING_BUILDER_MIN_CAPACITY);
+    if (sb->data == nullptr) {
+        sb->data = core_alloc<char>(sb->alloc, new_capacity + 1);
+    } else {
+        sb->data = core_realloc<char>(sb->alloc, sb->data, sb->capacity + 1,
+                                      new_capacity + 1);
+    }
+    sb->capacity = new_capacity;
+}
+
+inline void string_builder_clear(StringBuilder* sb) {
+    core_assert(sb != nullptr);
+    sb->size = 0;
+}
+
+// View into the builder, invalidated by the next append
+inline String string_builder_to_string(const StringBuilder* sb) {
+    core_assert(sb != nullptr);
+    return String{sb->data, sb->size};
+}
+
+inline const char* string_builder_to_cstr(StringBuilder* sb) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, 0);
+    sb->data[sb->size] = '\0';
+    return sb->data;
+}
+
+inline void string_builder_append(StringBuilder* sb, String str) {
+    core_assert(sb != nullptr);
+    core_assert(str.size >= 0);
+
+    if (str.size == 0) {
+        return;
+    }
+    string_builder_reserve(sb, str.size);
+    memcpy(sb->data + sb->size, str.data, str.size);
+    sb->size += str.size;
+}
+
+inline void string_builder_append_cstr(StringBuilder* sb, const char* cstr) {
+    core_assert(cstr != nullptr);
+    string_builder_append(sb, string_from_cstr(cstr));
+}
+
+inline void string_builder_append_char(StringBuilder* sb, char c) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, 1);
+    sb->data[sb->size++] = c;
+}
+
+inline void string_builder_append_repeat(StringBuilder* sb, char c,
+                                         isize count) {
+    core_assert(sb != nullptr);
+    core_assert(count >= 0);
+    string_builder_reserve(sb, count);
+    memset(sb->data + sb->size, c, count);
+    sb->size += count;
+}
+
+inline void string_builder_append_rune(StringBuilder* sb, rune r) {
+    core_assert(sb != nullptr);
+    core_assert_msg(r.codepoint >= 0 && r.codepoint <= 0x10FFFF,
+                    "Invalid codepoint %d", r.codepoint);
+
+    char buffer[5];
+    rune_to_cstr(r, buffer);
+    string_builder_append_cstr(sb, buffer);
+}
+
+inline void string_builder_append_u64(StringBuilder* sb, u64 value) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, FORMAT_U64_MAX_SIZE);
+    sb->size += format_u64(value, sb->data + sb->size);
+}
+
+inline void string_builder_append_i64(StringBuilder* sb, i64 value) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, FORMAT_I64_MAX_SIZE);
+    sb->size += format_i64(value, sb->data + sb->size);
+}
+
+// Shortest representation that parses back to the same value
+inline void string_builder_append_f64(StringBuilder* sb, f64 value) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, FORMAT_F64_MAX_SIZE);
+    sb->size += format_f64(value, sb->data + sb->size);
+}
+
+inline void string_builder_append_f32(StringBuilder* sb, f32 value) {
+    core_assert(sb != nullptr);
+    string_builder_reserve(sb, FORMAT_F32_MAX_SIZE);
+    sb->size += format_f32(value, sb->data + sb->size);
+}
+
+inline void string_builder_append_bool(StringBuilder* sb, bool value) {
+    string_builder_append_cstr(sb, value ? "true" : "false");
 }
 
+// Dispatches on the argument type for string_builder_format
 template <typename T>
-inline bool ring_buffer_contains(RingBuffer<T>* ring_buffer, T value) {
-    isize size = ring_buffer_size(ring_buffer);
-    for (isize i = 0; i < size; i++) {
-        if ((*ring_buffer)[i] == value) {
-            return true;
+inline void string_builder_append_value(StringBuilder* sb, const T& value) {
+    if constexpr (std::is_same_v<T, String>) {
+        string_builder_append(sb, value);
+    } else if constexpr (std::is_same_v<T, rune>) {
+        string_builder_append_rune(sb, value);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        string_builder_append_bool(sb, value);
+    } else if constexpr (std::is_same_v<T, char>) {
+        string_builder_append_char(sb, value);
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        string_builder_append_i64(sb, (i64)value);
+    } else if constexpr (std::is_integral_v<T>) {
+        string_builder_append_u64(sb, (u64)value);
+    } else if constexpr (std::is_same_v<T, f32>) {
+        string_builder_append_f32(sb, value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        string_builder_append_f64(sb, (f64)value);
+    } else if constexpr (std::is_convertible_v<T, const char*>) {
+        string_builder_append_cstr(sb, value);
+    } else {
+        static_assert(sizeof(T) == 0, "Type can't be formatted");
+    }
+}
+
+// Appends the literal text up to the next "{}" and returns the offset after
+// it, or -1 when the format string ends first. "{{" and "}}" are escapes.
+// A negative `start` means the format string was already used up, so
+// nothing is appended.
+inline isize string_builder_format_literal(StringBuilder* sb, String fmt,
+                                           isize start) {
+    if (start < 0) {
+        return -1;
+    }
+    isize i = start;
+    while (i < fmt.size) {
+        char c = fmt.data[i];
+        if (c != '{' && c != '}') {
+            isize run = i;
+            while (run < fmt.size && fmt.data[run] != '{' &&
+                   fmt.data[run] != '}') {
+                run++;
+            }
+            string_builder_append(sb, string_substr(fmt, i, run - i));
+            i = run;
+            continue;
         }
+
+        core_assert_msg(i + 1 < fmt.size, "Unmatched '%c' in format", c);
+        if (i + 1 >= fmt.size) {
+            string_builder_append_char(sb, c);
+            break;
+        }
+        char next = fmt.data[i + 1];
+        if (next == c) {
+            string_builder_append_char(sb, c);
+            i += 2;
+            continue;
+        }
+        core_assert_msg(c == '{' && next == '}', "Invalid format at %ld", i);
+        return i + 2;
     }
 
-    return false;
+    return -1;
+}
+
+// Replaces each "{}" in order with the next argument. The number of
+// placeholders has to match the number of arguments.
+template <typename... Args>
+inline void string_builder_format(StringBuilder* sb, String fmt,
+                                  const Args&... args) {
+    core_assert(sb != nullptr);
+
+    isize offset = 0;
+    auto append_arg = [&](const auto& arg) {
+        offset = string_builder_format_literal(sb, fmt, offset);
+        core_assert_msg(offset >= 0, "More arguments than placeholders");
+        // Without asserts the extra arguments are dropped
+        if (offset >= 0) {
+            string_builder_append_value(sb, arg);
+        }
+    };
+    (append_arg(args), ...);
+    (void)append_arg;
+
+    offset = string_builder_format_literal(sb, fmt, offset);
+    core_assert_msg(offset < 0, "More placeholders than arguments");
+}
+
+template <typename... Args>
+inline void string_builder_format(StringBuilder* sb, const char* fmt,
+                                  const Args&... args) {
+    string_builder_format(sb, string_from_cstr(fmt), args...);
+}
+
+// Formats into a new null terminated string allocated from `alloc`, free it
+// with core_free(alloc, str.data)
+template <typename... Args>
+inline String string_format(Allocator alloc, const char* fmt,
+                            const Args&... args) {
+    StringBuilder sb = string_builder_make(alloc);
+    string_builder_format(&sb, fmt, args...);
+    string_builder_to_cstr(&sb);
+    return string_builder_to_string(&sb);
 }
 
 /// ------------------
-/// StaticArray
+/// String search
 /// ------------------
 
-#define ARRAY_PROGRAMMING_OVERLOADS(LEN)                                       \
-    T& operator[](isize index) {                                               \
-        core_assert(index >= 0);                                               \
-        core_assert(index < LEN);                                              \
-        return data[index];                                                    \
-    }                                                                          \
-                                                                               \
-    const T& operator[](isize index) const {                                   \
-        core_assert(index >= 0);                                               \
-        core_assert(index < LEN);                                              \
-        return data[index];                                                    \
-    }                                                                          \
-                                                                               \
-    bool operator==(const StaticArray<T, LEN>& other) const {                  \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            if (data[i] != other[i]) {                                         \
-                return false;                                                  \
-            }                                                                  \
-        }                                                                      \
-        return true;                                                           \
-    }                                                                          \
-                                                                               \
-    bool operator!=(const StaticArray<T, LEN>& other) const {                  \
-        return !(*this == other);                                              \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN> operator*(const StaticArray<T, LEN>& other) const {    \
-        StaticArray<T, LEN> result;                                            \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            result[i] = data[i] * other[i];                                    \
-        }                                                                      \
-        return result;                                                         \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN> operator/(const StaticArray<T, LEN>& other) const {    \
-        StaticArray<T, LEN> result;                                            \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            result[i] = data[i] / other[i];                                    \
-        }                                                                      \
-        return result;                                                         \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN> operator+(const StaticArray<T, LEN>& other) const {    \
-        StaticArray<T, LEN> result;                                            \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            result[i] = data[i] + other[i];                                    \
-        }                                                                      \
-        return result;                                                         \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN> operator-(const StaticArray<T, LEN>& other) const {    \
-        StaticArray<T, LEN> result;                                            \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            result[i] = data[i] - other[i];                                    \
-        }                                                                      \
-        return result;                                                         \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN>& operator*=(const StaticArray<T, LEN>& other) {        \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            data[i] *= other[i];                                               \
-        }                                                                      \
-        return *this;                                                          \
-    }                                                                          \
-                                                                               \
-    StaticArray<T, LEN>& operator/=(const StaticArray<T, LEN>& other) {        \
-        for (isize i = 0; i < LEN; i++) {                                      \
-            data[i] /= other[i];                                               \
-        }                                                                      \
-        return *this;                                                          \
-    }                                                                          \
-                                                                               \
+// Searches return the byte offset of the match or -1. Forward searches start
+// at `start`, reverse searches look at the whole string.
+
+// Set of bytes laid out for nibble lookups: byte c is bit (c >> 4) & 7 of
+// bits[(c >> 7) * 16 + (c & 15)]. SIMD code looks up 32 bytes at once with
+// two shuffles on the low nibble and picks one by the high bit.
+struct ByteSet {
+    u8 bits[32];
+};
+
+inline void byte_set_add(ByteSet* set, u8 c) {
+    set->bits[((c >> 7) << 4) | (c & 15)] |= (u8)(1 << ((c >> 4) & 7));
+}
+
+inline bool byte_set_contains(const ByteSet* set, u8 c) {
+    return (set->bits[((c >> 7) << 4) | (c & 15)] >> ((c >> 4) & 7)) & 1;
+}
+
+inline ByteSet byte_set_make(String chars) {
+    ByteSet set = {};
+    for (isize i = 0; i < chars.size; i++) {
+        byte_set_add(&set, (u8)chars.data[i]);
+    }
+    return set;
+}
+
+inline isize string_find_byte_scalar(const u8* data, isize size, u8 c,
+                                     isize start) {
+    const void* found = memchr(data + start, c, size - start);
+    return found == nullptr ? -1 : (const u8*)found - data;
+}
+
+inline isize string_find_last_byte_scalar(const u8* data, isize size, u8 c) {
+    for (isize i = size - 1; i >= 0; i--) {
+        if (data[i] == c) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+inline isize string_find_any_of_scalar(const u8* data, isize size,
+                                       const ByteSet* set, isize start) {
+    for (isize i = start; i < size; i++) {
+        if (byte_set_contains(set, data[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+inline isize string_find_last_any_of_scalar(const u8* data, isize size,
+                                            const ByteSet* set) {
+    for (isize i = size - 1; i >= 0; i--) {
+        if (byte_set_contains(set, data[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline isize string_find_byte_avx2(const u8* data, isize size, u8 c,
+                                   isize start) {
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    isize i = start;
+    for (; i + 64 <= size; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 32));
+        __m256i eq_a = _mm256_cmpeq_epi8(a, needle);
+        __m256i eq_b = _mm256_cmpeq_epi8(b, needle);
+        if (!_mm256_testz_si256(_mm256_or_si256(eq_a, eq_b),
+                                _mm256_set1_epi8(-1))) {
+            u64 mask = (u32)_mm256_movemask_epi8(eq_a) |
+                       ((u64)(u32)_mm256_movemask_epi8(eq_b) << 32);
+            return i + ctz64(mask);
+        }
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle));
+        if (mask != 0) {
+            return i + ctz64(mask);
+        }
+    }
+    return string_find_byte_scalar(data, size, c, i);
+}
+
+CORE_TARGET("avx2")
+inline isize string_find_last_byte_avx2(const u8* data, isize size, u8 c) {
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    isize end = size;
+    for (; end >= 32; end -= 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + end - 32));
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle));
+        if (mask != 0) {
+            return end - 1 - clz64(mask) + 32;
+        }
+    }
+    return string_find_last_byte_scalar(data, end, c);
+}
+
+// 32 bit mask of the bytes in `set`, see ByteSet
+CORE_TARGET("avx2")
+inline u32 byte_set_match_avx2(__m256i input, __m256i low_table,
+                               __m256i high_table) {
+    const __m256i bit_of_high_nibble = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+        8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+
+    __m256i low = _mm256_and_si256(input, nibble_mask);
+    __m256i high =
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask);
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low_table, low),
+                                     _mm256_shuffle_epi8(high_table, low),
+                                     input);
+    __m256i bit = _mm256_shuffle_epi8(bit_of_high_nibble, high);
+    __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit),
+                                     _mm256_setzero_si256());
+    return ~(u32)_mm256_movemask_epi8(miss);
+}
+
+CORE_TARGET("avx2")
+inline isize string_find_any_of_avx2(const u8* data, isize size,
+                                     const ByteSet* set, isize start) {
+    __m128i low = _mm_loadu_si128((const __m128i*)set->bits);
+    __m128i high = _mm_loadu_si128((const __m128i*)(set->bits + 16));
+    __m256i low_table = _mm256_broadcastsi128_si256(low);
+    __m256i high_table = _mm256_broadcastsi128_si256(high);
+
+    isize i = start;
+    for (; i + 32 <= size; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(data + i));
+        u32 mask = byte_set_match_avx2(input, low_table, high_table);
+        if (mask != 0) {
+            return i + ctz64(mask);
+        }
+    }
+    return string_find_any_of_scalar(data, size, set, i);
+}
+
+CORE_TARGET("avx2")
+inline isize string_find_last_any_of_avx2(const u8* data, isize size,
+                                          const ByteSet* set) {
+    __m128i low = _mm_loadu_si128((const __m128i*)set->bits);
+    __m128i high = _mm_loadu_si128((const __m128i*)(set->bits + 16));
+    __m256i low_table = _mm256_broadcastsi128_si256(low);
+    __m256i high_table = _mm256_broadcastsi128_si256(high);
+
+    isize end = size;
+    for (; end >= 32; end -= 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(data + end - 32));
+        u32 mask = byte_set_match_avx2(input, low_table, high_table);
+        if (mask != 0) {
+            return end - 1 - clz64(mask) + 32;
+        }
+    }
+    return string_find_last_any_of_scalar(data, end, set);
+}
+#endif
+
+inline isize string_find_byte(String str, char c, isize start = 0) {
+    core_assert_msg(start >= 0 && start <= str.size, "%ld out of [0, %ld]",
+                    start, str.size);
+    const u8* data = (const u8*)str.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_find_byte_avx2(data, str.size, (u8)c, start);
+    }
+#endif
+    return string_find_byte_scalar(data, str.size, (u8)c, start);
+}
+
+inline isize string_find_last_byte(String str, char c) {
+    const u8* data = (const u8*)str.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_find_last_byte_avx2(data, str.size, (u8)c);
+    }
+#endif
+    return string_find_last_byte_scalar(data, str.size, (u8)c);
+}
+
+inline isize string_find_any_of(String str, const ByteSet* set,
+                                isize start = 0) {
+    core_assert_msg(start >= 0 && start <= str.size, "%ld out of [0, %ld]",
+                    start, str.size);
+    const u8* data = (const u8*)str.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_find_any_of_avx2(data, str.size, set, start);
+    }
+#endif
+    return string_find_any_of_scalar(data, str.size, set, start);
+}
+
+inline isize string_find_last_any_of(String str, const ByteSet* set) {
+    const u8* data = (const u8*)str.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_find_last_any_of_avx2(data, str.size, set);
+    }
+#endif
+    return string_find_last_any_of_scalar(data, str.size, set);
+}
+
+// Candidates are filtered on the first and last byte of the needle and then
+// compared, which is fastest on typical text but quadratic on inputs like
+// "aaaa...". Needles longer than this switch to two way, which is linear,
+// once the comparisons outgrow the scanned bytes.
+const isize STRING_FIND_TWO_WAY_MIN_SIZE = 32;
+
+inline bool string_find_should_switch(isize needle_size, isize compared,
+                                      isize scanned) {
+    return needle_size > STRING_FIND_TWO_WAY_MIN_SIZE &&
+           compared > 4 * scanned + 16 * needle_size;
+}
+
+// Byte `i` of `data`, counted from the end when searching backwards. The two
+// way search below runs on the reversed strings for string_find_last.
+template <bool reverse>
+inline u8 string_two_way_at(const u8* data, isize size, isize i) {
+    if constexpr (reverse) {
+        return data[size - 1 - i];
+    } else {
+        return data[i];
+    }
+}
+
+// Splits the needle into two halves such that the right one is a maximal
+// suffix, returns the split and the period of the needle
+// source: Crochemore-Perrin two way, as in glibc's str-two-way.h
+template <bool reverse = false>
+inline isize string_two_way_critical_factorization(const u8* needle,
+                                                   isize size,
+                                                   isize* period) {
+    // Maximal suffix for both orderings, the larger one is critical
+    isize suffixes[2];
+    isize periods[2];
+    for (i32 order = 0; order < 2; order++) {
+        isize max_suffix = -1;
+        isize j = 0;
+        isize k = 1;
+        isize p = 1;
+        while (j + k < size) {
+            u8 a = string_two_way_at<reverse>(needle, size, j + k);
+            u8 b = string_two_way_at<reverse>(needle, size, max_suffix + k);
+            if (order == 0 ? a < b : b < a) {
+                j += k;
+                k = 1;
+                p = j - max_suffix;
+            } else if (a == b) {
+                if (k != p) {
+                    k++;
+                } else {
+                    j += p;
+                    k = 1;
+                }
+            } else {
+                max_suffix = j++;
+                k = p = 1;
+            }
+        }
+        suffixes[order] = max_suffix;
+        periods[order] = p;
+    }
+
+    i32 critical = suffixes[1] < suffixes[0] ? 0 : 1;
+    *period = periods[critical];
+    return suffixes[critical] + 1;
+}
+
+// Returns the first match at or after `start`. With `reverse` both strings
+// are read back to front, so `start` and the result count from the end of the
+// haystack to the end of the match.
+template <bool reverse = false>
+inline isize string_find_two_way(const u8* haystack, isize haystack_size,
+                                 const u8* needle, isize size, isize start) {
+    auto h = [&](isize i) {
+        return string_two_way_at<reverse>(haystack, haystack_size, i);
+    };
+    auto n = [&](isize i) {
+        return string_two_way_at<reverse>(needle, size, i);
+    };
+
+    isize period;
+    isize suffix =
+        string_two_way_critical_factorization<reverse>(needle, size, &period);
+
+    // Skip by the last byte of the window, like Boyer-Moore-Horspool
+    isize shift_table[256];
+    for (isize& shift : shift_table) {
+        shift = size;
+    }
+    for (isize i = 0; i < size; i++) {
+        shift_table[n(i)] = size - i - 1;
+    }
+
+    bool periodic;
+    if constexpr (reverse) {
+        periodic = memcmp(needle + size - suffix - period,
+                          needle + size - suffix, suffix) == 0;
+    } else {
+        periodic = memcmp(needle, needle + period, suffix) == 0;
+    }
+
+    isize j = start;
+    if (periodic) {
+        // Periodic needle: after a full match of the right half, the next
+        // possible match is a period further and overlaps what was matched.
+        // `memory` is how much of the left half is known to match already.
+        isize memory = 0;
+        while (j + size <= haystack_size) {
+            isize shift = shift_table[h(j + size - 1)];
+            if (shift > 0) {
+                if (memory != 0 && shift < period) {
+                    shift = size - period;
+                }
+                memory = 0;
+                j += shift;
+                continue;
+            }
+
+            isize i = std::max(suffix, memory);
+            while (i < size - 1 && n(i) == h(i + j)) {
+                i++;
+            }
+            if (i >= size - 1) {
+                i = suffix - 1;
+                while (i >= memory && n(i) == h(i + j)) {
+                    i--;
+                }
+                if (i < memory) {
+                    return j;
+                }
+                j += period;
+                memory = size - period;
+            } else {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
+    } else {
+        // The halves differ, any mismatch allows a maximal shift
+        period = std::max(suffix, size - suffix) + 1;
+        while (j + size <= haystack_size) {
+            isize shift = shift_table[h(j + size - 1)];
+            if (shift > 0) {
+                j += shift;
+                continue;
+            }
+
+            isize i = suffix;
+            while (i < size - 1 && n(i) == h(i + j)) {
+                i++;
+            }
+            if (i >= size - 1) {
+                i = suffix - 1;
+                while (i >= 0 && n(i) == h(i + j)) {
+                    i--;
+                }
+                if (i < 0) {
+                    return j;
+                }
+                j += period;
+            } else {
+                j += i - suffix + 1;
+            }
+        }
+    }
+
+    return -1;
+}
+
+// Candidates come from memchr on the first byte and are checked on the last
+// byte before comparing everything
+inline isize string_find_scalar(const u8* haystack, isize haystack_size,
+                                const u8* needle, isize size, isize start) {
+    isize last = haystack_size - size;
+    isize compared = 0;
+    isize i = start;
+    while (i <= last) {
+        const u8* found = (const u8*)memchr(haystack + i, needle[0],
+                                            last - i + 1);
+        if (found == nullptr) {
+            return -1;
+        }
+        i = found - haystack;
+        if (haystack[i + size - 1] == needle[size - 1]) {
+            if (memcmp(haystack + i + 1, needle + 1, size - 2) == 0) {
+                return i;
+            }
+            compared += size;
+            if (string_find_should_switch(size, compared, i - start)) {
+                return string_find_two_way(haystack, haystack_size, needle,
+                                           size, i + 1);
+            }
+        }
+        i++;
+    }
+    return -1;
+}
+
+#if CORE_X86_SIMD
+// Compares the first and last byte of the needle against 32 windows at a
+// time, only windows matching both are verified
+// source: http://0x80.pl/articles/simd-strfind.html
+CORE_TARGET("avx2")
+inline isize string_find_avx2(const u8* haystack, isize haystack_size,
+                              const u8* needle, isize size, isize start) {
+    const __m256i first = _mm256_set1_epi8((char)needle[0]);
+    const __m256i last = _mm256_set1_epi8((char)needle[size - 1]);
+
+    isize compared = 0;
+    isize i = start;
+    for (; i + size - 1 + 32 <= haystack_size; i += 32) {
+        __m256i block_first =
+            _mm256_loadu_si256((const __m256i*)(haystack + i));
+        __m256i block_last =
+            _mm256_loadu_si256((const __m256i*)(haystack + i + size - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                      _mm256_cmpeq_epi8(last, block_last));
+        u32 eq_mask = (u32)_mm256_movemask_epi8(eq);
+        u32 mask = eq_mask;
+        while (mask != 0) {
+            isize candidate = i + ctz64(mask);
+            if (memcmp(haystack + candidate + 1, needle + 1, size - 2) == 0) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+        compared += popcount64(eq_mask) * size;
+        if (string_find_should_switch(size, compared, i - start)) {
+            return string_find_two_way(haystack, haystack_size, needle, size,
+                                       i + 32);
+        }
+    }
+    return string_find_scalar(haystack, haystack_size, needle, size, i);
+}
+#endif
+
+inline isize string_find(String haystack, String needle, isize start = 0) {
+    core_assert_msg(start >= 0 && start <= haystack.size,
+                    "%ld out of [0, %ld]", start, haystack.size);
+    if (needle.size == 0) {
+        return start;
+    }
+    if (needle.size == 1) {
+        return string_find_byte(haystack, needle.data[0], start);
+    }
+    if (haystack.size - start < needle.size) {
+        return -1;
+    }
+
+    const u8* h = (const u8*)haystack.data;
+    const u8* n = (const u8*)needle.data;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_find_avx2(h, haystack.size, n, needle.size, start);
+    }
+#endif
+    return string_find_scalar(h, haystack.size, n, needle.size, start);
+}
+
+// Candidates come from the last byte of the needle, scanning backwards. Like
+// string_find, it switches to two way on the reversed strings once the
+// comparisons outgrow the scanned bytes.
+inline isize string_find_last(String haystack, String needle) {
+    if (needle.size == 0) {
+        return haystack.size;
+    }
+
+    isize size = needle.size;
+    isize compared = 0;
+    isize end = haystack.size;
+    while (end >= size) {
+        isize last = string_find_last_byte(string_substr(haystack, 0, end),
+                                           needle.data[size - 1]);
+        if (last < size - 1) {
+            return -1;
+        }
+        isize candidate = last - (size - 1);
+        if (memcmp(haystack.data + candidate, needle.data, size) == 0) {
+            return candidate;
+        }
+        end = last;
+
+        compared += size;
+        if (string_find_should_switch(size, compared, haystack.size - end)) {
+            // Remaining candidates end before `end`
+            isize found = string_find_two_way<true>(
+                (const u8*)haystack.data, haystack.size,
+                (const u8*)needle.data, size, haystack.size - end);
+            return found < 0 ? -1 : haystack.size - found - size;
+        }
+    }
+    return -1;
+}
+
+inline bool string_contains(String haystack, String needle) {
+    return string_find(haystack, needle) >= 0;
+}
+
+inline bool string_starts_with(String str, String prefix) {
+    return str.size >= prefix.size &&
+           memcmp(str.data, prefix.data, prefix.size) == 0;
+}
+
+inline bool string_ends_with(String str, String suffix) {
+    return str.size >= suffix.size &&
+           memcmp(str.data + str.size - suffix.size, suffix.data,
+                  suffix.size) == 0;
+}
+
+/// ------------------
+/// String splitting
+/// ------------------
+
+// Iterators yielding views into the string, nothing is allocated. Delimiters
+// are found 64 bytes at a time as a bit mask.
+
+inline u64 string_delimiter_mask_scalar(const u8* data, u8 delimiter) {
+    u64 mask = 0;
+    for (isize i = 0; i < 64; i++) {
+        mask |= (u64)(data[i] == delimiter) << i;
+    }
+    return mask;
+}
+
+inline u64 string_delimiters_mask_scalar(const u8* data, const ByteSet* set) {
+    u64 mask = 0;
+    for (isize i = 0; i < 64; i++) {
+        mask |= (u64)byte_set_contains(set, data[i]) << i;
+    }
+    return mask;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline u64 string_delimiter_mask_avx2(const u8* data, u8 delimiter) {
+    const __m256i needle = _mm256_set1_epi8((char)delimiter);
+    __m256i a = _mm256_loadu_si256((const __m256i*)data);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(data + 32));
+    u32 low = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, needle));
+    u32 high = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, needle));
+    return low | ((u64)high << 32);
+}
+
+CORE_TARGET("avx2")
+inline u64 string_delimiters_mask_avx2(const u8* data, const ByteSet* set) {
+    __m128i low = _mm_loadu_si128((const __m128i*)set->bits);
+    __m128i high = _mm_loadu_si128((const __m128i*)(set->bits + 16));
+    __m256i low_table = _mm256_broadcastsi128_si256(low);
+    __m256i high_table = _mm256_broadcastsi128_si256(high);
+    __m256i a = _mm256_loadu_si256((const __m256i*)data);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(data + 32));
+    return byte_set_match_avx2(a, low_table, high_table) |
+           ((u64)byte_set_match_avx2(b, low_table, high_table) << 32);
+}
+#endif
+
+// Bytes classified per refill. Delimiter positions of a whole window are
+// decoded into a buffer, so the branch on running out of them is taken once
+// per window instead of once per 64 byte mask.
+const isize STRING_SPLIT_WINDOW = 512;
+
+struct StringSplitIterator {
+    String str;
+    // Start of the next piece
+    isize index;
+    // Bytes before this have been classified
+    isize scanned;
+    // Offsets in the current window, `next` is the first not returned yet
+    isize window;
+    isize count;
+    isize next;
+    bool done;
+    bool use_set;
+    bool use_avx2;
+    u8 delimiter;
+    ByteSet delimiters;
+    u16 positions[STRING_SPLIT_WINDOW];
+};
+
+inline u64 split_iter_block_mask(const StringSplitIterator* it,
+                                 const u8* data) {
+#if CORE_X86_SIMD
+    if (it->use_avx2) {
+        return it->use_set ? string_delimiters_mask_avx2(data, &it->delimiters)
+                           : string_delimiter_mask_avx2(data, it->delimiter);
+    }
+#endif
+    return it->use_set ? string_delimiters_mask_scalar(data, &it->delimiters)
+                       : string_delimiter_mask_scalar(data, it->delimiter);
+}
+
+// Appends the offsets of the set bits, returns how many. The first 8 are
+// written unconditionally, most masks have fewer and then there is no data
+// dependent branch. Bit 63 keeps ctz defined once the mask is empty.
+inline isize split_iter_decode(u16* out, u64 mask, isize offset) {
+    isize count = popcount64(mask);
+    for (isize k = 0; k < 8; k++) {
+        out[k] = (u16)(offset + ctz64(mask | ((u64)1 << 63)));
+        mask &= mask - 1;
+    }
+    for (isize k = 8; k < count; k++) {
+        out[k] = (u16)(offset + ctz64(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+// Classifies windows until one has delimiters, false when the string ends
+inline bool split_iter_refill(StringSplitIterator* it) {
+    const u8* data = (const u8*)it->str.data;
+    while (it->scanned < it->str.size) {
+        isize window = it->scanned;
+        isize size = std::min(STRING_SPLIT_WINDOW, it->str.size - window);
+        isize count = 0;
+        isize block = 0;
+        // At most 7 full blocks precede the last one, so its 64 offsets
+        // still fit
+        for (; block + 64 <= size; block += 64) {
+            u64 mask = split_iter_block_mask(it, data + window + block);
+            count += split_iter_decode(it->positions + count, mask, block);
+        }
+        if (block < size) {
+            // Bytes past the end are masked out
+            u8 tail[64] = {};
+            memcpy(tail, data + window + block, size - block);
+            u64 mask = split_iter_block_mask(it, tail) &
+                       (((u64)1 << (size - block)) - 1);
+            count += split_iter_decode(it->positions + count, mask, block);
+        }
+
+        it->scanned = window + size;
+        it->window = window;
+        it->count = count;
+        it->next = 0;
+        if (count > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline StringSplitIterator string_split_init(String str) {
+    StringSplitIterator it;
+    it.str = str;
+    it.index = 0;
+    it.scanned = 0;
+    it.window = 0;
+    it.count = 0;
+    it.next = 0;
+    it.done = false;
+    it.use_set = false;
+    it.use_avx2 = cpu_has_feature(CpuFeature::Avx2);
+    it.delimiter = 0;
+    it.delimiters = {};
+    return it;
+}
+
+// n delimiters give n + 1 pieces, possibly empty: "a,,b" is "a", "", "b"
+inline StringSplitIterator string_split(String str, char delimiter) {
+    StringSplitIterator it = string_split_init(str);
+    it.delimiter = (u8)delimiter;
+    return it;
+}
+
+inline StringSplitIterator string_split_any(String str,
+                                            const ByteSet* delimiters) {
+    StringSplitIterator it = string_split_init(str);
+    it.use_set = true;
+    it.delimiters = *delimiters;
+    return it;
+}
+
+inline String split_iter_next(StringSplitIterator* it) {
+    core_assert(it != nullptr);
+    core_assert_msg(!it->done, "Iterating past the last piece");
+
+    if (it->next == it->count && !split_iter_refill(it)) {
+        it->done = true;
+        return String{it->str.data + it->index, it->str.size - it->index};
+    }
+
+    isize position = it->window + it->positions[it->next++];
+    String piece = {it->str.data + it->index, position - it->index};
+    it->index = position + 1;
+    return piece;
+}
+
+inline bool split_iter_done(const StringSplitIterator* it) {
+    core_assert(it != nullptr);
+    return it->done;
+}
+
+struct LineIterator {
+    StringSplitIterator split;
+};
+
+// Lines end with "\n" or "\r\n", which are not part of them. A final line
+// without a newline is returned as well, but a trailing newline doesn't start
+// an empty last line.
+inline LineIterator string_lines(String str) {
+    return LineIterator{string_split(str, '\n')};
+}
+
+inline String line_iter_next(LineIterator* it) {
+    core_assert(it != nullptr);
+    String line = split_iter_next(&it->split);
+    if (line.size > 0 && line.data[line.size - 1] == '\r') {
+        line.size--;
+    }
+    return line;
+}
+
+inline bool line_iter_done(const LineIterator* it) {
+    core_assert(it != nullptr);
+    return it->split.done || it->split.index >= it->split.str.size;
+}
+
+/// ------------------
+/// Array
+/// ------------------
+
+template <typename T> struct Array {
+    Allocator alloc;
+    Slice<T> items;
+    isize capacity;
+};
+
+template <typename T>
+inline void array_init(Array<T>* list, Allocator alloc, isize capacity = 0) {
+    core_assert(list != nullptr);
+    core_assert(alloc.alloc != nullptr);
+    core_assert(capacity > 0);
+
+    list->alloc = alloc;
+    if (capacity > 0) {
+        list->items.data = core_alloc<T>(alloc, capacity);
+        list->items.size = 0;
+    }
+    list->capacity = capacity;
+}
+
+template <typename T>
+inline Array<T> array_make(Allocator alloc, isize capacity = 0) {
+    Array<T> list;
+    array_init(&list, alloc, capacity);
+    return list;
+}
+
+template <typename T> inline void array_push(Array<T>* array, T item) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size >= 0);
+    core_assert(array->items.size <= array->capacity);
+
+    if (array->items.size + 1 > array->capacity) {
+        isize new_capacity = std::max(array->capacity * 2, (isize)4);
+        array->items.data = core_realloc<T>(array->alloc, array->items.data,
+                                            array->capacity * sizeof(T),
+                                            new_capacity * sizeof(T));
+        array->capacity = new_capacity;
+    }
+
+    array->items[array->items.size++] = item;
+}
+
+template <typename T> inline void array_push_if_new(Array<T>* array, T item) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size >= 0);
+    core_assert(array->items.size <= array->capacity);
+
+    if (!array_contains(array, item)) {
+        array_push(array, item);
+    }
+}
+
+// Makes room for `count` more items without changing the size, so they can
+// be written directly to items.data
+template <typename T> inline void array_reserve(Array<T>* array, isize count) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size >= 0);
+    core_assert(array->items.size <= array->capacity);
+    core_assert_msg(count >= 0, "%ld < 0", count);
+
+    isize new_size = array->items.size + count;
+    if (new_size > array->capacity) {
+        isize new_capacity = std::max(array->capacity * 2, new_size);
+        array->items.data = core_realloc<T>(array->alloc, array->items.data,
+                                            array->capacity * sizeof(T),
+                                            new_capacity * sizeof(T));
+        array->capacity = new_capacity;
+    }
+}
+
+template <typename T>
+inline void array_push_slice(Array<T>* array, Slice<T> slice) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size >= 0);
+    core_assert(array->items.size <= array->capacity);
+
+    array_reserve(array, slice.size);
+    memcpy(array->items.data + array->items.size, slice.data,
+           sizeof(T) * slice.size);
+    array->items.size += slice.size;
+}
+
+template <typename T> inline T array_pop(Array<T>* array) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    T item = array->items[array->items.size - 1];
+    array->items.size--;
+    return item;
+}
+
+template <typename T> inline void array_clear(Array<T>* array) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size <= array->capacity);
+
+    array->items.size = 0;
+}
+
+template <typename T>
+inline T array_remove_at_unordered(Array<T>* array, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->items.size, "%ld >= %ld", index,
+                    array->items.size);
+
+    T value = array->items[index];
+    array->items[index] = array->items[array->items.size - 1];
+    array->items.size -= 1;
+
+    return value;
+}
+
+template <typename T>
+inline bool array_remove_unordered(Array<T>* array, T value) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    for (isize i = 0; i < array->items.size; i++) {
+        if (array->items[i] == value) {
+            array_remove_at_unordered(array, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T> inline isize array_index_of(Array<T>* array, T value) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    for (isize i = 0; i < array->items.size; i++) {
+        if (array->items[i] == value) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+template <typename T> inline T array_remove_at(Array<T>* array, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->items.size, "%ld >= %ld", index,
+                    array->items.size);
+
+    T value = array->items[index];
+    memmove(array->items.data + index, array->items.data + index + 1,
+            (array->items.size - index - 1) * sizeof(T));
+
+    return value;
+}
+
+template <typename T> inline void array_remove(Array<T>* array, T value) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    for (isize i = 0; i < array->items.size; i++) {
+        if (array->items[i] == value) {
+            array_remove_at(array, i);
+            return;
+        }
+    }
+}
+
+template <typename T>
+inline void array_insert(Array<T>* array, isize index, T value) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index <= array->size, "%ld > %ld", index, array->size);
+
+    array_push(array, value);
+
+    for (isize i = array->size - 1; i > index; i--) {
+        array->data[i] = array->data[i - 1];
+    }
+
+    array->data[index] = value;
+}
+
+template <typename T>
+inline void array_swap(Array<T>* array, isize index_a, isize index_b) {
+    core_assert_msg(index_a >= 0, "%ld < 0", index_a);
+    core_assert_msg(index_b >= 0, "%ld < 0", index_b);
+    core_assert_msg(index_a < array->size, "%ld >= %ld", index_a, array->size);
+    core_assert_msg(index_b < array->size, "%ld >= %ld", index_b, array->size);
+
+    T temp = array->items[index_a];
+    array->items[index_a] = array->items[index_b];
+    array->items[index_b] = temp;
+}
+
+template <typename T> inline bool array_contains(Array<T>* array, T value) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    for (isize i = 0; i < array->items.size; i++) {
+        if (array->items[i] == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T> inline T array_last(Array<T>* array) {
+    core_assert(array != nullptr);
+    core_assert(array->alloc.alloc != nullptr);
+    core_assert(array->items.data != nullptr);
+    core_assert(array->items.size > 0);
+    core_assert(array->items.size <= array->capacity);
+
+    return array->items[array->items.size - 1];
+}
+
+/// ------------------
+/// Multi pattern matching
+/// ------------------
+
+// Finds every occurrence of a set of patterns in one pass. Patterns are
+// compiled into an Aho-Corasick DFA: bytes that occur in no pattern share one
+// class, and each state has a dense row of transitions over the classes.
+// Small sets scan with Teddy instead, which compares the first bytes of all
+// patterns against 32 positions at once with nibble lookups and verifies the
+// few candidates.
+
+struct MultiMatch {
+    i32 pattern;
+    // Start of the occurrence in the text
+    isize offset;
+};
+
+// Transitions hold the row offset of the target state (state * class count),
+// so a step is one load and one add. Targets with matches have this bit set.
+const u32 MULTI_MATCHER_MATCH_FLAG = 0x80000000;
+
+// Teddy keeps one bit per bucket in a byte and looks at up to 3 bytes. With
+// more than 2 patterns per bucket the nibble lookups let through too many
+// candidates and the DFA is faster.
+const i32 MULTI_MATCHER_TEDDY_MAX_PATTERNS = 16;
+const i32 MULTI_MATCHER_TEDDY_BUCKETS = 8;
+const i32 MULTI_MATCHER_TEDDY_BYTES = 3;
+
+struct MultiMatcher {
+    Allocator alloc;
+    // Single allocation holding all the tables below and the pattern bytes
+    u8* memory;
+    isize memory_size;
+
+    i32 pattern_count;
+    i32 min_pattern_size;
+    i32 max_pattern_size;
+    const u8* pattern_bytes;
+    // Pattern i is pattern_bytes[pattern_offsets[i], pattern_offsets[i + 1])
+    const isize* pattern_offsets;
+    // Next pattern equal to this one, or -1
+    const i32* pattern_duplicates;
+
+    i32 state_count;
+    i32 class_count;
+    u8 classes[256];
+    const u32* transitions;
+    // First pattern ending at each state, or -1
+    const i32* state_patterns;
+    // Closest state on the failure chain with a pattern, or -1
+    const i32* output_links;
+
+    bool use_teddy;
+    u8 teddy_low[MULTI_MATCHER_TEDDY_BYTES][16];
+    u8 teddy_high[MULTI_MATCHER_TEDDY_BYTES][16];
+    // Patterns of each bucket as a bit mask of ids
+    u32 teddy_buckets[MULTI_MATCHER_TEDDY_BUCKETS];
+};
+
+inline String multi_matcher_pattern(const MultiMatcher* matcher, i32 pattern) {
+    isize start = matcher->pattern_offsets[pattern];
+    return String{(const char*)matcher->pattern_bytes + start,
+                  matcher->pattern_offsets[pattern + 1] - start};
+}
+
+inline void multi_matcher_build_teddy(MultiMatcher* matcher) {
+    i32 bytes = std::min(matcher->min_pattern_size, MULTI_MATCHER_TEDDY_BYTES);
+    // Positions past the shortest pattern accept every bucket
+    memset(matcher->teddy_low, 0xFF, sizeof(matcher->teddy_low));
+    memset(matcher->teddy_high, 0xFF, sizeof(matcher->teddy_high));
+    for (i32 k = 0; k < bytes; k++) {
+        memset(matcher->teddy_low[k], 0, 16);
+        memset(matcher->teddy_high[k], 0, 16);
+    }
+    memset(matcher->teddy_buckets, 0, sizeof(matcher->teddy_buckets));
+
+    for (i32 p = 0; p < matcher->pattern_count; p++) {
+        i32 bucket = p % MULTI_MATCHER_TEDDY_BUCKETS;
+        matcher->teddy_buckets[bucket] |= 1u << p;
+        String pattern = multi_matcher_pattern(matcher, p);
+        for (i32 k = 0; k < bytes; k++) {
+            u8 c = (u8)pattern.data[k];
+            matcher->teddy_low[k][c & 15] |= (u8)(1 << bucket);
+            matcher->teddy_high[k][c >> 4] |= (u8)(1 << bucket);
+        }
+    }
+}
+
+inline void multi_matcher_init(MultiMatcher* matcher, Slice<String> patterns,
+                               Allocator alloc) {
+    core_assert(matcher != nullptr);
+    core_assert_msg(patterns.size > 0, "No patterns");
+    core_assert_msg(patterns.size < INT32_MAX, "Too many patterns");
+
+    // Byte classes, 0 is every byte no pattern contains
+    memset(matcher->classes, 0, sizeof(matcher->classes));
+    isize total_size = 0;
+    i32 min_pattern_size = INT32_MAX;
+    i32 max_pattern_size = 0;
+    for (String pattern : patterns) {
+        core_assert_msg(pattern.size > 0, "Empty pattern");
+        total_size += pattern.size;
+        min_pattern_size = std::min(min_pattern_size, (i32)pattern.size);
+        max_pattern_size = std::max(max_pattern_size, (i32)pattern.size);
+        for (isize i = 0; i < pattern.size; i++) {
+            matcher->classes[(u8)pattern.data[i]] = 1;
+        }
+    }
+    i32 class_count = 1;
+    for (u8& c : matcher->classes) {
+        c = c ? (u8)class_count++ : 0;
+    }
+
+    // A trie has at most one state per pattern byte
+    isize max_states = total_size + 1;
+    core_assert_msg(max_states * class_count < (isize)MULTI_MATCHER_MATCH_FLAG,
+                    "Patterns too large");
+
+    // One allocation, largest alignment first
+    isize transitions_size = max_states * class_count * (isize)sizeof(u32);
+    isize offsets_size = (patterns.size + 1) * (isize)sizeof(isize);
+    isize states_size = max_states * (isize)sizeof(i32);
+    isize duplicates_size = patterns.size * (isize)sizeof(i32);
+    matcher->memory_size = offsets_size + transitions_size + 2 * states_size +
+                           duplicates_size + total_size;
+    matcher->memory =
+        core_alloc<u8>(alloc, matcher->memory_size, alignof(isize));
+    matcher->alloc = alloc;
+
+    u8* cursor = matcher->memory;
+    isize* pattern_offsets = (isize*)cursor;
+    cursor += offsets_size;
+    u32* transitions = (u32*)cursor;
+    cursor += transitions_size;
+    i32* state_patterns = (i32*)cursor;
+    cursor += states_size;
+    i32* output_links = (i32*)cursor;
+    cursor += states_size;
+    i32* pattern_duplicates = (i32*)cursor;
+    cursor += duplicates_size;
+    u8* pattern_bytes = cursor;
+
+    // Trie, a transition to 0 means none since the root is nobody's child
+    memset(transitions, 0, transitions_size);
+    for (isize s = 0; s < max_states; s++) {
+        state_patterns[s] = -1;
+    }
+    i32 state_count = 1;
+    isize offset = 0;
+    for (i32 p = 0; p < (i32)patterns.size; p++) {
+        String pattern = patterns[p];
+        pattern_offsets[p] = offset;
+        memcpy(pattern_bytes + offset, pattern.data, pattern.size);
+        offset += pattern.size;
+
+        i32 state = 0;
+        for (isize i = 0; i < pattern.size; i++) {
+            u32* next = &transitions[(isize)state * class_count +
+                                     matcher->classes[(u8)pattern.data[i]]];
+            if (*next == 0) {
+                *next = (u32)state_count++;
+            }
+            state = (i32)*next;
+        }
+        // Keep duplicates in a list, the last one added goes first
+        pattern_duplicates[p] = state_patterns[state];
+        state_patterns[state] = p;
+    }
+    pattern_offsets[patterns.size] = offset;
+
+    // Breadth first, the failure of a state is the longest proper suffix
+    // that is also in the trie. Missing transitions are taken from it, which
+    // turns the trie into a DFA. The scratch is temporary, so it stays out of
+    // `alloc` and the matcher remains a single allocation there.
+    Slice<i32> scratch = slice_make<i32>(2 * state_count, c_allocator());
+    defer(core_free(c_allocator(), scratch.data));
+    i32* failures = scratch.data;
+    i32* queue = scratch.data + state_count;
+    isize head = 0;
+    isize tail = 0;
+    output_links[0] = -1;
+    for (i32 c = 0; c < class_count; c++) {
+        i32 child = (i32)transitions[c];
+        if (child != 0) {
+            failures[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        i32 state = queue[head++];
+        i32 failure = failures[state];
+        output_links[state] = state_patterns[failure] >= 0
+                                  ? failure
+                                  : output_links[failure];
+
+        u32* row = &transitions[(isize)state * class_count];
+        const u32* failure_row = &transitions[(isize)failure * class_count];
+        for (i32 c = 0; c < class_count; c++) {
+            if (row[c] != 0) {
+                failures[row[c]] = (i32)failure_row[c];
+                queue[tail++] = (i32)row[c];
+            } else {
+                row[c] = failure_row[c];
+            }
+        }
+    }
+
+    // Row offsets instead of state ids, flagged when the target reports
+    for (isize i = 0; i < (isize)state_count * class_count; i++) {
+        i32 target = (i32)transitions[i];
+        bool reports = state_patterns[target] >= 0 || output_links[target] >= 0;
+        transitions[i] = (u32)(target * class_count) |
+                         (reports ? MULTI_MATCHER_MATCH_FLAG : 0);
+    }
+
+    matcher->pattern_count = (i32)patterns.size;
+    matcher->min_pattern_size = min_pattern_size;
+    matcher->max_pattern_size = max_pattern_size;
+    matcher->pattern_bytes = pattern_bytes;
+    matcher->pattern_offsets = pattern_offsets;
+    matcher->pattern_duplicates = pattern_duplicates;
+    matcher->state_count = state_count;
+    matcher->class_count = class_count;
+    matcher->transitions = transitions;
+    matcher->state_patterns = state_patterns;
+    matcher->output_links = output_links;
+
+    matcher->use_teddy = patterns.size <= MULTI_MATCHER_TEDDY_MAX_PATTERNS;
+    if (matcher->use_teddy) {
+        multi_matcher_build_teddy(matcher);
+    }
+}
+
+inline MultiMatcher multi_matcher_make(Slice<String> patterns,
+                                       Allocator alloc) {
+    MultiMatcher matcher;
+    multi_matcher_init(&matcher, patterns, alloc);
+    return matcher;
+}
+
+inline void multi_matcher_free(MultiMatcher* matcher) {
+    core_assert(matcher != nullptr);
+    core_free(matcher->alloc, matcher->memory);
+    matcher->memory = nullptr;
+}
+
+// Reports the patterns ending at `end` in the state at row offset `row`
+inline void multi_matcher_report(const MultiMatcher* matcher, u32 row,
+                                 isize end, Array<MultiMatch>* matches) {
+    i32 state = (i32)(row / (u32)matcher->class_count);
+    if (matcher->state_patterns[state] < 0) {
+        state = matcher->output_links[state];
+    }
+    while (state >= 0) {
+        for (i32 p = matcher->state_patterns[state]; p >= 0;
+             p = matcher->pattern_duplicates[p]) {
+            isize size = matcher->pattern_offsets[p + 1] -
+                         matcher->pattern_offsets[p];
+            array_push(matches, MultiMatch{p, end - size + 1});
+        }
+        state = matcher->output_links[state];
+    }
+}
+
+// Each step waits for the previous transition, so texts are split into
+// chunks scanned as independent interleaved streams
+const isize MULTI_MATCHER_STREAMS = 4;
+const isize MULTI_MATCHER_STREAM_MIN_SIZE = 4096;
+
+inline u32 multi_matcher_step(const u32* transitions, const u8* classes,
+                              u32 state, u8 c) {
+    return transitions[(state & ~MULTI_MATCHER_MATCH_FLAG) + classes[c]];
+}
+
+inline void multi_matcher_find_all_dfa(const MultiMatcher* matcher,
+                                       String text,
+                                       Array<MultiMatch>* matches) {
+    // Locals, the report calls would force reloading them from the matcher
+    const u32* transitions = matcher->transitions;
+    const u8* classes = matcher->classes;
+    const u8* data = (const u8*)text.data;
+    isize start = 0;
+    u32 state = 0;
+    if (text.size >= MULTI_MATCHER_STREAM_MIN_SIZE) {
+        isize chunk = text.size / MULTI_MATCHER_STREAMS;
+        u32 states[MULTI_MATCHER_STREAMS];
+        isize starts[MULTI_MATCHER_STREAMS];
+        for (isize k = 0; k < MULTI_MATCHER_STREAMS; k++) {
+            // Matches ending in the chunk start at most this far before it
+            starts[k] = k * chunk;
+            isize warm_up = std::max(
+                starts[k] - (isize)matcher->max_pattern_size + 1, (isize)0);
+            states[k] = 0;
+            for (isize i = warm_up; i < starts[k]; i++) {
+                states[k] = multi_matcher_step(transitions, classes,
+                                               states[k], data[i]);
+            }
+        }
+
+        for (isize j = 0; j < chunk; j++) {
+            u32 any = 0;
+            for (isize k = 0; k < MULTI_MATCHER_STREAMS; k++) {
+                states[k] = multi_matcher_step(transitions, classes, states[k],
+                                               data[starts[k] + j]);
+                any |= states[k];
+            }
+            if (any & MULTI_MATCHER_MATCH_FLAG) {
+                for (isize k = 0; k < MULTI_MATCHER_STREAMS; k++) {
+                    if (states[k] & MULTI_MATCHER_MATCH_FLAG) {
+                        multi_matcher_report(
+                            matcher, states[k] & ~MULTI_MATCHER_MATCH_FLAG,
+                            starts[k] + j, matches);
+                    }
+                }
+            }
+        }
+
+        // The last stream continues over the remainder
+        state = states[MULTI_MATCHER_STREAMS - 1];
+        start = MULTI_MATCHER_STREAMS * chunk;
+    }
+
+    for (isize i = start; i < text.size; i++) {
+        state = multi_matcher_step(transitions, classes, state, data[i]);
+        if (state & MULTI_MATCHER_MATCH_FLAG) {
+            multi_matcher_report(matcher, state & ~MULTI_MATCHER_MATCH_FLAG,
+                                 i, matches);
+        }
+    }
+}
+
+// Checks the patterns of `buckets` starting at `position`
+inline void multi_matcher_verify(const MultiMatcher* matcher, String text,
+                                 isize position, u32 buckets,
+                                 Array<MultiMatch>* matches) {
+    while (buckets != 0) {
+        u32 patterns = matcher->teddy_buckets[ctz64(buckets)];
+        buckets &= buckets - 1;
+        while (patterns != 0) {
+            i32 p = (i32)ctz64(patterns);
+            patterns &= patterns - 1;
+            String pattern = multi_matcher_pattern(matcher, p);
+            if (pattern.size <= text.size - position &&
+                memcmp(text.data + position, pattern.data, pattern.size) ==
+                    0) {
+                array_push(matches, MultiMatch{p, position});
+            }
+        }
+    }
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline __m256i multi_matcher_teddy_lookup(const u8* data, __m256i low,
+                                          __m256i high) {
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+    __m256i input = _mm256_loadu_si256((const __m256i*)data);
+    __m256i low_nibbles = _mm256_and_si256(input, nibble_mask);
+    __m256i high_nibbles =
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask);
+    return _mm256_and_si256(_mm256_shuffle_epi8(low, low_nibbles),
+                            _mm256_shuffle_epi8(high, high_nibbles));
+}
+
+// Buckets whose patterns may start at each of 32 positions are the AND of
+// the lookups of the following bytes
+// source: Teddy from Hyperscan, as described in
+// https://github.com/rust-lang/regex/tree/master/regex-automata
+CORE_TARGET("avx2")
+inline void multi_matcher_find_all_teddy_avx2(const MultiMatcher* matcher,
+                                              String text,
+                                              Array<MultiMatch>* matches) {
+    __m256i low[MULTI_MATCHER_TEDDY_BYTES];
+    __m256i high[MULTI_MATCHER_TEDDY_BYTES];
+    for (i32 k = 0; k < MULTI_MATCHER_TEDDY_BYTES; k++) {
+        low[k] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)matcher->teddy_low[k]));
+        high[k] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)matcher->teddy_high[k]));
+    }
+
+    const u8* data = (const u8*)text.data;
+    isize i = 0;
+    for (; i + 32 + MULTI_MATCHER_TEDDY_BYTES - 1 <= text.size; i += 32) {
+        __m256i buckets = _mm256_and_si256(
+            _mm256_and_si256(
+                multi_matcher_teddy_lookup(data + i, low[0], high[0]),
+                multi_matcher_teddy_lookup(data + i + 1, low[1], high[1])),
+            multi_matcher_teddy_lookup(data + i + 2, low[2], high[2]));
+        u32 candidates = ~(u32)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(buckets, _mm256_setzero_si256()));
+        if (candidates == 0) {
+            continue;
+        }
+
+        u8 lanes[32];
+        _mm256_storeu_si256((__m256i*)lanes, buckets);
+        while (candidates != 0) {
+            isize j = ctz64(candidates);
+            candidates &= candidates - 1;
+            multi_matcher_verify(matcher, text, i + j, lanes[j], matches);
+        }
+    }
+
+    // Every bucket is a candidate for the last few positions
+    u32 all_buckets = (1u << MULTI_MATCHER_TEDDY_BUCKETS) - 1;
+    for (; i < text.size; i++) {
+        multi_matcher_verify(matcher, text, i, all_buckets, matches);
+    }
+}
+#endif
+
+// Appends every occurrence of every pattern to `matches`, overlapping ones
+// included. The order of the matches is not specified.
+inline void multi_matcher_find_all(const MultiMatcher* matcher, String text,
+                                   Array<MultiMatch>* matches) {
+    core_assert(matcher != nullptr);
+    core_assert(matches != nullptr);
+#if CORE_X86_SIMD
+    if (matcher->use_teddy && cpu_has_feature(CpuFeature::Avx2)) {
+        multi_matcher_find_all_teddy_avx2(matcher, text, matches);
+        return;
+    }
+#endif
+    multi_matcher_find_all_dfa(matcher, text, matches);
+}
+
+/// ------------------
+/// Ring buffer
+/// ------------------
+
+inline isize mod_by_power_of_two(isize x, isize m) {
+    core_assert_msg((m & (m - 1)) == 0, "m must be a power of 2");
+
+    return x & (m - 1);
+}
+
+template <typename T> struct RingBuffer {
+    Allocator alloc;
+    T* data;
+    isize capacity;
+    // This is a position. Not an index. It can be larger than capacity.
+    // To get the index, do start_pos % capacity
+    isize start_pos;
+    // This is a position. Not an index. It can be larger than capacity.
+    // To get the index, do end_pos % capacity
+    isize end_pos;
+
+    T& operator[](isize index) {
+        core_assert(index >= 0);
+        core_assert(index < ring_buffer_size(this));
+
+        isize real_index = mod_by_power_of_two((start_pos + index), capacity);
+        return this->data[real_index];
+    }
+
+    const T& operator[](isize index) const {
+        core_assert(index >= 0);
+        core_assert(index < ring_buffer_size(this));
+
+        isize real_index = mod_by_power_of_two((start_pos + index), capacity);
+        return this->data[real_index];
+    }
+};
+
+template <typename T> inline isize ring_buffer_size(RingBuffer<T>* rb) {
+    return rb->end_pos - rb->start_pos;
+}
+
+template <typename T>
+inline void ring_buffer_init(RingBuffer<T>* ring_buffer, isize capacity,
+                             Allocator alloc) {
+    core_assert(ring_buffer != nullptr);
+    core_assert(capacity > 0);
+    core_assert_msg((capacity & (capacity - 1)) == 0,
+                    "Capacity must be a power of 2");
+    ring_buffer->alloc = alloc;
+    ring_buffer->data = core_alloc<T>(alloc, capacity);
+    ring_buffer->capacity = capacity;
+    ring_buffer->start_pos = 0;
+    ring_buffer->end_pos = 0;
+}
+
+template <typename T>
+inline RingBuffer<T> ring_buffer_make(isize capacity, Allocator alloc) {
+    RingBuffer<T> buffer = {};
+    ring_buffer_init(&buffer, capacity, alloc);
+    return buffer;
+}
+
+template <typename T>
+inline void ring_buffer_push_end(RingBuffer<T>* ring_buffer, T value) {
+    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
+    core_assert(ring_buffer->capacity > 0);
+    core_assert(ring_buffer->data);
+
+    isize size = ring_buffer_size(ring_buffer);
+
+    // Grow
+    if (size == ring_buffer->capacity) {
+        isize new_capacity = ring_buffer->capacity * 2;
+        T* new_data = core_alloc<T>(ring_buffer->alloc, new_capacity);
+
+        isize start_index =
+            mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
+        isize end_index =
+            mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+
+        if (start_index < end_index) {
+            memcpy(new_data, ring_buffer->data + start_index, sizeof(T) * size);
+        } else {
+            isize first_size = ring_buffer->capacity - start_index;
+            memcpy(new_data, ring_buffer->data + start_index,
+                   sizeof(T) * first_size);
+            memcpy(new_data + first_size, ring_buffer->data,
+                   sizeof(T) * end_index);
+        }
+
+        core_free(ring_buffer->alloc, ring_buffer->data);
+        ring_buffer->data = new_data;
+        ring_buffer->capacity = new_capacity;
+        ring_buffer->start_pos = 0;
+        ring_buffer->end_pos = size;
+    }
+
+    isize new_index =
+        mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+    ring_buffer->data[new_index] = value;
+    ring_buffer->end_pos += 1;
+}
+
+template <typename T>
+inline void ring_buffer_push_front(RingBuffer<T>* ring_buffer, T value) {
+    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
+    core_assert(ring_buffer->capacity > 0);
+    core_assert(ring_buffer->data);
+
+    isize size = ring_buffer_size(ring_buffer);
+
+    // Grow
+    if (size == ring_buffer->capacity) {
+        isize new_capacity = ring_buffer->capacity * 2;
+        T* new_data = core_alloc<T>(ring_buffer->alloc, new_capacity);
+
+        isize start_index =
+            mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
+        isize end_index =
+            mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+
+        if (start_index < end_index) {
+            memcpy(new_data + 1, ring_buffer->data + start_index,
+                   sizeof(T) * size);
+        } else {
+            isize first_size = ring_buffer->capacity - start_index;
+            memcpy(new_data + 1, ring_buffer->data + start_index,
+                   sizeof(T) * first_size);
+            memcpy(new_data + 1 + first_size, ring_buffer->data,
+                   sizeof(T) * end_index);
+        }
+
+        core_free(ring_buffer->alloc, ring_buffer->data);
+        ring_buffer->data = new_data;
+        ring_buffer->capacity = new_capacity;
+        ring_buffer->start_pos = 1;
+        ring_buffer->end_pos = size + 1;
+    }
+
+    ring_buffer->start_pos -= 1;
+    isize new_index =
+        mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
+    ring_buffer->data[new_index] = value;
+}
+
+template <typename T>
+inline T ring_buffer_pop_front(RingBuffer<T>* ring_buffer) {
+    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
+    core_assert(ring_buffer->capacity > 0);
+    core_assert(ring_buffer->data);
+
+    core_assert_msg(ring_buffer->start_pos != ring_buffer->end_pos,
+                    "ring_buffer is empty");
+
+    isize start_index =
+        mod_by_power_of_two(ring_buffer->start_pos, ring_buffer->capacity);
+    T value = ring_buffer->data[start_index];
+    ring_buffer->start_pos += 1;
+
+    return value;
+}
+
+template <typename T> inline T ring_buffer_pop_end(RingBuffer<T>* ring_buffer) {
+    core_assert(ring_buffer->end_pos >= ring_buffer->start_pos);
+    core_assert(ring_buffer->capacity > 0);
+    core_assert(ring_buffer->data);
+
+    core_assert_msg(ring_buffer->start_pos != ring_buffer->end_pos,
+                    "ring_buffer is empty");
+
+    ring_buffer->end_pos -= 1;
+    isize end_index =
+        mod_by_power_of_two(ring_buffer->end_pos, ring_buffer->capacity);
+    T value = ring_buffer->data[end_index];
+
+    return value;
+}
+
+template <typename T>
+inline bool ring_buffer_contains(RingBuffer<T>* ring_buffer, T value) {
+    isize size = ring_buffer_size(ring_buffer);
+    for (isize i = 0; i < size; i++) {
+        if ((*ring_buffer)[i] == value) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// ------------------
+/// StaticArray
+/// ------------------
+
+#define ARRAY_PROGRAMMING_OVERLOADS(LEN)                                       \
+    T& operator[](isize index) {                                               \
+        core_assert(index >= 0);                                               \
+        core_assert(index < LEN);                                              \
+        return data[index];                                                    \
+    }                                                                          \
+                                                                               \
+    const T& operator[](isize index) const {                                   \
+        core_assert(index >= 0);                                               \
+        core_assert(index < LEN);                                              \
+        return data[index];                                                    \
+    }                                                                          \
+                                                                               \
+    bool operator==(const StaticArray<T, LEN>& other) const {                  \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            if (data[i] != other[i]) {                                         \
+                return false;                                                  \
+            }                                                                  \
+        }                                                                      \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    bool operator!=(const StaticArray<T, LEN>& other) const {                  \
+        return !(*this == other);                                              \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN> operator*(const StaticArray<T, LEN>& other) const {    \
+        StaticArray<T, LEN> result;                                            \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            result[i] = data[i] * other[i];                                    \
+        }                                                                      \
+        return result;                                                         \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN> operator/(const StaticArray<T, LEN>& other) const {    \
+        StaticArray<T, LEN> result;                                            \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            result[i] = data[i] / other[i];                                    \
+        }                                                                      \
+        return result;                                                         \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN> operator+(const StaticArray<T, LEN>& other) const {    \
+        StaticArray<T, LEN> result;                                            \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            result[i] = data[i] + other[i];                                    \
+        }                                                                      \
+        return result;                                                         \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN> operator-(const StaticArray<T, LEN>& other) const {    \
+        StaticArray<T, LEN> result;                                            \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            result[i] = data[i] - other[i];                                    \
+        }                                                                      \
+        return result;                                                         \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN>& operator*=(const StaticArray<T, LEN>& other) {        \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            data[i] *= other[i];                                               \
+        }                                                                      \
+        return *this;                                                          \
+    }                                                                          \
+                                                                               \
+    StaticArray<T, LEN>& operator/=(const StaticArray<T, LEN>& other) {        \
+        for (isize i = 0; i < LEN; i++) {                                      \
+            data[i] /= other[i];                                               \
+        }                                                                      \
+        return *this;                                                          \
+    }                                                                          \
+                                                                               \
     StaticArray<T, LEN>& operator+=(const StaticArray<T, LEN>& other) {        \
         for (isize i = 0; i < LEN; i++) {                                      \
             data[i] += other[i];                                               \
@@ -1680,484 +5329,4234 @@ inline bool ring_buffer_contains(RingBuffer<T>* ring_buffer, T value) {
         return *this;                                                          \
     }
 
-template <typename T, isize N> struct StaticArray {
-    T data[N];
-    static const isize size = N;
+template <typename T, isize N> struct StaticArray {
+    T data[N];
+    static const isize size = N;
+
+    ARRAY_PROGRAMMING_OVERLOADS(N)
+};
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-anonymous-struct"
+#pragma clang diagnostic ignored "-Wnested-anon-types"
+template <typename T> struct StaticArray<T, 3> {
+    union {
+        T data[3];
+        struct {
+            T x, y, z;
+        };
+        struct {
+            T r, g, b;
+        };
+    };
+    static const isize size = 3;
+
+    StaticArray(T x, T y, T z) : x(x), y(y), z(z) {
+    }
+
+    StaticArray() : data{0, 0, 0} {
+    }
+
+    ARRAY_PROGRAMMING_OVERLOADS(3)
+};
+static_assert(sizeof(StaticArray<f32, 3>) == sizeof(f32) * 3,
+              "Vec3 size is incorrect");
+
+template <typename T> struct StaticArray<T, 4> {
+    union {
+        T data[4];
+        struct {
+            T x, y, z, w;
+        };
+        struct {
+            T r, g, b, a;
+        };
+    };
+    static const isize size = 4;
+
+    StaticArray(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) {
+    }
+
+    StaticArray() : data{0, 0, 0, 0} {
+    }
+
+    ARRAY_PROGRAMMING_OVERLOADS(4)
+};
+static_assert(sizeof(StaticArray<f32, 4>) == sizeof(f32) * 4,
+              "Vec3 size is incorrect");
+
+template <typename T> struct StaticArray<T, 2> {
+    union {
+        T data[2];
+        struct {
+            T x, y;
+        };
+    };
+    static const isize size = 2;
+
+    StaticArray(T x, T y) : x(x), y(y) {
+    }
+
+    StaticArray() : data{0, 0} {
+    }
+
+    ARRAY_PROGRAMMING_OVERLOADS(2)
+};
+
+#pragma clang diagnostic pop
+
+template <typename T, isize N>
+inline Slice<T> static_array_to_slice(const StaticArray<T, N>& array) {
+    return Slice<T>{array.data, N};
+}
+
+/// ------------------
+/// BitSet
+/// ------------------
+
+// Kernels over raw u64 word arrays. They back the BitSet operations and can be
+// used by anything else that stores bits the same way.
+
+#define bit_words_binary_kernels(name, scalar_op, avx2_op, avx512_op)          \
+    inline void bit_words_##name##_scalar(u64* a, const u64* b, isize count) { \
+        for (isize i = 0; i < count; i++) {                                    \
+            u64 x = a[i];                                                      \
+            u64 y = b[i];                                                      \
+            a[i] = scalar_op;                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    bit_words_simd_kernels(name, avx2_op, avx512_op)                           \
+                                                                               \
+    inline void bit_words_##name(u64* a, const u64* b, isize count) {          \
+        bit_words_simd_dispatch(name, a, b, count);                            \
+        bit_words_##name##_scalar(a, b, count);                                \
+    }
+
+#if CORE_X86_SIMD
+#define bit_words_simd_kernels(name, avx2_op, avx512_op)                       \
+    CORE_TARGET("avx2")                                                        \
+    inline void bit_words_##name##_avx2(u64* a, const u64* b, isize count) {   \
+        isize i = 0;                                                           \
+        for (; i + 4 <= count; i += 4) {                                       \
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));           \
+            __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));           \
+            _mm256_storeu_si256((__m256i*)(a + i), avx2_op);                   \
+        }                                                                      \
+        bit_words_##name##_scalar(a + i, b + i, count - i);                    \
+    }                                                                          \
+                                                                               \
+    CORE_TARGET("avx512f")                                                     \
+    inline void bit_words_##name##_avx512(u64* a, const u64* b, isize count) { \
+        isize i = 0;                                                           \
+        for (; i + 8 <= count; i += 8) {                                       \
+            __m512i x = _mm512_loadu_si512(a + i);                             \
+            __m512i y = _mm512_loadu_si512(b + i);                             \
+            _mm512_storeu_si512(a + i, avx512_op);                             \
+        }                                                                      \
+        bit_words_##name##_scalar(a + i, b + i, count - i);                    \
+    }
+
+#define bit_words_simd_dispatch(name, a, b, count)                             \
+    if (cpu_has_feature(CpuFeature::Avx512)) {                                 \
+        bit_words_##name##_avx512(a, b, count);                                \
+        return;                                                                \
+    }                                                                          \
+    if (cpu_has_feature(CpuFeature::Avx2)) {                                   \
+        bit_words_##name##_avx2(a, b, count);                                  \
+        return;                                                                \
+    }
+#else
+#define bit_words_simd_kernels(name, avx2_op, avx512_op)
+#define bit_words_simd_dispatch(name, a, b, count)
+#endif
+
+// a &= b
+bit_words_binary_kernels(and, x & y, _mm256_and_si256(x, y),
+                         _mm512_and_si512(x, y))
+// a |= b
+bit_words_binary_kernels(or, x | y, _mm256_or_si256(x, y),
+                         _mm512_or_si512(x, y))
+// a ^= b
+bit_words_binary_kernels(xor, x ^ y, _mm256_xor_si256(x, y),
+                         _mm512_xor_si512(x, y))
+// a &= ~b
+bit_words_binary_kernels(andnot, x & ~y, _mm256_andnot_si256(y, x),
+                         _mm512_and_si512(
+                             x, _mm512_xor_si512(y, _mm512_set1_epi64(-1))))
+
+#undef bit_words_binary_kernels
+#undef bit_words_simd_kernels
+#undef bit_words_simd_dispatch
+
+inline void bit_words_not_scalar(u64* a, isize count) {
+    for (isize i = 0; i < count; i++) {
+        a[i] = ~a[i];
+    }
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline void bit_words_not_avx2(u64* a, isize count) {
+    __m256i ones = _mm256_set1_epi64x(-1);
+    isize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        _mm256_storeu_si256((__m256i*)(a + i), _mm256_xor_si256(x, ones));
+    }
+    bit_words_not_scalar(a + i, count - i);
+}
+
+CORE_TARGET("avx512f")
+inline void bit_words_not_avx512(u64* a, isize count) {
+    __m512i ones = _mm512_set1_epi64(-1);
+    isize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        _mm512_storeu_si512(a + i, _mm512_xor_si512(x, ones));
+    }
+    bit_words_not_scalar(a + i, count - i);
+}
+#endif
+
+inline void bit_words_not(u64* a, isize count) {
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx512)) {
+        bit_words_not_avx512(a, count);
+        return;
+    }
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        bit_words_not_avx2(a, count);
+        return;
+    }
+#endif
+    bit_words_not_scalar(a, count);
+}
+
+// Population count of `a`, or of `a & b` when `b` is not null. The AND is
+// fused into the count, so the intersection is never materialized.
+inline isize bit_words_count_scalar(const u64* a, const u64* b, isize count) {
+    isize total = 0;
+    if (b == nullptr) {
+        for (isize i = 0; i < count; i++) {
+            total += popcount64(a[i]);
+        }
+    } else {
+        for (isize i = 0; i < count; i++) {
+            total += popcount64(a[i] & b[i]);
+        }
+    }
+    return total;
+}
+
+#if CORE_X86_SIMD
+// Same as the scalar version, but compiled so popcount64 becomes the popcnt
+// instruction instead of a bit twiddling sequence.
+CORE_TARGET("popcnt")
+inline isize bit_words_count_popcnt(const u64* a, const u64* b, isize count) {
+    isize total = 0;
+    if (b == nullptr) {
+        for (isize i = 0; i < count; i++) {
+            total += popcount64(a[i]);
+        }
+    } else {
+        for (isize i = 0; i < count; i++) {
+            total += popcount64(a[i] & b[i]);
+        }
+    }
+    return total;
+}
+
+// Per 64-bit lane popcount of a vector, using a nibble lookup table
+CORE_TARGET("avx2") inline __m256i popcount256_avx2(__m256i v) {
+    const __m256i lookup =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), low_mask);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                     _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+// Carry save adder, adds three bit vectors into a (high, low) pair
+CORE_TARGET("avx2")
+inline void csa256_avx2(__m256i* h, __m256i* l, __m256i a, __m256i b,
+                        __m256i c) {
+    __m256i u = _mm256_xor_si256(a, b);
+    *h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    *l = _mm256_xor_si256(u, c);
+}
+
+template <bool AND>
+CORE_TARGET("avx2")
+inline __m256i bit_words_load_avx2(const u64* a, const u64* b, isize i) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i * 4));
+    if (AND) {
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i * 4));
+        x = _mm256_and_si256(x, y);
+    }
+    return x;
+}
+
+// Harley-Seal popcount: a tree of carry save adders reduces 16 vectors to one
+// vector of "sixteens", so the expensive popcount runs once per 512 bytes.
+// source: Muła et al. - Faster Population Counts Using AVX2 Instructions
+template <bool AND>
+CORE_TARGET("avx2")
+inline isize bit_words_count_harley_seal_avx2(const u64* a, const u64* b,
+                                              isize count) {
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = _mm256_setzero_si256();
+    __m256i twos = _mm256_setzero_si256();
+    __m256i fours = _mm256_setzero_si256();
+    __m256i eights = _mm256_setzero_si256();
+    __m256i sixteens;
+    __m256i twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+
+    isize vectors = count / 4;
+    isize i = 0;
+    for (; i + 16 <= vectors; i += 16) {
+        csa256_avx2(&twos_a, &ones, ones, bit_words_load_avx2<AND>(a, b, i),
+                    bit_words_load_avx2<AND>(a, b, i + 1));
+        csa256_avx2(&twos_b, &ones, ones, bit_words_load_avx2<AND>(a, b, i + 2),
+                    bit_words_load_avx2<AND>(a, b, i + 3));
+        csa256_avx2(&fours_a, &twos, twos, twos_a, twos_b);
+        csa256_avx2(&twos_a, &ones, ones, bit_words_load_avx2<AND>(a, b, i + 4),
+                    bit_words_load_avx2<AND>(a, b, i + 5));
+        csa256_avx2(&twos_b, &ones, ones, bit_words_load_avx2<AND>(a, b, i + 6),
+                    bit_words_load_avx2<AND>(a, b, i + 7));
+        csa256_avx2(&fours_b, &twos, twos, twos_a, twos_b);
+        csa256_avx2(&eights_a, &fours, fours, fours_a, fours_b);
+        csa256_avx2(&twos_a, &ones, ones, bit_words_load_avx2<AND>(a, b, i + 8),
+                    bit_words_load_avx2<AND>(a, b, i + 9));
+        csa256_avx2(&twos_b, &ones, ones,
+                    bit_words_load_avx2<AND>(a, b, i + 10),
+                    bit_words_load_avx2<AND>(a, b, i + 11));
+        csa256_avx2(&fours_a, &twos, twos, twos_a, twos_b);
+        csa256_avx2(&twos_a, &ones, ones,
+                    bit_words_load_avx2<AND>(a, b, i + 12),
+                    bit_words_load_avx2<AND>(a, b, i + 13));
+        csa256_avx2(&twos_b, &ones, ones,
+                    bit_words_load_avx2<AND>(a, b, i + 14),
+                    bit_words_load_avx2<AND>(a, b, i + 15));
+        csa256_avx2(&fours_b, &twos, twos, twos_a, twos_b);
+        csa256_avx2(&eights_b, &fours, fours, fours_a, fours_b);
+        csa256_avx2(&sixteens, &eights, eights, eights_a, eights_b);
+
+        total = _mm256_add_epi64(total, popcount256_avx2(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total,
+                             _mm256_slli_epi64(popcount256_avx2(eights), 3));
+    total =
+        _mm256_add_epi64(total, _mm256_slli_epi64(popcount256_avx2(fours), 2));
+    total =
+        _mm256_add_epi64(total, _mm256_slli_epi64(popcount256_avx2(twos), 1));
+    total = _mm256_add_epi64(total, popcount256_avx2(ones));
+
+    for (; i < vectors; i++) {
+        total = _mm256_add_epi64(
+            total, popcount256_avx2(bit_words_load_avx2<AND>(a, b, i)));
+    }
+
+    isize result = _mm256_extract_epi64(total, 0) +
+                   _mm256_extract_epi64(total, 1) +
+                   _mm256_extract_epi64(total, 2) +
+                   _mm256_extract_epi64(total, 3);
+
+    isize tail = vectors * 4;
+    return result + bit_words_count_popcnt(a + tail, AND ? b + tail : nullptr,
+                                           count - tail);
+}
+
+CORE_TARGET("avx512f,avx512vpopcntdq")
+inline isize bit_words_count_avx512(const u64* a, const u64* b, isize count) {
+    __m512i total = _mm512_setzero_si512();
+    isize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        if (b != nullptr) {
+            x = _mm512_and_si512(x, _mm512_loadu_si512(b + i));
+        }
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(x));
+    }
+
+    if (i < count) {
+        __mmask8 mask = (__mmask8)((1u << (count - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi64(mask, a + i);
+        if (b != nullptr) {
+            x = _mm512_and_si512(x, _mm512_maskz_loadu_epi64(mask, b + i));
+        }
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(x));
+    }
+
+    u64 lanes[8];
+    _mm512_storeu_si512(lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] +
+           lanes[6] + lanes[7];
+}
+#endif
+
+// Below this many words the Harley-Seal setup costs more than it saves
+const isize BIT_WORDS_HARLEY_SEAL_MIN = 64;
+
+inline isize bit_words_count_dispatch(const u64* a, const u64* b,
+                                      isize count) {
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx512Popcnt)) {
+        return bit_words_count_avx512(a, b, count);
+    }
+    if (cpu_has_feature(CpuFeature::Avx2) &&
+        count >= BIT_WORDS_HARLEY_SEAL_MIN) {
+        return b == nullptr
+                   ? bit_words_count_harley_seal_avx2<false>(a, b, count)
+                   : bit_words_count_harley_seal_avx2<true>(a, b, count);
+    }
+    if (cpu_has_feature(CpuFeature::Popcnt)) {
+        return bit_words_count_popcnt(a, b, count);
+    }
+#endif
+    return bit_words_count_scalar(a, b, count);
+}
+
+inline isize bit_words_count(const u64* a, isize count) {
+    return bit_words_count_dispatch(a, nullptr, count);
+}
+
+inline isize bit_words_and_count(const u64* a, const u64* b, isize count) {
+    return bit_words_count_dispatch(a, b, count);
+}
+
+inline bool bit_words_intersects_scalar(const u64* a, const u64* b,
+                                        isize count) {
+    for (isize i = 0; i < count; i++) {
+        if ((a[i] & b[i]) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("avx2")
+inline bool bit_words_intersects_avx2(const u64* a, const u64* b,
+                                      isize count) {
+    isize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        if (!_mm256_testz_si256(x, y)) {
+            return true;
+        }
+    }
+    return bit_words_intersects_scalar(a + i, b + i, count - i);
+}
+
+CORE_TARGET("avx512f")
+inline bool bit_words_intersects_avx512(const u64* a, const u64* b,
+                                        isize count) {
+    isize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        if (_mm512_test_epi64_mask(x, y) != 0) {
+            return true;
+        }
+    }
+    return bit_words_intersects_scalar(a + i, b + i, count - i);
+}
+#endif
+
+inline bool bit_words_intersects(const u64* a, const u64* b, isize count) {
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx512)) {
+        return bit_words_intersects_avx512(a, b, count);
+    }
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return bit_words_intersects_avx2(a, b, count);
+    }
+#endif
+    return bit_words_intersects_scalar(a, b, count);
+}
+
+// Bits are stored in u64 words, bit `index` lives in word `index / 64` at
+// position `index % 64`. The unused bits of the last word are always kept
+// cleared, so whole word operations (count, equals, find, ...) don't need to
+// mask them.
+struct BitSet {
+    u64* data;
+    isize size;
+};
+
+inline isize bit_set_word_count(isize size) {
+    return (size + 63) / 64;
+}
+
+inline void bit_set_init(BitSet* bit_set, isize size, Allocator alloc) {
+    core_assert_msg(size >= 0, "%ld < 0", size);
+    bit_set->data = core_alloc<u64>(alloc, bit_set_word_count(size));
+    bit_set->size = size;
+}
+
+inline BitSet bit_set_make(isize size, Allocator alloc) {
+    BitSet bit_set = {};
+    bit_set_init(&bit_set, size, alloc);
+    return bit_set;
+}
+
+inline BitSet bit_set_clone(const BitSet* bit_set, Allocator alloc) {
+    BitSet new_bit_set = {};
+    new_bit_set.size = bit_set->size;
+    isize words = bit_set_word_count(bit_set->size);
+    new_bit_set.data = core_alloc<u64>(alloc, words);
+    memcpy(new_bit_set.data, bit_set->data, words * sizeof(u64));
+
+    return new_bit_set;
+}
+
+inline void bit_set_set(BitSet* bit_set, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    bit_set->data[index / 64] |= (u64)1 << (index % 64);
+}
+
+inline void bit_set_clear(BitSet* bit_set, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    bit_set->data[index / 64] &= ~((u64)1 << (index % 64));
+}
+
+inline bool bit_set_get(const BitSet* bit_set, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    return (bit_set->data[index / 64] >> (index % 64)) & 1;
+}
+
+inline void bit_set_and(BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    bit_words_and(a->data, b->data, bit_set_word_count(a->size));
+}
+
+inline void bit_set_or(BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    bit_words_or(a->data, b->data, bit_set_word_count(a->size));
+}
+
+inline void bit_set_xor(BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    bit_words_xor(a->data, b->data, bit_set_word_count(a->size));
+}
+
+// a = a & ~b
+inline void bit_set_andnot(BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    bit_words_andnot(a->data, b->data, bit_set_word_count(a->size));
+}
+
+inline void bit_set_not(BitSet* a) {
+    isize words = bit_set_word_count(a->size);
+    bit_words_not(a->data, words);
+
+    // Make sure to clear the last bits
+    isize last_bits = a->size % 64;
+    if (last_bits > 0) {
+        a->data[words - 1] &= ((u64)1 << last_bits) - 1;
+    }
+}
+
+inline isize bit_set_count(const BitSet* a) {
+    return bit_words_count(a->data, bit_set_word_count(a->size));
+}
+
+// Returns the number of bits set in both sets, without materializing a & b
+inline isize bit_set_and_count(const BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    return bit_words_and_count(a->data, b->data, bit_set_word_count(a->size));
+}
+
+// Returns true if any bit is set in both sets. Stops at the first common bit.
+inline bool bit_set_intersects(const BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    return bit_words_intersects(a->data, b->data, bit_set_word_count(a->size));
+}
+
+inline bool bit_set_equals(const BitSet* a, const BitSet* b) {
+    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
+    isize words = bit_set_word_count(a->size);
+    return memcmp(a->data, b->data, words * sizeof(u64)) == 0;
+}
+
+inline usize bit_set_hash(const BitSet* a) {
+    usize hash = 0xcbf29ce484222325;
+    isize words = bit_set_word_count(a->size);
+
+    for (isize i = 0; i < words; i++) {
+        hash ^= a->data[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+inline bool bit_set_is_empty(const BitSet* a) {
+    isize words = bit_set_word_count(a->size);
+    for (isize i = 0; i < words; i++) {
+        if (a->data[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the index of the first set bit at or after `from`, or -1 if there is
+// none.
+inline isize bit_set_find_next(const BitSet* a, isize from) {
+    core_assert_msg(from >= 0, "%ld < 0", from);
+    if (from >= a->size) {
+        return -1;
+    }
+
+    isize words = bit_set_word_count(a->size);
+    isize i = from / 64;
+    u64 word = a->data[i] & (~(u64)0 << (from % 64));
+
+    while (word == 0) {
+        i += 1;
+        if (i >= words) {
+            return -1;
+        }
+        word = a->data[i];
+    }
+
+    return i * 64 + ctz64(word);
+}
+
+// Returns the index of the first set bit, or -1 if the set is empty.
+inline isize bit_set_find_first(const BitSet* a) {
+    return bit_set_find_next(a, 0);
+}
+
+// Returns the index of the first cleared bit, or -1 if all bits are set.
+inline isize bit_set_find_first_zero(const BitSet* a) {
+    isize words = bit_set_word_count(a->size);
+    for (isize i = 0; i < words; i++) {
+        u64 word = ~a->data[i];
+        if (word != 0) {
+            isize index = i * 64 + ctz64(word);
+            // The unused bits of the last word are zero, so they show up here
+            return index < a->size ? index : -1;
+        }
+    }
+
+    return -1;
+}
+
+// Calls `f(index)` for every set bit in ascending order. Runs in
+// O(words + set bits), so it is cheap even for large sparse sets.
+template <typename F>
+inline void bit_set_for_each_set_bit(const BitSet* a, F f) {
+    isize words = bit_set_word_count(a->size);
+    for (isize i = 0; i < words; i++) {
+        u64 word = a->data[i];
+        while (word != 0) {
+            f(i * 64 + ctz64(word));
+            word &= word - 1;
+        }
+    }
+}
+
+/// ------------------
+/// Atomic BitSet
+/// ------------------
+
+// BitSet that can be modified by many threads at once. It has the same layout
+// as BitSet, so once the writers are done it can be viewed as one with
+// atomic_bit_set_freeze, without copying.
+struct AtomicBitSet {
+    u64* data;
+    isize size;
+};
+
+inline void atomic_bit_set_init(AtomicBitSet* bit_set, isize size,
+                                Allocator alloc) {
+    core_assert_msg(size >= 0, "%ld < 0", size);
+    bit_set->data = core_alloc<u64>(alloc, bit_set_word_count(size));
+    bit_set->size = size;
+}
+
+inline AtomicBitSet atomic_bit_set_make(isize size, Allocator alloc) {
+    AtomicBitSet bit_set = {};
+    atomic_bit_set_init(&bit_set, size, alloc);
+    return bit_set;
+}
+
+// Atomic operations on plain words. std::atomic_ref would do, but older
+// libc++ (including Apple clang) doesn't have it.
+#if defined(_MSC_VER) && !defined(__clang__)
+inline u64 atomic_word_load_relaxed(const u64* word) {
+    // Aligned 64 bit loads are atomic on the 64 bit targets MSVC supports
+    return *(const volatile u64*)word;
+}
+
+inline u64 atomic_word_fetch_or(u64* word, u64 mask) {
+    return (u64)_InterlockedOr64((volatile __int64*)word, (__int64)mask);
+}
+
+inline u64 atomic_word_fetch_and(u64* word, u64 mask) {
+    return (u64)_InterlockedAnd64((volatile __int64*)word, (__int64)mask);
+}
+#else
+inline u64 atomic_word_load_relaxed(const u64* word) {
+    return __atomic_load_n(word, __ATOMIC_RELAXED);
+}
+
+inline u64 atomic_word_fetch_or(u64* word, u64 mask) {
+    return __atomic_fetch_or(word, mask, __ATOMIC_ACQ_REL);
+}
+
+inline u64 atomic_word_fetch_and(u64* word, u64 mask) {
+    return __atomic_fetch_and(word, mask, __ATOMIC_ACQ_REL);
+}
+#endif
+
+// Sets the bit and returns its previous value. Exactly one of the threads
+// setting the same bit gets false.
+inline bool atomic_bit_set_test_and_set(AtomicBitSet* bit_set, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    u64 mask = (u64)1 << (index % 64);
+    // Skip the read-modify-write when the bit is already set, which is the
+    // common case when a traversal revisits marked nodes
+    u64* word = &bit_set->data[index / 64];
+    if (atomic_word_load_relaxed(word) & mask) {
+        return true;
+    }
+    return (atomic_word_fetch_or(word, mask) & mask) != 0;
+}
+
+// Clears the bit and returns its previous value
+inline bool atomic_bit_set_test_and_clear(AtomicBitSet* bit_set,
+                                          isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    u64 mask = (u64)1 << (index % 64);
+    u64* word = &bit_set->data[index / 64];
+    return (atomic_word_fetch_and(word, ~mask) & mask) != 0;
+}
+
+// Sets all bits of `mask` in word `word` at once and returns the previous
+// value of the word
+inline u64 atomic_bit_set_fetch_or(AtomicBitSet* bit_set, isize word,
+                                   u64 mask) {
+    core_assert_msg(word >= 0, "%ld < 0", word);
+    core_assert_msg(word < bit_set_word_count(bit_set->size), "%ld >= %ld",
+                    word, bit_set_word_count(bit_set->size));
+    // Keeps the unused bits of the last word cleared
+    core_assert_msg(word * 64 + 64 <= bit_set->size ||
+                        (mask >> (bit_set->size % 64)) == 0,
+                    "Mask sets bits past the end");
+
+    return atomic_word_fetch_or(&bit_set->data[word], mask);
+}
+
+// Relaxed read, doesn't order any other memory accesses
+inline bool atomic_bit_set_get(const AtomicBitSet* bit_set, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+
+    u64 word = atomic_word_load_relaxed(&bit_set->data[index / 64]);
+    return (word >> (index % 64)) & 1;
+}
+
+// Returns a regular BitSet over the same memory. The writers have to be
+// finished (joined) before it is used.
+inline BitSet atomic_bit_set_freeze(const AtomicBitSet* bit_set) {
+    return BitSet{bit_set->data, bit_set->size};
+}
+
+// Below this many words a single thread is faster than spawning more
+const isize ATOMIC_BIT_SET_PARALLEL_MIN_WORDS = 1 << 16;
+const isize ATOMIC_BIT_SET_MAX_THREADS = 64;
+
+// Counts the set bits with up to `thread_count` threads (0 means one per
+// hardware thread). Only exact if no bits are changed concurrently.
+inline isize atomic_bit_set_count(const AtomicBitSet* bit_set,
+                                  isize thread_count = 0) {
+    isize words = bit_set_word_count(bit_set->size);
+    if (thread_count <= 0) {
+        thread_count = (isize)std::thread::hardware_concurrency();
+    }
+    isize max_threads =
+        std::max(words / ATOMIC_BIT_SET_PARALLEL_MIN_WORDS, (isize)1);
+    thread_count = std::clamp(thread_count, (isize)1, max_threads);
+    thread_count = std::min(thread_count, ATOMIC_BIT_SET_MAX_THREADS);
+
+    if (thread_count == 1) {
+        return bit_words_count(bit_set->data, words);
+    }
+
+    // Chunks are rounded to whole cache lines
+    isize chunk = ((words + thread_count - 1) / thread_count + 7) & ~(isize)7;
+    isize counts[ATOMIC_BIT_SET_MAX_THREADS] = {};
+    std::thread threads[ATOMIC_BIT_SET_MAX_THREADS];
+    for (isize i = 0; i < thread_count; i++) {
+        isize start = std::min(i * chunk, words);
+        isize end = std::min(start + chunk, words);
+        threads[i] = std::thread([bit_set, start, end, &counts, i]() {
+            counts[i] = bit_words_count(bit_set->data + start, end - start);
+        });
+    }
+
+    isize total = 0;
+    for (isize i = 0; i < thread_count; i++) {
+        threads[i].join();
+        total += counts[i];
+    }
+    return total;
+}
+
+/// ------------------
+/// Bit matrix
+/// ------------------
+
+// Rows are stored contiguously, each padded to a multiple of 8 words (64
+// bytes), so row operations run on whole SIMD registers and never share a
+// cache line with the next row. Bit (row, col) lives in row `row`, at the same
+// position as in a BitSet. The padding bits are always kept cleared.
+struct BitMatrix {
+    u64* data;
+    isize rows;
+    isize cols;
+    // Words per row
+    isize stride;
+};
+
+inline isize bit_matrix_stride(isize cols) {
+    return (bit_set_word_count(cols) + 7) & ~(isize)7;
+}
+
+inline void bit_matrix_init(BitMatrix* matrix, isize rows, isize cols,
+                            Allocator alloc) {
+    core_assert_msg(rows >= 0, "%ld < 0", rows);
+    core_assert_msg(cols >= 0, "%ld < 0", cols);
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = bit_matrix_stride(cols);
+    matrix->data = core_alloc<u64>(alloc, rows * matrix->stride);
+}
+
+inline BitMatrix bit_matrix_make(isize rows, isize cols, Allocator alloc) {
+    BitMatrix matrix = {};
+    bit_matrix_init(&matrix, rows, cols, alloc);
+    return matrix;
+}
+
+inline u64* bit_matrix_row_data(const BitMatrix* matrix, isize row) {
+    core_assert_msg(row >= 0, "%ld < 0", row);
+    core_assert_msg(row < matrix->rows, "%ld >= %ld", row, matrix->rows);
+    return matrix->data + row * matrix->stride;
+}
+
+// Returns a view of the row, all BitSet functions can be used on it
+inline BitSet bit_matrix_row(const BitMatrix* matrix, isize row) {
+    return BitSet{bit_matrix_row_data(matrix, row), matrix->cols};
+}
+
+inline void bit_matrix_set(BitMatrix* matrix, isize row, isize col) {
+    core_assert_msg(col >= 0, "%ld < 0", col);
+    core_assert_msg(col < matrix->cols, "%ld >= %ld", col, matrix->cols);
+    bit_matrix_row_data(matrix, row)[col / 64] |= (u64)1 << (col % 64);
+}
+
+inline void bit_matrix_clear(BitMatrix* matrix, isize row, isize col) {
+    core_assert_msg(col >= 0, "%ld < 0", col);
+    core_assert_msg(col < matrix->cols, "%ld >= %ld", col, matrix->cols);
+    bit_matrix_row_data(matrix, row)[col / 64] &= ~((u64)1 << (col % 64));
+}
+
+inline bool bit_matrix_get(const BitMatrix* matrix, isize row, isize col) {
+    core_assert_msg(col >= 0, "%ld < 0", col);
+    core_assert_msg(col < matrix->cols, "%ld >= %ld", col, matrix->cols);
+    return (bit_matrix_row_data(matrix, row)[col / 64] >> (col % 64)) & 1;
+}
+
+// row dst &= row src
+inline void bit_matrix_row_and(BitMatrix* matrix, isize dst, isize src) {
+    bit_words_and(bit_matrix_row_data(matrix, dst),
+                  bit_matrix_row_data(matrix, src), matrix->stride);
+}
+
+// row dst |= row src
+inline void bit_matrix_row_or(BitMatrix* matrix, isize dst, isize src) {
+    bit_words_or(bit_matrix_row_data(matrix, dst),
+                 bit_matrix_row_data(matrix, src), matrix->stride);
+}
+
+// row dst ^= row src
+inline void bit_matrix_row_xor(BitMatrix* matrix, isize dst, isize src) {
+    bit_words_xor(bit_matrix_row_data(matrix, dst),
+                  bit_matrix_row_data(matrix, src), matrix->stride);
+}
+
+// Number of columns set in both rows
+inline isize bit_matrix_row_and_count(const BitMatrix* matrix, isize a,
+                                      isize b) {
+    return bit_words_and_count(bit_matrix_row_data(matrix, a),
+                               bit_matrix_row_data(matrix, b), matrix->stride);
+}
+
+// Transposes a 64x64 bit block in place, bit c of a[r] is swapped with bit r
+// of a[c]. Swaps the off diagonal 32x32 quadrants, then 16x16, ...
+// source: Hacker's Delight, 7-3
+inline void bit_transpose64_scalar(u64 a[64], isize first_step = 32) {
+    u64 mask = 0x00000000FFFFFFFF;
+    for (isize j = 32; j != first_step; j >>= 1) {
+        mask ^= mask << (j / 2);
+    }
+    for (isize j = first_step; j != 0; j >>= 1, mask ^= mask << j) {
+        for (isize k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            u64 t = ((a[k] >> j) ^ a[k | j]) & mask;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+#if CORE_X86_SIMD
+// The steps swapping 4 or more rows at a time work on runs of consecutive
+// words, so they are done 4 words at a time. The last two steps are scalar.
+CORE_TARGET("avx2")
+inline void bit_transpose64_avx2(u64 a[64]) {
+    u64 mask = 0x00000000FFFFFFFF;
+    for (isize j = 32; j >= 4; j >>= 1, mask ^= mask << j) {
+        __m256i m = _mm256_set1_epi64x((i64)mask);
+        __m128i shift = _mm_cvtsi64_si128(j);
+        for (isize k = 0; k < 64; k = ((k | j) + 4) & ~j) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + k));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(a + (k | j)));
+            __m256i t = _mm256_xor_si256(_mm256_srl_epi64(x, shift), y);
+            t = _mm256_and_si256(t, m);
+            x = _mm256_xor_si256(x, _mm256_sll_epi64(t, shift));
+            y = _mm256_xor_si256(y, t);
+            _mm256_storeu_si256((__m256i*)(a + k), x);
+            _mm256_storeu_si256((__m256i*)(a + (k | j)), y);
+        }
+    }
+    bit_transpose64_scalar(a, 2);
+}
+#endif
+
+inline void bit_transpose64(u64 a[64]) {
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        bit_transpose64_avx2(a);
+        return;
+    }
+#endif
+    bit_transpose64_scalar(a);
+}
+
+inline BitMatrix bit_matrix_transpose(const BitMatrix* matrix,
+                                      Allocator alloc) {
+    BitMatrix result = bit_matrix_make(matrix->cols, matrix->rows, alloc);
+
+    // Groups of 8 row blocks fill whole cache lines of the result rows
+    u64 block[64];
+    isize row_blocks = bit_set_word_count(matrix->rows);
+    for (isize group = 0; group < row_blocks; group += 8) {
+        isize group_end = std::min(group + 8, row_blocks);
+        for (isize col_block = 0; col_block * 64 < matrix->cols; col_block++) {
+            isize cols = std::min((isize)64, matrix->cols - col_block * 64);
+            for (isize row_block = group; row_block < group_end; row_block++) {
+                isize rows = std::min((isize)64, matrix->rows - row_block * 64);
+
+                for (isize i = 0; i < rows; i++) {
+                    block[i] =
+                        matrix->data[(row_block * 64 + i) * matrix->stride +
+                                     col_block];
+                }
+                for (isize i = rows; i < 64; i++) {
+                    block[i] = 0;
+                }
+
+                bit_transpose64(block);
+
+                for (isize i = 0; i < cols; i++) {
+                    result.data[(col_block * 64 + i) * result.stride +
+                                row_block] = block[i];
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Words of every row processed together by bit_matrix_intersection_counts, so
+// the chunks of all rows stay in cache while the pairs are counted.
+const isize BIT_MATRIX_CHUNK_WORDS = 256;
+
+// Returns a rows x rows matrix (row major) with the number of columns set in
+// both rows of every pair. The result is symmetric, the diagonal holds the
+// row counts.
+inline Slice<u32> bit_matrix_intersection_counts(const BitMatrix* matrix,
+                                                 Allocator alloc) {
+    core_assert_msg(matrix->cols <= UINT32_MAX, "%ld > %u", matrix->cols,
+                    UINT32_MAX);
+    isize rows = matrix->rows;
+    Slice<u32> counts = slice_make<u32>(rows * rows, alloc);
+
+    for (isize chunk = 0; chunk < matrix->stride;
+         chunk += BIT_MATRIX_CHUNK_WORDS) {
+        isize words = std::min(BIT_MATRIX_CHUNK_WORDS, matrix->stride - chunk);
+        for (isize i = 0; i < rows; i++) {
+            const u64* a = matrix->data + i * matrix->stride + chunk;
+            for (isize j = i; j < rows; j++) {
+                const u64* b = matrix->data + j * matrix->stride + chunk;
+                counts[i * rows + j] += (u32)bit_words_and_count(a, b, words);
+            }
+        }
+    }
+
+    for (isize i = 0; i < rows; i++) {
+        for (isize j = 0; j < i; j++) {
+            counts[i * rows + j] = counts[j * rows + i];
+        }
+    }
+
+    return counts;
+}
+
+/// ------------------
+/// Rank / select
+/// ------------------
+
+// Succinct rank/select index over a BitSet that is no longer modified. Uses the
+// Poppy layout: every 2048 bit block has one u64 entry with the number of set
+// bits before the block (relative to its 2^32 bit region) in the low 32 bits,
+// and the popcounts of its first three 512 bit sub blocks in 10 bits each. The
+// index costs ~3.2% of the bit vector.
+// source: Zhou, Andersen, Kaminsky - Space-Efficient, High-Performance Rank &
+// Select Structures on Uncompressed Bit Sequences
+
+const isize RANK_SELECT_BLOCK_BITS = 2048;
+const isize RANK_SELECT_SUB_BLOCK_WORDS = 8;
+const isize RANK_SELECT_BLOCKS_PER_REGION = ((isize)1 << 32) / 2048;
+// Position of every n-th set bit is sampled to narrow down select
+const isize RANK_SELECT_SAMPLE_RATE = 8192;
+
+struct RankSelect {
+    Allocator alloc;
+    // Not owned, has to outlive the index and must not change
+    BitSet bits;
+    isize ones;
+    // Number of set bits before each 2^32 bit region
+    u64* regions;
+    u64* blocks;
+    isize block_count;
+    // Block containing every RANK_SELECT_SAMPLE_RATE-th set bit
+    u64* samples;
+    isize sample_count;
+};
+
+// Returns the position of the k-th (0 based) set bit of word
+inline i32 u64_select_bit_scalar(u64 word, isize k) {
+    for (isize i = 0; i < k; i++) {
+        word &= word - 1;
+    }
+    return ctz64(word);
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("bmi2")
+inline i32 u64_select_bit_bmi2(u64 word, isize k) {
+    return ctz64(_pdep_u64((u64)1 << k, word));
+}
+#endif
+
+inline i32 u64_select_bit(u64 word, isize k) {
+    core_assert_msg(k < popcount64(word), "%ld >= %d", k,
+                    (i32)popcount64(word));
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Bmi2)) {
+        return u64_select_bit_bmi2(word, k);
+    }
+#endif
+    return u64_select_bit_scalar(word, k);
+}
+
+inline void rank_select_init(RankSelect* rs, const BitSet* bits,
+                             Allocator alloc) {
+    core_assert(rs != nullptr);
+    core_assert(bits != nullptr);
+
+    rs->alloc = alloc;
+    rs->bits = *bits;
+
+    isize words = bit_set_word_count(bits->size);
+    // One extra block, so rank(size) can be answered without a branch
+    rs->block_count = bits->size / RANK_SELECT_BLOCK_BITS + 1;
+    isize region_count = (rs->block_count + RANK_SELECT_BLOCKS_PER_REGION - 1) /
+                         RANK_SELECT_BLOCKS_PER_REGION;
+    rs->regions = core_alloc<u64>(alloc, region_count);
+    rs->blocks = core_alloc<u64>(alloc, rs->block_count);
+
+    isize ones = 0;
+    for (isize block = 0; block < rs->block_count; block++) {
+        if (block % RANK_SELECT_BLOCKS_PER_REGION == 0) {
+            rs->regions[block / RANK_SELECT_BLOCKS_PER_REGION] = ones;
+        }
+        u64 entry = ones - rs->regions[block / RANK_SELECT_BLOCKS_PER_REGION];
+
+        for (isize sub = 0; sub < 4; sub++) {
+            isize start = block * 32 + sub * RANK_SELECT_SUB_BLOCK_WORDS;
+            isize count = std::min(RANK_SELECT_SUB_BLOCK_WORDS, words - start);
+            isize sub_ones =
+                count > 0 ? bit_words_count(bits->data + start, count) : 0;
+            if (sub < 3) {
+                entry |= (u64)sub_ones << (32 + 10 * sub);
+            }
+            ones += sub_ones;
+        }
+        rs->blocks[block] = entry;
+    }
+    rs->ones = ones;
+
+    rs->sample_count =
+        (ones + RANK_SELECT_SAMPLE_RATE - 1) / RANK_SELECT_SAMPLE_RATE;
+    rs->samples = core_alloc<u64>(alloc, std::max(rs->sample_count, (isize)1));
+    isize sample = 0;
+    isize block_end_ones = 0;
+    for (isize block = 0; block < rs->block_count; block++) {
+        block_end_ones = block + 1 < rs->block_count
+                             ? rs->regions[(block + 1) /
+                                           RANK_SELECT_BLOCKS_PER_REGION] +
+                                   (rs->blocks[block + 1] & 0xFFFFFFFF)
+                             : ones;
+        while (sample < rs->sample_count &&
+               sample * RANK_SELECT_SAMPLE_RATE < block_end_ones) {
+            rs->samples[sample++] = block;
+        }
+    }
+}
+
+inline RankSelect rank_select_make(const BitSet* bits, Allocator alloc) {
+    RankSelect rs = {};
+    rank_select_init(&rs, bits, alloc);
+    return rs;
+}
+
+inline void rank_select_free(RankSelect* rs) {
+    core_free(rs->alloc, rs->regions);
+    core_free(rs->alloc, rs->blocks);
+    core_free(rs->alloc, rs->samples);
+    *rs = {};
+}
+
+// Size of the index, without the bits themselves
+inline isize rank_select_size_in_bytes(const RankSelect* rs) {
+    isize region_count = (rs->block_count + RANK_SELECT_BLOCKS_PER_REGION - 1) /
+                         RANK_SELECT_BLOCKS_PER_REGION;
+    return (region_count + rs->block_count +
+            std::max(rs->sample_count, (isize)1)) *
+           (isize)sizeof(u64);
+}
+
+// Number of set bits before the block
+inline isize rank_select_block_rank(const RankSelect* rs, isize block) {
+    return rs->regions[block / RANK_SELECT_BLOCKS_PER_REGION] +
+           (rs->blocks[block] & 0xFFFFFFFF);
+}
+
+// Returns the number of set bits in [0, index)
+inline isize rank_select_rank(const RankSelect* rs, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index <= rs->bits.size, "%ld > %ld", index, rs->bits.size);
+
+    isize block = index / RANK_SELECT_BLOCK_BITS;
+    u64 entry = rs->blocks[block];
+    isize rank = rank_select_block_rank(rs, block);
+
+    isize sub = (index % RANK_SELECT_BLOCK_BITS) / 512;
+    for (isize i = 0; i < sub; i++) {
+        rank += (entry >> (32 + 10 * i)) & 0x3FF;
+    }
+
+    isize word = block * 32 + sub * RANK_SELECT_SUB_BLOCK_WORDS;
+    isize last_word = index / 64;
+    for (; word < last_word; word++) {
+        rank += popcount64(rs->bits.data[word]);
+    }
+    if (index % 64 != 0) {
+        rank += popcount64(rs->bits.data[last_word] &
+                           (((u64)1 << (index % 64)) - 1));
+    }
+
+    return rank;
+}
+
+// Returns the number of cleared bits in [0, index)
+inline isize rank_select_rank0(const RankSelect* rs, isize index) {
+    return index - rank_select_rank(rs, index);
+}
+
+// Returns the position of the k-th (0 based) set bit
+inline isize rank_select_select(const RankSelect* rs, isize k) {
+    core_assert_msg(k >= 0, "%ld < 0", k);
+    core_assert_msg(k < rs->ones, "%ld >= %ld", k, rs->ones);
+
+    isize sample = k / RANK_SELECT_SAMPLE_RATE;
+    isize low = rs->samples[sample];
+    isize high = sample + 1 < rs->sample_count ? rs->samples[sample + 1]
+                                               : rs->block_count - 1;
+
+    // Last block with fewer than k + 1 set bits before it
+    while (low < high) {
+        isize mid = (low + high + 1) / 2;
+        if (rank_select_block_rank(rs, mid) <= k) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    isize block = low;
+    isize remaining = k - rank_select_block_rank(rs, block);
+    u64 entry = rs->blocks[block];
+
+    isize word = block * 32;
+    for (isize sub = 0; sub < 3; sub++) {
+        isize sub_ones = (entry >> (32 + 10 * sub)) & 0x3FF;
+        if (remaining < sub_ones) {
+            break;
+        }
+        remaining -= sub_ones;
+        word += RANK_SELECT_SUB_BLOCK_WORDS;
+    }
+
+    while (true) {
+        u64 value = rs->bits.data[word];
+        isize word_ones = popcount64(value);
+        if (remaining < word_ones) {
+            return word * 64 + u64_select_bit(value, remaining);
+        }
+        remaining -= word_ones;
+        word += 1;
+    }
+}
+
+/// ------------------
+/// Roaring bitmap
+/// ------------------
+
+// Compressed set of u32 values. The value space is split into 64K chunks keyed
+// by the high 16 bits, and each non empty chunk stores its low 16 bits in the
+// cheapest of three containers:
+//  - Array: sorted u16 values, used for at most 4096 values
+//  - Bitmap: 1024 u64 words, same bit layout as BitSet
+//  - Run: sorted runs of consecutive values
+// source: Chambi et al. - Better bitmap performance with Roaring bitmaps
+
+const i32 ROARING_ARRAY_MAX_SIZE = 4096;
+const isize ROARING_BITMAP_WORDS = 65536 / 64;
+
+enum class RoaringContainerKind : u8 {
+    Array,
+    Bitmap,
+    Run,
+};
+
+struct RoaringRun {
+    u16 start;
+    // Number of values in the run minus one, so one run can cover a full chunk
+    u16 length;
+};
+
+struct RoaringContainer {
+    RoaringContainerKind kind;
+    // Array: number of values, Bitmap: number of set bits, Run: number of runs
+    i32 size;
+    // Number of allocated values or runs, unused for bitmaps
+    i32 capacity;
+    union {
+        u16* values;
+        u64* words;
+        RoaringRun* runs;
+    };
+};
+
+struct RoaringBitmap {
+    Allocator alloc;
+    // Sorted high 16 bits of the chunk of each container
+    u16* keys;
+    RoaringContainer* containers;
+    isize size;
+    isize capacity;
+};
+
+inline void roaring_init(RoaringBitmap* rb, Allocator alloc) {
+    core_assert(rb != nullptr);
+    core_assert(alloc.alloc != nullptr);
+
+    rb->alloc = alloc;
+    rb->keys = nullptr;
+    rb->containers = nullptr;
+    rb->size = 0;
+    rb->capacity = 0;
+}
+
+inline RoaringBitmap roaring_make(Allocator alloc) {
+    RoaringBitmap rb;
+    roaring_init(&rb, alloc);
+    return rb;
+}
+
+inline void roaring_container_free(RoaringContainer* c, Allocator alloc) {
+    switch (c->kind) {
+    case RoaringContainerKind::Array:
+        core_free(alloc, c->values);
+        break;
+    case RoaringContainerKind::Bitmap:
+        core_free(alloc, c->words);
+        break;
+    case RoaringContainerKind::Run:
+        core_free(alloc, c->runs);
+        break;
+    }
+    c->values = nullptr;
+}
+
+inline void roaring_free(RoaringBitmap* rb) {
+    for (isize i = 0; i < rb->size; i++) {
+        roaring_container_free(&rb->containers[i], rb->alloc);
+    }
+    if (rb->keys != nullptr) {
+        core_free(rb->alloc, rb->keys);
+        core_free(rb->alloc, rb->containers);
+    }
+    rb->keys = nullptr;
+    rb->containers = nullptr;
+    rb->size = 0;
+    rb->capacity = 0;
+}
+
+inline RoaringContainer roaring_container_make(RoaringContainerKind kind,
+                                               i32 capacity, Allocator alloc) {
+    RoaringContainer c = {};
+    c.kind = kind;
+    c.size = 0;
+    switch (kind) {
+    case RoaringContainerKind::Array:
+        c.capacity = std::max(capacity, 4);
+        c.values = core_alloc<u16>(alloc, c.capacity);
+        break;
+    case RoaringContainerKind::Bitmap:
+        c.capacity = 0;
+        c.words = core_alloc<u64>(alloc, ROARING_BITMAP_WORDS);
+        break;
+    case RoaringContainerKind::Run:
+        c.capacity = std::max(capacity, 4);
+        c.runs = core_alloc<RoaringRun>(alloc, c.capacity);
+        break;
+    }
+    return c;
+}
+
+// Makes room for at least `capacity` values or runs
+inline void roaring_container_reserve(RoaringContainer* c, i32 capacity,
+                                      Allocator alloc) {
+    core_assert(c->kind != RoaringContainerKind::Bitmap);
+    if (capacity <= c->capacity) {
+        return;
+    }
+
+    i32 new_capacity = std::max(c->capacity * 2, capacity);
+    if (c->kind == RoaringContainerKind::Array) {
+        c->values = core_realloc<u16>(alloc, c->values,
+                                      c->capacity * (isize)sizeof(u16),
+                                      new_capacity * (isize)sizeof(u16));
+    } else {
+        c->runs = core_realloc<RoaringRun>(
+            alloc, c->runs, c->capacity * (isize)sizeof(RoaringRun),
+            new_capacity * (isize)sizeof(RoaringRun));
+    }
+    c->capacity = new_capacity;
+}
+
+inline isize roaring_container_cardinality(const RoaringContainer* c) {
+    if (c->kind != RoaringContainerKind::Run) {
+        return c->size;
+    }
+
+    isize count = 0;
+    for (i32 i = 0; i < c->size; i++) {
+        count += (isize)c->runs[i].length + 1;
+    }
+    return count;
+}
+
+// Returns the index of the first array value >= value
+inline i32 roaring_array_lower_bound(const u16* values, i32 size, u16 value) {
+    i32 low = 0;
+    i32 high = size;
+    while (low < high) {
+        i32 mid = (low + high) / 2;
+        if (values[mid] < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Returns the index of the last run starting at or before value, or -1
+inline i32 roaring_run_find(const RoaringRun* runs, i32 size, u16 value) {
+    i32 low = 0;
+    i32 high = size;
+    while (low < high) {
+        i32 mid = (low + high) / 2;
+        if (runs[mid].start <= value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low - 1;
+}
+
+inline bool roaring_container_contains(const RoaringContainer* c, u16 value) {
+    switch (c->kind) {
+    case RoaringContainerKind::Array: {
+        i32 index = roaring_array_lower_bound(c->values, c->size, value);
+        return index < c->size && c->values[index] == value;
+    }
+    case RoaringContainerKind::Bitmap:
+        return (c->words[value / 64] >> (value % 64)) & 1;
+    case RoaringContainerKind::Run: {
+        i32 index = roaring_run_find(c->runs, c->size, value);
+        return index >= 0 &&
+               value - c->runs[index].start <= c->runs[index].length;
+    }
+    }
+    return false;
+}
+
+inline void roaring_words_set_range(u64* words, isize start, isize count) {
+    isize end = start + count;
+    while (start < end) {
+        isize bit = start % 64;
+        isize bits = std::min((isize)64 - bit, end - start);
+        u64 mask = bits == 64 ? ~(u64)0 : (((u64)1 << bits) - 1) << bit;
+        words[start / 64] |= mask;
+        start += bits;
+    }
+}
+
+// Writes the container as a 1024 word bitmap into `words`, which has to be
+// cleared by the caller
+inline void roaring_container_to_words(const RoaringContainer* c, u64* words) {
+    switch (c->kind) {
+    case RoaringContainerKind::Array:
+        for (i32 i = 0; i < c->size; i++) {
+            u16 value = c->values[i];
+            words[value / 64] |= (u64)1 << (value % 64);
+        }
+        break;
+    case RoaringContainerKind::Bitmap:
+        memcpy(words, c->words, ROARING_BITMAP_WORDS * sizeof(u64));
+        break;
+    case RoaringContainerKind::Run:
+        for (i32 i = 0; i < c->size; i++) {
+            roaring_words_set_range(words, c->runs[i].start,
+                                    (isize)c->runs[i].length + 1);
+        }
+        break;
+    }
+}
+
+inline isize roaring_words_count_runs(const u64* words) {
+    isize runs = 0;
+    u64 carry = 0;
+    for (isize i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        u64 word = words[i];
+        // A run starts at every set bit whose predecessor is cleared
+        runs += popcount64(word & ~((word << 1) | carry));
+        carry = word >> 63;
+    }
+    return runs;
+}
+
+// Builds the smallest container holding the bits of a 1024 word bitmap.
+// Returns a container with size 0 when the bitmap is empty.
+inline RoaringContainer roaring_container_from_words(const u64* words,
+                                                     Allocator alloc) {
+    isize cardinality = bit_words_count(words, ROARING_BITMAP_WORDS);
+    if (cardinality == 0) {
+        RoaringContainer empty = {};
+        empty.kind = RoaringContainerKind::Array;
+        return empty;
+    }
+
+    isize runs = roaring_words_count_runs(words);
+    isize array_bytes = cardinality * (isize)sizeof(u16);
+    isize bitmap_bytes = ROARING_BITMAP_WORDS * (isize)sizeof(u64);
+    isize run_bytes = runs * (isize)sizeof(RoaringRun);
+
+    if (run_bytes < bitmap_bytes && run_bytes < array_bytes) {
+        RoaringContainer c =
+            roaring_container_make(RoaringContainerKind::Run, (i32)runs, alloc);
+        isize index = 0;
+        while (index < 65536) {
+            // Start of the run is the next set bit
+            isize w = index / 64;
+            u64 word = words[w] & (~(u64)0 << (index % 64));
+            while (word == 0 && ++w < ROARING_BITMAP_WORDS) {
+                word = words[w];
+            }
+            if (w >= ROARING_BITMAP_WORDS) {
+                break;
+            }
+            isize start = w * 64 + ctz64(word);
+
+            // End of the run is the next cleared bit
+            u64 cleared = ~words[w] & (~(u64)0 << (start % 64));
+            while (cleared == 0 && ++w < ROARING_BITMAP_WORDS) {
+                cleared = ~words[w];
+            }
+            isize end = w >= ROARING_BITMAP_WORDS ? 65536
+                                                  : w * 64 + ctz64(cleared);
+
+            c.runs[c.size++] = RoaringRun{(u16)start, (u16)(end - start - 1)};
+            index = end;
+        }
+        return c;
+    }
+
+    if (cardinality <= ROARING_ARRAY_MAX_SIZE) {
+        RoaringContainer c = roaring_container_make(
+            RoaringContainerKind::Array, (i32)cardinality, alloc);
+        for (isize i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            u64 word = words[i];
+            while (word != 0) {
+                c.values[c.size++] = (u16)(i * 64 + ctz64(word));
+                word &= word - 1;
+            }
+        }
+        return c;
+    }
+
+    RoaringContainer c =
+        roaring_container_make(RoaringContainerKind::Bitmap, 0, alloc);
+    memcpy(c.words, words, ROARING_BITMAP_WORDS * sizeof(u64));
+    c.size = (i32)cardinality;
+    return c;
+}
+
+inline RoaringContainer roaring_container_clone(const RoaringContainer* c,
+                                                Allocator alloc) {
+    RoaringContainer copy = roaring_container_make(c->kind, c->size, alloc);
+    copy.size = c->size;
+    switch (c->kind) {
+    case RoaringContainerKind::Array:
+        memcpy(copy.values, c->values, c->size * sizeof(u16));
+        break;
+    case RoaringContainerKind::Bitmap:
+        memcpy(copy.words, c->words, ROARING_BITMAP_WORDS * sizeof(u64));
+        break;
+    case RoaringContainerKind::Run:
+        memcpy(copy.runs, c->runs, c->size * sizeof(RoaringRun));
+        break;
+    }
+    return copy;
+}
+
+// Converts the container to the cheapest representation
+inline void roaring_container_optimize(RoaringContainer* c, Allocator alloc) {
+    u64 words[ROARING_BITMAP_WORDS] = {};
+    roaring_container_to_words(c, words);
+    RoaringContainer optimized = roaring_container_from_words(words, alloc);
+    roaring_container_free(c, alloc);
+    *c = optimized;
+}
+
+// Converts a run container back to an array or bitmap once its runs cost
+// more than either would
+inline void roaring_run_container_fit(RoaringContainer* c, Allocator alloc) {
+    isize run_bytes = c->size * (isize)sizeof(RoaringRun);
+    if (run_bytes < ROARING_BITMAP_WORDS * (isize)sizeof(u64) &&
+        run_bytes < roaring_container_cardinality(c) * (isize)sizeof(u16)) {
+        return;
+    }
+    roaring_container_optimize(c, alloc);
+}
+
+// Returns the index of the container for key, or -(insertion point) - 1
+inline isize roaring_find_key(const RoaringBitmap* rb, u16 key) {
+    isize low = 0;
+    isize high = rb->size;
+    while (low < high) {
+        isize mid = (low + high) / 2;
+        if (rb->keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < rb->size && rb->keys[low] == key) {
+        return low;
+    }
+    return -low - 1;
+}
+
+inline void roaring_insert_container(RoaringBitmap* rb, isize index, u16 key,
+                                     RoaringContainer c) {
+    if (rb->size == rb->capacity) {
+        isize new_capacity = std::max(rb->capacity * 2, (isize)4);
+        rb->keys = core_realloc<u16>(rb->alloc, rb->keys,
+                                     rb->capacity * sizeof(u16),
+                                     new_capacity * sizeof(u16));
+        rb->containers = core_realloc<RoaringContainer>(
+            rb->alloc, rb->containers, rb->capacity * sizeof(RoaringContainer),
+            new_capacity * sizeof(RoaringContainer));
+        rb->capacity = new_capacity;
+    }
+
+    memmove(rb->keys + index + 1, rb->keys + index,
+            (rb->size - index) * sizeof(u16));
+    memmove(rb->containers + index + 1, rb->containers + index,
+            (rb->size - index) * sizeof(RoaringContainer));
+    rb->keys[index] = key;
+    rb->containers[index] = c;
+    rb->size += 1;
+}
+
+inline void roaring_remove_container(RoaringBitmap* rb, isize index) {
+    roaring_container_free(&rb->containers[index], rb->alloc);
+    memmove(rb->keys + index, rb->keys + index + 1,
+            (rb->size - index - 1) * sizeof(u16));
+    memmove(rb->containers + index, rb->containers + index + 1,
+            (rb->size - index - 1) * sizeof(RoaringContainer));
+    rb->size -= 1;
+}
+
+// Appends a container with a key larger than all existing ones. Empty
+// containers are dropped.
+inline void roaring_append_container(RoaringBitmap* rb, u16 key,
+                                     RoaringContainer c) {
+    core_assert(rb->size == 0 || rb->keys[rb->size - 1] < key);
+    if (c.size == 0) {
+        roaring_container_free(&c, rb->alloc);
+        return;
+    }
+    roaring_insert_container(rb, rb->size, key, c);
+}
+
+inline void roaring_container_add(RoaringContainer* c, u16 value,
+                                  Allocator alloc) {
+    switch (c->kind) {
+    case RoaringContainerKind::Array: {
+        i32 index = roaring_array_lower_bound(c->values, c->size, value);
+        if (index < c->size && c->values[index] == value) {
+            return;
+        }
+        if (c->size >= ROARING_ARRAY_MAX_SIZE) {
+            u64 words[ROARING_BITMAP_WORDS] = {};
+            roaring_container_to_words(c, words);
+            roaring_container_free(c, alloc);
+            *c = roaring_container_make(RoaringContainerKind::Bitmap, 0,
+                                        alloc);
+            memcpy(c->words, words, sizeof(words));
+            c->size = ROARING_ARRAY_MAX_SIZE;
+            roaring_container_add(c, value, alloc);
+            return;
+        }
+        roaring_container_reserve(c, c->size + 1, alloc);
+        memmove(c->values + index + 1, c->values + index,
+                (c->size - index) * sizeof(u16));
+        c->values[index] = value;
+        c->size += 1;
+        return;
+    }
+    case RoaringContainerKind::Bitmap: {
+        u64 bit = (u64)1 << (value % 64);
+        if ((c->words[value / 64] & bit) == 0) {
+            c->words[value / 64] |= bit;
+            c->size += 1;
+        }
+        return;
+    }
+    case RoaringContainerKind::Run: {
+        i32 index = roaring_run_find(c->runs, c->size, value);
+        if (index >= 0) {
+            RoaringRun* run = &c->runs[index];
+            isize end = (isize)run->start + run->length;
+            if (value <= end) {
+                return;
+            }
+            if (value == end + 1) {
+                run->length += 1;
+                // Merge with the next run if the gap is closed
+                if (index + 1 < c->size &&
+                    c->runs[index + 1].start == value + 1) {
+                    run->length += c->runs[index + 1].length + 1;
+                    memmove(c->runs + index + 1, c->runs + index + 2,
+                            (c->size - index - 2) * sizeof(RoaringRun));
+                    c->size -= 1;
+                }
+                return;
+            }
+        }
+        if (index + 1 < c->size && c->runs[index + 1].start == value + 1) {
+            c->runs[index + 1].start = value;
+            c->runs[index + 1].length += 1;
+            return;
+        }
+        roaring_container_reserve(c, c->size + 1, alloc);
+        memmove(c->runs + index + 2, c->runs + index + 1,
+                (c->size - index - 1) * sizeof(RoaringRun));
+        c->runs[index + 1] = RoaringRun{value, 0};
+        c->size += 1;
+        roaring_run_container_fit(c, alloc);
+        return;
+    }
+    }
+}
+
+inline void roaring_container_remove(RoaringContainer* c, u16 value,
+                                     Allocator alloc) {
+    switch (c->kind) {
+    case RoaringContainerKind::Array: {
+        i32 index = roaring_array_lower_bound(c->values, c->size, value);
+        if (index < c->size && c->values[index] == value) {
+            memmove(c->values + index, c->values + index + 1,
+                    (c->size - index - 1) * sizeof(u16));
+            c->size -= 1;
+        }
+        return;
+    }
+    case RoaringContainerKind::Bitmap: {
+        u64 bit = (u64)1 << (value % 64);
+        if ((c->words[value / 64] & bit) != 0) {
+            c->words[value / 64] &= ~bit;
+            c->size -= 1;
+            if (c->size <= ROARING_ARRAY_MAX_SIZE) {
+                roaring_container_optimize(c, alloc);
+            }
+        }
+        return;
+    }
+    case RoaringContainerKind::Run: {
+        i32 index = roaring_run_find(c->runs, c->size, value);
+        if (index < 0) {
+            return;
+        }
+        RoaringRun* run = &c->runs[index];
+        isize end = (isize)run->start + run->length;
+        if (value > end) {
+            return;
+        }
+        if (run->length == 0) {
+            memmove(c->runs + index, c->runs + index + 1,
+                    (c->size - index - 1) * sizeof(RoaringRun));
+            c->size -= 1;
+        } else if (value == run->start) {
+            run->start += 1;
+            run->length -= 1;
+        } else if (value == end) {
+            run->length -= 1;
+        } else {
+            // Split the run in two
+            roaring_container_reserve(c, c->size + 1, alloc);
+            run = &c->runs[index];
+            memmove(c->runs + index + 2, c->runs + index + 1,
+                    (c->size - index - 1) * sizeof(RoaringRun));
+            c->runs[index + 1] =
+                RoaringRun{(u16)(value + 1), (u16)(end - value - 1)};
+            run->length = (u16)(value - run->start - 1);
+            c->size += 1;
+            roaring_run_container_fit(c, alloc);
+        }
+        return;
+    }
+    }
+}
+
+inline void roaring_add(RoaringBitmap* rb, u32 value) {
+    u16 key = (u16)(value >> 16);
+    isize index = roaring_find_key(rb, key);
+    if (index < 0) {
+        index = -index - 1;
+        RoaringContainer c =
+            roaring_container_make(RoaringContainerKind::Array, 4, rb->alloc);
+        roaring_insert_container(rb, index, key, c);
+    }
+    roaring_container_add(&rb->containers[index], (u16)value, rb->alloc);
+}
+
+inline void roaring_remove(RoaringBitmap* rb, u32 value) {
+    isize index = roaring_find_key(rb, (u16)(value >> 16));
+    if (index < 0) {
+        return;
+    }
+    RoaringContainer* c = &rb->containers[index];
+    roaring_container_remove(c, (u16)value, rb->alloc);
+    if (c->size == 0) {
+        roaring_remove_container(rb, index);
+    }
+}
+
+inline bool roaring_contains(const RoaringBitmap* rb, u32 value) {
+    isize index = roaring_find_key(rb, (u16)(value >> 16));
+    if (index < 0) {
+        return false;
+    }
+    return roaring_container_contains(&rb->containers[index], (u16)value);
+}
+
+inline isize roaring_cardinality(const RoaringBitmap* rb) {
+    isize count = 0;
+    for (isize i = 0; i < rb->size; i++) {
+        count += roaring_container_cardinality(&rb->containers[i]);
+    }
+    return count;
+}
+
+inline bool roaring_is_empty(const RoaringBitmap* rb) {
+    return rb->size == 0;
+}
+
+// Returns the number of values smaller than `value`
+inline isize roaring_rank(const RoaringBitmap* rb, u32 value) {
+    u16 key = (u16)(value >> 16);
+    u16 low = (u16)value;
+    isize rank = 0;
+    for (isize i = 0; i < rb->size && rb->keys[i] <= key; i++) {
+        const RoaringContainer* c = &rb->containers[i];
+        if (rb->keys[i] < key) {
+            rank += roaring_container_cardinality(c);
+            continue;
+        }
+
+        switch (c->kind) {
+        case RoaringContainerKind::Array:
+            rank += roaring_array_lower_bound(c->values, c->size, low);
+            break;
+        case RoaringContainerKind::Bitmap:
+            rank += bit_words_count(c->words, low / 64);
+            if (low % 64 != 0) {
+                rank += popcount64(c->words[low / 64] &
+                                   (((u64)1 << (low % 64)) - 1));
+            }
+            break;
+        case RoaringContainerKind::Run:
+            for (i32 r = 0; r < c->size && c->runs[r].start < low; r++) {
+                isize end = (isize)c->runs[r].start + c->runs[r].length;
+                rank += std::min(end + 1, (isize)low) - c->runs[r].start;
+            }
+            break;
+        }
+    }
+    return rank;
+}
+
+// Calls `f(value)` for every value in ascending order
+template <typename F>
+inline void roaring_for_each(const RoaringBitmap* rb, F f) {
+    for (isize i = 0; i < rb->size; i++) {
+        u32 high = (u32)rb->keys[i] << 16;
+        const RoaringContainer* c = &rb->containers[i];
+        switch (c->kind) {
+        case RoaringContainerKind::Array:
+            for (i32 j = 0; j < c->size; j++) {
+                f(high | c->values[j]);
+            }
+            break;
+        case RoaringContainerKind::Bitmap: {
+            BitSet view = {c->words, 65536};
+            bit_set_for_each_set_bit(
+                &view, [&](isize index) { f(high | (u32)index); });
+            break;
+        }
+        case RoaringContainerKind::Run:
+            for (i32 j = 0; j < c->size; j++) {
+                u32 start = high | c->runs[j].start;
+                for (u32 k = 0; k <= c->runs[j].length; k++) {
+                    f(start + k);
+                }
+            }
+            break;
+        }
+    }
+}
+
+// Converts every container to its cheapest representation, mostly useful
+// after many single value adds to turn dense ranges into runs
+inline void roaring_optimize(RoaringBitmap* rb) {
+    for (isize i = 0; i < rb->size; i++) {
+        roaring_container_optimize(&rb->containers[i], rb->alloc);
+    }
+}
+
+inline RoaringBitmap roaring_clone(const RoaringBitmap* rb, Allocator alloc) {
+    RoaringBitmap result = roaring_make(alloc);
+    for (isize i = 0; i < rb->size; i++) {
+        roaring_append_container(
+            &result, rb->keys[i],
+            roaring_container_clone(&rb->containers[i], alloc));
+    }
+    return result;
+}
+
+enum class RoaringOp : u8 {
+    And,
+    Or,
+    Xor,
+    AndNot,
+};
+
+inline RoaringContainer roaring_container_op(const RoaringContainer* a,
+                                             const RoaringContainer* b,
+                                             RoaringOp op, Allocator alloc) {
+    // Sparse fast paths, the result is a subset of the array
+    if (a->kind == RoaringContainerKind::Array &&
+        (op == RoaringOp::And || op == RoaringOp::AndNot)) {
+        RoaringContainer c = roaring_container_make(RoaringContainerKind::Array,
+                                                    a->size, alloc);
+        bool keep_contained = op == RoaringOp::And;
+        for (i32 i = 0; i < a->size; i++) {
+            if (roaring_container_contains(b, a->values[i]) == keep_contained) {
+                c.values[c.size++] = a->values[i];
+            }
+        }
+        return c;
+    }
+    if (op == RoaringOp::And && b->kind == RoaringContainerKind::Array) {
+        return roaring_container_op(b, a, op, alloc);
+    }
+
+    u64 a_words[ROARING_BITMAP_WORDS] = {};
+    u64 b_words[ROARING_BITMAP_WORDS] = {};
+    roaring_container_to_words(a, a_words);
+    roaring_container_to_words(b, b_words);
+
+    switch (op) {
+    case RoaringOp::And:
+        bit_words_and(a_words, b_words, ROARING_BITMAP_WORDS);
+        break;
+    case RoaringOp::Or:
+        bit_words_or(a_words, b_words, ROARING_BITMAP_WORDS);
+        break;
+    case RoaringOp::Xor:
+        bit_words_xor(a_words, b_words, ROARING_BITMAP_WORDS);
+        break;
+    case RoaringOp::AndNot:
+        bit_words_andnot(a_words, b_words, ROARING_BITMAP_WORDS);
+        break;
+    }
+
+    return roaring_container_from_words(a_words, alloc);
+}
+
+inline RoaringBitmap roaring_op(const RoaringBitmap* a, const RoaringBitmap* b,
+                                RoaringOp op, Allocator alloc) {
+    RoaringBitmap result = roaring_make(alloc);
+    bool keep_a_only = op != RoaringOp::And;
+    bool keep_b_only = op == RoaringOp::Or || op == RoaringOp::Xor;
+
+    isize i = 0;
+    isize j = 0;
+    while (i < a->size || j < b->size) {
+        if (j >= b->size || (i < a->size && a->keys[i] < b->keys[j])) {
+            if (keep_a_only) {
+                roaring_append_container(
+                    &result, a->keys[i],
+                    roaring_container_clone(&a->containers[i], alloc));
+            }
+            i += 1;
+        } else if (i >= a->size || b->keys[j] < a->keys[i]) {
+            if (keep_b_only) {
+                roaring_append_container(
+                    &result, b->keys[j],
+                    roaring_container_clone(&b->containers[j], alloc));
+            }
+            j += 1;
+        } else {
+            roaring_append_container(
+                &result, a->keys[i],
+                roaring_container_op(&a->containers[i], &b->containers[j], op,
+                                     alloc));
+            i += 1;
+            j += 1;
+        }
+    }
+    return result;
+}
+
+inline RoaringBitmap roaring_and(const RoaringBitmap* a, const RoaringBitmap* b,
+                                 Allocator alloc) {
+    return roaring_op(a, b, RoaringOp::And, alloc);
+}
+
+inline RoaringBitmap roaring_or(const RoaringBitmap* a, const RoaringBitmap* b,
+                                Allocator alloc) {
+    return roaring_op(a, b, RoaringOp::Or, alloc);
+}
+
+inline RoaringBitmap roaring_xor(const RoaringBitmap* a, const RoaringBitmap* b,
+                                 Allocator alloc) {
+    return roaring_op(a, b, RoaringOp::Xor, alloc);
+}
+
+// a & ~b
+inline RoaringBitmap roaring_andnot(const RoaringBitmap* a,
+                                    const RoaringBitmap* b, Allocator alloc) {
+    return roaring_op(a, b, RoaringOp::AndNot, alloc);
+}
+
+inline bool roaring_equals(const RoaringBitmap* a, const RoaringBitmap* b) {
+    if (a->size != b->size) {
+        return false;
+    }
+    for (isize i = 0; i < a->size; i++) {
+        if (a->keys[i] != b->keys[i]) {
+            return false;
+        }
+        u64 a_words[ROARING_BITMAP_WORDS] = {};
+        u64 b_words[ROARING_BITMAP_WORDS] = {};
+        roaring_container_to_words(&a->containers[i], a_words);
+        roaring_container_to_words(&b->containers[i], b_words);
+        if (memcmp(a_words, b_words, sizeof(a_words)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline RoaringBitmap roaring_from_bit_set(const BitSet* bit_set,
+                                          Allocator alloc) {
+    core_assert_msg(bit_set->size <= ((isize)1 << 32), "%ld > 2^32",
+                    bit_set->size);
+    RoaringBitmap result = roaring_make(alloc);
+
+    isize words = bit_set_word_count(bit_set->size);
+    for (isize start = 0; start < words; start += ROARING_BITMAP_WORDS) {
+        isize count = std::min(ROARING_BITMAP_WORDS, words - start);
+        if (bit_words_count(bit_set->data + start, count) == 0) {
+            continue;
+        }
+        u64 chunk[ROARING_BITMAP_WORDS] = {};
+        memcpy(chunk, bit_set->data + start, count * sizeof(u64));
+        roaring_append_container(&result,
+                                 (u16)(start / ROARING_BITMAP_WORDS),
+                                 roaring_container_from_words(chunk, alloc));
+    }
+    return result;
+}
+
+// Returns a BitSet of `size` bits, which has to be larger than every value
+inline BitSet roaring_to_bit_set(const RoaringBitmap* rb, isize size,
+                                 Allocator alloc) {
+    BitSet result = bit_set_make(size, alloc);
+    isize words = bit_set_word_count(size);
+
+    for (isize i = 0; i < rb->size; i++) {
+        isize start = (isize)rb->keys[i] * ROARING_BITMAP_WORDS;
+        core_assert_msg(start < words, "Value out of range of the BitSet");
+        u64 chunk[ROARING_BITMAP_WORDS] = {};
+        roaring_container_to_words(&rb->containers[i], chunk);
+
+        isize count = std::min(ROARING_BITMAP_WORDS, words - start);
+        for (isize j = count; j < ROARING_BITMAP_WORDS; j++) {
+            core_assert_msg(chunk[j] == 0, "Value out of range of the BitSet");
+        }
+        if (start + count == words && size % 64 != 0) {
+            core_assert_msg((chunk[count - 1] >> (size % 64)) == 0,
+                            "Value out of range of the BitSet");
+        }
+        memcpy(result.data + start, chunk, count * sizeof(u64));
+    }
+    return result;
+}
+
+// Serialized layout, all integers in native byte order:
+//   u32 magic, u32 container count
+//   per container: u16 key, u8 kind, u8 padding, u32 size
+//   per container, in the same order: the values, words or runs
+const u32 ROARING_SERIAL_MAGIC = 0x52524f43; // "CORR"
+
+enum class RoaringDeserializeError {
+    InvalidHeader,
+    Truncated,
+    InvalidContainer,
+};
+
+inline isize roaring_container_data_bytes(RoaringContainerKind kind,
+                                          isize size) {
+    switch (kind) {
+    case RoaringContainerKind::Array:
+        return size * (isize)sizeof(u16);
+    case RoaringContainerKind::Bitmap:
+        return ROARING_BITMAP_WORDS * (isize)sizeof(u64);
+    case RoaringContainerKind::Run:
+        return size * (isize)sizeof(RoaringRun);
+    }
+    return 0;
+}
+
+inline isize roaring_serialized_size(const RoaringBitmap* rb) {
+    isize size = 8 + rb->size * 8;
+    for (isize i = 0; i < rb->size; i++) {
+        size += roaring_container_data_bytes(rb->containers[i].kind,
+                                             rb->containers[i].size);
+    }
+    return size;
+}
+
+inline Slice<u8> roaring_serialize(const RoaringBitmap* rb, Allocator alloc) {
+    Slice<u8> out = slice_make<u8>(roaring_serialized_size(rb), alloc);
+    u8* cursor = out.data;
+
+    u32 header[2] = {ROARING_SERIAL_MAGIC, (u32)rb->size};
+    memcpy(cursor, header, sizeof(header));
+    cursor += sizeof(header);
+
+    for (isize i = 0; i < rb->size; i++) {
+        u8 entry[8] = {};
+        memcpy(entry, &rb->keys[i], sizeof(u16));
+        entry[2] = (u8)rb->containers[i].kind;
+        u32 size = (u32)rb->containers[i].size;
+        memcpy(entry + 4, &size, sizeof(u32));
+        memcpy(cursor, entry, sizeof(entry));
+        cursor += sizeof(entry);
+    }
+
+    for (isize i = 0; i < rb->size; i++) {
+        const RoaringContainer* c = &rb->containers[i];
+        isize bytes = roaring_container_data_bytes(c->kind, c->size);
+        memcpy(cursor, c->values, bytes);
+        cursor += bytes;
+    }
+
+    core_assert(cursor == out.data + out.size);
+    return out;
+}
+
+inline Result<RoaringBitmap, RoaringDeserializeError>
+roaring_deserialize(Slice<u8> data, Allocator alloc) {
+    u32 header[2];
+    if (data.size < (isize)sizeof(header)) {
+        return result_err(RoaringDeserializeError::Truncated);
+    }
+    memcpy(header, data.data, sizeof(header));
+    if (header[0] != ROARING_SERIAL_MAGIC) {
+        return result_err(RoaringDeserializeError::InvalidHeader);
+    }
+
+    isize count = header[1];
+    if (count > 65536) {
+        return result_err(RoaringDeserializeError::InvalidHeader);
+    }
+    if (data.size < 8 + count * 8) {
+        return result_err(RoaringDeserializeError::Truncated);
+    }
+
+    RoaringBitmap result = roaring_make(alloc);
+    const u8* entries = data.data + 8;
+    isize offset = 8 + count * 8;
+    for (isize i = 0; i < count; i++) {
+        u16 key;
+        u32 size;
+        memcpy(&key, entries + i * 8, sizeof(u16));
+        u8 kind = entries[i * 8 + 2];
+        memcpy(&size, entries + i * 8 + 4, sizeof(u32));
+
+        bool valid = size > 0 && kind <= (u8)RoaringContainerKind::Run &&
+                     (result.size == 0 || result.keys[result.size - 1] < key);
+        if (kind == (u8)RoaringContainerKind::Array) {
+            valid = valid && size <= (u32)ROARING_ARRAY_MAX_SIZE;
+        } else if (kind == (u8)RoaringContainerKind::Bitmap) {
+            valid = valid && size <= 65536;
+        } else {
+            valid = valid && size <= 32768;
+        }
+        if (!valid) {
+            roaring_free(&result);
+            return result_err(RoaringDeserializeError::InvalidContainer);
+        }
+
+        RoaringContainerKind container_kind = (RoaringContainerKind)kind;
+        isize bytes = roaring_container_data_bytes(container_kind, size);
+        if (offset + bytes > data.size) {
+            roaring_free(&result);
+            return result_err(RoaringDeserializeError::Truncated);
+        }
+
+        RoaringContainer c =
+            roaring_container_make(container_kind, (i32)size, alloc);
+        memcpy(c.values, data.data + offset, bytes);
+        c.size = (i32)size;
+        offset += bytes;
+        roaring_insert_container(&result, result.size, key, c);
+
+        // Make sure lookups can rely on the container invariants
+        bool sorted = true;
+        if (c.kind == RoaringContainerKind::Array) {
+            for (i32 j = 1; j < c.size; j++) {
+                sorted = sorted && c.values[j - 1] < c.values[j];
+            }
+        } else if (c.kind == RoaringContainerKind::Bitmap) {
+            sorted = bit_words_count(c.words, ROARING_BITMAP_WORDS) == c.size;
+        } else {
+            for (i32 j = 0; j < c.size; j++) {
+                isize end = (isize)c.runs[j].start + c.runs[j].length;
+                sorted = sorted && end < 65536 &&
+                         (j + 1 == c.size || end + 1 < c.runs[j + 1].start);
+            }
+        }
+        if (!sorted) {
+            roaring_free(&result);
+            return result_err(RoaringDeserializeError::InvalidContainer);
+        }
+    }
+
+    if (offset != data.size) {
+        roaring_free(&result);
+        return result_err(RoaringDeserializeError::InvalidContainer);
+    }
+
+    return result_ok(result);
+}
+
+/// ------------------
+/// Bloom filter
+/// ------------------
+
+// Cache line blocked Bloom filter. The hash picks one 512 bit block and all k
+// probes land inside it, so a lookup touches a single cache line. Costs a
+// slightly higher false positive rate than a classic Bloom filter with the
+// same number of bits.
+// source: Putze, Sanders, Singler - Cache-, Hash- and Space-Efficient Bloom
+// Filters
+//
+// Keys are added by their 64 bit hash (hash_u64, hash_string, ...), which has
+// to be well mixed.
+
+const isize BLOOM_BLOCK_BITS = 512;
+const i32 BLOOM_MAX_HASH_COUNT = 16;
+
+struct BloomFilter {
+    Allocator alloc;
+    // Allocation backing `bits`, which is aligned to a cache line
+    u64* memory;
+    BitSet bits;
+    isize block_count;
+    // Number of probes per key
+    i32 hash_count;
+};
+
+inline void bloom_init(BloomFilter* filter, isize expected_keys,
+                       f64 bits_per_key, Allocator alloc) {
+    core_assert_msg(expected_keys >= 0, "%ld < 0", expected_keys);
+    core_assert_msg(bits_per_key > 0, "%f <= 0", bits_per_key);
+
+    isize bits = (isize)((f64)expected_keys * bits_per_key);
+    filter->alloc = alloc;
+    filter->block_count =
+        std::max((bits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS, (isize)1);
+    // k = ln(2) * m / n is optimal for a classic Bloom filter
+    filter->hash_count = std::clamp((i32)(bits_per_key * 0.6931 + 0.5), 1,
+                                    BLOOM_MAX_HASH_COUNT);
+
+    isize words = filter->block_count * (BLOOM_BLOCK_BITS / 64);
+    filter->memory = core_alloc<u64>(alloc, words + 7);
+    u64* aligned = (u64*)(((usize)filter->memory + 63) & ~(usize)63);
+    filter->bits = BitSet{aligned, filter->block_count * BLOOM_BLOCK_BITS};
+}
+
+inline BloomFilter bloom_make(isize expected_keys, f64 bits_per_key,
+                              Allocator alloc) {
+    BloomFilter filter = {};
+    bloom_init(&filter, expected_keys, bits_per_key, alloc);
+    return filter;
+}
+
+inline void bloom_free(BloomFilter* filter) {
+    core_free(filter->alloc, filter->memory);
+    *filter = {};
+}
+
+inline u64* bloom_block(const BloomFilter* filter, u64 hash) {
+    // Maps the low half of the hash onto [0, block_count) without a division
+    u64 block = ((hash & 0xFFFFFFFF) * (u64)filter->block_count) >> 32;
+    return filter->bits.data + block * (BLOOM_BLOCK_BITS / 64);
+}
+
+// Odd multipliers, the top 9 bits of `hash * salt` pick the bit of one probe.
+// The probes don't depend on each other, so they are computed in parallel.
+const u64 BLOOM_SALTS[BLOOM_MAX_HASH_COUNT] = {
+    0x47b6137b44974d91, 0x8824ad5ba2b7289d, 0x705495c72df1424b,
+    0x9efc49475c6bfb31, 0xd1342543de82ef95, 0xbf58476d1ce4e5b9,
+    0x94d049bb133111eb, 0x9e3779b97f4a7c15, 0xa0761d6478bd642f,
+    0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3, 0x589965cc75374cc3,
+    0x1d8e4e27c47d124f, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9,
+    0x27d4eb2f165667c5,
+};
+
+inline void bloom_add(BloomFilter* filter, u64 hash) {
+    u64* block = bloom_block(filter, hash);
+    for (i32 i = 0; i < filter->hash_count; i++) {
+        u64 bit = (hash * BLOOM_SALTS[i]) >> 55;
+        block[bit / 64] |= (u64)1 << (bit % 64);
+    }
+}
+
+// False means the key was never added, true means it probably was
+inline bool bloom_maybe_contains(const BloomFilter* filter, u64 hash) {
+    const u64* block = bloom_block(filter, hash);
+    // No early exit, the branch would be mispredicted for most misses
+    u64 found = 1;
+    for (i32 i = 0; i < filter->hash_count; i++) {
+        u64 bit = (hash * BLOOM_SALTS[i]) >> 55;
+        found &= block[bit / 64] >> (bit % 64);
+    }
+    return found & 1;
+}
+
+// How far ahead the batch functions prefetch blocks
+const isize BLOOM_PREFETCH_DISTANCE = 8;
+
+inline void bloom_add_batch(BloomFilter* filter, Slice<u64> hashes) {
+    for (isize i = 0; i < hashes.size; i++) {
+        if (i + BLOOM_PREFETCH_DISTANCE < hashes.size) {
+            core_prefetch(
+                bloom_block(filter, hashes[i + BLOOM_PREFETCH_DISTANCE]));
+        }
+        bloom_add(filter, hashes[i]);
+    }
+}
+
+// Writes the result for every hash into `results` and returns the number of
+// hashes that may be contained
+inline isize bloom_maybe_contains_batch(const BloomFilter* filter,
+                                        Slice<u64> hashes,
+                                        Slice<bool> results) {
+    core_assert_msg(results.size >= hashes.size, "%ld < %ld", results.size,
+                    hashes.size);
+
+    isize count = 0;
+    for (isize i = 0; i < hashes.size; i++) {
+        if (i + BLOOM_PREFETCH_DISTANCE < hashes.size) {
+            core_prefetch(
+                bloom_block(filter, hashes[i + BLOOM_PREFETCH_DISTANCE]));
+        }
+        results[i] = bloom_maybe_contains(filter, hashes[i]);
+        count += results[i];
+    }
+    return count;
+}
+
+// a |= b, both filters must have been created with the same parameters
+inline void bloom_union(BloomFilter* a, const BloomFilter* b) {
+    core_assert_msg(a->block_count == b->block_count, "%ld != %ld",
+                    a->block_count, b->block_count);
+    core_assert_msg(a->hash_count == b->hash_count, "%d != %d", a->hash_count,
+                    b->hash_count);
+    bit_set_or(&a->bits, &b->bits);
+}
+
+inline void bloom_clear(BloomFilter* filter) {
+    memset(filter->bits.data, 0,
+           bit_set_word_count(filter->bits.size) * sizeof(u64));
+}
+
+/// ------------------
+/// Ternary array
+/// ------------------
+
+// Array of true / false / unassigned values packed into 2 bits each, 32 per
+// u64 word. The low bit of an element says whether it is assigned, the high
+// bit holds the value. Unassigned elements always have the value bit cleared.
+enum class Ternary : u8 {
+    Unassigned = 0,
+    False = 1,
+    True = 3,
+};
+
+const u64 TERNARY_ASSIGNED_MASK = 0x5555555555555555;
+
+struct TernaryArray {
+    u64* data;
+    isize size;
+};
+
+inline isize ternary_array_word_count(isize size) {
+    return (size + 31) / 32;
+}
+
+// All elements start unassigned
+inline void ternary_array_init(TernaryArray* array, isize size,
+                               Allocator alloc) {
+    core_assert_msg(size >= 0, "%ld < 0", size);
+    array->data = core_alloc<u64>(alloc, ternary_array_word_count(size));
+    array->size = size;
+}
+
+inline TernaryArray ternary_array_make(isize size, Allocator alloc) {
+    TernaryArray array = {};
+    ternary_array_init(&array, size, alloc);
+    return array;
+}
+
+inline Ternary ternary_array_get(const TernaryArray* array, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->size, "%ld >= %ld", index, array->size);
+
+    return (Ternary)((array->data[index / 32] >> (2 * (index % 32))) & 3);
+}
+
+inline void ternary_array_set(TernaryArray* array, isize index, Ternary value) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->size, "%ld >= %ld", index, array->size);
+
+    isize shift = 2 * (index % 32);
+    u64* word = &array->data[index / 32];
+    *word = (*word & ~((u64)3 << shift)) | ((u64)value << shift);
+}
+
+inline void ternary_array_set_bool(TernaryArray* array, isize index,
+                                   bool value) {
+    ternary_array_set(array, index, value ? Ternary::True : Ternary::False);
+}
+
+// Makes every element unassigned
+inline void ternary_array_clear(TernaryArray* array) {
+    memset(array->data, 0, ternary_array_word_count(array->size) * sizeof(u64));
+}
+
+inline isize ternary_words_count_assigned_scalar(const u64* data,
+                                                isize count) {
+    isize total = 0;
+    for (isize i = 0; i < count; i++) {
+        total += popcount64(data[i] & TERNARY_ASSIGNED_MASK);
+    }
+    return total;
+}
+
+#if CORE_X86_SIMD
+CORE_TARGET("popcnt")
+inline isize ternary_words_count_assigned_popcnt(const u64* data,
+                                                isize count) {
+    isize total = 0;
+    for (isize i = 0; i < count; i++) {
+        total += popcount64(data[i] & TERNARY_ASSIGNED_MASK);
+    }
+    return total;
+}
+#endif
+
+inline isize ternary_array_count_assigned(const TernaryArray* array) {
+    isize words = ternary_array_word_count(array->size);
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Popcnt)) {
+        return ternary_words_count_assigned_popcnt(array->data, words);
+    }
+#endif
+    return ternary_words_count_assigned_scalar(array->data, words);
+}
+
+// Returns the index of the first unassigned element at or after `from`, or -1
+inline isize ternary_array_find_unassigned(const TernaryArray* array,
+                                           isize from) {
+    core_assert_msg(from >= 0, "%ld < 0", from);
+    if (from >= array->size) {
+        return -1;
+    }
+
+    isize words = ternary_array_word_count(array->size);
+    isize word = from / 32;
+    u64 unassigned = ~array->data[word] & TERNARY_ASSIGNED_MASK;
+    unassigned &= ~(u64)0 << (2 * (from % 32));
+    while (true) {
+        if (unassigned != 0) {
+            isize index = word * 32 + ctz64(unassigned) / 2;
+            // The unused elements of the last word look unassigned
+            return index < array->size ? index : -1;
+        }
+        word += 1;
+        if (word >= words) {
+            return -1;
+        }
+        unassigned = ~array->data[word] & TERNARY_ASSIGNED_MASK;
+    }
+}
+
+inline isize ternary_array_first_unassigned(const TernaryArray* array) {
+    return ternary_array_find_unassigned(array, 0);
+}
+
+// Literals follow the DIMACS convention: literal `l` refers to element
+// `abs(l) - 1` and is negated when `l < 0`.
+inline Ternary ternary_array_eval_literal(const TernaryArray* array,
+                                          i32 literal) {
+    core_assert_msg(literal != 0, "Literal must not be 0");
+    // Widened first, std::abs(INT32_MIN) overflows
+    isize index = (literal < 0 ? -(isize)literal : (isize)literal) - 1;
+    u32 value = (u32)ternary_array_get(array, index);
+    // Flipping the value bit negates an assigned element
+    value ^= (literal < 0 ? 2 : 0) & (value << 1);
+    return (Ternary)value;
+}
+
+// Summary of the values of a slice of literals, e.g. a clause. It is satisfied
+// when `true_count > 0`, a conflict when all literals are false and unit when
+// only `last_unassigned` is left.
+struct LiteralsEvaluation {
+    isize true_count;
+    isize unassigned_count;
+    // Position in the slice of the last unassigned literal, -1 if none
+    isize last_unassigned;
+};
+
+inline void ternary_array_eval_literals_scalar(const TernaryArray* array,
+                                               Slice<i32> literals,
+                                               isize start,
+                                               LiteralsEvaluation* result) {
+    for (isize i = start; i < literals.size; i++) {
+        Ternary value = ternary_array_eval_literal(array, literals[i]);
+        result->true_count += value == Ternary::True;
+        if (value == Ternary::Unassigned) {
+            result->unassigned_count += 1;
+            result->last_unassigned = i;
+        }
+    }
+}
+
+#if CORE_X86_SIMD
+// Gathers the 32 bit words holding 8 elements at a time
+CORE_TARGET("avx2")
+inline isize ternary_array_eval_literals_avx2(const TernaryArray* array,
+                                              Slice<i32> literals,
+                                              LiteralsEvaluation* result) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i fifteen = _mm256_set1_epi32(15);
+#ifndef NO_ASSERTS
+    // As unsigned, literal 0 gives index 0xFFFFFFFF and INT32_MIN gives
+    // 0x7FFFFFFF, so one compare against the size rejects both
+    const __m256i limit = _mm256_set1_epi32(
+        (i32)std::min(array->size, (isize)INT32_MAX));
+#endif
+
+    isize i = 0;
+    for (; i + 8 <= literals.size; i += 8) {
+        __m256i literal =
+            _mm256_loadu_si256((const __m256i*)(literals.data + i));
+        __m256i index = _mm256_sub_epi32(_mm256_abs_epi32(literal), one);
+#ifndef NO_ASSERTS
+        // Checked before the gather reads anything
+        __m256i out_of_range =
+            _mm256_cmpeq_epi32(_mm256_max_epu32(index, limit), index);
+        core_assert_msg(_mm256_testz_si256(out_of_range, out_of_range),
+                        "Literal 0 or out of range at %ld", i);
+#endif
+        __m256i words = _mm256_i32gather_epi32(
+            (const int*)array->data, _mm256_srli_epi32(index, 4), 4);
+        __m256i shift = _mm256_slli_epi32(_mm256_and_si256(index, fifteen), 1);
+        __m256i value =
+            _mm256_and_si256(_mm256_srlv_epi32(words, shift), three);
+
+        // Negated literals flip the value bit of assigned elements
+        __m256i negated = _mm256_srli_epi32(literal, 31);
+        value = _mm256_xor_si256(
+            value, _mm256_slli_epi32(_mm256_and_si256(negated, value), 1));
+
+        u32 true_mask = (u32)_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(value, three)));
+        u32 unassigned_mask = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(value, _mm256_setzero_si256())));
+
+        result->true_count += popcount64(true_mask);
+        if (unassigned_mask != 0) {
+            result->unassigned_count += popcount64(unassigned_mask);
+            result->last_unassigned = i + 63 - clz64(unassigned_mask);
+        }
+    }
+    return i;
+}
+#endif
+
+inline LiteralsEvaluation
+ternary_array_eval_literals(const TernaryArray* array, Slice<i32> literals) {
+    LiteralsEvaluation result = {0, 0, -1};
+    isize start = 0;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        start = ternary_array_eval_literals_avx2(array, literals, &result);
+    }
+#endif
+    ternary_array_eval_literals_scalar(array, literals, start, &result);
+    return result;
+}
+
+/// ------------------
+/// Packed int array
+/// ------------------
+
+// Array of unsigned integers of a fixed bit width (1 to 32), stored back to
+// back in u64 words. Element `i` starts at bit `i * width`. An element is read
+// with a single unaligned u64 load at its first byte, which always covers it
+// (7 + 32 bits), so one padding word is kept after the last element.
+struct PackedIntArray {
+    Allocator alloc;
+    u64* data;
+    isize size;
+    isize capacity;
+    i32 width;
+};
+
+inline isize packed_int_array_word_count(isize capacity, i32 width) {
+    return (capacity * width + 63) / 64 + 1;
+}
+
+inline void packed_int_array_init(PackedIntArray* array, i32 width,
+                                  isize capacity, Allocator alloc) {
+    core_assert_msg(width >= 1 && width <= 32, "Invalid width %d", width);
+    core_assert_msg(capacity >= 0, "%ld < 0", capacity);
+
+    array->alloc = alloc;
+    array->data =
+        core_alloc<u64>(alloc, packed_int_array_word_count(capacity, width));
+    array->size = 0;
+    array->capacity = capacity;
+    array->width = width;
+}
+
+inline PackedIntArray packed_int_array_make(i32 width, isize capacity,
+                                            Allocator alloc) {
+    PackedIntArray array = {};
+    packed_int_array_init(&array, width, capacity, alloc);
+    return array;
+}
+
+inline void packed_int_array_free(PackedIntArray* array) {
+    core_free(array->alloc, array->data);
+    *array = {};
+}
+
+// Smallest width that can hold `value`
+inline i32 packed_int_width(u32 value) {
+    return value == 0 ? 1 : 64 - clz64(value);
+}
+
+inline u64 packed_int_array_mask(const PackedIntArray* array) {
+    return ((u64)1 << array->width) - 1;
+}
+
+inline u32 packed_int_array_get(const PackedIntArray* array, isize index) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->size, "%ld >= %ld", index, array->size);
+
+    isize bit = index * array->width;
+    u64 word;
+    memcpy(&word, (const u8*)array->data + bit / 8, sizeof(word));
+    return (u32)((word >> (bit % 8)) & packed_int_array_mask(array));
+}
+
+inline void packed_int_array_set(PackedIntArray* array, isize index,
+                                 u32 value) {
+    core_assert_msg(index >= 0, "%ld < 0", index);
+    core_assert_msg(index < array->size, "%ld >= %ld", index, array->size);
+    core_assert_msg(value <= packed_int_array_mask(array),
+                    "%u doesn't fit into %d bits", value, array->width);
+
+    isize bit = index * array->width;
+    u8* bytes = (u8*)array->data + bit / 8;
+    u64 word;
+    memcpy(&word, bytes, sizeof(word));
+    u64 mask = packed_int_array_mask(array) << (bit % 8);
+    word = (word & ~mask) | ((u64)value << (bit % 8));
+    memcpy(bytes, &word, sizeof(word));
+}
+
+inline void packed_int_array_push(PackedIntArray* array, u32 value) {
+    if (array->size + 1 > array->capacity) {
+        isize new_capacity = std::max(array->capacity * 2, (isize)64);
+        array->data = core_realloc<u64>(
+            array->alloc, array->data,
+            packed_int_array_word_count(array->capacity, array->width) *
+                sizeof(u64),
+            packed_int_array_word_count(new_capacity, array->width) *
+                sizeof(u64));
+        array->capacity = new_capacity;
+    }
+
+    array->size += 1;
+    packed_int_array_set(array, array->size - 1, value);
+}
+
+// Packs `values` with the smallest width that fits all of them
+inline PackedIntArray packed_int_array_from_slice(Slice<u32> values,
+                                                  Allocator alloc) {
+    u32 max = 0;
+    for (u32 value : values) {
+        max = std::max(max, value);
+    }
+
+    PackedIntArray array =
+        packed_int_array_make(packed_int_width(max), values.size, alloc);
+    array.size = values.size;
+    for (isize i = 0; i < values.size; i++) {
+        packed_int_array_set(&array, i, values[i]);
+    }
+    return array;
+}
+
+inline void packed_int_array_unpack_scalar(const PackedIntArray* array,
+                                           isize start, Slice<u32> out) {
+    const u8* bytes = (const u8*)array->data;
+    u64 mask = packed_int_array_mask(array);
+    for (isize i = start; i < array->size; i++) {
+        isize bit = i * array->width;
+        u64 word;
+        memcpy(&word, bytes + bit / 8, sizeof(word));
+        out.data[i] = (u32)((word >> (bit % 8)) & mask);
+    }
+}
+
+#if CORE_X86_SIMD
+// Gathers the bytes covering each element, then shifts and masks them in
+// parallel. Offsets are relative to the byte of the first element of the
+// block, so they stay small no matter how large the array is. Up to 25 bits
+// an element fits into the u32 at its first byte, so 8 are done at a time,
+// wider ones use u64 gathers, 4 at a time.
+CORE_TARGET("avx2")
+inline isize packed_int_array_unpack_avx2(const PackedIntArray* array,
+                                          Slice<u32> out) {
+    const u8* bytes = (const u8*)array->data;
+    i32 width = array->width;
+    const __m256i seven = _mm256_set1_epi32(7);
+
+    isize i = 0;
+    if (width <= 25) {
+        const __m256i lanes =
+            _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                               _mm256_set1_epi32(width));
+        const __m256i mask =
+            _mm256_set1_epi32((i32)packed_int_array_mask(array));
+        for (; i + 8 <= array->size; i += 8) {
+            isize bit = i * width;
+            __m256i offsets =
+                _mm256_add_epi32(lanes, _mm256_set1_epi32(bit % 8));
+            __m256i words =
+                _mm256_i32gather_epi32((const int*)(bytes + bit / 8),
+                                       _mm256_srli_epi32(offsets, 3), 1);
+            __m256i shifts = _mm256_and_si256(offsets, seven);
+            __m256i values =
+                _mm256_and_si256(_mm256_srlv_epi32(words, shifts), mask);
+            _mm256_storeu_si256((__m256i*)(out.data + i), values);
+        }
+        return i;
+    }
+
+    const __m256i lanes = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(width));
+    const __m256i mask = _mm256_set1_epi64x((i64)packed_int_array_mask(array));
+    const __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    for (; i + 8 <= array->size; i += 8) {
+        isize bit = i * width;
+        __m256i offsets = _mm256_add_epi32(lanes, _mm256_set1_epi32(bit % 8));
+        __m256i indices = _mm256_srli_epi32(offsets, 3);
+        __m256i shifts = _mm256_and_si256(offsets, seven);
+
+        const long long* base = (const long long*)(bytes + bit / 8);
+        __m256i lo = _mm256_i32gather_epi64(
+            base, _mm256_castsi256_si128(indices), 1);
+        __m256i hi = _mm256_i32gather_epi64(
+            base, _mm256_extracti128_si256(indices, 1), 1);
+        lo = _mm256_srlv_epi64(
+            lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(shifts)));
+        hi = _mm256_srlv_epi64(
+            hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(shifts, 1)));
+        lo = _mm256_and_si256(lo, mask);
+        hi = _mm256_and_si256(hi, mask);
+
+        // Take the low dword of every u64 lane, in order
+        lo = _mm256_permutevar8x32_epi32(lo, low_dwords);
+        hi = _mm256_permutevar8x32_epi32(hi, low_dwords);
+        _mm256_storeu_si256((__m256i*)(out.data + i),
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+    }
+    return i;
+}
+#endif
+
+// Writes all elements into `out`, which has to have room for them
+inline void packed_int_array_unpack(const PackedIntArray* array,
+                                    Slice<u32> out) {
+    core_assert_msg(out.size >= array->size, "%ld < %ld", out.size,
+                    array->size);
+
+    isize start = 0;
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        start = packed_int_array_unpack_avx2(array, out);
+    }
+#endif
+    packed_int_array_unpack_scalar(array, start, out);
+}
+
+/// ------------------
+/// HyperLogLog
+/// ------------------
+
+// Estimates the number of distinct keys with a fixed amount of memory. Keys
+// are added by their 64 bit hash (hash_u64, hash_string, ...). The top
+// `precision` bits of the hash pick one of 2^precision registers, which keeps
+// the longest run of leading zeros seen in the remaining bits. The standard
+// error is about 1.04 / sqrt(2^precision), 0.8% for the default precision.
+//
+// Small sketches start sparse: a list of (25 bit index, run) entries, counted
+// exactly with linear counting over 2^25 registers. Once the list would take
+// more memory than the dense registers, it is converted.
+// source: Heule, Nunkesser, Hall - HyperLogLog in Practice
+// source: Ertl - New cardinality estimation algorithms for HyperLogLog sketches
+
+const i32 HLL_DEFAULT_PRECISION = 14;
+const i32 HLL_SPARSE_PRECISION = 25;
+
+struct HyperLogLog {
+    Allocator alloc;
+    i32 precision;
+    bool is_sparse;
+    // Dense representation, one register per byte
+    u8* registers;
+    // Sparse representation, entries are `index << 6 | run`. The first
+    // `sparse_sorted` entries are sorted and have unique indices.
+    u32* sparse;
+    isize sparse_size;
+    isize sparse_sorted;
+    isize sparse_capacity;
+};
+
+inline isize hll_register_count(const HyperLogLog* hll) {
+    return (isize)1 << hll->precision;
+}
+
+inline void hll_init(HyperLogLog* hll, Allocator alloc,
+                     i32 precision = HLL_DEFAULT_PRECISION) {
+    core_assert_msg(precision >= 4 && precision <= 18, "Invalid precision %d",
+                    precision);
+    hll->alloc = alloc;
+    hll->precision = precision;
+    hll->is_sparse = true;
+    hll->registers = nullptr;
+    hll->sparse_capacity = 16;
+    hll->sparse = core_alloc<u32>(alloc, hll->sparse_capacity);
+    hll->sparse_size = 0;
+    hll->sparse_sorted = 0;
+}
+
+inline HyperLogLog hll_make(Allocator alloc,
+                            i32 precision = HLL_DEFAULT_PRECISION) {
+    HyperLogLog hll = {};
+    hll_init(&hll, alloc, precision);
+    return hll;
+}
+
+inline void hll_free(HyperLogLog* hll) {
+    if (hll->is_sparse) {
+        core_free(hll->alloc, hll->sparse);
+    } else {
+        core_free(hll->alloc, hll->registers);
+    }
+    *hll = {};
+}
+
+inline void hll_dense_update(HyperLogLog* hll, isize index, u8 run) {
+    hll->registers[index] = std::max(hll->registers[index], run);
+}
+
+// Folds a sparse entry into the dense register it belongs to. The low bits of
+// the sparse index are the first bits of the dense run.
+inline void hll_dense_add_sparse_entry(HyperLogLog* hll, u32 entry) {
+    i32 extra_bits = HLL_SPARSE_PRECISION - hll->precision;
+    u32 index = entry >> 6;
+    u32 low = index & ((1u << extra_bits) - 1);
+    u8 run = low != 0 ? (u8)(clz64(low) - (64 - extra_bits) + 1)
+                      : (u8)(extra_bits + (entry & 63));
+    hll_dense_update(hll, index >> extra_bits, run);
+}
+
+// Sorts the entries and keeps only the longest run of every index
+inline void hll_sparse_compact(HyperLogLog* hll) {
+    std::sort(hll->sparse, hll->sparse + hll->sparse_size);
+    isize size = 0;
+    for (isize i = 0; i < hll->sparse_size; i++) {
+        bool last_of_index = i + 1 == hll->sparse_size ||
+                             (hll->sparse[i + 1] >> 6) != (hll->sparse[i] >> 6);
+        if (last_of_index) {
+            hll->sparse[size++] = hll->sparse[i];
+        }
+    }
+    hll->sparse_size = size;
+    hll->sparse_sorted = size;
+}
+
+inline void hll_to_dense(HyperLogLog* hll) {
+    core_assert(hll->is_sparse);
+    hll->registers = core_alloc<u8>(hll->alloc, hll_register_count(hll));
+    hll->is_sparse = false;
+    for (isize i = 0; i < hll->sparse_size; i++) {
+        hll_dense_add_sparse_entry(hll, hll->sparse[i]);
+    }
+    core_free(hll->alloc, hll->sparse);
+    hll->sparse = nullptr;
+    hll->sparse_size = 0;
+    hll->sparse_sorted = 0;
+    hll->sparse_capacity = 0;
+}
+
+inline void hll_sparse_add_entry(HyperLogLog* hll, u32 entry) {
+    // Most keys of a stream repeat, skip them if the sorted part already
+    // covers them
+    if (hll->sparse_sorted > 0) {
+        // Branchless lower bound, the comparisons are unpredictable. Written
+        // as a multiplication, the ternary form is compiled to a branch.
+        const u32* base = hll->sparse;
+        isize length = hll->sparse_sorted;
+        u32 key = entry & ~63u;
+        while (length > 1) {
+            isize half = length / 2;
+            base += (isize)(base[half - 1] < key) * half;
+            length -= half;
+        }
+        if ((*base >> 6) == (entry >> 6) && *base >= entry) {
+            return;
+        }
+    }
+
+    if (hll->sparse_size == hll->sparse_capacity) {
+        hll_sparse_compact(hll);
+        // Grow only when compacting didn't free up at least half
+        if (hll->sparse_size * 2 > hll->sparse_capacity) {
+            isize new_capacity = hll->sparse_capacity * 2;
+            // 4 bytes per entry, the dense registers are 1 byte each
+            if (new_capacity * 4 > hll_register_count(hll)) {
+                hll_to_dense(hll);
+                hll_dense_add_sparse_entry(hll, entry);
+                return;
+            }
+            hll->sparse = core_realloc<u32>(
+                hll->alloc, hll->sparse, hll->sparse_capacity * sizeof(u32),
+                new_capacity * sizeof(u32));
+            hll->sparse_capacity = new_capacity;
+        }
+    }
+    hll->sparse[hll->sparse_size++] = entry;
+}
+
+inline void hll_add_hash(HyperLogLog* hll, u64 hash) {
+    if (hll->is_sparse) {
+        u32 index = (u32)(hash >> (64 - HLL_SPARSE_PRECISION));
+        u64 rest = hash << HLL_SPARSE_PRECISION;
+        u32 run = rest == 0 ? 64 - HLL_SPARSE_PRECISION + 1 : clz64(rest) + 1;
+        hll_sparse_add_entry(hll, (index << 6) | run);
+    } else {
+        isize index = (isize)(hash >> (64 - hll->precision));
+        u64 rest = hash << hll->precision;
+        u8 run = rest == 0 ? (u8)(64 - hll->precision + 1)
+                           : (u8)(clz64(rest) + 1);
+        hll_dense_update(hll, index, run);
+    }
+}
+
+inline void hll_add_u64(HyperLogLog* hll, u64 key) {
+    hll_add_hash(hll, hash_u64(key));
+}
+
+inline void hll_add_string(HyperLogLog* hll, String key) {
+    hll_add_hash(hll, hash_string(key));
+}
+
+// a += b, both sketches must have the same precision
+inline void hll_merge(HyperLogLog* a, const HyperLogLog* b) {
+    core_assert_msg(a->precision == b->precision, "%d != %d", a->precision,
+                    b->precision);
+
+    if (b->is_sparse) {
+        for (isize i = 0; i < b->sparse_size; i++) {
+            if (a->is_sparse) {
+                hll_sparse_add_entry(a, b->sparse[i]);
+            } else {
+                hll_dense_add_sparse_entry(a, b->sparse[i]);
+            }
+        }
+        return;
+    }
+
+    if (a->is_sparse) {
+        hll_to_dense(a);
+    }
+    isize count = hll_register_count(a);
+    for (isize i = 0; i < count; i++) {
+        a->registers[i] = std::max(a->registers[i], b->registers[i]);
+    }
+}
+
+inline f64 hll_sigma(f64 x) {
+    if (x == 1) {
+        return INFINITY;
+    }
+    f64 y = 1;
+    f64 z = x;
+    f64 previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+    return z;
+}
+
+inline f64 hll_tau(f64 x) {
+    if (x == 0 || x == 1) {
+        return 0;
+    }
+    f64 y = 1;
+    f64 z = 1 - x;
+    f64 previous;
+    do {
+        x = sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while (z != previous);
+    return z / 3;
+}
+
+// Returns the estimated number of distinct keys added
+inline f64 hll_count(HyperLogLog* hll) {
+    if (hll->is_sparse) {
+        hll_sparse_compact(hll);
+        // Linear counting over the sparse registers
+        f64 m = (f64)((isize)1 << HLL_SPARSE_PRECISION);
+        return m * log(m / (m - (f64)hll->sparse_size));
+    }
+
+    // Ertl's improved raw estimator, from the histogram of register values
+    i32 q = 64 - hll->precision;
+    isize histogram[66] = {};
+    isize count = hll_register_count(hll);
+    for (isize i = 0; i < count; i++) {
+        histogram[hll->registers[i]] += 1;
+    }
+
+    f64 m = (f64)count;
+    f64 z = m * hll_tau(1 - (f64)histogram[q + 1] / m);
+    for (i32 k = q; k >= 1; k--) {
+        z = 0.5 * (z + (f64)histogram[k]);
+    }
+    z += m * hll_sigma((f64)histogram[0] / m);
+    return m * m / (2 * log(2) * z);
+}
+
+/// ------------------
+/// STL compat allocator
+/// ------------------
+
+template <typename T> struct StlCompatAllocator {
+    using value_type = T;
+
+    Allocator alloc;
+
+    StlCompatAllocator(Allocator alloc) : alloc(alloc) {
+    }
+
+    template <typename U>
+    StlCompatAllocator(const StlCompatAllocator<U>& other)
+        : alloc(other.alloc) {
+    }
+
+    T* allocate(std::size_t n) {
+        return core_alloc<T>(alloc, n);
+    }
+
+    void deallocate(T* pointer, std::size_t) {
+        core_free(alloc, pointer);
+    }
+
+    template <typename U>
+    bool operator==(const StlCompatAllocator<U>& other) const {
+        return alloc == other.alloc;
+    }
+
+    template <typename U>
+    bool operator!=(const StlCompatAllocator<U>& other) const {
+        return !(*this == other);
+    }
+};
+
+/// ------------------
+/// Hash map
+/// ------------------
+
+template <typename K, typename V> struct HashMap {
+    Allocator alloc;
+    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                       StlCompatAllocator<std::pair<const K, V>>>* backing_map;
+};
+
+template <typename K, typename V>
+inline void hash_map_init(HashMap<K, V>* hash_map, isize default_size,
+                          Allocator alloc) {
+    hash_map->alloc = alloc;
+
+    StlCompatAllocator<K> allocator(alloc);
+    hash_map->backing_map =
+        new (core_alloc<
+             std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                                StlCompatAllocator<std::pair<const K, V>>>>(
+            alloc))
+            std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                               StlCompatAllocator<std::pair<const K, V>>>(
+                default_size, std::hash<K>(), std::equal_to<K>(), allocator);
+
+    core_assert(hash_map->backing_map);
+}
+
+template <typename K, typename V>
+inline void hash_map_insert_or_set(HashMap<K, V>* hash_map, K key, V value) {
+    (*hash_map->backing_map)[key] = value;
+}
+
+template <typename K, typename V>
+inline V hash_map_must_get(HashMap<K, V>* hash_map, K key) {
+    auto it = hash_map->backing_map->find(key);
+    core_assert_msg(it != hash_map->backing_map->end(), "Key not found");
+    return it->second;
+}
+
+template <typename K, typename V>
+inline V* hash_map_get_ptr(HashMap<K, V>* hash_map, K key) {
+    auto it = hash_map->backing_map->find(key);
+    if (it == hash_map->backing_map->end()) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
 
-    ARRAY_PROGRAMMING_OVERLOADS(N)
+template <typename K, typename V>
+inline void hash_map_remove(HashMap<K, V>* hash_map, K key) {
+    hash_map->backing_map->erase(key);
+}
+
+/// ----------------
+/// HashSet
+/// ----------------
+
+template <typename T> struct HashSet {
+    Allocator alloc;
+    std::unordered_set<T, std::hash<T>, std::equal_to<T>,
+                       StlCompatAllocator<T>>* backing_set;
 };
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wgnu-anonymous-struct"
-#pragma clang diagnostic ignored "-Wnested-anon-types"
-template <typename T> struct StaticArray<T, 3> {
-    union {
-        T data[3];
-        struct {
-            T x, y, z;
-        };
-        struct {
-            T r, g, b;
-        };
-    };
-    static const isize size = 3;
+template <typename T>
+inline void hash_set_init(HashSet<T>* hash_set, isize default_size,
+                          Allocator alloc) {
+    hash_set->alloc = alloc;
 
-    StaticArray(T x, T y, T z) : x(x), y(y), z(z) {
-    }
+    StlCompatAllocator<T> allocator(alloc);
+    hash_set->backing_set =
+        new (core_alloc<std::unordered_set<T, std::hash<T>, std::equal_to<T>,
+                                           StlCompatAllocator<T>>>(alloc))
+            std::unordered_set<T, std::hash<T>, std::equal_to<T>,
+                               StlCompatAllocator<T>>(
+                default_size, std::hash<T>(), std::equal_to<T>(), allocator);
 
-    StaticArray() : data{0, 0, 0} {
+    core_assert(hash_set->backing_set);
+}
+
+template <typename T>
+inline HashSet<T> hash_set_make(isize default_size, Arena* arena) {
+    HashSet<T> hash_set = {};
+    hash_set_init(&hash_set, default_size, arena);
+    return hash_set;
+}
+
+template <typename T>
+inline bool hash_set_insert(HashSet<T>* hash_set, T value) {
+    auto result = hash_set->backing_set->insert(value);
+    return result.second;
+}
+
+template <typename T>
+inline bool hash_set_contains(HashSet<T>* hash_set, T value) {
+    auto it = hash_set->backing_set->find(value);
+    return it != hash_set->backing_set->end();
+}
+
+template <typename T>
+inline const T* hash_set_get_ptr(HashSet<T>* hash_set, T value) {
+    auto it = hash_set->backing_set->find(value);
+    if (it == hash_set->backing_set->end()) {
+        return nullptr;
     }
+    return &(*it);
+}
 
-    ARRAY_PROGRAMMING_OVERLOADS(3)
+template <typename T>
+inline void hash_set_remove(HashSet<T>* hash_set, T value) {
+    hash_set->backing_set->erase(value);
+}
+
+/// ----------------
+/// Files
+/// ----------------
+
+const isize MAX_FILE_SIZE = 10 * 1024 * 1024 * 1024ll;
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+enum class FileReadError {
+    FileNotFound,
+    PermissionsDenied,
+    SystemError,
+    ReadError,
+    InvalidFile,
+    SizeTooLarge
 };
-static_assert(sizeof(StaticArray<f32, 3>) == sizeof(f32) * 3,
-              "Vec3 size is incorrect");
 
-template <typename T> struct StaticArray<T, 4> {
-    union {
-        T data[4];
-        struct {
-            T x, y, z, w;
-        };
-        struct {
-            T r, g, b, a;
-        };
-    };
-    static const isize size = 4;
+inline FileReadError file_read_error_from_errno(int error) {
+    switch (error) {
+    case ENOENT:
+        return FileReadError::FileNotFound;
+    case EACCES:
+    case EPERM:
+        return FileReadError::PermissionsDenied;
+    default:
+        return FileReadError::SystemError;
+    }
+}
 
-    StaticArray(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) {
+inline Result<Slice<u8>, FileReadError>
+file_read_full(const String path, Allocator alloc,
+               isize max_allowed_size = MAX_FILE_SIZE) {
+
+    char path_buffer[PATH_MAX];
+    string_to_cstr(path, path_buffer, sizeof(path_buffer));
+
+    FILE* file = fopen(path_buffer, "rb");
+    if (!file) {
+        return result_err(file_read_error_from_errno(errno));
     }
+    defer(fclose(file));
 
-    StaticArray() : data{0, 0, 0, 0} {
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return result_err(FileReadError::InvalidFile);
     }
 
-    ARRAY_PROGRAMMING_OVERLOADS(4)
-};
-static_assert(sizeof(StaticArray<f32, 4>) == sizeof(f32) * 4,
-              "Vec3 size is incorrect");
+    long size = ftell(file);
+    if (size < 0) {
+        return result_err(FileReadError::InvalidFile);
+    }
 
-template <typename T> struct StaticArray<T, 2> {
-    union {
-        T data[2];
-        struct {
-            T x, y;
-        };
-    };
-    static const isize size = 2;
+    if (size > max_allowed_size) {
+        return result_err(FileReadError::SizeTooLarge);
+    }
 
-    StaticArray(T x, T y) : x(x), y(y) {
+    if (fseek(file, 0, SEEK_SET) != 0) {
+        return result_err(FileReadError::InvalidFile);
     }
 
-    StaticArray() : data{0, 0} {
+    Slice<u8> data;
+    data = slice_make<u8>(size, alloc);
+
+    isize bytes_read = 0;
+    while (bytes_read < size) {
+        isize read = fread(data.data + bytes_read, 1, size - bytes_read, file);
+        if (read <= 0) {
+            if (ferror(file)) {
+                return result_err(FileReadError::ReadError);
+            }
+            break;
+        }
+        bytes_read += read;
     }
 
-    ARRAY_PROGRAMMING_OVERLOADS(2)
-};
+    if (bytes_read != size) {
+        return result_err(FileReadError::ReadError);
+    }
 
-#pragma clang diagnostic pop
+    return result_ok(data);
+}
 
-template <typename T, isize N>
-inline Slice<T> static_array_to_slice(const StaticArray<T, N>& array) {
-    return Slice<T>{array.data, N};
+// Bytes per pread call, large enough that the syscalls don't matter
+const isize FILE_READ_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// file_read_full without stdio. Sizes the buffer with fstat, skips zeroing
+// it and reads it with preads at chunk aligned offsets, telling the kernel
+// the file is read sequentially. Falls back to file_read_full on Windows.
+inline Result<Slice<u8>, FileReadError>
+file_read_full_pread(const String path, Allocator alloc,
+                     isize max_allowed_size = MAX_FILE_SIZE) {
+#if defined(_WIN32)
+    return file_read_full(path, alloc, max_allowed_size);
+#else
+    char path_buffer[PATH_MAX];
+    string_to_cstr(path, path_buffer, sizeof(path_buffer));
+
+    int fd = open(path_buffer, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return result_err(file_read_error_from_errno(errno));
+    }
+    defer(close(fd));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return result_err(FileReadError::SystemError);
+    }
+    if (!S_ISREG(info.st_mode)) {
+        return result_err(FileReadError::InvalidFile);
+    }
+
+    isize size = (isize)info.st_size;
+    if (size > max_allowed_size) {
+        return result_err(FileReadError::SizeTooLarge);
+    }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    Slice<u8> data = slice_from_parts(core_alloc_non_zeroed<u8>(alloc, size),
+                                      size);
+    isize bytes_read = 0;
+    while (bytes_read < size) {
+        isize chunk = std::min(size - bytes_read, FILE_READ_CHUNK_SIZE);
+        ssize_t read = pread(fd, data.data + bytes_read, chunk, bytes_read);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        // Also fails when the file shrank since fstat
+        if (read <= 0) {
+            core_free(alloc, data.data);
+            return result_err(FileReadError::ReadError);
+        }
+        bytes_read += read;
+    }
+
+    return result_ok(data);
+#endif
 }
 
-/// ------------------
-/// BitSet
-/// ------------------
+// Read only view of a whole file mapped into memory. Pages are loaded on
+// first access instead of copied up front, which avoids a buffer and a pass
+// over the data for big inputs.
+struct MappedFile {
+    Slice<u8> data;
+};
 
-struct BitSet {
-    u8* data;
-    isize size;
+struct FileMapOptions {
+    // Read ahead aggressively and drop pages behind the reader
+    bool sequential = true;
+    // Start reading the whole file in the background
+    bool will_need = false;
+    // Fault in every page before returning, Linux only. Slower to open, but
+    // no page faults afterwards.
+    bool populate = false;
 };
 
-inline void bit_set_init(BitSet* bit_set, isize size, Allocator alloc) {
-    core_assert_msg(size >= 0, "%ld < 0", size);
-    isize byte_size = (size + 7) / 8;
-    // Here we set the alignment to sizeof(u64), as in many of the functions we
-    // do an optimization, where we treat the data as u64s.
-    // On ARM and ARM64, this is important, as the compiler will not be able to
-    // do this optimization automatically, as the alignment is not guaranteed to
-    // be u64 which is a requirement on ARM.
-    bit_set->data = core_alloc<u8>(alloc, byte_size, sizeof(u64));
-    bit_set->size = size;
-}
+inline Result<MappedFile, FileReadError>
+file_map(const String path, FileMapOptions options = {}) {
+    char path_buffer[PATH_MAX];
+    string_to_cstr(path, path_buffer, sizeof(path_buffer));
 
-inline BitSet bit_set_make(isize size, Allocator alloc) {
-    BitSet bit_set = {};
-    bit_set_init(&bit_set, size, alloc);
-    return bit_set;
-}
+#if defined(_WIN32)
+    DWORD flags = options.sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    HANDLE file = CreateFileA(path_buffer, GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        switch (GetLastError()) {
+        case ERROR_FILE_NOT_FOUND:
+        case ERROR_PATH_NOT_FOUND:
+            return result_err(FileReadError::FileNotFound);
+        case ERROR_ACCESS_DENIED:
+            return result_err(FileReadError::PermissionsDenied);
+        default:
+            return result_err(FileReadError::SystemError);
+        }
+    }
+    defer(CloseHandle(file));
 
-inline BitSet bit_set_clone(const BitSet* bit_set, Allocator alloc) {
-    BitSet new_bit_set = {};
-    new_bit_set.size = bit_set->size;
-    isize byte_size = (bit_set->size + 7) / 8;
-    new_bit_set.data = core_alloc<u8>(alloc, byte_size);
-    memcpy(new_bit_set.data, bit_set->data, byte_size);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        return result_err(FileReadError::InvalidFile);
+    }
+    if (size.QuadPart == 0) {
+        return result_ok(MappedFile{});
+    }
 
-    return new_bit_set;
-}
+    // The view keeps the mapping alive after its handle is closed
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        return result_err(FileReadError::SystemError);
+    }
+    defer(CloseHandle(mapping));
+
+    u8* data = (u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        return result_err(FileReadError::SizeTooLarge);
+    }
+
+    if (options.will_need || options.populate) {
+        WIN32_MEMORY_RANGE_ENTRY range = {data, (SIZE_T)size.QuadPart};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    isize mapped_size = (isize)size.QuadPart;
+    return result_ok(MappedFile{slice_from_parts(data, mapped_size)});
+#else
+    int fd = open(path_buffer, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return result_err(file_read_error_from_errno(errno));
+    }
+    // The mapping keeps its own reference to the file
+    defer(close(fd));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return result_err(FileReadError::SystemError);
+    }
+    if (!S_ISREG(info.st_mode)) {
+        return result_err(FileReadError::InvalidFile);
+    }
+
+    // mmap refuses empty mappings
+    isize size = (isize)info.st_size;
+    if (size == 0) {
+        return result_ok(MappedFile{});
+    }
 
-inline void bit_set_set(BitSet* bit_set, isize index) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    if (options.populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void* data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    if (data == MAP_FAILED) {
+        return result_err(errno == ENOMEM ? FileReadError::SizeTooLarge
+                                          : FileReadError::SystemError);
+    }
 
-    isize byte_index = index / 8;
-    isize bit_index = index % 8;
+    // Only hints, failing them doesn't affect the mapping
+    if (options.sequential) {
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    if (options.will_need) {
+        madvise(data, size, MADV_WILLNEED);
+    }
+    return result_ok(MappedFile{slice_from_parts((u8*)data, size)});
+#endif
+}
 
-    bit_set->data[byte_index] |= (1 << bit_index);
+inline void file_unmap(MappedFile* file) {
+    core_assert(file != nullptr);
+    if (file->data.data == nullptr) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(file->data.data);
+#else
+    munmap(file->data.data, file->data.size);
+#endif
+    file->data = {};
 }
 
-inline void bit_set_clear(BitSet* bit_set, isize index) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+enum class FileWriteError {
+    DiskFull,
+    WriteError,
+};
 
-    isize byte_index = index / 8;
-    isize bit_index = index % 8;
+/// ------------------
+/// Batched file reading
+/// ------------------
 
-    bit_set->data[byte_index] &= ~(1 << bit_index);
-}
+// Reads many files at once, for loading thousands of inputs where waiting on
+// one read at a time dominates. All contents go into one block. On Linux the
+// reads are queued on an io_uring with that block registered as a fixed
+// buffer, elsewhere (see CORE_IO_URING) or when io_uring is unavailable a pool
+// of threads issues preads. POSIX only.
+#if !defined(_WIN32)
 
-inline bool bit_set_get(const BitSet* bit_set, isize index) {
-    core_assert_msg(index >= 0, "%ld < 0", index);
-    core_assert_msg(index < bit_set->size, "%ld >= %ld", index, bit_set->size);
+struct FileReadMany {
+    Allocator alloc;
+    // One result per path, in the same order, pointing into `memory`
+    Slice<Result<Slice<u8>, FileReadError>> files;
+    Slice<u8> memory;
+};
 
-    isize byte_index = index / 8;
-    isize bit_index = index % 8;
+// Files open at a time, well below the usual limit of 1024 descriptors
+const isize FILE_READ_MANY_BATCH = 256;
+const isize FILE_READ_MANY_MAX_THREADS = 16;
+// Reads in flight on the io_uring
+const u32 FILE_READ_MANY_QUEUE_DEPTH = 64;
 
-    return (bit_set->data[byte_index] & (1 << bit_index)) != 0;
+// Reads all of `data` from the start of the file
+inline bool file_read_many_pread(int fd, Slice<u8> data) {
+    isize bytes_read = 0;
+    while (bytes_read < data.size) {
+        isize chunk = std::min(data.size - bytes_read, FILE_READ_CHUNK_SIZE);
+        ssize_t read = pread(fd, data.data + bytes_read, chunk, bytes_read);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        bytes_read += read;
+    }
+    return true;
 }
 
-#define bit_set_combine_loop(op)                                               \
-    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);       \
-                                                                               \
-    isize bytes = (a->size + 7) / 8;                                           \
-    isize i = 0;                                                               \
-                                                                               \
-    while (bytes - i >= 8) {                                                   \
-        u64* a_data = &((u64*)(a->data))[i];                                   \
-        u64 b_data = ((u64*)(b->data))[i];                                     \
-        *a_data = *a_data op b_data;                                           \
-        i += 8;                                                                \
-    }                                                                          \
-                                                                               \
-    while (bytes - i >= 4) {                                                   \
-        u32* a_data = &((u32*)(a->data))[i];                                   \
-        u32 b_data = ((u32*)(b->data))[i];                                     \
-        *a_data = *a_data op b_data;                                           \
-        i += 4;                                                                \
-    }                                                                          \
-                                                                               \
-    while (bytes - i >= 1) {                                                   \
-        a->data[i] = a->data[i] op b->data[i];                                 \
-        i += 1;                                                                \
+// Reads the files of a batch that aren't done yet with a pool of threads
+inline void file_read_many_threads(FileReadMany* many, const int* fds,
+                                   bool* done, isize start, isize count) {
+    isize pending = 0;
+    for (isize i = 0; i < count; i++) {
+        pending += !done[i];
     }
+    if (pending == 0) {
+        return;
+    }
+    // hardware_concurrency() is 0 when it can't be determined
+    isize thread_count = std::min(
+        {std::max((isize)std::thread::hardware_concurrency(), (isize)1),
+         pending, FILE_READ_MANY_MAX_THREADS});
 
-inline void bit_set_and(BitSet* a, const BitSet* b) {
-    bit_set_combine_loop(&)
-}
+    std::atomic<isize> next = 0;
+    auto work = [&]() {
+        for (isize i = next++; i < count; i = next++) {
+            if (done[i]) {
+                continue;
+            }
+            Result<Slice<u8>, FileReadError>* file = &many->files[start + i];
+            if (!file_read_many_pread(fds[i], file->value)) {
+                *file = result_err(FileReadError::ReadError);
+            }
+            done[i] = true;
+        }
+    };
+    std::thread threads[FILE_READ_MANY_MAX_THREADS];
+    for (isize i = 1; i < thread_count; i++) {
+        threads[i] = std::thread(work);
+    }
+    work();
+    for (isize i = 1; i < thread_count; i++) {
+        threads[i].join();
+    }
+}
+
+#if CORE_IO_URING
+// Minimal io_uring over the raw syscalls, enough to queue reads and reap
+// their completions. The kernel and this process share both rings, the
+// indices are published with release stores and read with acquire loads.
+// source: https://kernel.dk/io_uring.pdf
+struct IoUring {
+    int fd;
+    u32 entries;
+    u32* sq_head;
+    u32* sq_tail;
+    u32* sq_mask;
+    u32* sq_array;
+    io_uring_sqe* sqes;
+    u32* cq_head;
+    u32* cq_tail;
+    u32* cq_mask;
+    io_uring_cqe* cqes;
+    u8* rings;
+    isize rings_size;
+    isize sqes_size;
+    bool fixed_buffer;
+};
 
-inline void bit_set_or(BitSet* a, const BitSet* b) {
-    bit_set_combine_loop(|)
+inline u32 io_uring_load(u32* index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
 }
 
-inline void bit_set_xor(BitSet* a, const BitSet* b) {
-    bit_set_combine_loop(^)
+inline void io_uring_store(u32* index, u32 value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
 }
 
-inline void bit_set_not(BitSet* a) {
-    isize bytes = (a->size + 7) / 8;
-    for (isize i = 0; i < bytes; i++) {
-        a->data[i] = ~a->data[i];
+// Returns false when io_uring is unavailable, e.g. an old kernel or seccomp
+inline bool io_uring_init(IoUring* ring, u32 entries, Slice<u8> buffer) {
+    io_uring_params params = {};
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return false;
     }
-
-    // Make sure to clear the last bits
-    isize last_bits = a->size % 8;
-    if (last_bits > 0) {
-        u8 mask = (1 << last_bits) - 1;
-        a->data[bytes - 1] &= ~mask;
+    // Kernels before 5.4 need separate mappings for the two rings
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd);
+        return false;
     }
-}
-
-inline isize bit_set_count(const BitSet* a) {
-    isize count = 0;
-    isize bytes = (a->size + 7) / 8;
-    isize i = 0;
 
-    while (bytes - i >= 8) {
-        u64 value = ((u64*)(a->data))[i];
-        count += popcount64(value);
-        i += 8;
+    isize sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    isize cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring->rings_size = std::max(sq_size, cq_size);
+    void* rings = mmap(nullptr, ring->rings_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+        close(fd);
+        return false;
     }
-
-    if (bytes - i > 0) {
-        u64 value = 0;
-        u8* value_ptr = (u8*)&value;
-        core_assert(bytes - i < 8);
-        memcpy(value_ptr, a->data + i, bytes - i);
-        count += popcount64(value);
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(rings, ring->rings_size);
+        close(fd);
+        return false;
     }
 
-    return count;
-}
-
-inline bool bit_set_equals(const BitSet* a, const BitSet* b) {
-    core_assert_msg(a->size == b->size, "%ld != %ld", a->size, b->size);
-    isize bytes = (a->size + 7) / 8;
-    return memcmp(a->data, b->data, bytes) == 0;
+    u8* base = (u8*)rings;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->rings = base;
+    ring->sq_head = (u32*)(base + params.sq_off.head);
+    ring->sq_tail = (u32*)(base + params.sq_off.tail);
+    ring->sq_mask = (u32*)(base + params.sq_off.ring_mask);
+    ring->sq_array = (u32*)(base + params.sq_off.array);
+    ring->sqes = (io_uring_sqe*)sqes;
+    ring->cq_head = (u32*)(base + params.cq_off.head);
+    ring->cq_tail = (u32*)(base + params.cq_off.tail);
+    ring->cq_mask = (u32*)(base + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(base + params.cq_off.cqes);
+
+    // Pins the buffer once instead of on every read. Plain reads still work
+    // when it's over the locked memory limit or the 1 GB per buffer limit.
+    iovec buffer_iovec = {buffer.data, (size_t)buffer.size};
+    ring->fixed_buffer =
+        buffer.size > 0 &&
+        syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                &buffer_iovec, 1) == 0;
+    return true;
 }
 
-inline usize bit_set_hash(const BitSet* a) {
-    usize hash = 0xcbf29ce484222325;
-    isize bytes = (a->size + 7) / 8;
+inline void io_uring_free(IoUring* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->rings, ring->rings_size);
+    close(ring->fd);
+}
+
+// Queues a read, the caller keeps at most `entries` of them in flight
+inline void io_uring_queue_read(IoUring* ring, int fd, Slice<u8> data,
+                                isize offset, u64 user_data) {
+    u32 tail = *ring->sq_tail;
+    u32 index = tail & *ring->sq_mask;
+    io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = ring->fixed_buffer ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (u64)data.data;
+    sqe->len = (u32)data.size;
+    sqe->off = (u64)offset;
+    sqe->buf_index = 0;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    io_uring_store(ring->sq_tail, tail + 1);
+}
+
+// Reads the pending files of a batch, one chunk per file in flight. Returns
+// false if the ring stopped working, either io_uring_enter failing or reads
+// failing with EINVAL, which is how 5.4 and 5.5 kernels reject
+// IORING_OP_READ. The files not marked done are left to the caller. Reads
+// the kernel already took are reaped before returning, they would
+// otherwise keep writing into the files' memory.
+inline bool file_read_many_uring(IoUring* ring, FileReadMany* many,
+                                 const int* fds, bool* done, isize start,
+                                 isize count) {
+    isize offsets[FILE_READ_MANY_BATCH] = {};
+    auto queue_chunk = [&](isize i) {
+        Slice<u8> data = many->files[start + i].value;
+        isize size = std::min(data.size - offsets[i], FILE_READ_CHUNK_SIZE);
+        io_uring_queue_read(ring, fds[i],
+                            slice_from_parts(data.data + offsets[i], size),
+                            offsets[i], (u64)i);
+    };
 
-    for (isize i = 0; i < bytes; i++) {
-        hash ^= a->data[i];
-        hash *= 0x100000001b3;
-    }
+    isize next = 0;
+    u32 in_flight = 0;
+    bool failed = false;
+    while (true) {
+        while (!failed && next < count && in_flight < ring->entries) {
+            if (!done[next]) {
+                queue_chunk(next);
+                in_flight++;
+            }
+            next++;
+        }
+        if (failed) {
+            // Takes back the reads the kernel hasn't taken yet
+            u32 sq_head = io_uring_load(ring->sq_head);
+            in_flight -= *ring->sq_tail - sq_head;
+            io_uring_store(ring->sq_tail, sq_head);
+        }
+        if (in_flight == 0) {
+            return !failed;
+        }
 
-    return hash;
-}
+        // Everything queued since the kernel last took entries
+        u32 to_submit = *ring->sq_tail - io_uring_load(ring->sq_head);
+        long result = syscall(__NR_io_uring_enter, ring->fd, to_submit, 1,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+        // Busy means completions have to be reaped first
+        if (result < 0 && errno != EINTR && errno != EAGAIN &&
+            errno != EBUSY) {
+            // Completions are still posted without io_uring_enter, keep
+            // polling for them
+            if (failed) {
+                std::this_thread::yield();
+            }
+            failed = true;
+        }
 
-inline bool bit_set_is_empty(const BitSet* a) {
-    isize bytes = (a->size + 7) / 8;
-    for (isize i = 0; i < bytes; i++) {
-        if (a->data[i] != 0) {
-            return false;
+        u32 head = *ring->cq_head;
+        u32 tail = io_uring_load(ring->cq_tail);
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            isize i = (isize)cqe->user_data;
+            Result<Slice<u8>, FileReadError>* file = &many->files[start + i];
+            failed = failed || cqe->res == -EINVAL;
+            bool retry = cqe->res == -EINTR || cqe->res == -EAGAIN;
+            if (retry && !failed) {
+                queue_chunk(i);
+                continue;
+            }
+            // Left for the pread fallback, which starts the file over
+            if (retry || cqe->res == -EINVAL) {
+                in_flight--;
+                continue;
+            }
+            // Zero bytes means the file shrank since it was sized
+            if (cqe->res <= 0) {
+                *file = result_err(FileReadError::ReadError);
+                done[i] = true;
+                in_flight--;
+                continue;
+            }
+            offsets[i] += cqe->res;
+            if (offsets[i] == file->value.size) {
+                done[i] = true;
+                in_flight--;
+            } else if (failed) {
+                in_flight--;
+            } else {
+                queue_chunk(i);
+            }
         }
+        io_uring_store(ring->cq_head, head);
     }
-
-    return true;
 }
+#endif
 
-/// ------------------
-/// STL compat allocator
-/// ------------------
+// Reads every file in `paths`. Files are sized up front, opened
+// FILE_READ_MANY_BATCH at a time and read concurrently. `use_io_uring` is
+// only there to test the fallback. Free with file_read_many_free.
+inline FileReadMany file_read_many(Slice<String> paths, Allocator alloc,
+                                   bool use_io_uring = true) {
+    FileReadMany many;
+    many.alloc = alloc;
+    many.files = slice_make<Result<Slice<u8>, FileReadError>>(paths.size,
+                                                               alloc);
+
+    // Sizes and places every file, errors are final
+    isize total = 0;
+    for (isize i = 0; i < paths.size; i++) {
+        char path_buffer[PATH_MAX];
+        string_to_cstr(paths[i], path_buffer, sizeof(path_buffer));
+        struct stat info;
+        if (stat(path_buffer, &info) != 0) {
+            many.files[i] = result_err(file_read_error_from_errno(errno));
+        } else if (!S_ISREG(info.st_mode)) {
+            many.files[i] = result_err(FileReadError::InvalidFile);
+        } else if (info.st_size > MAX_FILE_SIZE) {
+            many.files[i] = result_err(FileReadError::SizeTooLarge);
+        } else {
+            // Offsets for now, each file starts on a cache line
+            total = (total + 63) & ~(isize)63;
+            many.files[i] = result_ok(
+                slice_from_parts((u8*)total, (isize)info.st_size));
+            total += info.st_size;
+        }
+    }
+    many.memory =
+        slice_from_parts(core_alloc_non_zeroed<u8>(alloc, total), total);
+    for (Result<Slice<u8>, FileReadError>& file : many.files) {
+        if (file.is_ok) {
+            file.value.data = many.memory.data + (isize)file.value.data;
+        }
+    }
 
-template <typename T> struct StlCompatAllocator {
-    using value_type = T;
+#if CORE_IO_URING
+    IoUring ring;
+    bool has_ring = use_io_uring &&
+                    io_uring_init(&ring, FILE_READ_MANY_QUEUE_DEPTH,
+                                  many.memory);
+#else
+    (void)use_io_uring;
+#endif
 
-    Allocator alloc;
+    for (isize start = 0; start < paths.size; start += FILE_READ_MANY_BATCH) {
+        isize count = std::min(paths.size - start, FILE_READ_MANY_BATCH);
+        int fds[FILE_READ_MANY_BATCH];
+        bool done[FILE_READ_MANY_BATCH];
+        for (isize i = 0; i < count; i++) {
+            Result<Slice<u8>, FileReadError>* file = &many.files[start + i];
+            fds[i] = -1;
+            done[i] = !file->is_ok || file->value.size == 0;
+            if (done[i]) {
+                continue;
+            }
 
-    StlCompatAllocator(Allocator alloc) : alloc(alloc) {
-    }
+            char path_buffer[PATH_MAX];
+            string_to_cstr(paths[start + i], path_buffer,
+                           sizeof(path_buffer));
+            fds[i] = open(path_buffer, O_RDONLY | O_CLOEXEC);
+            if (fds[i] < 0) {
+                *file = result_err(file_read_error_from_errno(errno));
+                done[i] = true;
+            }
+        }
 
-    template <typename U>
-    StlCompatAllocator(const StlCompatAllocator<U>& other)
-        : alloc(other.alloc) {
-    }
+#if CORE_IO_URING
+        if (has_ring &&
+            !file_read_many_uring(&ring, &many, fds, done, start, count)) {
+            io_uring_free(&ring);
+            has_ring = false;
+        }
+#endif
+        file_read_many_threads(&many, fds, done, start, count);
 
-    T* allocate(std::size_t n) {
-        return core_alloc<T>(alloc, n);
+        for (isize i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
     }
 
-    void deallocate(T* pointer, std::size_t) {
-        core_free(alloc, pointer);
+#if CORE_IO_URING
+    if (has_ring) {
+        io_uring_free(&ring);
     }
+#endif
+    return many;
+}
 
-    template <typename U>
-    bool operator==(const StlCompatAllocator<U>& other) const {
-        return alloc == other.alloc;
-    }
+inline void file_read_many_free(FileReadMany* many) {
+    core_assert(many != nullptr);
+    core_free(many->alloc, many->memory.data);
+    core_free(many->alloc, many->files.data);
+    many->memory = {};
+    many->files = {};
+}
 
-    template <typename U>
-    bool operator!=(const StlCompatAllocator<U>& other) const {
-        return !(*this == other);
-    }
-};
+#endif
 
 /// ------------------
-/// Hash map
+/// Rope
 /// ------------------
 
-template <typename K, typename V> struct HashMap {
+// Text as a balanced tree of String chunks, for large texts edited in place.
+// Chunks are views, the rope doesn't copy them, so their memory has to
+// outlive it. Leaves hold the chunks and inner nodes their concatenation.
+// The tree is an AVL tree on heights, every edit is a split and a join in
+// O(log n). Nodes come from the allocator, typically an arena; inner nodes
+// dropped by edits are reused.
+
+struct RopeNode {
+    // Both null for leaves
+    RopeNode* left;
+    RopeNode* right;
+    String chunk;
+    isize size;
+    i32 height;
+};
+
+struct Rope {
     Allocator alloc;
-    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
-                       StlCompatAllocator<std::pair<const K, V>>>* backing_map;
+    RopeNode* root;
+    // Linked through `left`
+    RopeNode* free_nodes;
 };
 
-template <typename K, typename V>
-inline void hash_map_init(HashMap<K, V>* hash_map, isize default_size,
-                          Allocator alloc) {
-    hash_map->alloc = alloc;
+// An AVL tree of height 96 has more leaves than fit in memory
+const i32 ROPE_MAX_HEIGHT = 96;
 
-    StlCompatAllocator<K> allocator(alloc);
-    hash_map->backing_map =
-        new (core_alloc<
-             std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
-                                StlCompatAllocator<std::pair<const K, V>>>>(
-            alloc))
-            std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
-                               StlCompatAllocator<std::pair<const K, V>>>(
-                default_size, std::hash<K>(), std::equal_to<K>(), allocator);
+inline void rope_init(Rope* rope, Allocator alloc) {
+    core_assert(rope != nullptr);
+    core_assert(alloc.alloc != nullptr);
+    rope->alloc = alloc;
+    rope->root = nullptr;
+    rope->free_nodes = nullptr;
+}
 
-    core_assert(hash_map->backing_map);
+inline Rope rope_make(Allocator alloc) {
+    Rope rope;
+    rope_init(&rope, alloc);
+    return rope;
 }
 
-template <typename K, typename V>
-inline void hash_map_insert_or_set(HashMap<K, V>* hash_map, K key, V value) {
-    (*hash_map->backing_map)[key] = value;
+inline isize rope_size(const Rope* rope) {
+    return rope->root == nullptr ? 0 : rope->root->size;
 }
 
-template <typename K, typename V>
-inline V hash_map_must_get(HashMap<K, V>* hash_map, K key) {
-    auto it = hash_map->backing_map->find(key);
-    core_assert_msg(it != hash_map->backing_map->end(), "Key not found");
-    return it->second;
+inline i32 rope_node_height(const RopeNode* node) {
+    return node == nullptr ? 0 : node->height;
 }
 
-template <typename K, typename V>
-inline V* hash_map_get_ptr(HashMap<K, V>* hash_map, K key) {
-    auto it = hash_map->backing_map->find(key);
-    if (it == hash_map->backing_map->end()) {
-        return nullptr;
+inline RopeNode* rope_node_alloc(Rope* rope) {
+    RopeNode* node = rope->free_nodes;
+    if (node != nullptr) {
+        rope->free_nodes = node->left;
+        return node;
     }
-
-    return &it->second;
+    return core_alloc<RopeNode>(rope->alloc);
 }
 
-template <typename K, typename V>
-inline void hash_map_remove(HashMap<K, V>* hash_map, K key) {
-    hash_map->backing_map->erase(key);
+inline void rope_node_release(Rope* rope, RopeNode* node) {
+    node->left = rope->free_nodes;
+    rope->free_nodes = node;
 }
 
-/// ----------------
-/// HashSet
-/// ----------------
-
-template <typename T> struct HashSet {
-    Allocator alloc;
-    std::unordered_set<T, std::hash<T>, std::equal_to<T>,
-                       StlCompatAllocator<T>>* backing_set;
-};
-
-template <typename T>
-inline void hash_set_init(HashSet<T>* hash_set, isize default_size,
-                          Allocator alloc) {
-    hash_set->alloc = alloc;
-
-    StlCompatAllocator<T> allocator(alloc);
-    hash_set->backing_set =
-        new (core_alloc<std::unordered_set<T, std::hash<T>, std::equal_to<T>,
-                                           StlCompatAllocator<T>>>(alloc))
-            std::unordered_set<T, std::hash<T>, std::equal_to<T>,
-                               StlCompatAllocator<T>>(
-                default_size, std::hash<T>(), std::equal_to<T>(), allocator);
-
-    core_assert(hash_set->backing_set);
+inline RopeNode* rope_leaf_make(Rope* rope, String chunk) {
+    RopeNode* node = rope_node_alloc(rope);
+    node->left = nullptr;
+    node->right = nullptr;
+    node->chunk = chunk;
+    node->size = chunk.size;
+    node->height = 1;
+    return node;
 }
 
-template <typename T>
-inline HashSet<T> hash_set_make(isize default_size, Arena* arena) {
-    HashSet<T> hash_set = {};
-    hash_set_init(&hash_set, default_size, arena);
-    return hash_set;
+inline void rope_node_update(RopeNode* node) {
+    node->size = node->left->size + node->right->size;
+    node->height = 1 + std::max(node->left->height, node->right->height);
 }
 
-template <typename T>
-inline bool hash_set_insert(HashSet<T>* hash_set, T value) {
-    auto result = hash_set->backing_set->insert(value);
-    return result.second;
+inline RopeNode* rope_inner_make(Rope* rope, RopeNode* left,
+                                 RopeNode* right) {
+    RopeNode* node = rope_node_alloc(rope);
+    node->left = left;
+    node->right = right;
+    node->chunk = {};
+    rope_node_update(node);
+    return node;
 }
 
-template <typename T>
-inline bool hash_set_contains(HashSet<T>* hash_set, T value) {
-    auto it = hash_set->backing_set->find(value);
-    return it != hash_set->backing_set->end();
+inline RopeNode* rope_rotate_left(RopeNode* node) {
+    RopeNode* right = node->right;
+    node->right = right->left;
+    rope_node_update(node);
+    right->left = node;
+    rope_node_update(right);
+    return right;
 }
 
-template <typename T>
-inline const T* hash_set_get_ptr(HashSet<T>* hash_set, T value) {
-    auto it = hash_set->backing_set->find(value);
-    if (it == hash_set->backing_set->end()) {
-        return nullptr;
-    }
-    return &(*it);
+inline RopeNode* rope_rotate_right(RopeNode* node) {
+    RopeNode* left = node->left;
+    node->left = left->right;
+    rope_node_update(node);
+    left->right = node;
+    rope_node_update(left);
+    return left;
 }
 
-template <typename T>
-inline void hash_set_remove(HashSet<T>* hash_set, T value) {
-    hash_set->backing_set->erase(value);
+// Restores the height invariant after one side grew by at most 2
+inline RopeNode* rope_rebalance(RopeNode* node) {
+    rope_node_update(node);
+    i32 balance = node->left->height - node->right->height;
+    if (balance > 1) {
+        if (node->left->left->height < node->left->right->height) {
+            node->left = rope_rotate_left(node->left);
+        }
+        return rope_rotate_right(node);
+    }
+    if (balance < -1) {
+        if (node->right->right->height < node->right->left->height) {
+            node->right = rope_rotate_right(node->right);
+        }
+        return rope_rotate_left(node);
+    }
+    return node;
 }
 
-/// ----------------
-/// Files
-/// ----------------
-
-const isize MAX_FILE_SIZE = 10 * 1024 * 1024 * 1024ll;
-
-#ifndef PATH_MAX
-#define PATH_MAX 4096
-#endif
-
-enum class FileReadError {
-    FileNotFound,
-    PermissionsDenied,
-    SystemError,
-    ReadError,
-    InvalidFile,
-    SizeTooLarge
-};
-
-inline Result<Slice<u8>, FileReadError>
-file_read_full(const String path, Allocator alloc,
-               isize max_allowed_size = MAX_FILE_SIZE) {
+// Concatenates two trees by descending the taller one to the height of the
+// other, O(height difference)
+inline RopeNode* rope_join(Rope* rope, RopeNode* left, RopeNode* right) {
+    if (left == nullptr) {
+        return right;
+    }
+    if (right == nullptr) {
+        return left;
+    }
+    if (left->height > right->height + 1) {
+        left->right = rope_join(rope, left->right, right);
+        return rope_rebalance(left);
+    }
+    if (right->height > left->height + 1) {
+        right->left = rope_join(rope, left, right->left);
+        return rope_rebalance(right);
+    }
+    return rope_inner_make(rope, left, right);
+}
 
-    char path_buffer[PATH_MAX];
-    string_to_cstr(path, path_buffer, sizeof(path_buffer));
+struct RopeSplit {
+    RopeNode* left;
+    RopeNode* right;
+};
 
-    FILE* file = fopen(path_buffer, "rb");
-    if (!file) {
-        switch (errno) {
-        case ENOENT:
-            return result_err(FileReadError::FileNotFound);
-        case EACCES:
-        case EPERM:
-            return result_err(FileReadError::PermissionsDenied);
-        default:
-            return result_err(FileReadError::SystemError);
+// Splits before byte `index`. The joins on the way up cost a telescoping sum
+// of height differences, O(log n) in total.
+inline RopeSplit rope_split_node(Rope* rope, RopeNode* node, isize index) {
+    if (node == nullptr) {
+        return {nullptr, nullptr};
+    }
+    if (index == 0) {
+        return {nullptr, node};
+    }
+    if (index == node->size) {
+        return {node, nullptr};
+    }
+
+    if (node->left == nullptr) {
+        // Inside a chunk, this node keeps the second half
+        String chunk = node->chunk;
+        RopeNode* first = rope_leaf_make(rope, string_substr(chunk, 0, index));
+        node->chunk = string_substr(chunk, index, chunk.size - index);
+        node->size = node->chunk.size;
+        return {first, node};
+    }
+
+    RopeNode* left = node->left;
+    RopeNode* right = node->right;
+    rope_node_release(rope, node);
+    if (index < left->size) {
+        RopeSplit split = rope_split_node(rope, left, index);
+        return {split.left, rope_join(rope, split.right, right)};
+    }
+    if (index > left->size) {
+        RopeSplit split = rope_split_node(rope, right, index - left->size);
+        return {rope_join(rope, left, split.left), split.right};
+    }
+    return {left, right};
+}
+
+inline void rope_release_tree(Rope* rope, RopeNode* node) {
+    if (node == nullptr) {
+        return;
+    }
+    rope_release_tree(rope, node->left);
+    rope_release_tree(rope, node->right);
+    rope_node_release(rope, node);
+}
+
+inline void rope_append(Rope* rope, String str) {
+    core_assert(rope != nullptr);
+    if (str.size == 0) {
+        return;
+    }
+    rope->root = rope_join(rope, rope->root, rope_leaf_make(rope, str));
+}
+
+inline void rope_insert(Rope* rope, isize index, String str) {
+    core_assert(rope != nullptr);
+    core_assert_msg(index >= 0 && index <= rope_size(rope),
+                    "%ld out of [0, %ld]", index, rope_size(rope));
+    if (str.size == 0) {
+        return;
+    }
+    RopeSplit split = rope_split_node(rope, rope->root, index);
+    RopeNode* left = rope_join(rope, split.left, rope_leaf_make(rope, str));
+    rope->root = rope_join(rope, left, split.right);
+}
+
+inline void rope_delete(Rope* rope, isize index, isize count) {
+    core_assert(rope != nullptr);
+    core_assert_msg(index >= 0 && count >= 0 &&
+                        index + count <= rope_size(rope),
+                    "[%ld, %ld) out of [0, %ld)", index, index + count,
+                    rope_size(rope));
+    if (count == 0) {
+        return;
+    }
+    RopeSplit first = rope_split_node(rope, rope->root, index);
+    RopeSplit second = rope_split_node(rope, first.right, count);
+    rope_release_tree(rope, second.left);
+    rope->root = rope_join(rope, first.left, second.right);
+}
+
+// Moves all of `other` to the end of `rope`, both need the same allocator
+inline void rope_concat(Rope* rope, Rope* other) {
+    core_assert(rope != nullptr);
+    core_assert(other != nullptr);
+    core_assert_msg(rope->alloc.alloc == other->alloc.alloc &&
+                        rope->alloc.data == other->alloc.data,
+                    "Ropes use different allocators");
+    rope->root = rope_join(rope, rope->root, other->root);
+    other->root = nullptr;
+}
+
+// Cuts `rope` before `index` and returns the rest as a new rope
+inline Rope rope_split(Rope* rope, isize index) {
+    core_assert(rope != nullptr);
+    core_assert_msg(index >= 0 && index <= rope_size(rope),
+                    "%ld out of [0, %ld]", index, rope_size(rope));
+    RopeSplit split = rope_split_node(rope, rope->root, index);
+    rope->root = split.left;
+    Rope right = rope_make(rope->alloc);
+    right.root = split.right;
+    return right;
+}
+
+inline char rope_get(const Rope* rope, isize index) {
+    core_assert(rope != nullptr);
+    core_assert_msg(index >= 0 && index < rope_size(rope),
+                    "%ld out of [0, %ld)", index, rope_size(rope));
+    const RopeNode* node = rope->root;
+    while (node->left != nullptr) {
+        if (index < node->left->size) {
+            node = node->left;
+        } else {
+            index -= node->left->size;
+            node = node->right;
         }
     }
-    defer(fclose(file));
+    return node->chunk.data[index];
+}
 
-    if (fseek(file, 0, SEEK_END) != 0) {
-        return result_err(FileReadError::InvalidFile);
+inline void rope_free(Rope* rope) {
+    core_assert(rope != nullptr);
+    rope_release_tree(rope, rope->root);
+    rope->root = nullptr;
+    while (rope->free_nodes != nullptr) {
+        RopeNode* next = rope->free_nodes->left;
+        core_free(rope->alloc, rope->free_nodes);
+        rope->free_nodes = next;
     }
+}
 
-    long size = ftell(file);
-    if (size < 0) {
-        return result_err(FileReadError::InvalidFile);
+// Yields the chunks in order
+struct RopeIterator {
+    const RopeNode* stack[ROPE_MAX_HEIGHT];
+    i32 depth;
+};
+
+inline void rope_iter_push_left(RopeIterator* it, const RopeNode* node) {
+    while (node != nullptr) {
+        core_assert(it->depth < ROPE_MAX_HEIGHT);
+        it->stack[it->depth++] = node;
+        node = node->left;
     }
+}
 
-    if (size > max_allowed_size) {
-        return result_err(FileReadError::SizeTooLarge);
+inline RopeIterator rope_chunks(const Rope* rope) {
+    RopeIterator it;
+    it.depth = 0;
+    rope_iter_push_left(&it, rope->root);
+    return it;
+}
+
+inline bool rope_iter_done(const RopeIterator* it) {
+    return it->depth == 0;
+}
+
+inline String rope_iter_next(RopeIterator* it) {
+    core_assert(it != nullptr);
+    core_assert_msg(it->depth > 0, "Iterating past the last chunk");
+
+    // The top is always a leaf, its parents wait for their right side
+    const RopeNode* leaf = it->stack[--it->depth];
+    if (it->depth > 0) {
+        const RopeNode* parent = it->stack[--it->depth];
+        rope_iter_push_left(it, parent->right);
     }
+    return leaf->chunk;
+}
 
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        return result_err(FileReadError::InvalidFile);
+inline String rope_to_string(const Rope* rope, Allocator alloc) {
+    isize size = rope_size(rope);
+    char* data = core_alloc<char>(alloc, size + 1);
+    isize offset = 0;
+    RopeIterator it = rope_chunks(rope);
+    while (!rope_iter_done(&it)) {
+        String chunk = rope_iter_next(&it);
+        memcpy(data + offset, chunk.data, chunk.size);
+        offset += chunk.size;
     }
+    data[size] = '\0';
+    return String{data, size};
+}
 
-    Slice<u8> data;
-    data = slice_make<u8>(size, alloc);
+#if !defined(_WIN32)
+// Chunks per writev call, IOV_MAX on Linux
+const i32 ROPE_WRITEV_BATCH = 1024;
+
+// Writes the whole rope to `fd` without joining the chunks first, returns
+// the number of bytes written
+inline Result<isize, FileWriteError> rope_writev(const Rope* rope, int fd) {
+    core_assert(rope != nullptr);
+    iovec batch[ROPE_WRITEV_BATCH];
+    RopeIterator it = rope_chunks(rope);
+    isize written = 0;
+    while (!rope_iter_done(&it)) {
+        i32 count = 0;
+        while (count < ROPE_WRITEV_BATCH && !rope_iter_done(&it)) {
+            String chunk = rope_iter_next(&it);
+            batch[count++] = iovec{(void*)chunk.data, (size_t)chunk.size};
+        }
 
-    isize bytes_read = 0;
-    while (bytes_read < size) {
-        isize read = fread(data.data + bytes_read, 1, size - bytes_read, file);
-        if (read <= 0) {
-            if (ferror(file)) {
-                return result_err(FileReadError::ReadError);
+        // Continue after partial writes
+        iovec* pending = batch;
+        while (count > 0) {
+            ssize_t result = writev(fd, pending, count);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return result_err(errno == ENOSPC ? FileWriteError::DiskFull
+                                                  : FileWriteError::WriteError);
+            }
+            written += result;
+            while (count > 0 && (size_t)result >= pending->iov_len) {
+                result -= pending->iov_len;
+                pending++;
+                count--;
+            }
+            if (count > 0) {
+                pending->iov_base = (u8*)pending->iov_base + result;
+                pending->iov_len -= result;
             }
-            break;
         }
-        bytes_read += read;
-    }
-
-    if (bytes_read != size) {
-        return result_err(FileReadError::ReadError);
     }
-
-    return result_ok(data);
+    return result_ok(written);
 }
+#endif
 
 /// ----------------
 /// Virtual Memory Ring Buffer
@@ -2330,6 +9729,793 @@ inline void vm_ring_buffer_consume(VMRingBuffer<T>* ring_buffer, isize count) {
     ring_buffer->start_pos += count;
 }
 
+/// ------------------
+/// Decompression
+/// ------------------
+
+// Streams compressed files into a VMRingBuffer, so parsers read plain bytes
+// without a temporary file. The format is detected from the magic bytes and
+// uncompressed files pass through. Each codec is opt in, define
+// CORE_WITH_ZLIB (gzip), CORE_WITH_LZMA (xz) or CORE_WITH_ZSTD and link the
+// library. Decompression can run on its own thread to overlap with parsing.
+// POSIX only.
+#if !defined(_WIN32)
+
+enum class CompressionFormat {
+    None,
+    Gzip,
+    Xz,
+    Zstd,
+};
+
+enum class DecompressError {
+    FileNotFound,
+    PermissionsDenied,
+    SystemError,
+    ReadError,
+    // Detected, but the library for it wasn't compiled in
+    UnsupportedFormat,
+    CorruptData,
+    // The input ended in the middle of a stream
+    TruncatedData,
+};
+
+inline CompressionFormat compression_detect(Slice<u8> header) {
+    auto starts_with = [&](const char* magic, isize size) {
+        return header.size >= size && memcmp(header.data, magic, size) == 0;
+    };
+    if (starts_with("\x1F\x8B", 2)) {
+        return CompressionFormat::Gzip;
+    }
+    if (starts_with("\xFD" "7zXZ\x00", 6)) {
+        return CompressionFormat::Xz;
+    }
+    if (starts_with("\x28\xB5\x2F\xFD", 4)) {
+        return CompressionFormat::Zstd;
+    }
+    return CompressionFormat::None;
+}
+
+// Compressed bytes read from the file at a time
+const isize DECOMPRESS_INPUT_SIZE = 1024 * 1024;
+
+// Pull decompressor over a file descriptor
+struct DecompressStream {
+    Allocator alloc;
+    CompressionFormat format;
+    int fd;
+    u8* input;
+    isize input_size;
+    isize input_pos;
+    bool input_done;
+    bool finished;
+#if defined(CORE_WITH_ZLIB)
+    z_stream zlib;
+#endif
+#if defined(CORE_WITH_LZMA)
+    lzma_stream lzma;
+#endif
+#if defined(CORE_WITH_ZSTD)
+    ZSTD_DStream* zstd;
+    // Result of the last call that made progress, 0 at the end of a frame
+    size_t zstd_hint;
+#endif
+};
+
+inline bool decompress_stream_refill(DecompressStream* stream) {
+    while (true) {
+        ssize_t read_size =
+            read(stream->fd, stream->input, DECOMPRESS_INPUT_SIZE);
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size < 0) {
+            return false;
+        }
+        stream->input_size = read_size;
+        stream->input_pos = 0;
+        stream->input_done = read_size == 0;
+        return true;
+    }
+}
+
+// Takes ownership of `fd`, even on errors
+inline Result<CompressionFormat, DecompressError>
+decompress_stream_init(DecompressStream* stream, int fd, Allocator alloc) {
+    *stream = {};
+    stream->alloc = alloc;
+    stream->fd = fd;
+    stream->input = core_alloc_non_zeroed<u8>(alloc, DECOMPRESS_INPUT_SIZE);
+    if (!decompress_stream_refill(stream)) {
+        return result_err(DecompressError::ReadError);
+    }
+
+    Slice<u8> header = slice_from_parts(stream->input, stream->input_size);
+    stream->format = compression_detect(header);
+    switch (stream->format) {
+    case CompressionFormat::None:
+        break;
+    case CompressionFormat::Gzip:
+#if defined(CORE_WITH_ZLIB)
+        // 32 adds automatic gzip or zlib header detection
+        if (inflateInit2(&stream->zlib, 15 + 32) != Z_OK) {
+            return result_err(DecompressError::SystemError);
+        }
+        break;
+#else
+        return result_err(DecompressError::UnsupportedFormat);
+#endif
+    case CompressionFormat::Xz:
+#if defined(CORE_WITH_LZMA)
+        stream->lzma = LZMA_STREAM_INIT;
+        if (lzma_stream_decoder(&stream->lzma, UINT64_MAX,
+                                LZMA_CONCATENATED) != LZMA_OK) {
+            return result_err(DecompressError::SystemError);
+        }
+        break;
+#else
+        return result_err(DecompressError::UnsupportedFormat);
+#endif
+    case CompressionFormat::Zstd:
+#if defined(CORE_WITH_ZSTD)
+        stream->zstd = ZSTD_createDStream();
+        if (stream->zstd == nullptr) {
+            return result_err(DecompressError::SystemError);
+        }
+        break;
+#else
+        return result_err(DecompressError::UnsupportedFormat);
+#endif
+    }
+    return result_ok(stream->format);
+}
+
+inline void decompress_stream_free(DecompressStream* stream) {
+    // Codecs are only set up when their format was detected
+    switch (stream->format) {
+    case CompressionFormat::None:
+        break;
+    case CompressionFormat::Gzip:
+#if defined(CORE_WITH_ZLIB)
+        inflateEnd(&stream->zlib);
+#endif
+        break;
+    case CompressionFormat::Xz:
+#if defined(CORE_WITH_LZMA)
+        lzma_end(&stream->lzma);
+#endif
+        break;
+    case CompressionFormat::Zstd:
+#if defined(CORE_WITH_ZSTD)
+        ZSTD_freeDStream(stream->zstd);
+#endif
+        break;
+    }
+    core_free(stream->alloc, stream->input);
+    close(stream->fd);
+    *stream = {};
+    stream->fd = -1;
+}
+
+// Decompresses into `out` until it's full or the stream ends, returns the
+// number of bytes written, 0 once everything was read
+inline Result<isize, DecompressError>
+decompress_stream_read(DecompressStream* stream, Slice<u8> out) {
+    isize produced = 0;
+    while (produced < out.size && !stream->finished) {
+        if (stream->input_pos == stream->input_size && !stream->input_done &&
+            !decompress_stream_refill(stream)) {
+            return result_err(DecompressError::ReadError);
+        }
+        u8* input = stream->input + stream->input_pos;
+        isize input_size = stream->input_size - stream->input_pos;
+        u8* output = out.data + produced;
+        isize output_size = out.size - produced;
+
+        switch (stream->format) {
+        case CompressionFormat::None: {
+            if (stream->input_done) {
+                stream->finished = true;
+                break;
+            }
+            isize size = std::min(input_size, output_size);
+            memcpy(output, input, size);
+            stream->input_pos += size;
+            produced += size;
+            break;
+        }
+        case CompressionFormat::Gzip: {
+#if defined(CORE_WITH_ZLIB)
+            z_stream* zlib = &stream->zlib;
+            zlib->next_in = input;
+            zlib->avail_in = (uInt)input_size;
+            zlib->next_out = output;
+            zlib->avail_out = (uInt)std::min(output_size, (isize)1 << 30);
+            uInt avail_out = zlib->avail_out;
+            int result = inflate(zlib, Z_NO_FLUSH);
+            stream->input_pos += input_size - zlib->avail_in;
+            produced += avail_out - zlib->avail_out;
+            if (result == Z_STREAM_END) {
+                // Another gzip member may follow, e.g. from pigz
+                if (stream->input_pos == stream->input_size &&
+                    !stream->input_done && !decompress_stream_refill(stream)) {
+                    return result_err(DecompressError::ReadError);
+                }
+                if (stream->input_pos == stream->input_size) {
+                    stream->finished = true;
+                } else {
+                    inflateReset(zlib);
+                }
+            } else if (result == Z_BUF_ERROR) {
+                // No progress, fine unless no more input is coming
+                if (stream->input_done) {
+                    return result_err(DecompressError::TruncatedData);
+                }
+            } else if (result != Z_OK) {
+                return result_err(DecompressError::CorruptData);
+            }
+#endif
+            break;
+        }
+        case CompressionFormat::Xz: {
+#if defined(CORE_WITH_LZMA)
+            lzma_stream* lzma = &stream->lzma;
+            lzma->next_in = input;
+            lzma->avail_in = input_size;
+            lzma->next_out = output;
+            lzma->avail_out = output_size;
+            lzma_ret result = lzma_code(
+                lzma, stream->input_done ? LZMA_FINISH : LZMA_RUN);
+            stream->input_pos += input_size - lzma->avail_in;
+            produced += output_size - lzma->avail_out;
+            if (result == LZMA_STREAM_END) {
+                stream->finished = true;
+            } else if (result == LZMA_BUF_ERROR) {
+                return result_err(DecompressError::TruncatedData);
+            } else if (result != LZMA_OK) {
+                return result_err(DecompressError::CorruptData);
+            }
+#endif
+            break;
+        }
+        case CompressionFormat::Zstd: {
+#if defined(CORE_WITH_ZSTD)
+            ZSTD_inBuffer in = {input, (size_t)input_size, 0};
+            ZSTD_outBuffer zstd_out = {output, (size_t)output_size, 0};
+            size_t result = ZSTD_decompressStream(stream->zstd, &zstd_out, &in);
+            if (ZSTD_isError(result)) {
+                return result_err(DecompressError::CorruptData);
+            }
+            stream->input_pos += in.pos;
+            produced += zstd_out.pos;
+            if (in.pos > 0 || zstd_out.pos > 0) {
+                stream->zstd_hint = result;
+            }
+            // At the end of the input it flushes until there's no progress,
+            // then the last frame has to be complete
+            if (stream->input_done && zstd_out.pos == 0) {
+                if (stream->zstd_hint != 0) {
+                    return result_err(DecompressError::TruncatedData);
+                }
+                stream->finished = true;
+            }
+#endif
+            break;
+        }
+        }
+    }
+    return result_ok(produced);
+}
+
+// Decompressed bytes published at a time, smaller means the consumer gets
+// data sooner, larger means fewer locks
+const isize DECOMPRESS_CHUNK_SIZE = 256 * 1024;
+
+struct DecompressOptions {
+    // Power of two multiple of the page size
+    isize buffer_size = 16 * 1024 * 1024;
+    bool threaded = true;
+};
+
+// Decompressed contents of a file, read through decompress_reader_fill and
+// decompress_reader_consume. With a thread the producer writes past the end
+// of the readable bytes while the consumer reads them, positions are only
+// touched under the mutex.
+struct DecompressReader {
+    Allocator alloc;
+    DecompressStream stream;
+    VMRingBuffer<u8> buffer;
+    bool threaded;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done;
+    bool stop;
+    bool has_error;
+    DecompressError error;
+};
+
+// Decompresses one chunk into the free space. Locks when threaded.
+inline bool decompress_reader_produce(DecompressReader* reader) {
+    std::unique_lock<std::mutex> lock(reader->mutex, std::defer_lock);
+    if (reader->threaded) {
+        lock.lock();
+        reader->changed.wait(lock, [&]() {
+            return reader->stop ||
+                   vm_ring_buffer_size(&reader->buffer) <
+                       reader->buffer.capacity;
+        });
+        if (reader->stop) {
+            return false;
+        }
+    }
+    Slice<u8> free_space = vm_ring_buffer_writable_slice(&reader->buffer);
+    free_space.size = std::min(free_space.size, DECOMPRESS_CHUNK_SIZE);
+    if (reader->threaded) {
+        lock.unlock();
+    }
+
+    Result<isize, DecompressError> result =
+        decompress_stream_read(&reader->stream, free_space);
+
+    if (reader->threaded) {
+        lock.lock();
+    }
+    if (!result.is_ok) {
+        reader->has_error = true;
+        reader->error = result.error;
+        reader->done = true;
+    } else if (result.value == 0) {
+        reader->done = true;
+    } else {
+        vm_ring_buffer_advance_end(&reader->buffer, result.value);
+    }
+    if (reader->threaded) {
+        reader->changed.notify_all();
+    }
+    return !reader->done;
+}
+
+inline Result<DecompressReader*, DecompressError>
+decompress_reader_open(String path, Allocator alloc,
+                       DecompressOptions options = {}) {
+    char path_buffer[PATH_MAX];
+    string_to_cstr(path, path_buffer, sizeof(path_buffer));
+    int fd = open(path_buffer, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        switch (file_read_error_from_errno(errno)) {
+        case FileReadError::FileNotFound:
+            return result_err(DecompressError::FileNotFound);
+        case FileReadError::PermissionsDenied:
+            return result_err(DecompressError::PermissionsDenied);
+        default:
+            return result_err(DecompressError::SystemError);
+        }
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    DecompressReader* reader = new (core_alloc<DecompressReader>(alloc))
+        DecompressReader();
+    reader->alloc = alloc;
+    Result<CompressionFormat, DecompressError> format =
+        decompress_stream_init(&reader->stream, fd, alloc);
+    if (!format.is_ok) {
+        decompress_stream_free(&reader->stream);
+        reader->~DecompressReader();
+        core_free(alloc, reader);
+        return result_err(format.error);
+    }
+
+    vm_ring_buffer_init(&reader->buffer, options.buffer_size);
+    reader->threaded = options.threaded;
+    if (reader->threaded) {
+        reader->thread = std::thread([reader]() {
+            while (decompress_reader_produce(reader)) {
+            }
+        });
+    }
+    return result_ok(reader);
+}
+
+inline CompressionFormat decompress_reader_format(DecompressReader* reader) {
+    return reader->stream.format;
+}
+
+// Waits until at least `min_size` bytes are readable or the file ended and
+// returns all readable bytes, contiguous even across the end of the ring.
+// Empty once everything was consumed. Errors are reported after the bytes
+// decompressed before them.
+inline Result<Slice<u8>, DecompressError>
+decompress_reader_fill(DecompressReader* reader, isize min_size = 1) {
+    core_assert(reader != nullptr);
+    core_assert_msg(min_size >= 0 && min_size <= reader->buffer.capacity,
+                    "%ld out of [0, %ld]", min_size, reader->buffer.capacity);
+
+    std::unique_lock<std::mutex> lock(reader->mutex, std::defer_lock);
+    if (reader->threaded) {
+        lock.lock();
+        reader->changed.wait(lock, [&]() {
+            return reader->done ||
+                   vm_ring_buffer_size(&reader->buffer) >= min_size;
+        });
+    } else {
+        while (!reader->done &&
+               vm_ring_buffer_size(&reader->buffer) < min_size) {
+            decompress_reader_produce(reader);
+        }
+    }
+
+    // The producer only writes past the readable bytes
+    Slice<u8> readable = vm_ring_buffer_readable_slice(&reader->buffer);
+    if (readable.size == 0 && reader->has_error) {
+        return result_err(reader->error);
+    }
+    return result_ok(readable);
+}
+
+inline void decompress_reader_consume(DecompressReader* reader, isize count) {
+    core_assert(reader != nullptr);
+    std::lock_guard<std::mutex> lock(reader->mutex);
+    vm_ring_buffer_consume(&reader->buffer, count);
+    if (reader->threaded) {
+        reader->changed.notify_all();
+    }
+}
+
+inline void decompress_reader_close(DecompressReader* reader) {
+    core_assert(reader != nullptr);
+    if (reader->threaded) {
+        {
+            std::lock_guard<std::mutex> lock(reader->mutex);
+            reader->stop = true;
+        }
+        reader->changed.notify_all();
+        reader->thread.join();
+    }
+    decompress_stream_free(&reader->stream);
+    vm_ring_buffer_free(&reader->buffer);
+    Allocator alloc = reader->alloc;
+    reader->~DecompressReader();
+    core_free(alloc, reader);
+}
+
+#endif
+
+/// ------------------
+/// DIMACS CNF
+/// ------------------
+
+// Parser for SAT problems in the DIMACS CNF format:
+//   c a comment
+//   p cnf <variables> <clauses>
+//   1 -3 0
+//   2 3 -1 0
+// Clauses end with 0 and may span lines, a line starting with % ends the
+// input (SATLIB files have one). Literals go into one flat array, clause i is
+// literals[clause_offsets[i], clause_offsets[i + 1]).
+//
+// Whitespace of 64 byte blocks is classified with SIMD, the bit mask gives
+// the token starts and each token is parsed with the SWAR digit parser.
+// Input can be fed in chunks, e.g. from a DecompressReader.
+struct CnfFormula {
+    i32 variable_count;
+    i32 clause_count;
+    Array<i32> literals;
+    // clause_count + 1 entries, starting at 0
+    Array<isize> clause_offsets;
+};
+
+enum class DimacsErrorKind {
+    MissingHeader,
+    InvalidHeader,
+    InvalidLiteral,
+    VariableOutOfRange,
+    UnterminatedClause,
+    ClauseCountMismatch,
+    LineTooLong,
+    ReadError,
+};
+
+struct DimacsError {
+    DimacsErrorKind kind;
+    // Byte offset in the whole input
+    isize offset;
+};
+
+struct DimacsParser {
+    CnfFormula formula;
+    ByteSet whitespace;
+    bool has_header;
+    bool ended;
+    // Bytes consumed by earlier chunks, for error offsets
+    isize offset;
+};
+
+inline Slice<i32> cnf_clause(const CnfFormula* formula, isize index) {
+    const isize* offsets = formula->clause_offsets.items.data;
+    core_assert_msg(index >= 0 &&
+                        index < formula->clause_offsets.items.size - 1,
+                    "%ld out of [0, %ld)", index,
+                    formula->clause_offsets.items.size - 1);
+    isize start = offsets[index];
+    isize end = offsets[index + 1];
+    return slice_from_parts(formula->literals.items.data + start, end - start);
+}
+
+inline void cnf_formula_free(CnfFormula* formula) {
+    // Formulas handed over by dimacs_parser_finish leave an empty one behind
+    if (formula->literals.items.data != nullptr) {
+        core_free(formula->literals.alloc, formula->literals.items.data);
+        core_free(formula->clause_offsets.alloc,
+                  formula->clause_offsets.items.data);
+    }
+    *formula = {};
+}
+
+inline void dimacs_parser_init(DimacsParser* parser, Allocator alloc) {
+    core_assert(parser != nullptr);
+    *parser = {};
+    parser->whitespace = byte_set_make(string_from_cstr(" \t\n\r\v\f"));
+    array_init(&parser->formula.literals, alloc, 1024);
+    array_init(&parser->formula.clause_offsets, alloc, 256);
+    array_push(&parser->formula.clause_offsets, (isize)0);
+}
+
+inline u64 dimacs_whitespace_mask(const DimacsParser* parser,
+                                  const u8* data) {
+#if CORE_X86_SIMD
+    if (cpu_has_feature(CpuFeature::Avx2)) {
+        return string_delimiters_mask_avx2(data, &parser->whitespace);
+    }
+#endif
+    return string_delimiters_mask_scalar(data, &parser->whitespace);
+}
+
+inline const u8* dimacs_skip_line(const u8* p, const u8* end) {
+    const u8* newline = (const u8*)memchr(p, '\n', end - p);
+    return newline == nullptr ? end : newline + 1;
+}
+
+inline const u8* dimacs_skip_blanks(const u8* p, const u8* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// "p cnf <variables> <clauses>", `p` points after the 'p'
+inline bool dimacs_parse_header(DimacsParser* parser, const u8** cursor,
+                                const u8* end) {
+    const u8* p = dimacs_skip_blanks(*cursor, end);
+    if (end - p < 3 || memcmp(p, "cnf", 3) != 0) {
+        return false;
+    }
+    p += 3;
+    i64 counts[2];
+    for (i64& count : counts) {
+        p = dimacs_skip_blanks(p, end);
+        String rest = string_from_parts((const char*)p, end - p);
+        Result<i64, ParseError> value = string_parse_i64(&rest);
+        if (!value.is_ok || value.value < 0 || value.value > INT32_MAX) {
+            return false;
+        }
+        count = value.value;
+        p = (const u8*)rest.data;
+    }
+    p = dimacs_skip_blanks(p, end);
+    if (p < end && *p != '\n' && *p != '\r') {
+        return false;
+    }
+    parser->formula.variable_count = (i32)counts[0];
+    parser->formula.clause_count = (i32)counts[1];
+    parser->has_header = true;
+    *cursor = p;
+    return true;
+}
+
+// Parses the literal at `p`, which starts with a digit or '-'. Returns null
+// on errors.
+inline const u8* dimacs_parse_literal(DimacsParser* parser, const u8* p,
+                                      const u8* end, DimacsErrorKind* error) {
+    const u8* start = p;
+    bool negative = *p == '-';
+    p += negative;
+    u64 value = parse_digits(&p, end, 0);
+    isize digits = p - start - negative;
+    // Also rejects "-" alone, "12abc" and numbers too long for an i32
+    if (digits == 0 || digits > 10 ||
+        (p < end && !byte_set_contains(&parser->whitespace, *p))) {
+        *error = DimacsErrorKind::InvalidLiteral;
+        return nullptr;
+    }
+    if (value > (u64)parser->formula.variable_count) {
+        *error = DimacsErrorKind::VariableOutOfRange;
+        return nullptr;
+    }
+
+    Slice<i32>* literals = &parser->formula.literals.items;
+    if (value == 0) {
+        Slice<isize>* offsets = &parser->formula.clause_offsets.items;
+        offsets->data[offsets->size++] = literals->size;
+    } else {
+        literals->data[literals->size++] =
+            negative ? -(i32)value : (i32)value;
+    }
+    return p;
+}
+
+// Parses [data, end), which has to end after a token
+inline Result<isize, DimacsError>
+dimacs_parse_range(DimacsParser* parser, const u8* data, const u8* end) {
+    const u8* p = data;
+    // Whether the byte before `p` is whitespace, the start counts as one
+    u64 carry = 1;
+    CnfFormula* formula = &parser->formula;
+    DimacsErrorKind error_kind = DimacsErrorKind::InvalidLiteral;
+    auto error = [&](DimacsErrorKind kind,
+                     const u8* at) -> Result<isize, DimacsError> {
+        return result_err((DimacsError{kind, parser->offset + (at - data)}));
+    };
+
+    while (p < end && !parser->ended) {
+        // Blocks past the end are padded with whitespace
+        u8 padded[64];
+        const u8* block = p;
+        if (end - p < 64) {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, p, end - p);
+            block = padded;
+        }
+        u64 whitespace = dimacs_whitespace_mask(parser, block);
+        u64 starts = ~whitespace & ((whitespace << 1) | carry);
+        carry = whitespace >> 63;
+
+        // At most 32 tokens start in 64 bytes
+        array_reserve(&formula->literals, 32);
+        array_reserve(&formula->clause_offsets, 32);
+
+        const u8* block_end = p + 64;
+        while (starts != 0) {
+            const u8* token = p + ctz64(starts);
+            starts &= starts - 1;
+            u8 c = *token;
+            if (parse_is_digit(c) || c == '-') {
+                if (!parser->has_header) {
+                    return error(DimacsErrorKind::MissingHeader, token);
+                }
+                if (dimacs_parse_literal(parser, token, end, &error_kind) ==
+                    nullptr) {
+                    return error(error_kind, token);
+                }
+                continue;
+            }
+
+            // Rare lines handled by restarting the blocks after them
+            const u8* next = token;
+            if (c == 'c') {
+                next = dimacs_skip_line(token, end);
+            } else if (c == 'p' && !parser->has_header) {
+                next = token + 1;
+                if (!dimacs_parse_header(parser, &next, end)) {
+                    return error(DimacsErrorKind::InvalidHeader, token);
+                }
+            } else if (c == '%') {
+                parser->ended = true;
+                next = end;
+            } else {
+                return error(c == 'p' ? DimacsErrorKind::InvalidHeader
+                                      : DimacsErrorKind::InvalidLiteral,
+                             token);
+            }
+            // Whatever ended the line or header is whitespace
+            block_end = next;
+            carry = 1;
+            break;
+        }
+        p = std::min(block_end, end);
+    }
+    return result_ok((isize)(end - data));
+}
+
+// Parses the complete lines of `chunk` and returns how many bytes that was,
+// the rest has to be fed again with more data. Set `last` for the final
+// chunk, which is parsed completely.
+inline Result<isize, DimacsError>
+dimacs_parser_feed(DimacsParser* parser, Slice<u8> chunk, bool last) {
+    core_assert(parser != nullptr);
+    isize size = chunk.size;
+    if (!last) {
+        while (size > 0 && chunk.data[size - 1] != '\n') {
+            size--;
+        }
+    }
+    Result<isize, DimacsError> result =
+        dimacs_parse_range(parser, chunk.data, chunk.data + size);
+    parser->offset += size;
+    return result;
+}
+
+// Checks the parsed clauses against the header and hands over the formula
+inline Result<CnfFormula, DimacsError>
+dimacs_parser_finish(DimacsParser* parser) {
+    core_assert(parser != nullptr);
+    CnfFormula formula = parser->formula;
+    Slice<isize> offsets = formula.clause_offsets.items;
+    DimacsError error = {DimacsErrorKind::MissingHeader, parser->offset};
+    if (!parser->has_header) {
+        error.kind = DimacsErrorKind::MissingHeader;
+    } else if (formula.literals.items.size != offsets.data[offsets.size - 1]) {
+        error.kind = DimacsErrorKind::UnterminatedClause;
+    } else if (offsets.size - 1 != formula.clause_count) {
+        error.kind = DimacsErrorKind::ClauseCountMismatch;
+    } else {
+        parser->formula = {};
+        return result_ok(formula);
+    }
+    cnf_formula_free(&parser->formula);
+    return result_err(error);
+}
+
+inline void dimacs_parser_free(DimacsParser* parser) {
+    cnf_formula_free(&parser->formula);
+}
+
+// Parses a whole file in memory, e.g. from file_read_full or file_map
+inline Result<CnfFormula, DimacsError> dimacs_parse(Slice<u8> data,
+                                                    Allocator alloc) {
+    DimacsParser parser;
+    dimacs_parser_init(&parser, alloc);
+    Result<isize, DimacsError> result = dimacs_parser_feed(&parser, data, true);
+    if (!result.is_ok) {
+        dimacs_parser_free(&parser);
+        return result_err(result.error);
+    }
+    return dimacs_parser_finish(&parser);
+}
+
+#if !defined(_WIN32)
+// Parses while the reader decompresses, lines have to fit into its buffer
+inline Result<CnfFormula, DimacsError>
+dimacs_parse_reader(DecompressReader* reader, Allocator alloc) {
+    DimacsParser parser;
+    dimacs_parser_init(&parser, alloc);
+    isize min_size = 1;
+    while (true) {
+        Result<Slice<u8>, DecompressError> data =
+            decompress_reader_fill(reader, min_size);
+        if (!data.is_ok) {
+            dimacs_parser_free(&parser);
+            return result_err(
+                (DimacsError{DimacsErrorKind::ReadError, parser.offset}));
+        }
+        // Less than asked for only happens at the end
+        bool last = data.value.size < min_size;
+        Result<isize, DimacsError> consumed =
+            dimacs_parser_feed(&parser, data.value, last);
+        if (!consumed.is_ok) {
+            dimacs_parser_free(&parser);
+            return result_err(consumed.error);
+        }
+        decompress_reader_consume(reader, consumed.value);
+        if (last) {
+            break;
+        }
+
+        // Without a complete line wait for more bytes than are there
+        isize left = data.value.size - consumed.value;
+        min_size = consumed.value == 0 ? left + 1 : 1;
+        if (min_size > reader->buffer.capacity) {
+            dimacs_parser_free(&parser);
+            return result_err(
+                (DimacsError{DimacsErrorKind::LineTooLong, parser.offset}));
+        }
+    }
+    return dimacs_parser_finish(&parser);
+}
+#endif
+
 /// ------------------
 /// Matrices
 /// ------------------
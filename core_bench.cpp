@@ -0,0 +1,1595 @@
+#include "core.hpp"
+#include <chrono>
+
+// Simple benchmark runner. Usage: core_bench [filter]
+// Only benchmarks whose name contains `filter` are run.
+
+static volatile isize bench_sink = 0;
+
+inline f64 bench_now_seconds() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<f64>(now).count();
+}
+
+// Runs `f` repeatedly for at least `min_seconds` and returns the average time
+// of a single call in seconds.
+template <typename F> inline f64 bench_run(F f, f64 min_seconds = 0.2) {
+    // Warm up caches and page in the memory
+    f();
+
+    isize iterations = 0;
+    f64 start = bench_now_seconds();
+    f64 elapsed = 0;
+    do {
+        f();
+        iterations += 1;
+        elapsed = bench_now_seconds() - start;
+    } while (elapsed < min_seconds);
+
+    return elapsed / (f64)iterations;
+}
+
+inline void bench_report(const char* name, const char* variant, isize size,
+                         f64 seconds, f64 bytes) {
+    printf("%-28s %-10s %12ld %12.3f us %10.2f GB/s\n", name, variant, size,
+           seconds * 1e6, bytes / seconds / 1e9);
+}
+
+struct BenchVariant {
+    const char* name;
+    u32 features;
+};
+
+inline Slice<BenchVariant> bench_cpu_variants() {
+    static BenchVariant variants[4];
+    static isize count = []() {
+        // Only list variants the CPU supports, so a label never names a
+        // code path that was not actually run
+        u32 detected = cpu_detect_features();
+        BenchVariant candidates[] = {
+            {"scalar", 0},
+            {"popcnt", (u32)CpuFeature::Popcnt},
+            {"avx2", (u32)CpuFeature::Popcnt | (u32)CpuFeature::Avx2},
+            {"avx512", detected & (u32)CpuFeature::Avx512 ? detected : ~0u},
+        };
+        isize n = 0;
+        for (BenchVariant variant : candidates) {
+            if ((variant.features & detected) == variant.features) {
+                variants[n++] = variant;
+            }
+        }
+        return n;
+    }();
+    return slice_from_parts(variants, count);
+}
+
+inline u64 bench_random_u64(u64* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void bench_bit_set() {
+    isize sizes[] = {
+        1024, 32 * 1024, 1024 * 1024, 32 * 1024 * 1024, 1024 * 1024 * 1024,
+    };
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    for (isize size : sizes) {
+        BitSet a = bit_set_make(size, c_allocator());
+        BitSet b = bit_set_make(size, c_allocator());
+        defer(core_free(c_allocator(), a.data));
+        defer(core_free(c_allocator(), b.data));
+
+        u64 state = 0x9E3779B97F4A7C15;
+        isize words = bit_set_word_count(size);
+        for (isize i = 0; i < words; i++) {
+            a.data[i] = bench_random_u64(&state);
+            b.data[i] = bench_random_u64(&state);
+        }
+        // Disjoint from `b`, so intersects has to scan everything
+        BitSet not_b = bit_set_clone(&b, c_allocator());
+        defer(core_free(c_allocator(), not_b.data));
+        bit_set_not(&not_b);
+
+        f64 bytes = (f64)words * sizeof(u64);
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features) {
+                continue;
+            }
+
+            f64 t = bench_run([&]() { bit_set_and(&a, &b); });
+            bench_report("bit_set_and", variant.name, size, t, bytes * 2);
+            t = bench_run([&]() { bit_set_or(&a, &b); });
+            bench_report("bit_set_or", variant.name, size, t, bytes * 2);
+            t = bench_run([&]() { bit_set_xor(&a, &b); });
+            bench_report("bit_set_xor", variant.name, size, t, bytes * 2);
+            t = bench_run([&]() { bit_set_andnot(&a, &b); });
+            bench_report("bit_set_andnot", variant.name, size, t, bytes * 2);
+            t = bench_run([&]() { bit_set_not(&a); });
+            bench_report("bit_set_not", variant.name, size, t, bytes);
+            t = bench_run([&]() { bench_sink = bit_set_count(&b); });
+            bench_report("bit_set_count", variant.name, size, t, bytes);
+            t = bench_run([&]() { bench_sink = bit_set_and_count(&a, &b); });
+            bench_report("bit_set_and_count", variant.name, size, t,
+                         bytes * 2);
+            t = bench_run(
+                [&]() { bench_sink = bit_set_intersects(&b, &not_b); });
+            bench_report("bit_set_intersects", variant.name, size, t,
+                         bytes * 2);
+        }
+    }
+}
+
+static void bench_rank_select() {
+    isize sizes[] = {32 * 1024, 32 * 1024 * 1024, 1024 * 1024 * 1024};
+    const isize queries = 1024;
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    for (isize size : sizes) {
+        BitSet bits = bit_set_make(size, c_allocator());
+        defer(core_free(c_allocator(), bits.data));
+
+        u64 state = 0x9E3779B97F4A7C15;
+        isize words = bit_set_word_count(size);
+        for (isize i = 0; i < words; i++) {
+            bits.data[i] = bench_random_u64(&state);
+        }
+
+        RankSelect rs = rank_select_make(&bits, c_allocator());
+        defer(rank_select_free(&rs));
+
+        isize positions[queries];
+        isize ranks[queries];
+        for (isize i = 0; i < queries; i++) {
+            positions[i] = (isize)(bench_random_u64(&state) % size);
+            ranks[i] = (isize)(bench_random_u64(&state) % rs.ones);
+        }
+
+        f64 t = bench_run([&]() {
+            RankSelect index = rank_select_make(&bits, c_allocator());
+            rank_select_free(&index);
+        });
+        bench_report("rank_select_make", "", size, t,
+                     (f64)words * sizeof(u64));
+
+        // Reported bandwidth is meaningless for queries, time is per query
+        t = bench_run([&]() {
+            isize sum = 0;
+            for (isize i = 0; i < queries; i++) {
+                sum += rank_select_rank(&rs, positions[i]);
+            }
+            bench_sink = sum;
+        });
+        bench_report("rank_select_rank", "", size, t / queries, 0);
+
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features) {
+                continue;
+            }
+            t = bench_run([&]() {
+                isize sum = 0;
+                for (isize i = 0; i < queries; i++) {
+                    sum += rank_select_select(&rs, ranks[i]);
+                }
+                bench_sink = sum;
+            });
+            bench_report("rank_select_select", variant.name, size,
+                         t / queries, 0);
+        }
+    }
+}
+
+static void bench_bit_matrix() {
+    struct Shape {
+        isize rows;
+        isize cols;
+    };
+    Shape shapes[] = {{256, 64 * 1024}, {2048, 8 * 1024}, {8192, 8192}};
+
+    for (Shape shape : shapes) {
+        BitMatrix matrix =
+            bit_matrix_make(shape.rows, shape.cols, c_allocator());
+        defer(core_free(c_allocator(), matrix.data));
+
+        u64 state = 0x9E3779B97F4A7C15;
+        for (isize row = 0; row < shape.rows; row++) {
+            BitSet view = bit_matrix_row(&matrix, row);
+            for (isize i = 0; i < bit_set_word_count(shape.cols); i++) {
+                view.data[i] = bench_random_u64(&state);
+            }
+        }
+
+        f64 bytes = (f64)shape.rows * matrix.stride * sizeof(u64);
+        f64 t = bench_run([&]() {
+            BitMatrix transposed = bit_matrix_transpose(&matrix, c_allocator());
+            core_free(c_allocator(), transposed.data);
+        });
+        bench_report("bit_matrix_transpose", "", shape.rows * shape.cols, t,
+                     bytes * 2);
+
+        // Every pair reads both rows, bandwidth is reported for that traffic
+        if (shape.rows <= 2048) {
+            t = bench_run([&]() {
+                Slice<u32> counts =
+                    bit_matrix_intersection_counts(&matrix, c_allocator());
+                core_free(c_allocator(), counts.data);
+            });
+            f64 pairs = (f64)shape.rows * (shape.rows + 1) / 2;
+            bench_report("bit_matrix_intersection", "",
+                         shape.rows * shape.cols, t,
+                         pairs * matrix.stride * sizeof(u64) * 2);
+        }
+    }
+}
+
+static void bench_bloom() {
+    const isize keys = 1024 * 1024;
+    Slice<u64> hashes = slice_make<u64>(keys, c_allocator());
+    defer(core_free(c_allocator(), hashes.data));
+    Slice<u64> queries = slice_make<u64>(keys, c_allocator());
+    defer(core_free(c_allocator(), queries.data));
+    Slice<bool> results = slice_make<bool>(keys, c_allocator());
+    defer(core_free(c_allocator(), results.data));
+    for (isize i = 0; i < keys; i++) {
+        hashes[i] = hash_u64(i);
+        queries[i] = hash_u64(keys + i);
+    }
+
+    printf("%-12s %6s %14s %14s %14s\n", "bits/key", "k", "fp rate",
+           "ns/lookup", "ns/batch");
+    f64 bits_per_key[] = {4, 6, 8, 10, 12, 16, 20};
+    for (f64 bpk : bits_per_key) {
+        BloomFilter filter = bloom_make(keys, bpk, c_allocator());
+        defer(bloom_free(&filter));
+        bloom_add_batch(&filter, hashes);
+
+        isize false_positives = 0;
+        f64 t = bench_run([&]() {
+            false_positives = 0;
+            for (u64 hash : queries) {
+                false_positives += bloom_maybe_contains(&filter, hash);
+            }
+        });
+        f64 t_batch = bench_run([&]() {
+            bench_sink = bloom_maybe_contains_batch(&filter, queries, results);
+        });
+        printf("%-12.0f %6d %13.4f%% %14.2f %14.2f\n", bpk, filter.hash_count,
+               100.0 * false_positives / keys, t / keys * 1e9,
+               t_batch / keys * 1e9);
+    }
+
+    // The lookup the filter is meant to avoid
+    Slice<u8> buff = slice_make<u8>(256 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    HashSet<u64> set = {};
+    hash_set_init(&set, keys, arena_allocator(&arena));
+    for (u64 hash : hashes) {
+        hash_set_insert(&set, hash);
+    }
+    f64 t = bench_run([&]() {
+        isize found = 0;
+        for (u64 hash : queries) {
+            found += hash_set_contains(&set, hash);
+        }
+        bench_sink = found;
+    });
+    printf("%-12s %6s %14s %14.2f\n", "HashSet", "", "", t / keys * 1e9);
+}
+
+static void bench_atomic_bit_set() {
+    isize sizes[] = {32 * 1024 * 1024, 1024 * 1024 * 1024};
+
+    for (isize size : sizes) {
+        AtomicBitSet bits = atomic_bit_set_make(size, c_allocator());
+        defer(core_free(c_allocator(), bits.data));
+
+        u64 state = 0x9E3779B97F4A7C15;
+        isize words = bit_set_word_count(size);
+        for (isize i = 0; i < words; i++) {
+            bits.data[i] = bench_random_u64(&state);
+        }
+
+        f64 bytes = (f64)words * sizeof(u64);
+        f64 t =
+            bench_run([&]() { bench_sink = atomic_bit_set_count(&bits, 1); });
+        bench_report("atomic_bit_set_count", "1 thread", size, t, bytes);
+        t = bench_run([&]() { bench_sink = atomic_bit_set_count(&bits); });
+        bench_report("atomic_bit_set_count", "all", size, t, bytes);
+
+        // Random marking, half of the bits are already set
+        const isize marks = 1024 * 1024;
+        t = bench_run([&]() {
+            isize won = 0;
+            for (isize i = 0; i < marks; i++) {
+                isize index = (isize)(bench_random_u64(&state) % size);
+                won += !atomic_bit_set_test_and_set(&bits, index);
+            }
+            bench_sink = won;
+        });
+        bench_report("atomic_bit_set_test_and_set", "", size, t / marks, 0);
+    }
+}
+
+static void bench_ternary_array() {
+    isize sizes[] = {64 * 1024, 16 * 1024 * 1024};
+    const isize literal_count = 1024 * 1024;
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    for (isize size : sizes) {
+        TernaryArray array = ternary_array_make(size, c_allocator());
+        defer(core_free(c_allocator(), array.data));
+        // Baseline, one byte per element with the same encoding
+        Slice<u8> bytes = slice_make<u8>(size, c_allocator());
+        defer(core_free(c_allocator(), bytes.data));
+        Slice<i32> literals = slice_make<i32>(literal_count, c_allocator());
+        defer(core_free(c_allocator(), literals.data));
+
+        u64 state = 0x9E3779B97F4A7C15;
+        for (isize i = 0; i < size; i++) {
+            u64 r = bench_random_u64(&state) % 3;
+            Ternary value = r == 0   ? Ternary::Unassigned
+                            : r == 1 ? Ternary::False
+                                     : Ternary::True;
+            ternary_array_set(&array, i, value);
+            bytes[i] = (u8)value;
+        }
+        for (i32& literal : literals) {
+            u64 r = bench_random_u64(&state);
+            literal = (i32)(r % size + 1) * ((r >> 40) & 1 ? 1 : -1);
+        }
+
+        f64 t = bench_run([&]() {
+            isize true_count = 0;
+            for (i32 literal : literals) {
+                u8 value = bytes[std::abs(literal) - 1];
+                value ^= (literal < 0 ? 2 : 0) & (value << 1);
+                true_count += value == (u8)Ternary::True;
+            }
+            bench_sink = true_count;
+        });
+        bench_report("eval_literals_u8", "", size, t / literal_count, 0);
+
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features ||
+                variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            t = bench_run([&]() {
+                bench_sink =
+                    ternary_array_eval_literals(&array, literals).true_count;
+            });
+            bench_report("ternary_eval_literals", variant.name, size,
+                         t / literal_count, 0);
+        }
+
+        t = bench_run([&]() {
+            bench_sink = ternary_array_count_assigned(&array);
+        });
+        bench_report("ternary_count_assigned", "", size, t,
+                     (f64)ternary_array_word_count(size) * sizeof(u64));
+    }
+}
+
+static void bench_packed_int_array() {
+    const isize size = 4 * 1024 * 1024;
+    i32 widths[] = {3, 7, 12, 20, 32};
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    Slice<u32> values = slice_make<u32>(size, c_allocator());
+    defer(core_free(c_allocator(), values.data));
+
+    for (i32 width : widths) {
+        u64 state = 0x9E3779B97F4A7C15;
+        for (u32& value : values) {
+            value = (u32)(bench_random_u64(&state) >> (64 - width));
+        }
+        PackedIntArray array =
+            packed_int_array_from_slice(values, c_allocator());
+        defer(packed_int_array_free(&array));
+
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features ||
+                variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            f64 t = bench_run([&]() {
+                packed_int_array_unpack(&array, values);
+                bench_sink = values[size - 1];
+            });
+            bench_report("packed_int_array_unpack", variant.name, width, t,
+                         (f64)size * sizeof(u32));
+        }
+    }
+}
+
+static void bench_hyper_log_log() {
+    const isize stream_size = 8 * 1024 * 1024;
+    // Keys are drawn from these ranges, the number of distinct keys is a bit
+    // lower for the largest one
+    isize ranges[] = {1000, 100000, 4 * 1024 * 1024};
+
+    Slice<u64> stream = slice_make<u64>(stream_size, c_allocator());
+    defer(core_free(c_allocator(), stream.data));
+    Slice<u8> buff = slice_make<u8>(512 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+
+    printf("%-12s %10s %14s %14s %10s\n", "distinct", "precision",
+           "ns/key", "count", "error");
+    for (isize range : ranges) {
+        u64 state = 0x9E3779B97F4A7C15;
+        for (u64& key : stream) {
+            key = bench_random_u64(&state) % range;
+        }
+
+        // Exact counting, what the sketch replaces
+        isize exact = 0;
+        f64 t = bench_run([&]() {
+            Arena arena = arena_make(buff);
+            HashSet<u64> set = {};
+            hash_set_init(&set, 16, arena_allocator(&arena));
+            for (u64 key : stream) {
+                hash_set_insert(&set, key);
+            }
+            exact = (isize)set.backing_set->size();
+        });
+        printf("%-12ld %10s %14.2f %14ld\n", exact, "HashSet",
+               t / stream_size * 1e9, exact);
+
+        i32 precisions[] = {10, 14, 18};
+        for (i32 precision : precisions) {
+            f64 estimate = 0;
+            t = bench_run([&]() {
+                HyperLogLog hll = hll_make(c_allocator(), precision);
+                for (u64 key : stream) {
+                    hll_add_u64(&hll, key);
+                }
+                estimate = hll_count(&hll);
+                hll_free(&hll);
+            });
+            printf("%-12ld %10d %14.2f %14.0f %9.3f%%\n", exact, precision,
+                   t / stream_size * 1e9, estimate,
+                   100.0 * fabs(estimate - (f64)exact) / (f64)exact);
+        }
+    }
+}
+
+// Text mixing ASCII with 2, 3 and 4 byte sequences. `ascii_percent` of the
+// pieces are plain ASCII words.
+static Slice<u8> bench_utf8_text(isize size, u64 ascii_percent) {
+    const char* pieces[] = {"\xC5\xA1", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                            "\xC4\x8D"};
+    Slice<u8> text = slice_make<u8>(size, c_allocator());
+    u64 state = 0x9E3779B97F4A7C15;
+    isize i = 0;
+    while (i < size) {
+        u64 r = bench_random_u64(&state);
+        const char* piece = r % 100 < ascii_percent ? "word " : pieces[r % 4];
+        isize piece_size = (isize)strlen(piece);
+        if (i + piece_size > size) {
+            break;
+        }
+        memcpy(text.data + i, piece, piece_size);
+        i += piece_size;
+    }
+    // Pad with ASCII to stay valid
+    memset(text.data + i, ' ', size - i);
+    return text;
+}
+
+static void bench_utf8() {
+    const isize size = 16 * 1024 * 1024;
+    u64 ascii_percents[] = {100, 90, 0};
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    for (u64 ascii_percent : ascii_percents) {
+        Slice<u8> text = bench_utf8_text(size, ascii_percent);
+        defer(core_free(c_allocator(), text.data));
+        String str = string_from_slice(text);
+
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features ||
+                variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            f64 t = bench_run([&]() {
+                bench_sink = string_validate_utf8(str).error_offset;
+            });
+            bench_report("string_validate_utf8", variant.name, ascii_percent,
+                         t, (f64)size);
+        }
+    }
+
+    for (u64 ascii_percent : ascii_percents) {
+        Slice<u8> text = bench_utf8_text(size, ascii_percent);
+        defer(core_free(c_allocator(), text.data));
+        String str = string_from_slice(text);
+        Slice<rune> runes = slice_make<rune>(size, c_allocator());
+        defer(core_free(c_allocator(), runes.data));
+        // 4 bytes per rune, so the size precondition doesn't need a pass
+        Slice<u8> encoded = slice_make<u8>(size * 4, c_allocator());
+        defer(core_free(c_allocator(), encoded.data));
+
+        // Baseline, one rune per call
+        cpu_set_features(all_features);
+        f64 t = bench_run([&]() {
+            RuneIterator it = string_to_runes(str);
+            isize count = 0;
+            while (!rune_iter_done(&it)) {
+                runes[count++] = rune_iter_next(&it);
+            }
+            bench_sink = count;
+        });
+        bench_report("rune_iter_next", "", ascii_percent, t, (f64)size);
+
+        isize rune_count = string_rune_count(str);
+        Slice<rune> decoded = slice_from_parts(runes.data, rune_count);
+        for (BenchVariant variant : bench_cpu_variants()) {
+            cpu_set_features(variant.features);
+            if (cpu_get_features() != variant.features ||
+                variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            t = bench_run([&]() { bench_sink = string_rune_count(str); });
+            bench_report("string_rune_count", variant.name, ascii_percent, t,
+                         (f64)size);
+            t = bench_run(
+                [&]() { bench_sink = string_decode_runes(str, runes); });
+            bench_report("string_decode_runes", variant.name, ascii_percent,
+                         t, (f64)size);
+            t = bench_run(
+                [&]() { bench_sink = runes_encode_utf8(decoded, encoded); });
+            bench_report("runes_encode_utf8", variant.name, ascii_percent, t,
+                         (f64)size);
+        }
+    }
+}
+
+static void bench_string_builder() {
+    const isize count = 100000;
+    Slice<u8> buff = slice_make<u8>(64 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+
+    printf("%-28s %14s %14s\n", "method", "ns/line", "bytes");
+
+    // What we replace: snprintf into a temporary, then copy it out
+    isize bytes = 0;
+    f64 t = bench_run([&]() {
+        Arena arena = arena_make(buff);
+        bytes = 0;
+        for (isize i = 0; i < count; i++) {
+            char line[128];
+            snprintf(line, sizeof(line), "node %ld: weight=%g flag=%d\n", i,
+                     (f64)i * 0.25, (i32)(i & 1));
+            String str = string_from_cstr_alloc(line, arena_allocator(&arena));
+            bytes += str.size;
+        }
+    });
+    printf("%-28s %14.2f %14ld\n", "snprintf + copy", t / count * 1e9, bytes);
+
+    t = bench_run([&]() {
+        Arena arena = arena_make(buff);
+        StringBuilder sb = string_builder_make(arena_allocator(&arena));
+        for (isize i = 0; i < count; i++) {
+            string_builder_format(&sb, "node {}: weight={} flag={}\n", i,
+                                  (f64)i * 0.25, (i32)(i & 1));
+        }
+        bytes = sb.size;
+    });
+    printf("%-28s %14.2f %14ld\n", "string_builder_format", t / count * 1e9,
+           bytes);
+
+    t = bench_run([&]() {
+        Arena arena = arena_make(buff);
+        StringBuilder sb = string_builder_make(arena_allocator(&arena));
+        for (isize i = 0; i < count; i++) {
+            string_builder_append_cstr(&sb, "node ");
+            string_builder_append_i64(&sb, i);
+            string_builder_append_cstr(&sb, ": weight=");
+            string_builder_append_f64(&sb, (f64)i * 0.25);
+            string_builder_append_cstr(&sb, " flag=");
+            string_builder_append_i64(&sb, i & 1);
+            string_builder_append_char(&sb, '\n');
+        }
+        bytes = sb.size;
+    });
+    printf("%-28s %14.2f %14ld\n", "string_builder_append", t / count * 1e9,
+           bytes);
+}
+
+static void bench_ignore_case() {
+    const isize count = 4096;
+    const isize max_size = 48;
+    u64 state = 0x9E3779B97F4A7C15;
+    Slice<char> text = slice_make<char>(count * max_size, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+    Slice<char> upper = slice_make<char>(count * max_size, c_allocator());
+    defer(core_free(c_allocator(), upper.data));
+    for (isize i = 0; i < text.size; i++) {
+        u64 r = bench_random_u64(&state);
+        text[i] = (char)((r & 1 ? 'a' : 'A') + (r >> 8) % 26);
+        upper[i] = (char)(text[i] & ~0x20);
+    }
+
+    // Keyword sized keys of 4 to 48 bytes
+    String keys[count];
+    String upper_keys[count];
+    for (isize i = 0; i < count; i++) {
+        isize size = 4 + bench_random_u64(&state) % (max_size - 3);
+        keys[i] = string_from_parts(text.data + i * max_size, size);
+        upper_keys[i] = string_from_parts(upper.data + i * max_size, size);
+    }
+
+    printf("%-28s %-10s %15s\n", "method", "variant", "time/key");
+    auto report = [](const char* method, const char* variant, f64 t) {
+        printf("%-28s %-10s %12.1f ns\n", method, variant, t / count * 1e9);
+    };
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    Slice<u8> buff = slice_make<u8>(count * 2 * (max_size + 16), c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    u64 sum = 0;
+    for (BenchVariant variant : bench_cpu_variants()) {
+        if (variant.features == (u32)CpuFeature::Popcnt) {
+            continue;
+        }
+        cpu_set_features(variant.features);
+
+        // What the adaptor replaces, lowered copies of both sides
+        f64 t = bench_run([&]() {
+            arena_reset(&arena);
+            Allocator alloc = arena_allocator(&arena);
+            for (isize i = 0; i < count; i++) {
+                String a = string_to_lower_ascii(keys[i], alloc);
+                String b = string_to_lower_ascii(upper_keys[i], alloc);
+                sum += hash_string(a) + (a == b);
+            }
+        });
+        report("lowered copy + hash_string", variant.name, t);
+
+        t = bench_run([&]() {
+            for (isize i = 0; i < count; i++) {
+                sum += hash_string_ignore_case(keys[i]) +
+                       string_equals_ignore_case_ascii(keys[i], upper_keys[i]);
+            }
+        });
+        report("hash/equals ignore case", variant.name, t);
+    }
+    cpu_set_features(all_features);
+    bench_sink = (isize)sum;
+}
+
+static void bench_inline_string() {
+    const isize count = 100000;
+    u64 state = 0x9E3779B97F4A7C15;
+    Slice<char> text = slice_make<char>(count * 24, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+    Slice<String> names = slice_make<String>(count, c_allocator());
+    defer(core_free(c_allocator(), names.data));
+    for (isize i = 0; i < count; i++) {
+        // Identifiers of 4 to 20 bytes
+        isize size = 4 + bench_random_u64(&state) % 17;
+        char* name = text.data + i * 24;
+        for (isize j = 0; j < size; j++) {
+            name[j] = (char)('a' + bench_random_u64(&state) % 26);
+        }
+        names[i] = string_from_parts(name, size);
+    }
+
+    printf("%-28s %15s\n", "method", "time/string");
+    auto report = [](const char* method, f64 t) {
+        printf("%-28s %12.1f ns\n", method, t / count * 1e9);
+    };
+
+    Slice<String> copies = slice_make<String>(count, c_allocator());
+    defer(core_free(c_allocator(), copies.data));
+    f64 t = bench_run([&]() {
+        for (isize i = 0; i < count; i++) {
+            char* data = core_alloc<char>(c_allocator(), names[i].size + 1);
+            memcpy(data, names[i].data, names[i].size);
+            copies[i] = string_from_parts(data, names[i].size);
+        }
+        for (isize i = 0; i < count; i++) {
+            core_free(c_allocator(), (void*)copies[i].data);
+        }
+    });
+    report("allocated String copy+free", t);
+
+    Slice<InlineString<>> owned =
+        slice_make<InlineString<>>(count, c_allocator());
+    defer(core_free(c_allocator(), owned.data));
+    t = bench_run([&]() {
+        for (isize i = 0; i < count; i++) {
+            inline_string_init(&owned[i], names[i], c_allocator());
+        }
+        for (isize i = 0; i < count; i++) {
+            inline_string_free(&owned[i], c_allocator());
+        }
+    });
+    report("InlineString make+free", t);
+
+    // Reading every key back, scattered copies against inline bytes
+    for (isize i = 0; i < count; i++) {
+        char* data = core_alloc<char>(c_allocator(), names[i].size + 1);
+        memcpy(data, names[i].data, names[i].size);
+        copies[i] = string_from_parts(data, names[i].size);
+        inline_string_init(&owned[i], names[i], c_allocator());
+    }
+    u64 sum = 0;
+    t = bench_run([&]() {
+        for (isize i = 0; i < count; i++) {
+            sum += hash_string(copies[i]);
+        }
+    });
+    report("hash allocated String", t);
+    t = bench_run([&]() {
+        for (isize i = 0; i < count; i++) {
+            sum += hash_string(inline_string_to_string(&owned[i]));
+        }
+    });
+    report("hash InlineString", t);
+    for (isize i = 0; i < count; i++) {
+        core_free(c_allocator(), (void*)copies[i].data);
+    }
+    bench_sink = (isize)sum;
+}
+
+static void bench_numbers() {
+    const isize count = 1000000;
+    Slice<u64> ints = slice_make<u64>(count, c_allocator());
+    defer(core_free(c_allocator(), ints.data));
+    Slice<f64> floats = slice_make<f64>(count, c_allocator());
+    defer(core_free(c_allocator(), floats.data));
+
+    // Mixed magnitudes, and doubles with up to 17 significant digits
+    u64 state = 0x9E3779B97F4A7C15;
+    for (isize i = 0; i < count; i++) {
+        u64 r = bench_random_u64(&state);
+        ints[i] = r >> (r % 64);
+        floats[i] = (f64)(r >> 11) / (f64)(1ull << 53) *
+                    pow(10.0, (f64)(i % 41) - 20.0);
+    }
+
+    StringBuilder sb = string_builder_make(c_allocator());
+    defer(string_builder_free(&sb));
+
+    printf("%-28s %-14s %10s\n", "operation", "method", "ns/number");
+    auto report = [&](const char* op, const char* method, f64 t) {
+        printf("%-28s %-14s %10.2f\n", op, method, t / count * 1e9);
+    };
+
+    for (u64 value : ints) {
+        string_builder_append_u64(&sb, value);
+        string_builder_append_char(&sb, ' ');
+    }
+    const char* text = string_builder_to_cstr(&sb);
+    const char* text_end = text + sb.size;
+
+    report("parse u64", "strtoull", bench_run([&]() {
+               u64 sum = 0;
+               char* p = (char*)text;
+               for (isize i = 0; i < count; i++) {
+                   sum += strtoull(p, &p, 10);
+               }
+               bench_sink = (isize)sum;
+           }));
+    report("parse u64", "from_chars", bench_run([&]() {
+               u64 sum = 0;
+               const char* p = text;
+               for (isize i = 0; i < count; i++) {
+                   u64 value = 0;
+                   p = std::from_chars(p, text_end, value).ptr + 1;
+                   sum += value;
+               }
+               bench_sink = (isize)sum;
+           }));
+    report("parse u64", "core", bench_run([&]() {
+               u64 sum = 0;
+               String str = string_builder_to_string(&sb);
+               for (isize i = 0; i < count; i++) {
+                   sum += string_parse_u64(&str).value;
+                   str = string_substr(str, 1, str.size - 1);
+               }
+               bench_sink = (isize)sum;
+           }));
+
+    string_builder_clear(&sb);
+    for (f64 value : floats) {
+        string_builder_append_f64(&sb, value);
+        string_builder_append_char(&sb, ' ');
+    }
+    text = string_builder_to_cstr(&sb);
+    text_end = text + sb.size;
+
+    report("parse f64", "strtod", bench_run([&]() {
+               f64 sum = 0;
+               char* p = (char*)text;
+               for (isize i = 0; i < count; i++) {
+                   sum += strtod(p, &p);
+               }
+               bench_sink = (isize)sum;
+           }));
+    report("parse f64", "from_chars", bench_run([&]() {
+               f64 sum = 0;
+               const char* p = text;
+               for (isize i = 0; i < count; i++) {
+                   f64 value = 0;
+                   p = std::from_chars(p, text_end, value).ptr + 1;
+                   sum += value;
+               }
+               bench_sink = (isize)sum;
+           }));
+    report("parse f64", "core", bench_run([&]() {
+               f64 sum = 0;
+               String str = string_builder_to_string(&sb);
+               for (isize i = 0; i < count; i++) {
+                   sum += string_parse_f64(&str).value;
+                   str = string_substr(str, 1, str.size - 1);
+               }
+               bench_sink = (isize)sum;
+           }));
+
+    char buffer[32];
+    report("format u64", "snprintf", bench_run([&]() {
+               isize total = 0;
+               for (u64 value : ints) {
+                   total += snprintf(buffer, sizeof(buffer), "%lu", value);
+               }
+               bench_sink = total;
+           }));
+    report("format u64", "to_chars", bench_run([&]() {
+               isize total = 0;
+               for (u64 value : ints) {
+                   total += std::to_chars(buffer, buffer + sizeof(buffer),
+                                          value).ptr - buffer;
+               }
+               bench_sink = total;
+           }));
+    report("format u64", "core", bench_run([&]() {
+               isize total = 0;
+               for (u64 value : ints) {
+                   total += format_u64(value, buffer);
+               }
+               bench_sink = total;
+           }));
+    report("format f64", "snprintf %.17g", bench_run([&]() {
+               isize total = 0;
+               for (f64 value : floats) {
+                   total += snprintf(buffer, sizeof(buffer), "%.17g", value);
+               }
+               bench_sink = total;
+           }));
+    report("format f64", "core", bench_run([&]() {
+               isize total = 0;
+               for (f64 value : floats) {
+                   total += format_f64(value, buffer);
+               }
+               bench_sink = total;
+           }));
+}
+
+static void bench_string_search() {
+    const isize size = 16 * 1024 * 1024;
+    Slice<u8> text = slice_make<u8>(size, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+
+    // Lowercase words, the needles are planted once at the very end. Their
+    // first and last bytes are common, so filters see many candidates, the
+    // uppercase byte keeps them from occurring earlier.
+    const char* needles[] = {
+        "X",
+        "eXte",
+        "the quick Xrowne",
+        "the quick brown fox jumps over the lazy dog aXain and again",
+    };
+    u64 state = 0x9E3779B97F4A7C15;
+    for (isize i = 0; i < size; i++) {
+        u64 r = bench_random_u64(&state);
+        text[i] = r % 6 == 0 ? ' ' : (u8)('a' + (r >> 8) % 26);
+    }
+    String haystack = string_from_slice(text);
+    std::string_view view((const char*)text.data, size);
+
+    printf("%-28s %-10s %12s %15s\n", "operation", "variant", "needle",
+           "throughput");
+    auto report = [&](const char* op, const char* variant, isize needle_size,
+                      f64 t) {
+        printf("%-28s %-10s %12ld %10.2f GB/s\n", op, variant, needle_size,
+               size / t / 1e9);
+    };
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    for (const char* needle_cstr : needles) {
+        String needle = string_from_cstr(needle_cstr);
+        memcpy(text.data + size - needle.size, needle.data, needle.size);
+
+#if !defined(_WIN32)
+        report("memmem", "", needle.size, bench_run([&]() {
+                   bench_sink = (isize)memmem(text.data, size, needle.data,
+                                              needle.size);
+               }));
+#endif
+        report("string_view::find", "", needle.size, bench_run([&]() {
+                   bench_sink = (isize)view.find(needle_cstr);
+               }));
+        for (BenchVariant variant : bench_cpu_variants()) {
+            if (variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            cpu_set_features(variant.features);
+            report("string_find", variant.name, needle.size, bench_run([&]() {
+                       bench_sink = string_find(haystack, needle);
+                   }));
+        }
+        cpu_set_features(all_features);
+        report("string_find_last", "", needle.size, bench_run([&]() {
+                   bench_sink = string_find_last(
+                       string_substr(haystack, 0, size - needle.size),
+                       needle);
+               }));
+    }
+
+    // Bytes that are not in the text
+    ByteSet set = byte_set_make(string_from_cstr("\n\t,;"));
+    text[size - 1] = ',';
+    report("memchr", "", 1, bench_run([&]() {
+               bench_sink = (isize)memchr(text.data, ',', size);
+           }));
+    report("string_view::find_first_of", "", 4, bench_run([&]() {
+               bench_sink = (isize)view.find_first_of("\n\t,;");
+           }));
+    for (BenchVariant variant : bench_cpu_variants()) {
+        if (variant.features == (u32)CpuFeature::Popcnt) {
+            continue;
+        }
+        cpu_set_features(variant.features);
+        report("string_find_any_of", variant.name, 4, bench_run([&]() {
+                   bench_sink = string_find_any_of(haystack, &set);
+               }));
+    }
+    cpu_set_features(all_features);
+}
+
+static void bench_string_split() {
+    const isize size = 256 * 1024 * 1024;
+    Slice<u8> text = slice_make<u8>(size, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+
+    // CSV like lines, 4 fields of up to 16 characters
+    u64 state = 0x9E3779B97F4A7C15;
+    isize i = 0;
+    while (i < size) {
+        u64 r = bench_random_u64(&state);
+        isize field = 1 + r % 16;
+        for (isize j = 0; j < field && i < size; j++) {
+            text[i++] = (u8)('a' + (r >> (j * 4)) % 16);
+        }
+        if (i < size) {
+            text[i++] = (r >> 60) % 4 == 0 ? '\n' : ',';
+        }
+    }
+    String str = string_from_slice(text);
+
+    printf("%-28s %-10s %12s %15s\n", "operation", "variant", "pieces",
+           "throughput");
+    auto report = [&](const char* op, const char* variant, isize pieces,
+                      f64 t) {
+        printf("%-28s %-10s %12ld %10.2f GB/s\n", op, variant, pieces,
+               size / t / 1e9);
+    };
+
+    // Reading the memory once, the bound for everything below
+    report("read", "", 0, bench_run([&]() {
+               u64 sum = 0;
+               const u64* words = (const u64*)text.data;
+               for (isize w = 0; w < size / 8; w++) {
+                   sum += words[w];
+               }
+               bench_sink = (isize)sum;
+           }));
+
+    report("byte loop lines", "", 0, bench_run([&]() {
+               isize count = 0;
+               isize start = 0;
+               for (isize j = 0; j < size; j++) {
+                   if (text[j] == '\n') {
+                       count += j - start;
+                       start = j + 1;
+                   }
+               }
+               bench_sink = count;
+           }));
+    report("memchr lines", "", 0, bench_run([&]() {
+               isize count = 0;
+               const u8* p = text.data;
+               const u8* end = p + size;
+               while (p < end) {
+                   const u8* nl = (const u8*)memchr(p, '\n', end - p);
+                   if (nl == nullptr) {
+                       nl = end;
+                   }
+                   count += nl - p;
+                   p = nl + 1;
+               }
+               bench_sink = count;
+           }));
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    ByteSet set = byte_set_make(string_from_cstr(",\n"));
+    for (BenchVariant variant : bench_cpu_variants()) {
+        if (variant.features == (u32)CpuFeature::Popcnt) {
+            continue;
+        }
+        cpu_set_features(variant.features);
+        isize lines = 0;
+        f64 t = bench_run([&]() {
+            LineIterator it = string_lines(str);
+            isize count = 0;
+            lines = 0;
+            while (!line_iter_done(&it)) {
+                count += line_iter_next(&it).size;
+                lines++;
+            }
+            bench_sink = count;
+        });
+        report("line_iter_next", variant.name, lines, t);
+
+        isize fields = 0;
+        t = bench_run([&]() {
+            StringSplitIterator it = string_split_any(str, &set);
+            isize count = 0;
+            fields = 0;
+            while (!split_iter_done(&it)) {
+                count += split_iter_next(&it).size;
+                fields++;
+            }
+            bench_sink = count;
+        });
+        report("split_iter_next any", variant.name, fields, t);
+    }
+}
+
+static void bench_multi_matcher() {
+    const isize size = 32 * 1024 * 1024;
+    Slice<u8> text = slice_make<u8>(size, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+    u64 state = 0x9E3779B97F4A7C15;
+    for (isize i = 0; i < size; i++) {
+        u64 r = bench_random_u64(&state);
+        text[i] = r % 6 == 0 ? ' ' : (u8)('a' + (r >> 8) % 26);
+    }
+    String haystack = string_from_slice(text);
+
+    // Random words of 5 to 10 letters, rare enough to be reported a few times
+    const isize max_patterns = 300;
+    char pattern_bytes[max_patterns][10];
+    String patterns[max_patterns];
+    for (isize p = 0; p < max_patterns; p++) {
+        isize pattern_size = 5 + bench_random_u64(&state) % 6;
+        for (isize i = 0; i < pattern_size; i++) {
+            pattern_bytes[p][i] =
+                (char)('a' + bench_random_u64(&state) % 26);
+        }
+        patterns[p] = string_from_parts(pattern_bytes[p], pattern_size);
+    }
+
+    printf("%-28s %-10s %10s %10s %15s\n", "method", "variant", "patterns",
+           "matches", "throughput");
+    auto report = [&](const char* method, const char* variant,
+                      isize pattern_count, isize matches, f64 t) {
+        printf("%-28s %-10s %10ld %10ld %10.2f GB/s\n", method, variant,
+               pattern_count, matches, size / t / 1e9);
+    };
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    Array<MultiMatch> matches = array_make<MultiMatch>(c_allocator(), 1024);
+    defer(core_free(c_allocator(), matches.items.data));
+    for (isize pattern_count : {8, 32, 300}) {
+        Slice<String> set = slice_from_parts(patterns, pattern_count);
+
+        // One pass per pattern, what the matcher replaces
+        isize found = 0;
+        f64 t = bench_run([&]() {
+            found = 0;
+            for (String pattern : set) {
+                isize start = 0;
+                while (true) {
+                    isize at = string_find(haystack, pattern, start);
+                    if (at < 0) {
+                        break;
+                    }
+                    found++;
+                    start = at + 1;
+                }
+            }
+        });
+        report("string_find per pattern", "", pattern_count, found, t);
+
+        MultiMatcher matcher = multi_matcher_make(set, c_allocator());
+        defer(multi_matcher_free(&matcher));
+        for (BenchVariant variant : bench_cpu_variants()) {
+            if (variant.features == (u32)CpuFeature::Popcnt) {
+                continue;
+            }
+            cpu_set_features(variant.features);
+            t = bench_run([&]() {
+                array_clear(&matches);
+                multi_matcher_find_all(&matcher, haystack, &matches);
+            });
+            report("multi_matcher_find_all", variant.name, pattern_count,
+                   matches.items.size, t);
+        }
+        cpu_set_features(all_features);
+    }
+}
+
+static void bench_rope() {
+    const isize initial_size = 4 * 1024 * 1024;
+    const isize inserts = 10000;
+    const char* words = "lorem ipsum dolor sit amet consectetur adipiscing";
+    std::string text(initial_size, 'x');
+
+    printf("%-28s %10s %15s\n", "method", "ops", "time/op");
+    auto report = [](const char* method, isize ops, f64 t) {
+        printf("%-28s %10ld %12.1f ns\n", method, ops, t / ops * 1e9);
+    };
+
+    // Same random edit positions for both
+    u64 state = 0x9E3779B97F4A7C15;
+    Slice<isize> positions = slice_make<isize>(inserts, c_allocator());
+    defer(core_free(c_allocator(), positions.data));
+    Slice<isize> sizes = slice_make<isize>(inserts, c_allocator());
+    defer(core_free(c_allocator(), sizes.data));
+    isize size = initial_size;
+    for (isize i = 0; i < inserts; i++) {
+        positions[i] = bench_random_u64(&state) % (size + 1);
+        sizes[i] = 1 + bench_random_u64(&state) % 8;
+        size += sizes[i];
+    }
+
+    f64 t = bench_run([&]() {
+        std::string copy = text;
+        for (isize i = 0; i < inserts; i++) {
+            copy.insert(positions[i], words, sizes[i]);
+        }
+    }, 0.0);
+    report("std::string insert", inserts, t);
+
+    DynamicArena arena = dynamic_arena_make(1024 * 1024);
+    defer(dynamic_arena_free(&arena));
+    Rope rope = rope_make(dynamic_arena_allocator(&arena));
+    t = bench_run([&]() {
+        dynamic_arena_reset(&arena);
+        rope = rope_make(dynamic_arena_allocator(&arena));
+        rope_append(&rope, string_from_parts(text.data(), text.size()));
+        for (isize i = 0; i < inserts; i++) {
+            rope_insert(&rope, positions[i],
+                        string_from_parts(words, sizes[i]));
+        }
+    });
+    report("rope_insert", inserts, t);
+
+    u64 sum = 0;
+    t = bench_run([&]() {
+        for (isize i = 0; i < inserts; i++) {
+            sum += (u8)rope_get(&rope, positions[i] % initial_size);
+        }
+    });
+    report("rope_get", inserts, t);
+
+    isize chunks = 0;
+    t = bench_run([&]() {
+        chunks = 0;
+        RopeIterator it = rope_chunks(&rope);
+        while (!rope_iter_done(&it)) {
+            sum += rope_iter_next(&it).size;
+            chunks++;
+        }
+    });
+    report("rope_iter_next", chunks, t);
+    bench_sink = (isize)sum;
+}
+
+static void bench_file_read() {
+    const isize size = 256 * 1024 * 1024;
+    const char* path = "core_bench_file_read.tmp";
+    FILE* file = fopen(path, "wb");
+    core_assert_msg(file != nullptr, "Can't create %s", path);
+    Slice<u8> block = slice_make<u8>(1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), block.data));
+    u64 state = 0x9E3779B97F4A7C15;
+    for (isize i = 0; i < block.size; i++) {
+        block[i] = (u8)bench_random_u64(&state);
+    }
+    for (isize written = 0; written < size; written += block.size) {
+        fwrite(block.data, 1, block.size, file);
+    }
+    fclose(file);
+    defer(remove(path));
+
+    // Reads every byte once, the file stays in the page cache between runs
+    auto checksum = [](Slice<u8> data) {
+        u64 sum = 0;
+        for (isize i = 0; i + 8 <= data.size; i += 8) {
+            sum += hash_read_u64(data.data + i);
+        }
+        return sum;
+    };
+
+    u64 sum = 0;
+    f64 t = bench_run([&]() {
+        Result<Slice<u8>, FileReadError> data =
+            file_read_full(string_from_cstr(path), c_allocator());
+        core_assert(data.is_ok);
+        sum += checksum(data.value);
+        core_free(c_allocator(), data.value.data);
+    });
+    bench_report("file_read_full", "", size, t, (f64)size);
+
+    t = bench_run([&]() {
+        Result<Slice<u8>, FileReadError> data =
+            file_read_full_pread(string_from_cstr(path), c_allocator());
+        core_assert(data.is_ok);
+        sum += checksum(data.value);
+        core_free(c_allocator(), data.value.data);
+    });
+    bench_report("file_read_full_pread", "", size, t, (f64)size);
+
+    for (bool populate : {false, true}) {
+        FileMapOptions options;
+        options.populate = populate;
+        t = bench_run([&]() {
+            Result<MappedFile, FileReadError> mapped =
+                file_map(string_from_cstr(path), options);
+            core_assert(mapped.is_ok);
+            sum += checksum(mapped.value.data);
+            file_unmap(&mapped.value);
+        });
+        bench_report("file_map", populate ? "populate" : "lazy", size, t,
+                     (f64)size);
+    }
+    bench_sink = (isize)sum;
+}
+
+#if !defined(_WIN32)
+static void bench_file_read_many() {
+    const isize file_count = 2000;
+    const isize file_size = 16 * 1024;
+    char dir[] = "core_bench_many_XXXXXX";
+    core_assert_msg(mkdtemp(dir) != nullptr, "Can't create a directory");
+
+    Slice<u8> content = slice_make<u8>(file_size, c_allocator());
+    defer(core_free(c_allocator(), content.data));
+    Slice<char> names = slice_make<char>(file_count * 64, c_allocator());
+    defer(core_free(c_allocator(), names.data));
+    Slice<String> paths = slice_make<String>(file_count, c_allocator());
+    defer(core_free(c_allocator(), paths.data));
+    for (isize i = 0; i < file_count; i++) {
+        char* name = names.data + i * 64;
+        int size = snprintf(name, 64, "%s/%ld", dir, i);
+        paths[i] = string_from_parts(name, size);
+        FILE* file = fopen(name, "wb");
+        core_assert(file != nullptr);
+        fwrite(content.data, 1, content.size, file);
+        fclose(file);
+    }
+    defer({
+        for (String path : paths) {
+            remove(path.data);
+        }
+        rmdir(dir);
+    });
+
+    // Drops the files from the page cache, so reads wait on the device.
+    // Without posix_fadvise (macOS) the cold runs are served from the cache.
+    auto evict = [&]() {
+#if defined(POSIX_FADV_DONTNEED)
+        for (String path : paths) {
+            int fd = open(path.data, O_RDONLY);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+#endif
+    };
+#if !defined(POSIX_FADV_DONTNEED)
+    printf("posix_fadvise is unavailable, the cold runs are not cold\n");
+#endif
+    auto read_each = [&](bool use_pread) {
+        for (String path : paths) {
+            Result<Slice<u8>, FileReadError> data =
+                use_pread ? file_read_full_pread(path, c_allocator())
+                          : file_read_full(path, c_allocator());
+            core_assert(data.is_ok);
+            core_free(c_allocator(), data.value.data);
+        }
+    };
+    auto read_many = [&](bool use_io_uring) {
+        FileReadMany many = file_read_many(paths, c_allocator(), use_io_uring);
+        file_read_many_free(&many);
+    };
+
+    // Cached runs measure the syscall overhead, cold ones the overlap of
+    // device reads, averaged over a few evicted runs
+    const f64 bytes = (f64)(file_count * file_size);
+    for (bool cold : {false, true}) {
+        const char* variant = cold ? "cold" : "cached";
+        auto run = [&](auto f) {
+            if (!cold) {
+                return bench_run(f);
+            }
+            const isize runs = 5;
+            f64 total = 0;
+            for (isize i = 0; i < runs; i++) {
+                evict();
+                f64 start = bench_now_seconds();
+                f();
+                total += bench_now_seconds() - start;
+            }
+            return total / runs;
+        };
+        f64 t = run([&]() { read_each(false); });
+        bench_report("file_read_full each", variant, file_count, t, bytes);
+        t = run([&]() { read_each(true); });
+        bench_report("file_read_full_pread each", variant, file_count, t,
+                     bytes);
+        t = run([&]() { read_many(true); });
+        bench_report("file_read_many io_uring", variant, file_count, t, bytes);
+        t = run([&]() { read_many(false); });
+        bench_report("file_read_many threads", variant, file_count, t, bytes);
+    }
+}
+#endif
+
+#if !defined(_WIN32)
+static void bench_decompress() {
+    // DIMACS like text, numbers and clause ends
+    const isize size = 32 * 1024 * 1024;
+    Slice<u8> text = slice_make<u8>(size, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+    u64 state = 0x9E3779B97F4A7C15;
+    isize length = 0;
+    while (length < size - 32) {
+        u64 r = bench_random_u64(&state);
+        length += format_i64((i64)(r >> 44) - (1 << 19),
+                             (char*)text.data + length);
+        text[length++] = (r & 7) == 0 ? '\n' : ' ';
+    }
+    text.size = length;
+
+    const char* plain_path = "core_bench_decompress.cnf";
+    FILE* file = fopen(plain_path, "wb");
+    core_assert(file != nullptr);
+    fwrite(text.data, 1, text.size, file);
+    fclose(file);
+    defer(remove(plain_path));
+    const char* paths[] = {plain_path, nullptr, nullptr};
+    const char* names[] = {"none", "gzip", "xz"};
+
+#if defined(CORE_WITH_ZLIB)
+    const char* gzip_path = "core_bench_decompress.cnf.gz";
+    gzFile gz = gzopen(gzip_path, "wb6");
+    gzwrite(gz, text.data, (unsigned)text.size);
+    gzclose(gz);
+    paths[1] = gzip_path;
+#endif
+#if defined(CORE_WITH_LZMA)
+    const char* xz_path = "core_bench_decompress.cnf.xz";
+    Slice<u8> xz = slice_make<u8>(text.size + 4096, c_allocator());
+    defer(core_free(c_allocator(), xz.data));
+    size_t xz_size = 0;
+    lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr, text.data,
+                            text.size, xz.data, &xz_size, xz.size);
+    file = fopen(xz_path, "wb");
+    fwrite(xz.data, 1, xz_size, file);
+    fclose(file);
+    paths[2] = xz_path;
+#endif
+    defer({
+        for (isize i = 1; i < 3; i++) {
+            if (paths[i] != nullptr) {
+                remove(paths[i]);
+            }
+        }
+    });
+
+    // The consumer counts lines, a stand in for a parser
+    isize lines = 0;
+    for (isize format = 0; format < 3; format++) {
+        if (paths[format] == nullptr) {
+            continue;
+        }
+        for (bool threaded : {false, true}) {
+            DecompressOptions options;
+            options.threaded = threaded;
+            f64 t = bench_run([&]() {
+                Result<DecompressReader*, DecompressError> reader =
+                    decompress_reader_open(string_from_cstr(paths[format]),
+                                           c_allocator(), options);
+                core_assert(reader.is_ok);
+                lines = 0;
+                while (true) {
+                    Result<Slice<u8>, DecompressError> data =
+                        decompress_reader_fill(reader.value);
+                    core_assert(data.is_ok);
+                    if (data.value.size == 0) {
+                        break;
+                    }
+                    String chunk = string_from_slice(data.value);
+                    for (isize at = string_find_byte(chunk, '\n'); at >= 0;
+                         at = string_find_byte(chunk, '\n', at + 1)) {
+                        lines++;
+                    }
+                    decompress_reader_consume(reader.value, chunk.size);
+                }
+                decompress_reader_close(reader.value);
+            });
+            char method[32];
+            snprintf(method, sizeof(method), "decompress %s", names[format]);
+            bench_report(method, threaded ? "thread" : "inline", text.size,
+                         t, (f64)text.size);
+        }
+    }
+    bench_sink = lines;
+}
+#endif
+
+static void bench_dimacs() {
+    // Random 3-SAT with a million variables, about 100 MB of text
+    const i32 variables = 1000000;
+    const isize clauses = 4 * variables;
+    const isize capacity = clauses * 3 * 9 + 64;
+    Slice<u8> text = slice_make<u8>(capacity, c_allocator());
+    defer(core_free(c_allocator(), text.data));
+    isize size = snprintf((char*)text.data, 64,
+                          "c random 3-SAT\np cnf %d %ld\n", variables,
+                          (long)clauses);
+    u64 state = 0x9E3779B97F4A7C15;
+    for (isize i = 0; i < clauses; i++) {
+        for (isize j = 0; j < 3; j++) {
+            u64 r = bench_random_u64(&state);
+            i64 literal = 1 + (i64)((r >> 1) % variables);
+            size += format_i64(r & 1 ? -literal : literal,
+                               (char*)text.data + size);
+            text[size++] = ' ';
+        }
+        text[size++] = '0';
+        text[size++] = '\n';
+    }
+    text.size = size;
+
+    // What a straightforward parser does, for reference
+    isize count = 0;
+    f64 t = bench_run([&]() {
+        Array<i32> literals = array_make<i32>(c_allocator(), 1024);
+        char* p = (char*)text.data;
+        char* end = p + text.size;
+        p = strchr(strchr(p, '\n') + 1, '\n') + 1;
+        while (p < end) {
+            char* next;
+            long value = strtol(p, &next, 10);
+            if (next == p) {
+                break;
+            }
+            if (value != 0) {
+                array_push(&literals, (i32)value);
+            }
+            p = next;
+        }
+        count = literals.items.size;
+        core_free(c_allocator(), literals.items.data);
+    });
+    bench_report("strtol loop", "", text.size, t, (f64)text.size);
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    for (BenchVariant variant : bench_cpu_variants()) {
+        if (variant.features == (u32)CpuFeature::Popcnt) {
+            continue;
+        }
+        cpu_set_features(variant.features);
+        t = bench_run([&]() {
+            Result<CnfFormula, DimacsError> formula =
+                dimacs_parse(text, c_allocator());
+            core_assert(formula.is_ok);
+            count = formula.value.literals.items.size;
+            cnf_formula_free(&formula.value);
+        });
+        bench_report("dimacs_parse", variant.name, text.size, t,
+                     (f64)text.size);
+    }
+    cpu_set_features(all_features);
+
+#if !defined(_WIN32)
+    const char* path = "core_bench_dimacs.cnf";
+    FILE* file = fopen(path, "wb");
+    core_assert(file != nullptr);
+    fwrite(text.data, 1, text.size, file);
+    fclose(file);
+    defer(remove(path));
+    for (bool threaded : {false, true}) {
+        DecompressOptions options;
+        options.threaded = threaded;
+        t = bench_run([&]() {
+            Result<DecompressReader*, DecompressError> reader =
+                decompress_reader_open(string_from_cstr(path), c_allocator(),
+                                       options);
+            core_assert(reader.is_ok);
+            Result<CnfFormula, DimacsError> formula =
+                dimacs_parse_reader(reader.value, c_allocator());
+            core_assert(formula.is_ok);
+            count = formula.value.literals.items.size;
+            cnf_formula_free(&formula.value);
+            decompress_reader_close(reader.value);
+        });
+        bench_report("dimacs_parse_reader", threaded ? "thread" : "inline",
+                     text.size, t, (f64)text.size);
+    }
+#endif
+    bench_sink = count;
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+int main(int argc, char** argv) {
+    Benchmark benchmarks[] = {
+        {"bit_set", bench_bit_set},
+        {"rank_select", bench_rank_select},
+        {"atomic_bit_set", bench_atomic_bit_set},
+        {"bit_matrix", bench_bit_matrix},
+        {"bloom", bench_bloom},
+        {"ternary_array", bench_ternary_array},
+        {"packed_int_array", bench_packed_int_array},
+        {"hyper_log_log", bench_hyper_log_log},
+        {"utf8", bench_utf8},
+        {"ignore_case", bench_ignore_case},
+        {"inline_string", bench_inline_string},
+        {"string_builder", bench_string_builder},
+        {"numbers", bench_numbers},
+        {"string_search", bench_string_search},
+        {"string_split", bench_string_split},
+        {"multi_matcher", bench_multi_matcher},
+        {"file_read", bench_file_read},
+#if !defined(_WIN32)
+        {"file_read_many", bench_file_read_many},
+        {"decompress", bench_decompress},
+#endif
+        {"rope", bench_rope},
+        {"dimacs", bench_dimacs},
+    };
+
+    const char* filter = argc > 1 ? argv[1] : "";
+    for (Benchmark benchmark : benchmarks) {
+        if (strstr(benchmark.name, filter) == nullptr) {
+            continue;
+        }
+        printf("== %s\n", benchmark.name);
+        benchmark.run();
+    }
+
+    return 0;
+}
@@ -1,6 +1,14 @@
 #include "core.hpp"
 #include <gtest/gtest.h>
 
+// xorshift64, a fixed seed gives every randomized test the same inputs
+static u64 test_random_u64(u64* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
 TEST(Core, Slice) {
     int values[] = {1, 2, 3, 4, 5};
     Slice<int> slice = slice_from_parts(values, 5);
@@ -265,6 +273,658 @@ TEST(Core, BitSet) {
     EXPECT_TRUE(bit_set_is_empty(&bits3));
 }
 
+TEST(Core, BitSetFind) {
+    Slice<u8> buff = slice_make<u8>(1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    BitSet bits = bit_set_make(200, alloc);
+    EXPECT_EQ(bit_set_find_first(&bits), -1);
+    EXPECT_EQ(bit_set_find_first_zero(&bits), 0);
+
+    bit_set_set(&bits, 3);
+    bit_set_set(&bits, 64);
+    bit_set_set(&bits, 130);
+    bit_set_set(&bits, 199);
+
+    EXPECT_EQ(bit_set_find_first(&bits), 3);
+    EXPECT_EQ(bit_set_find_next(&bits, 3), 3);
+    EXPECT_EQ(bit_set_find_next(&bits, 4), 64);
+    EXPECT_EQ(bit_set_find_next(&bits, 65), 130);
+    EXPECT_EQ(bit_set_find_next(&bits, 131), 199);
+    EXPECT_EQ(bit_set_find_next(&bits, 200), -1);
+
+    isize expected[] = {3, 64, 130, 199};
+    isize visited = 0;
+    bit_set_for_each_set_bit(&bits, [&](isize index) {
+        EXPECT_EQ(index, expected[visited]);
+        visited += 1;
+    });
+    EXPECT_EQ(visited, 4);
+
+    // The unused bits of the last word must not be reported as zeros
+    bit_set_not(&bits);
+    EXPECT_EQ(bit_set_count(&bits), 196);
+    EXPECT_EQ(bit_set_find_first_zero(&bits), 3);
+    bit_set_set(&bits, 3);
+    bit_set_set(&bits, 64);
+    bit_set_set(&bits, 130);
+    bit_set_set(&bits, 199);
+    EXPECT_EQ(bit_set_find_first_zero(&bits), -1);
+}
+
+TEST(Core, BitSetKernels) {
+    Slice<u8> buff = slice_make<u8>(1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    u32 feature_sets[] = {
+        0,
+        (u32)CpuFeature::Popcnt,
+        (u32)CpuFeature::Popcnt | (u32)CpuFeature::Avx2,
+        all_features,
+    };
+    isize sizes[] = {1, 63, 64, 65, 1000, 20000};
+
+    u64 state = 0x9E3779B97F4A7C15;
+    for (u32 features : feature_sets) {
+        cpu_set_features(features);
+
+        for (isize size : sizes) {
+            BitSet a = bit_set_make(size, alloc);
+            BitSet b = bit_set_make(size, alloc);
+            for (isize i = 0; i < size; i++) {
+                u64 random = test_random_u64(&state);
+                if (random & 1) {
+                    bit_set_set(&a, i);
+                }
+                if (random & 2) {
+                    bit_set_set(&b, i);
+                }
+            }
+
+            isize count_a = 0, count_and = 0, count_or = 0, count_xor = 0,
+                  count_andnot = 0;
+            for (isize i = 0; i < size; i++) {
+                bool x = bit_set_get(&a, i);
+                bool y = bit_set_get(&b, i);
+                count_a += x;
+                count_and += x && y;
+                count_or += x || y;
+                count_xor += x != y;
+                count_andnot += x && !y;
+            }
+
+            EXPECT_EQ(bit_set_count(&a), count_a);
+            EXPECT_EQ(bit_set_and_count(&a, &b), count_and);
+            EXPECT_EQ(bit_set_intersects(&a, &b), count_and > 0);
+
+            BitSet result = bit_set_clone(&a, alloc);
+            bit_set_and(&result, &b);
+            EXPECT_EQ(bit_set_count(&result), count_and);
+
+            result = bit_set_clone(&a, alloc);
+            bit_set_or(&result, &b);
+            EXPECT_EQ(bit_set_count(&result), count_or);
+
+            result = bit_set_clone(&a, alloc);
+            bit_set_xor(&result, &b);
+            EXPECT_EQ(bit_set_count(&result), count_xor);
+
+            result = bit_set_clone(&a, alloc);
+            bit_set_andnot(&result, &b);
+            EXPECT_EQ(bit_set_count(&result), count_andnot);
+
+            result = bit_set_clone(&a, alloc);
+            bit_set_not(&result);
+            EXPECT_EQ(bit_set_count(&result), size - count_a);
+            EXPECT_FALSE(bit_set_intersects(&result, &a));
+
+            arena_reset(&arena);
+        }
+    }
+}
+
+TEST(Core, AtomicBitSet) {
+    // Enough words for the count to be split over 4 threads, plus a partial
+    // last word
+    isize size = 4 * ATOMIC_BIT_SET_PARALLEL_MIN_WORDS * 64 + 100;
+    AtomicBitSet bits = atomic_bit_set_make(size, c_allocator());
+    defer(core_free(c_allocator(), bits.data));
+
+    // Every thread marks every third bit of the same range, each bit must be
+    // won by exactly one of them
+    const isize thread_count = 4;
+    isize won[thread_count] = {};
+    std::thread threads[thread_count];
+    for (isize t = 0; t < thread_count; t++) {
+        threads[t] = std::thread([&bits, &won, t, size]() {
+            for (isize i = 0; i < size; i += 3) {
+                won[t] += !atomic_bit_set_test_and_set(&bits, i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    isize expected = (size + 2) / 3;
+    EXPECT_EQ(won[0] + won[1] + won[2] + won[3], expected);
+    EXPECT_EQ(atomic_bit_set_count(&bits), expected);
+    EXPECT_EQ(atomic_bit_set_count(&bits, 1), expected);
+    EXPECT_EQ(atomic_bit_set_count(&bits, 3), expected);
+    EXPECT_EQ(atomic_bit_set_count(&bits, 4), expected);
+
+    EXPECT_TRUE(atomic_bit_set_get(&bits, 3));
+    EXPECT_FALSE(atomic_bit_set_get(&bits, 4));
+    EXPECT_TRUE(atomic_bit_set_test_and_clear(&bits, 3));
+    EXPECT_FALSE(atomic_bit_set_get(&bits, 3));
+    EXPECT_EQ(atomic_bit_set_fetch_or(&bits, 0, 0xF0), 0x9249249249249241);
+    EXPECT_EQ(atomic_bit_set_fetch_or(&bits, 0, 0), 0x92492492492492F1);
+
+    BitSet frozen = atomic_bit_set_freeze(&bits);
+    EXPECT_EQ(bit_set_count(&frozen), atomic_bit_set_count(&bits));
+    EXPECT_TRUE(bit_set_get(&frozen, 6));
+}
+
+TEST(Core, BitMatrix) {
+    Slice<u8> buff = slice_make<u8>(1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    isize rows = 70;
+    isize cols = 150;
+    BitMatrix matrix = bit_matrix_make(rows, cols, alloc);
+    EXPECT_EQ(matrix.stride, 8);
+
+    u64 state = 7;
+    for (isize row = 0; row < rows; row++) {
+        for (isize col = 0; col < cols; col++) {
+            if (test_random_u64(&state) % 3 == 0) {
+                bit_matrix_set(&matrix, row, col);
+            }
+        }
+    }
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        BitMatrix transposed = bit_matrix_transpose(&matrix, alloc);
+        EXPECT_EQ(transposed.rows, cols);
+        EXPECT_EQ(transposed.cols, rows);
+        for (isize row = 0; row < rows; row++) {
+            for (isize col = 0; col < cols; col++) {
+                EXPECT_EQ(bit_matrix_get(&transposed, col, row),
+                          bit_matrix_get(&matrix, row, col));
+            }
+        }
+        BitMatrix back = bit_matrix_transpose(&transposed, alloc);
+        for (isize row = 0; row < rows; row++) {
+            BitSet expected = bit_matrix_row(&matrix, row);
+            BitSet actual = bit_matrix_row(&back, row);
+            EXPECT_TRUE(bit_set_equals(&actual, &expected));
+        }
+    }
+
+    Slice<u32> counts = bit_matrix_intersection_counts(&matrix, alloc);
+    for (isize i = 0; i < rows; i++) {
+        for (isize j = 0; j < rows; j++) {
+            isize expected = 0;
+            for (isize col = 0; col < cols; col++) {
+                expected += bit_matrix_get(&matrix, i, col) &&
+                            bit_matrix_get(&matrix, j, col);
+            }
+            EXPECT_EQ(counts[i * rows + j], expected);
+            EXPECT_EQ(bit_matrix_row_and_count(&matrix, i, j), expected);
+        }
+    }
+
+    BitSet row0 = bit_matrix_row(&matrix, 0);
+    BitSet expected = bit_set_clone(&row0, alloc);
+    BitSet row1 = bit_matrix_row(&matrix, 1);
+    bit_set_xor(&expected, &row1);
+    bit_matrix_row_xor(&matrix, 0, 1);
+    EXPECT_TRUE(bit_set_equals(&row0, &expected));
+    bit_set_or(&expected, &row1);
+    bit_matrix_row_or(&matrix, 0, 1);
+    EXPECT_TRUE(bit_set_equals(&row0, &expected));
+    bit_matrix_row_and(&matrix, 0, 1);
+    EXPECT_TRUE(bit_set_equals(&row0, &row1));
+    bit_matrix_clear(&matrix, 0, 3);
+    EXPECT_FALSE(bit_matrix_get(&matrix, 0, 3));
+}
+
+TEST(Core, RankSelect) {
+    Slice<u8> buff = slice_make<u8>(4 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    // Dense, sparse, full and empty bit vectors, sizes not block aligned
+    isize sizes[] = {1, 64, 2048, 100000, 1000003};
+    u64 densities[] = {1, 7, 0, 64};
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        for (isize size : sizes) {
+            for (u64 density : densities) {
+                arena_reset(&arena);
+                BitSet bits = bit_set_make(size, alloc);
+                u64 state = 0x2545F4914F6CDD1D + size;
+                for (isize i = 0; i < size; i++) {
+                    if (test_random_u64(&state) % 64 < density) {
+                        bit_set_set(&bits, i);
+                    }
+                }
+
+                RankSelect rs = rank_select_make(&bits, alloc);
+                EXPECT_EQ(rs.ones, bit_set_count(&bits));
+                if (size >= 100000) {
+                    EXPECT_LT(rank_select_size_in_bytes(&rs) * 8,
+                              size * 6 / 100);
+                }
+
+                isize rank = 0;
+                for (isize i = 0; i < size; i++) {
+                    EXPECT_EQ(rank_select_rank(&rs, i), rank);
+                    if (bit_set_get(&bits, i)) {
+                        EXPECT_EQ(rank_select_select(&rs, rank), i);
+                        rank += 1;
+                    }
+                }
+                EXPECT_EQ(rank_select_rank(&rs, size), rs.ones);
+                EXPECT_EQ(rank_select_rank0(&rs, size), size - rs.ones);
+            }
+        }
+    }
+}
+
+static void fill_clustered_bit_set(BitSet* bits, u64 seed) {
+    u64 state = seed;
+
+    // Chunk 0 sparse, chunk 1 dense, chunk 2 long runs, chunk 3 empty,
+    // chunk 4 a single value
+    for (isize i = 0; i < 300; i++) {
+        bit_set_set(bits, test_random_u64(&state) % 65536);
+    }
+    for (isize i = 65536; i < 2 * 65536; i++) {
+        if (test_random_u64(&state) & 1) {
+            bit_set_set(bits, i);
+        }
+    }
+    for (isize run = 0; run < 20; run++) {
+        isize start = 2 * 65536 + (isize)(test_random_u64(&state) % 60000);
+        isize length = (isize)(test_random_u64(&state) % 2000);
+        for (isize i = start; i < start + length; i++) {
+            bit_set_set(bits, i);
+        }
+    }
+    bit_set_set(bits, 4 * 65536 + 7);
+}
+
+TEST(Core, RoaringBitmap) {
+    Slice<u8> buff = slice_make<u8>(8 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    isize size = 5 * 65536;
+    BitSet bits_a = bit_set_make(size, alloc);
+    BitSet bits_b = bit_set_make(size, alloc);
+    fill_clustered_bit_set(&bits_a, 1);
+    fill_clustered_bit_set(&bits_b, 2);
+
+    RoaringBitmap a = roaring_from_bit_set(&bits_a, alloc);
+    RoaringBitmap b = roaring_from_bit_set(&bits_b, alloc);
+    EXPECT_EQ(a.size, 4);
+    EXPECT_EQ(a.containers[0].kind, RoaringContainerKind::Array);
+    EXPECT_EQ(a.containers[1].kind, RoaringContainerKind::Bitmap);
+    EXPECT_EQ(a.containers[2].kind, RoaringContainerKind::Run);
+    EXPECT_EQ(roaring_cardinality(&a), bit_set_count(&bits_a));
+
+    BitSet back = roaring_to_bit_set(&a, size, alloc);
+    EXPECT_TRUE(bit_set_equals(&back, &bits_a));
+
+    isize expected_rank = 0;
+    for (isize i = 0; i < size; i++) {
+        if (i % 97 == 0) {
+            EXPECT_EQ(roaring_rank(&a, (u32)i), expected_rank);
+        }
+        EXPECT_EQ(roaring_contains(&a, (u32)i), bit_set_get(&bits_a, i));
+        expected_rank += bit_set_get(&bits_a, i);
+    }
+
+    isize previous = -1;
+    isize visited = 0;
+    roaring_for_each(&a, [&](u32 value) {
+        EXPECT_GT((isize)value, previous);
+        EXPECT_TRUE(bit_set_get(&bits_a, value));
+        previous = value;
+        visited += 1;
+    });
+    EXPECT_EQ(visited, bit_set_count(&bits_a));
+
+    auto check_op = [&](RoaringBitmap result,
+                        void (*op)(BitSet*, const BitSet*)) {
+        BitSet expected = bit_set_clone(&bits_a, alloc);
+        op(&expected, &bits_b);
+        BitSet actual = roaring_to_bit_set(&result, size, alloc);
+        EXPECT_TRUE(bit_set_equals(&actual, &expected));
+        EXPECT_EQ(roaring_cardinality(&result), bit_set_count(&expected));
+    };
+    check_op(roaring_and(&a, &b, alloc), bit_set_and);
+    check_op(roaring_or(&a, &b, alloc), bit_set_or);
+    check_op(roaring_xor(&a, &b, alloc), bit_set_xor);
+    check_op(roaring_andnot(&a, &b, alloc), bit_set_andnot);
+
+    RoaringBitmap self_xor = roaring_xor(&a, &a, alloc);
+    EXPECT_TRUE(roaring_is_empty(&self_xor));
+
+    // Single value updates on every container kind, including run splits
+    RoaringBitmap c = roaring_clone(&a, alloc);
+    BitSet bits_c = bit_set_clone(&bits_a, alloc);
+    u64 state = 3;
+    for (isize i = 0; i < 20000; i++) {
+        u64 random = test_random_u64(&state);
+        u32 value = (u32)(random % size);
+        if (random & (1 << 20)) {
+            roaring_add(&c, value);
+            bit_set_set(&bits_c, value);
+        } else {
+            roaring_remove(&c, value);
+            bit_set_clear(&bits_c, value);
+        }
+    }
+    back = roaring_to_bit_set(&c, size, alloc);
+    EXPECT_TRUE(bit_set_equals(&back, &bits_c));
+    EXPECT_EQ(roaring_cardinality(&c), bit_set_count(&bits_c));
+
+    roaring_optimize(&c);
+    back = roaring_to_bit_set(&c, size, alloc);
+    EXPECT_TRUE(bit_set_equals(&back, &bits_c));
+
+    // Scattered adds to a run container fall back to cheaper kinds
+    RoaringBitmap d = roaring_make(alloc);
+    for (u32 i = 0; i < 100; i++) {
+        roaring_add(&d, i);
+    }
+    roaring_optimize(&d);
+    EXPECT_EQ(d.containers[0].kind, RoaringContainerKind::Run);
+    for (u32 i = 200; i < 400; i += 2) {
+        roaring_add(&d, i);
+    }
+    EXPECT_EQ(d.containers[0].kind, RoaringContainerKind::Array);
+    for (u32 i = 400; i < 65536; i += 2) {
+        roaring_add(&d, i);
+    }
+    EXPECT_EQ(d.containers[0].kind, RoaringContainerKind::Bitmap);
+    EXPECT_EQ(roaring_cardinality(&d), 100 + (65536 - 200) / 2);
+    EXPECT_TRUE(roaring_contains(&d, 65534));
+    EXPECT_FALSE(roaring_contains(&d, 65535));
+}
+
+TEST(Core, RoaringBitmapSerialize) {
+    Slice<u8> buff = slice_make<u8>(4 * 1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    BitSet bits = bit_set_make(5 * 65536, alloc);
+    fill_clustered_bit_set(&bits, 5);
+    RoaringBitmap rb = roaring_from_bit_set(&bits, alloc);
+
+    Slice<u8> data = roaring_serialize(&rb, alloc);
+    EXPECT_EQ(data.size, roaring_serialized_size(&rb));
+
+    Result<RoaringBitmap, RoaringDeserializeError> result =
+        roaring_deserialize(data, alloc);
+    EXPECT_TRUE(result.is_ok);
+    EXPECT_TRUE(roaring_equals(&result.value, &rb));
+
+    Result<RoaringBitmap, RoaringDeserializeError> truncated =
+        roaring_deserialize(slice_subslice(data, 0, data.size - 1), alloc);
+    EXPECT_FALSE(truncated.is_ok);
+    EXPECT_EQ(truncated.error, RoaringDeserializeError::Truncated);
+
+    data.data[0] ^= 0xFF;
+    Result<RoaringBitmap, RoaringDeserializeError> bad_header =
+        roaring_deserialize(data, alloc);
+    EXPECT_FALSE(bad_header.is_ok);
+    EXPECT_EQ(bad_header.error, RoaringDeserializeError::InvalidHeader);
+}
+
+TEST(Core, Hashing) {
+    EXPECT_NE(hash_u64(0), hash_u64(1));
+    EXPECT_EQ(hash_string(string_from_cstr("hello")),
+              hash_string(string_from_cstr("hello")));
+    EXPECT_NE(hash_string(string_from_cstr("hello")),
+              hash_string(string_from_cstr("hello"), 1));
+
+    // Every length takes a different path, every byte has to matter
+    u8 data[100] = {};
+    for (isize size = 0; size < 100; size++) {
+        u64 hash = hash_bytes(data, size);
+        EXPECT_NE(hash, hash_bytes(data, size + 1));
+        for (isize i = 0; i < size; i++) {
+            data[i] ^= 1;
+            EXPECT_NE(hash, hash_bytes(data, size));
+            data[i] ^= 1;
+        }
+    }
+}
+
+TEST(Core, BloomFilter) {
+    isize keys = 10000;
+    BloomFilter a = bloom_make(keys, 10, c_allocator());
+    defer(bloom_free(&a));
+    BloomFilter b = bloom_make(keys, 10, c_allocator());
+    defer(bloom_free(&b));
+    EXPECT_EQ((usize)a.bits.data % 64, 0u);
+    EXPECT_EQ(a.hash_count, 7);
+
+    Slice<u64> hashes = slice_make<u64>(keys, c_allocator());
+    defer(core_free(c_allocator(), hashes.data));
+    for (isize i = 0; i < keys; i++) {
+        hashes[i] = hash_u64(i);
+    }
+    Slice<u64> first_half = slice_from_parts(hashes.data, keys / 2);
+    Slice<u64> second_half =
+        slice_from_parts(hashes.data + keys / 2, keys - keys / 2);
+    bloom_add_batch(&a, first_half);
+    for (u64 hash : second_half) {
+        bloom_add(&b, hash);
+    }
+
+    for (u64 hash : first_half) {
+        EXPECT_TRUE(bloom_maybe_contains(&a, hash));
+    }
+    bloom_union(&a, &b);
+    for (isize i = 0; i < keys; i++) {
+        EXPECT_TRUE(bloom_maybe_contains(&a, hashes[i]));
+    }
+
+    isize false_positives = 0;
+    for (isize i = keys; i < 11 * keys; i++) {
+        false_positives += bloom_maybe_contains(&a, hash_u64(i));
+    }
+    // ~1% is expected with 10 bits per key
+    EXPECT_LT(false_positives, keys * 10 / 50);
+
+    Slice<bool> results = slice_make<bool>(keys, c_allocator());
+    defer(core_free(c_allocator(), results.data));
+    EXPECT_EQ(bloom_maybe_contains_batch(&a, hashes, results),
+              keys);
+
+    bloom_clear(&a);
+    EXPECT_TRUE(bit_set_is_empty(&a.bits));
+}
+
+TEST(Core, TernaryArray) {
+    Slice<u8> buff = slice_make<u8>(64 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    isize size = 1000;
+    TernaryArray array = ternary_array_make(size, alloc);
+    EXPECT_EQ(ternary_array_count_assigned(&array), 0);
+    EXPECT_EQ(ternary_array_first_unassigned(&array), 0);
+
+    for (isize i = 0; i < size; i++) {
+        if (i % 3 != 2) {
+            ternary_array_set_bool(&array, i, i % 3 == 0);
+        }
+    }
+    EXPECT_EQ(ternary_array_get(&array, 0), Ternary::True);
+    EXPECT_EQ(ternary_array_get(&array, 1), Ternary::False);
+    EXPECT_EQ(ternary_array_get(&array, 2), Ternary::Unassigned);
+    EXPECT_EQ(ternary_array_count_assigned(&array), size - size / 3);
+    EXPECT_EQ(ternary_array_first_unassigned(&array), 2);
+    EXPECT_EQ(ternary_array_find_unassigned(&array, 3), 5);
+    EXPECT_EQ(ternary_array_find_unassigned(&array, 999), -1);
+    ternary_array_set(&array, 2, Ternary::Unassigned);
+    EXPECT_EQ(ternary_array_get(&array, 2), Ternary::Unassigned);
+
+    EXPECT_EQ(ternary_array_eval_literal(&array, 1), Ternary::True);
+    EXPECT_EQ(ternary_array_eval_literal(&array, -1), Ternary::False);
+    EXPECT_EQ(ternary_array_eval_literal(&array, -2), Ternary::True);
+    EXPECT_EQ(ternary_array_eval_literal(&array, -3), Ternary::Unassigned);
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+
+        // Clause over literals of all kinds, longer than a SIMD block
+        i32 clause[] = {-1, 2, -4, 5, -7, 8, -10, 11, -13, 14, -16, 998};
+        LiteralsEvaluation eval =
+            ternary_array_eval_literals(&array, slice_from_parts(clause, 12));
+        EXPECT_EQ(eval.true_count, 0);
+        EXPECT_EQ(eval.unassigned_count, 0);
+        EXPECT_EQ(eval.last_unassigned, -1);
+
+        clause[3] = -5;
+        clause[9] = 15;
+        clause[11] = -999;
+        eval =
+            ternary_array_eval_literals(&array, slice_from_parts(clause, 12));
+        EXPECT_EQ(eval.true_count, 1);
+        EXPECT_EQ(eval.unassigned_count, 2);
+        EXPECT_EQ(eval.last_unassigned, 11);
+    }
+
+    ternary_array_clear(&array);
+    EXPECT_EQ(ternary_array_count_assigned(&array), 0);
+}
+
+TEST(Core, PackedIntArray) {
+    Slice<u8> buff = slice_make<u8>(1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    EXPECT_EQ(packed_int_width(0), 1);
+    EXPECT_EQ(packed_int_width(7), 3);
+    EXPECT_EQ(packed_int_width(8), 4);
+    EXPECT_EQ(packed_int_width(UINT32_MAX), 32);
+
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    Slice<u32> values = slice_make<u32>(1001, alloc);
+    Slice<u32> unpacked = slice_make<u32>(1001, alloc);
+    for (i32 width = 1; width <= 32; width++) {
+        u64 state = width;
+        u64 mask = ((u64)1 << width) - 1;
+        PackedIntArray pushed = packed_int_array_make(width, 0, alloc);
+        for (isize i = 0; i < values.size; i++) {
+            values[i] = (u32)(test_random_u64(&state) & mask);
+            packed_int_array_push(&pushed, values[i]);
+        }
+        // Make sure the widest value is present
+        values[500] = (u32)mask;
+        packed_int_array_set(&pushed, 500, (u32)mask);
+
+        PackedIntArray array = packed_int_array_from_slice(values, alloc);
+        EXPECT_EQ(array.width, width);
+        for (isize i = 0; i < values.size; i++) {
+            EXPECT_EQ(packed_int_array_get(&array, i), values[i]);
+            EXPECT_EQ(packed_int_array_get(&pushed, i), values[i]);
+        }
+
+        for (u32 features : {0u, all_features}) {
+            cpu_set_features(features);
+            memset(unpacked.data, 0, unpacked.size * sizeof(u32));
+            packed_int_array_unpack(&array, unpacked);
+            for (isize i = 0; i < values.size; i++) {
+                EXPECT_EQ(unpacked[i], values[i]);
+            }
+        }
+    }
+}
+
+TEST(Core, HyperLogLog) {
+    HyperLogLog empty = hll_make(c_allocator());
+    defer(hll_free(&empty));
+    EXPECT_EQ(hll_count(&empty), 0);
+
+    isize sizes[] = {10, 1000, 5000, 100000, 2000000};
+    for (isize size : sizes) {
+        HyperLogLog hll = hll_make(c_allocator());
+        defer(hll_free(&hll));
+        // Every key is added twice
+        for (isize repeat = 0; repeat < 2; repeat++) {
+            for (isize i = 0; i < size; i++) {
+                hll_add_u64(&hll, (u64)i);
+            }
+        }
+        f64 error = fabs(hll_count(&hll) - (f64)size) / (f64)size;
+        // Sparse sketches are almost exact, dense ones have ~0.8% error
+        EXPECT_LT(error, hll.is_sparse ? 0.002 : 0.03);
+        EXPECT_EQ(hll.is_sparse, size <= 1000);
+    }
+
+    // Merging sketches of overlapping ranges matches a sketch of the union,
+    // for every combination of representations
+    isize ranges[] = {500, 300000};
+    for (isize range_a : ranges) {
+        for (isize range_b : ranges) {
+            HyperLogLog a = hll_make(c_allocator());
+            defer(hll_free(&a));
+            HyperLogLog b = hll_make(c_allocator());
+            defer(hll_free(&b));
+            HyperLogLog all = hll_make(c_allocator());
+            defer(hll_free(&all));
+            for (isize i = 0; i < range_a; i++) {
+                hll_add_u64(&a, (u64)i);
+                hll_add_u64(&all, (u64)i);
+            }
+            for (isize i = range_a / 2; i < range_a / 2 + range_b; i++) {
+                hll_add_u64(&b, (u64)i);
+                hll_add_u64(&all, (u64)i);
+            }
+            hll_merge(&a, &b);
+            EXPECT_EQ(hll_count(&a), hll_count(&all));
+        }
+    }
+
+    HyperLogLog strings = hll_make(c_allocator(), 10);
+    defer(hll_free(&strings));
+    const char* words[] = {"apple", "banana", "cherry", "apple", "banana"};
+    for (const char* word : words) {
+        hll_add_string(&strings, string_from_cstr(word));
+    }
+    EXPECT_NEAR(hll_count(&strings), 3, 0.01);
+}
+
 TEST(Core, HashMap) {
     Slice<u8> buff = slice_make<u8>(1024, c_allocator());
     defer(core_free(c_allocator(), buff.data));
@@ -369,6 +1029,13 @@ TEST(Core, ArrayOperations) {
 
     // Test last
     EXPECT_EQ(array_last(&arr), 5);
+
+    // Test reserve
+    isize size = arr.items.size;
+    array_reserve(&arr, 20);
+    EXPECT_EQ(arr.items.size, size);
+    EXPECT_GE(arr.capacity, size + 20);
+    EXPECT_EQ(array_last(&arr), 5);
 }
 
 TEST(Core, StringBasics) {
@@ -450,6 +1117,890 @@ TEST(Core, StringUtf8Size) {
     EXPECT_EQ(string_utf8_size(str2), 2);
 }
 
+TEST(Core, RuneTranscoding) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    Slice<u8> buff = slice_make<u8>(64 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    // Long enough for the SIMD paths, with ASCII runs and every sequence
+    // length at every alignment
+    const char* pieces[] = {"plain ascii text ", "\xC5\xA1", "\xE2\x82\xAC",
+                            "\xF0\x9F\x98\x80", "x"};
+    i32 codepoints[] = {-1, 0x161, 0x20AC, 0x1F600, 'x'};
+    Slice<u8> text = slice_make<u8>(4096, alloc);
+    Slice<rune> expected = slice_make<rune>(4096, alloc);
+    isize size = 0;
+    isize rune_count = 0;
+    u64 state = 5;
+    while (size < 4000) {
+        isize piece = (isize)(test_random_u64(&state) % 5);
+        isize piece_size = (isize)strlen(pieces[piece]);
+        memcpy(text.data + size, pieces[piece], piece_size);
+        size += piece_size;
+        if (piece == 0) {
+            for (isize i = 0; i < piece_size; i++) {
+                expected[rune_count++] = rune{pieces[0][i]};
+            }
+        } else {
+            expected[rune_count++] = rune{codepoints[piece]};
+        }
+    }
+
+    Slice<rune> runes = slice_make<rune>(size, alloc);
+    Slice<u8> encoded = slice_make<u8>(size, alloc);
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        // Prefixes of every length, the string isn't NUL terminated
+        for (isize prefix = 0; prefix < 300; prefix++) {
+            String str = string_from_parts((const char*)text.data, prefix);
+            isize count = string_rune_count(str);
+            EXPECT_EQ(count, string_rune_count_scalar(text.data, prefix));
+            EXPECT_EQ(string_utf8_size(str), count);
+        }
+
+        String str = string_from_slice(text);
+        str.size = size;
+        EXPECT_EQ(string_rune_count(str), rune_count);
+        EXPECT_EQ(string_decode_runes(str, runes), rune_count);
+        for (isize i = 0; i < rune_count; i++) {
+            EXPECT_EQ(runes[i], expected[i]);
+        }
+
+        Slice<rune> decoded = slice_from_parts(runes.data, rune_count);
+        EXPECT_EQ(runes_utf8_size(decoded), size);
+        EXPECT_EQ(runes_encode_utf8(decoded, encoded), size);
+        EXPECT_EQ(memcmp(encoded.data, text.data, size), 0);
+
+        // A sequence cut off by the end stays in bounds
+        String cut = string_from_cstr("0123456789abcdef\xC5\xA1x\xF0\x9F\x98");
+        EXPECT_EQ(string_decode_runes(cut, runes), 19);
+        EXPECT_EQ(runes[16], rune{0x161});
+        EXPECT_EQ(runes[18], rune{UTF8_REPLACEMENT_CODEPOINT});
+        cut.size -= 5;
+        EXPECT_EQ(string_decode_runes(cut, runes), 17);
+        EXPECT_EQ(runes[16], rune{UTF8_REPLACEMENT_CODEPOINT});
+    }
+}
+
+TEST(Core, Utf8Validation) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    struct Case {
+        const char* text;
+        isize error_offset;
+    };
+    Case cases[] = {
+        {"", -1},
+        {"hello", -1},
+        {"\xC5\xA1\xC4\x8D\xC5\x99 \xE2\x82\xAC \xF0\x9F\x98\x80", -1},
+        {"\xEF\xBF\xBF \xF4\x8F\xBF\xBF", -1},
+        // Lone continuation
+        {"ab\x80", 2},
+        // Overlong encodings
+        {"a\xC0\xAF", 1},
+        {"a\xE0\x80\xAF", 1},
+        {"a\xF0\x80\x80\xAF", 1},
+        // Surrogate
+        {"a\xED\xA0\x80", 1},
+        // Above U+10FFFF
+        {"a\xF4\x90\x80\x80", 1},
+        {"a\xF5\x80\x80\x80", 1},
+        // Truncated sequences
+        {"a\xE2\x82", 1},
+        {"a\xE2\x82z", 1},
+        {"\xF0\x9F\x98", 0},
+        // Missing continuation in a 4 byte sequence
+        {"ab\xF0\x9F\x98z", 2},
+    };
+
+    char buffer[256];
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        for (Case test : cases) {
+            // Every case is checked at every position around a 32 byte block
+            // boundary, with valid text before and after it
+            isize size = (isize)strlen(test.text);
+            for (isize prefix = 0; prefix < 70; prefix++) {
+                memset(buffer, 'x', prefix);
+                memcpy(buffer + prefix, test.text, size);
+                for (isize suffix = 0; suffix < 3; suffix++) {
+                    // Suffixes would complete truncated sequences
+                    if (test.error_offset != -1 && suffix > 0) {
+                        break;
+                    }
+                    for (isize i = 0; i < suffix; i++) {
+                        memcpy(buffer + prefix + size + 2 * i, "\xC2\xA9", 2);
+                    }
+                    Utf8Validation result = string_validate_utf8(
+                        string_from_parts(buffer, prefix + size + 2 * suffix));
+                    EXPECT_EQ(result.is_valid, test.error_offset == -1);
+                    EXPECT_EQ(result.error_offset,
+                              test.error_offset == -1
+                                  ? -1
+                                  : prefix + test.error_offset);
+                }
+            }
+        }
+    }
+
+    // Valid text with random corruptions, SIMD has to agree with scalar
+    const char* pieces[] = {"a", "\xC5\xA1", "\xE2\x82\xAC",
+                            "\xF0\x9F\x98\x80"};
+    u64 state = 11;
+    for (isize round = 0; round < 200; round++) {
+        isize size = 0;
+        char text[512];
+        while (size < 400) {
+            const char* piece = pieces[test_random_u64(&state) % 4];
+            isize piece_size = (isize)strlen(piece);
+            memcpy(text + size, piece, piece_size);
+            size += piece_size;
+        }
+        if (round % 2 == 1) {
+            text[(state >> 8) % size] = (char)(state >> 32);
+        }
+
+        cpu_set_features(0);
+        Utf8Validation expected =
+            string_validate_utf8(string_from_parts(text, size));
+        cpu_set_features(all_features);
+        Utf8Validation actual =
+            string_validate_utf8(string_from_parts(text, size));
+        EXPECT_EQ(actual.is_valid, expected.is_valid);
+        EXPECT_EQ(actual.error_offset, expected.error_offset);
+        if (round % 2 == 0) {
+            EXPECT_TRUE(actual.is_valid);
+        }
+    }
+}
+
+TEST(Core, IgnoreCaseAscii) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    u8 bytes[256];
+    for (i32 i = 0; i < 256; i++) {
+        bytes[i] = (u8)i;
+    }
+    std::string text =
+        "Hello, WORLD! The Quick Brown Fox @[`{ \xC3\x89t\xC3\xA9 ZzAa";
+    while (text.size() < 200) {
+        text += text;
+    }
+
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+
+        // Only 'A' to 'Z' change, every other byte is kept
+        char lowered[256];
+        ascii_to_lower(lowered, (const char*)bytes, 256);
+        for (i32 i = 0; i < 256; i++) {
+            u8 expected = (i >= 'A' && i <= 'Z') ? (u8)(i + 32) : (u8)i;
+            EXPECT_EQ((u8)lowered[i], expected);
+        }
+
+        for (isize size = 0; size <= (isize)text.size(); size++) {
+            String a = string_from_parts(text.data(), size);
+            std::string expected(text.data(), size);
+            for (char& c : expected) {
+                c = (char)ascii_to_lower((u8)c);
+            }
+            std::string upper(text.data(), size);
+            for (char& c : upper) {
+                c = (c >= 'a' && c <= 'z') ? (char)(c - 32) : c;
+            }
+            String b = string_from_parts(upper.data(), size);
+            String lower = string_from_parts(expected.data(), size);
+
+            EXPECT_TRUE(string_equals_ignore_case_ascii(a, b));
+            EXPECT_TRUE(string_equals_ignore_case_ascii(a, lower));
+            EXPECT_EQ(hash_string_ignore_case(a), hash_string(lower));
+            EXPECT_EQ(hash_string_ignore_case(b), hash_string(lower));
+
+            String copy = string_to_lower_ascii(a, c_allocator());
+            EXPECT_EQ(copy, lower);
+            core_free(c_allocator(), (void*)copy.data);
+
+            if (size > 0) {
+                // Differences other than case, including in the last byte
+                // and between bytes that are 0x20 apart
+                std::string other = upper;
+                other[size - 1] ^= 0x01;
+                EXPECT_FALSE(string_equals_ignore_case_ascii(
+                    a, string_from_parts(other.data(), size)));
+                other = upper;
+                other[size / 2] = (char)(other[size / 2] ^ 0x20);
+                bool is_letter = ascii_to_lower((u8)other[size / 2]) !=
+                                     (u8)other[size / 2] ||
+                                 ascii_to_lower((u8)upper[size / 2]) !=
+                                     (u8)upper[size / 2];
+                EXPECT_EQ(string_equals_ignore_case_ascii(
+                              a, string_from_parts(other.data(), size)),
+                          is_letter);
+            }
+        }
+        EXPECT_FALSE(string_equals_ignore_case_ascii(
+            string_from_cstr("abc"), string_from_cstr("ABCD")));
+    }
+
+    Slice<u8> buff = slice_make<u8>(64 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    HashMap<IgnoreCaseString, i32> keywords;
+    hash_map_init(&keywords, 16, arena_allocator(&arena));
+    hash_map_insert_or_set(&keywords, ignore_case(string_from_cstr("select")),
+                           1);
+    hash_map_insert_or_set(&keywords, ignore_case(string_from_cstr("FROM")),
+                           2);
+    EXPECT_EQ(hash_map_must_get(&keywords,
+                                ignore_case(string_from_cstr("SeLeCt"))),
+              1);
+    EXPECT_EQ(hash_map_must_get(&keywords,
+                                ignore_case(string_from_cstr("from"))),
+              2);
+    EXPECT_EQ(hash_map_get_ptr(&keywords,
+                               ignore_case(string_from_cstr("where"))),
+              nullptr);
+}
+
+TEST(Core, InlineString) {
+    EXPECT_EQ(sizeof(InlineString<>), 24u);
+
+    Slice<u8> buff = slice_make<u8>(64 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    InlineString<> empty = {};
+    EXPECT_TRUE(inline_string_is_inline(&empty));
+    EXPECT_EQ(inline_string_size(&empty), 0);
+    EXPECT_STREQ(inline_string_cstr(&empty), "");
+
+    // Up to 22 bytes stay inline and don't touch the allocator
+    const char* text = "abcdefghijklmnopqrstuvwxyz0123456789";
+    for (isize size = 0; size <= 36; size++) {
+        String value = string_from_parts(text, size);
+        isize offset = arena.offset;
+        InlineString<> str = inline_string_make(value, alloc);
+        EXPECT_EQ(inline_string_is_inline(&str), size <= 22);
+        EXPECT_EQ(arena.offset == offset, size <= 22);
+        EXPECT_EQ(inline_string_size(&str), size);
+        EXPECT_EQ(inline_string_to_string(&str), value);
+        EXPECT_EQ(std::string(inline_string_cstr(&str)),
+                  std::string(text, size));
+        EXPECT_EQ(str, value);
+        inline_string_free(&str, alloc);
+        EXPECT_EQ(inline_string_size(&str), 0);
+    }
+
+    InlineString<> a =
+        inline_string_make(string_from_cstr("identifier"), alloc);
+    InlineString<> b =
+        inline_string_make(string_from_cstr("identifier"), alloc);
+    InlineString<> c =
+        inline_string_make(string_from_cstr("a_much_longer_identifier_name"),
+                           alloc);
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(std::hash<InlineString<>>()(a),
+              hash_string(string_from_cstr("identifier")));
+
+    HashMap<InlineString<>, i32> ids;
+    hash_map_init(&ids, 16, alloc);
+    hash_map_insert_or_set(&ids, a, 1);
+    hash_map_insert_or_set(&ids, c, 2);
+    EXPECT_EQ(hash_map_must_get(&ids, b), 1);
+    InlineString<> d =
+        inline_string_make(string_from_cstr("a_much_longer_identifier_name"),
+                           alloc);
+    EXPECT_EQ(hash_map_must_get(&ids, d), 2);
+
+    InlineString<30> wide = inline_string_make<30>(
+        string_from_cstr("thirty bytes fit inline here!!"), alloc);
+    EXPECT_TRUE(inline_string_is_inline(&wide));
+    EXPECT_EQ(inline_string_size(&wide), 30);
+}
+
+// Checked on the bits because -ffast-math folds std::isnan to false and
+// flushes subnormals to zero
+static bool f64_is_nan_bits(f64 value) {
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits << 1) > ((u64)0x7FF << 53);
+}
+
+#if defined(__FAST_MATH__)
+static bool f64_is_subnormal_bits(f64 value) {
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits << 1) != 0 && (bits << 1) < ((u64)1 << 53);
+}
+#endif
+
+TEST(Core, NumberParsing) {
+    String str = string_from_cstr("12345678901234567890,rest");
+    Result<u64, ParseError> u = string_parse_u64(&str);
+    EXPECT_TRUE(u.is_ok);
+    EXPECT_EQ(u.value, 12345678901234567890ull);
+    EXPECT_EQ(str, ",rest");
+
+    struct IntCase {
+        const char* text;
+        bool is_ok;
+        i64 value;
+        isize rest;
+    };
+    IntCase int_cases[] = {
+        {"0", true, 0, 0},
+        {"-0", true, 0, 0},
+        {"+17 x", true, 17, 2},
+        {"000000000000000000000000042", true, 42, 0},
+        {"9223372036854775807", true, INT64_MAX, 0},
+        {"-9223372036854775808", true, INT64_MIN, 0},
+        {"9223372036854775808", false, 0, 19},
+        {"-9223372036854775809", false, 0, 20},
+        {"123456789012345678901", false, 0, 21},
+        {"-", false, 0, 1},
+        {"", false, 0, 0},
+        {"x1", false, 0, 2},
+        {"12ab", true, 12, 2},
+    };
+    for (IntCase c : int_cases) {
+        String s = string_from_cstr(c.text);
+        Result<i64, ParseError> r = string_parse_i64(&s);
+        EXPECT_EQ(r.is_ok, c.is_ok) << c.text;
+        if (c.is_ok) {
+            EXPECT_EQ(r.value, c.value) << c.text;
+        }
+        EXPECT_EQ(s.size, c.rest) << c.text;
+    }
+
+    // 20 digits starting with 1 that wrap around, and UINT64_MAX + 1
+    const char* overflows[] = {"29999999999999999999", "18446744073709551616"};
+    for (const char* text : overflows) {
+        String s = string_from_cstr(text);
+        Result<u64, ParseError> r = string_parse_u64(&s);
+        EXPECT_FALSE(r.is_ok) << text;
+        EXPECT_EQ(r.error, ParseError::Overflow) << text;
+    }
+    String max = string_from_cstr("18446744073709551615");
+    EXPECT_EQ(string_parse_u64(&max).value, UINT64_MAX);
+
+    // The string is not null terminated, a digit right after must be ignored
+    const char* digits = "1234567890";
+    String prefix = string_from_parts(digits, 4);
+    EXPECT_EQ(string_parse_i64(&prefix).value, 1234);
+
+    const char* float_cases[] = {
+        "0",
+        "-0.0",
+        "1",
+        "0.1",
+        ".5",
+        "5.",
+        "3.14159e+2",
+        "1e-400",
+        "1e400",
+        "-1e400",
+        "2.2250738585072014e-308",
+        "2.2250738585072011e-308",
+        "4.9406564584124654e-324",
+        "2.4703282292062328e-324",
+        "2.4703282292062327e-324",
+        "1.7976931348623157e308",
+        "1.7976931348623158e308",
+        "1.7976931348623159e308",
+        "9007199254740993",
+        "9007199254740992.000000000000000000001",
+        "9007199254740993.000000000000000000001",
+        "0.1000000000000000055511151231257827021181583404541015625",
+        "0.1000000000000000055511151231257827021181583404541015624",
+        "123456789012345678901234567890e-10",
+        "0.000000000000000000000000000000000000012345678901234567890123",
+        "7.038531e-26",
+        "1e23",
+        "8.589973e9",
+        "1.00000005960464477550",
+        "4503599627370496.5",
+        "4503599627370497.5",
+    };
+    for (const char* text : float_cases) {
+        String s = string_from_cstr(text);
+        Result<f64, ParseError> r = string_parse_f64(&s);
+        EXPECT_TRUE(r.is_ok) << text;
+        EXPECT_EQ(s.size, 0) << text;
+        f64 expected = strtod(text, nullptr);
+        EXPECT_EQ(memcmp(&r.value, &expected, sizeof(f64)), 0)
+            << text << " " << r.value << " " << expected;
+    }
+
+    String exponent = string_from_cstr("2e+x");
+    EXPECT_EQ(string_parse_f64(&exponent).value, 2.0);
+    EXPECT_EQ(exponent, "e+x");
+    String inf = string_from_cstr("-Infinity");
+    EXPECT_EQ(string_parse_f64(&inf).value, -INFINITY);
+    String nan = string_from_cstr("nan");
+    EXPECT_TRUE(f64_is_nan_bits(string_parse_f64(&nan).value));
+    String dot = string_from_cstr("-.e1");
+    EXPECT_FALSE(string_parse_f64(&dot).is_ok);
+    EXPECT_EQ(dot.size, 4);
+
+    // Random bit patterns round trip through the shortest representation, and
+    // random decimal strings match strtod
+    u64 state = 0x9E3779B97F4A7C15;
+    auto next = [&]() { return test_random_u64(&state); };
+    char buffer[64];
+    for (i32 i = 0; i < 100000; i++) {
+        u64 bits = next();
+        f64 value;
+        memcpy(&value, &bits, sizeof(value));
+        if (f64_is_nan_bits(value)) {
+            continue;
+        }
+#if defined(__FAST_MATH__)
+        if (f64_is_subnormal_bits(value)) {
+            continue;
+        }
+#endif
+        isize size = format_f64(value, buffer);
+        String s = string_from_parts(buffer, size);
+        Result<f64, ParseError> r = string_parse_f64(&s);
+        ASSERT_TRUE(r.is_ok);
+        ASSERT_EQ(memcmp(&r.value, &value, sizeof(f64)), 0)
+            << std::string(buffer, size);
+
+        // Up to 25 digits with a random decimal point and exponent
+        isize digit_count = 1 + next() % 25;
+        isize point = next() % (digit_count + 1);
+        isize length = 0;
+        for (isize d = 0; d < digit_count; d++) {
+            if (d == point) {
+                buffer[length++] = '.';
+            }
+            buffer[length++] = (char)('0' + next() % 10);
+        }
+        length += snprintf(buffer + length, 16, "e%d",
+                           (i32)(next() % 700) - 350);
+        s = string_from_parts(buffer, length);
+        r = string_parse_f64(&s);
+        ASSERT_TRUE(r.is_ok);
+        f64 expected = strtod(buffer, nullptr);
+#if defined(__FAST_MATH__)
+        if (f64_is_subnormal_bits(expected)) {
+            continue;
+        }
+#endif
+        ASSERT_EQ(memcmp(&r.value, &expected, sizeof(f64)), 0) << buffer;
+    }
+}
+
+TEST(Core, NumberFormatting) {
+    char buffer[FORMAT_F64_MAX_SIZE];
+    u64 values[] = {0, 1, 9, 10, 99, 100, 12345, 999999999999,
+                    1000000000000, 10000000000000000000ull, UINT64_MAX};
+    for (u64 value : values) {
+        isize size = format_u64(value, buffer);
+        EXPECT_EQ(std::string(buffer, size), std::to_string(value));
+        EXPECT_EQ(u64_digit_count(value), size);
+    }
+    u64 power = 1;
+    for (isize digits = 1; digits < 20; digits++) {
+        power *= 10;
+        EXPECT_EQ(u64_digit_count(power - 1), digits);
+        EXPECT_EQ(u64_digit_count(power), digits + 1);
+    }
+
+    i64 signed_values[] = {0, -1, 42, -100, INT64_MAX, INT64_MIN};
+    for (i64 value : signed_values) {
+        isize size = format_i64(value, buffer);
+        EXPECT_EQ(std::string(buffer, size), std::to_string(value));
+    }
+
+    struct FloatCase {
+        f64 value;
+        const char* text;
+    };
+    FloatCase float_cases[] = {
+        {0.1, "0.1"},
+        {-2.5, "-2.5"},
+        {1e23, "1e+23"},
+#if !defined(__FAST_MATH__)
+        {5e-324, "5e-324"},
+#endif
+        {-2.2250738585072014e-308, "-2.2250738585072014e-308"},
+        {INFINITY, "inf"},
+    };
+    for (FloatCase c : float_cases) {
+        isize size = format_f64(c.value, buffer);
+        EXPECT_EQ(std::string(buffer, size), c.text);
+    }
+
+    EXPECT_EQ(std::string(buffer, format_f32(0.1f, buffer)), "0.1");
+    EXPECT_EQ(std::string(buffer, format_f32(-1.1f, buffer)), "-1.1");
+    EXPECT_EQ(std::string(buffer, format_f32(3.4028235e38f, buffer)),
+              "3.4028235e+38");
+}
+
+TEST(Core, StringSearch) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    String text = string_from_cstr("the quick brown fox jumps over the lazy "
+                                   "dog, the end");
+    EXPECT_EQ(string_find(text, string_from_cstr("the")), 0);
+    EXPECT_EQ(string_find(text, string_from_cstr("the"), 1), 31);
+    EXPECT_EQ(string_find_last(text, string_from_cstr("the")), 45);
+    EXPECT_EQ(string_find(text, string_from_cstr("cat")), -1);
+    EXPECT_EQ(string_find(text, string_from_cstr("")), 0);
+    EXPECT_EQ(string_find_byte(text, 'q'), 4);
+    EXPECT_EQ(string_find_last_byte(text, 'o'), 41);
+    EXPECT_TRUE(string_contains(text, string_from_cstr("lazy dog")));
+    EXPECT_TRUE(string_starts_with(text, string_from_cstr("the quick")));
+    EXPECT_TRUE(string_ends_with(text, string_from_cstr("end")));
+    EXPECT_FALSE(string_ends_with(text, string_from_cstr("the")));
+
+    ByteSet set = byte_set_make(string_from_cstr(",z\xFF"));
+    EXPECT_TRUE(byte_set_contains(&set, 0xFF));
+    EXPECT_FALSE(byte_set_contains(&set, 0x7F));
+    EXPECT_EQ(string_find_any_of(text, &set), 37);
+    EXPECT_EQ(string_find_last_any_of(text, &set), 43);
+
+    // Every window is a candidate, long needles switch to two way
+    std::string run(5000, 'a');
+    std::string long_needle = std::string(40, 'a') + "b";
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        EXPECT_EQ(string_find(string_from_cstr(run.c_str()),
+                              string_from_cstr(long_needle.c_str())),
+                  -1);
+        std::string found = run + long_needle + run;
+        EXPECT_EQ(string_find(string_from_cstr(found.c_str()),
+                              string_from_cstr(long_needle.c_str())),
+                  (isize)run.size());
+    }
+
+    // The same for the backwards search, whose candidates end in 'a'
+    std::string reverse_needle = std::string(40, 'a') + "ba";
+    EXPECT_EQ(string_find_last(string_from_cstr(run.c_str()),
+                               string_from_cstr(reverse_needle.c_str())),
+              -1);
+    std::string reverse_found = run + reverse_needle + run + reverse_needle +
+                                run;
+    EXPECT_EQ(string_find_last(string_from_cstr(reverse_found.c_str()),
+                               string_from_cstr(reverse_needle.c_str())),
+              (isize)(2 * run.size() + reverse_needle.size()));
+
+    // Small alphabets give many partial matches, needle sizes cross the two
+    // way threshold and periodic needles exercise its memory
+    u64 state = 0x9E3779B97F4A7C15;
+    auto next = [&]() { return test_random_u64(&state); };
+    char haystack[600];
+    char needle[80];
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        for (i32 round = 0; round < 3000; round++) {
+            isize haystack_size = next() % sizeof(haystack);
+            u64 alphabet = 2 + next() % 3;
+            for (isize i = 0; i < haystack_size; i++) {
+                haystack[i] = (char)('a' + next() % alphabet);
+            }
+            isize needle_size = 1 + next() % (sizeof(needle) - 1);
+            if (next() % 2 == 0 && haystack_size > needle_size) {
+                // Take it from the haystack so it's found
+                memcpy(needle, haystack + next() % (haystack_size -
+                                                    needle_size),
+                       needle_size);
+            } else {
+                isize period = 1 + next() % 4;
+                for (isize i = 0; i < needle_size; i++) {
+                    needle[i] = i < period ? (char)('a' + next() % alphabet)
+                                           : needle[i - period];
+                }
+            }
+
+            String h = string_from_parts(haystack, haystack_size);
+            String n = string_from_parts(needle, needle_size);
+            std::string_view hv(haystack, haystack_size);
+            std::string_view nv(needle, needle_size);
+            isize start = haystack_size == 0 ? 0 : next() % haystack_size;
+
+            isize expected = (isize)hv.find(nv, start);
+            ASSERT_EQ(string_find(h, n, start), expected)
+                << hv << " " << nv << " " << start;
+            if (needle_size >= 3 && start + needle_size <= haystack_size) {
+                ASSERT_EQ(string_find_two_way((const u8*)haystack,
+                                              haystack_size,
+                                              (const u8*)needle, needle_size,
+                                              start),
+                          expected)
+                    << hv << " " << nv << " " << start;
+            }
+            expected = (isize)hv.rfind(nv);
+            if (hv.size() < nv.size()) {
+                expected = -1;
+            }
+            ASSERT_EQ(string_find_last(h, n), expected) << hv << " " << nv;
+            if (needle_size >= 3 && needle_size <= haystack_size) {
+                isize found = string_find_two_way<true>(
+                    (const u8*)haystack, haystack_size, (const u8*)needle,
+                    needle_size, 0);
+                ASSERT_EQ(found < 0 ? -1 : haystack_size - found - needle_size,
+                          expected)
+                    << hv << " " << nv;
+            }
+
+            expected = (isize)hv.find(needle[0], start);
+            ASSERT_EQ(string_find_byte(h, needle[0], start), expected);
+            expected = (isize)hv.rfind(needle[0]);
+            ASSERT_EQ(string_find_last_byte(h, needle[0]), expected);
+
+            // Sets with bytes above 127 as well
+            char chars[3] = {needle[0], (char)(0x80 + next() % 128),
+                             (char)(next() % 128)};
+            ByteSet any = byte_set_make(string_from_parts(chars, 3));
+            std::string_view cv(chars, 3);
+            haystack[next() % sizeof(haystack)] = chars[1];
+            expected = (isize)hv.find_first_of(cv, start);
+            ASSERT_EQ(string_find_any_of(h, &any, start), expected);
+            expected = (isize)hv.find_last_of(cv);
+            ASSERT_EQ(string_find_last_any_of(h, &any), expected);
+        }
+    }
+}
+
+TEST(Core, StringSplit) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    auto split_all = [](StringSplitIterator it) {
+        std::vector<std::string> pieces;
+        while (!split_iter_done(&it)) {
+            String piece = split_iter_next(&it);
+            pieces.emplace_back(piece.data, piece.size);
+        }
+        return pieces;
+    };
+    auto lines_all = [](String str) {
+        std::vector<std::string> lines;
+        LineIterator it = string_lines(str);
+        while (!line_iter_done(&it)) {
+            String line = line_iter_next(&it);
+            lines.emplace_back(line.data, line.size);
+        }
+        return lines;
+    };
+    using Pieces = std::vector<std::string>;
+
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+
+        EXPECT_EQ(split_all(string_split(string_from_cstr("a,,b"), ',')),
+                  (Pieces{"a", "", "b"}));
+        EXPECT_EQ(split_all(string_split(string_from_cstr(""), ',')),
+                  (Pieces{""}));
+        EXPECT_EQ(split_all(string_split(string_from_cstr(",x,"), ',')),
+                  (Pieces{"", "x", ""}));
+        ByteSet space = byte_set_make(string_from_cstr(" \t"));
+        EXPECT_EQ(split_all(string_split_any(string_from_cstr("p cnf\t3 2"),
+                                             &space)),
+                  (Pieces{"p", "cnf", "3", "2"}));
+
+        EXPECT_EQ(lines_all(string_from_cstr("one\r\ntwo\n\nfour")),
+                  (Pieces{"one", "two", "", "four"}));
+        EXPECT_EQ(lines_all(string_from_cstr("one\n")), (Pieces{"one"}));
+        EXPECT_EQ(lines_all(string_from_cstr("\n")), (Pieces{""}));
+        EXPECT_EQ(lines_all(string_from_cstr("")), Pieces{});
+
+        // Random strings across several windows against a naive split
+        u64 state = 0x9E3779B97F4A7C15;
+        for (i32 round = 0; round < 500; round++) {
+            std::string text;
+            isize size = (isize)(state % 1500);
+            for (isize i = 0; i < size; i++) {
+                text += "ab,;"[test_random_u64(&state) % 4];
+            }
+            state += 1;
+
+            Pieces expected = {""};
+            Pieces expected_any = {""};
+            for (char ch : text) {
+                if (ch == ',') {
+                    expected.push_back("");
+                } else {
+                    expected.back() += ch;
+                }
+                if (ch == ',' || ch == ';') {
+                    expected_any.push_back("");
+                } else {
+                    expected_any.back() += ch;
+                }
+            }
+            String str = string_from_parts(text.data(), size);
+            ASSERT_EQ(split_all(string_split(str, ',')), expected) << text;
+            ByteSet set = byte_set_make(string_from_cstr(",;"));
+            ASSERT_EQ(split_all(string_split_any(str, &set)), expected_any)
+                << text;
+        }
+    }
+}
+
+TEST(Core, MultiMatcher) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+
+    auto sorted_matches = [](const MultiMatcher* matcher, String text) {
+        Array<MultiMatch> matches = array_make<MultiMatch>(c_allocator(), 16);
+        multi_matcher_find_all(matcher, text, &matches);
+        std::vector<std::pair<isize, i32>> result;
+        for (MultiMatch match : matches.items) {
+            result.push_back({match.offset, match.pattern});
+        }
+        core_free(c_allocator(), matches.items.data);
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    String classic[] = {
+        string_from_cstr("he"),
+        string_from_cstr("she"),
+        string_from_cstr("his"),
+        string_from_cstr("hers"),
+        string_from_cstr("she"),
+    };
+    {
+        // In an arena the matcher is the only allocation left behind
+        Slice<u8> buff = slice_make<u8>(4096, c_allocator());
+        defer(core_free(c_allocator(), buff.data));
+        Arena arena = arena_make(buff);
+        MultiMatcher matcher = multi_matcher_make(
+            slice_from_parts(classic, 5), arena_allocator(&arena));
+        EXPECT_EQ(arena.offset, matcher.memory_size);
+    }
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        MultiMatcher matcher =
+            multi_matcher_make(slice_from_parts(classic, 5), c_allocator());
+        defer(multi_matcher_free(&matcher));
+        // Overlapping matches and both copies of the duplicate
+        std::vector<std::pair<isize, i32>> expected = {
+            {1, 1}, {1, 4}, {2, 0}, {2, 3}};
+        EXPECT_EQ(sorted_matches(&matcher, string_from_cstr("ushers")),
+                  expected);
+        EXPECT_TRUE(sorted_matches(&matcher, string_from_cstr("")).empty());
+    }
+
+    // Random patterns over a small alphabet against a naive scan. Up to 16
+    // patterns use Teddy when available, more use the DFA.
+    u64 state = 0x9E3779B97F4A7C15;
+    auto next = [&]() { return test_random_u64(&state); };
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        for (isize pattern_count : {5, 12, 40, 200}) {
+            for (i32 round = 0; round < 20; round++) {
+                std::vector<std::string> pattern_strings;
+                std::vector<String> patterns;
+                for (isize p = 0; p < pattern_count; p++) {
+                    std::string pattern;
+                    isize size = 1 + next() % 6;
+                    for (isize i = 0; i < size; i++) {
+                        pattern += (char)('a' + next() % 4);
+                    }
+                    pattern_strings.push_back(pattern);
+                }
+                for (const std::string& pattern : pattern_strings) {
+                    patterns.push_back(
+                        string_from_parts(pattern.data(), pattern.size()));
+                }
+                std::string text;
+                // Long texts are scanned as several streams by the DFA
+                isize text_size = next() % 2 == 0 ? next() % 300
+                                                  : 4096 + next() % 4096;
+                for (isize i = 0; i < text_size; i++) {
+                    text += (char)('a' + next() % 5);
+                }
+
+                std::vector<std::pair<isize, i32>> expected;
+                for (isize i = 0; i < text_size; i++) {
+                    for (i32 p = 0; p < (i32)pattern_count; p++) {
+                        if (text.compare(i, pattern_strings[p].size(),
+                                         pattern_strings[p]) == 0) {
+                            expected.push_back({i, p});
+                        }
+                    }
+                }
+
+                MultiMatcher matcher = multi_matcher_make(
+                    slice_from_parts(patterns.data(), pattern_count),
+                    c_allocator());
+                ASSERT_EQ(sorted_matches(&matcher, string_from_parts(
+                                                       text.data(),
+                                                       text_size)),
+                          expected)
+                    << text;
+                multi_matcher_free(&matcher);
+            }
+        }
+    }
+}
+
+TEST(Core, StringBuilder) {
+    u8 buffer[1024];
+    Arena arena = arena_make(Slice<u8>{buffer, sizeof(buffer)});
+    StringBuilder sb = string_builder_make(arena_allocator(&arena));
+
+    string_builder_append_cstr(&sb, "Hello");
+    string_builder_append_char(&sb, ' ');
+    string_builder_append_rune(&sb, rune_from_cstr("世"));
+    string_builder_append_char(&sb, ' ');
+    string_builder_append_i64(&sb, INT64_MIN);
+    string_builder_append_char(&sb, ' ');
+    string_builder_append_u64(&sb, UINT64_MAX);
+    string_builder_append_char(&sb, ' ');
+    string_builder_append_f64(&sb, 0.1);
+    EXPECT_EQ(string_builder_to_string(&sb),
+              "Hello 世 -9223372036854775808 18446744073709551615 0.1");
+
+    // The builder is the last arena allocation, so growing stays in place
+    const char* data = sb.data;
+    isize offset = arena.offset;
+    string_builder_append_repeat(&sb, 'x', sb.capacity);
+    EXPECT_EQ(sb.data, data);
+    EXPECT_GT(arena.offset, offset);
+    EXPECT_EQ(strlen(string_builder_to_cstr(&sb)), (size_t)sb.size);
+
+    string_builder_clear(&sb);
+    String name = string_from_cstr("x");
+    string_builder_format(&sb, "{} = {} ({}, {}) {{}} {}", name, -42, 2.5f,
+                          true, 'c');
+    EXPECT_EQ(string_builder_to_string(&sb), "x = -42 (2.5, true) {} c");
+
+    String floats = string_format(c_allocator(), "{} {} {}", 0.1f, 1.1f, 0.1);
+    EXPECT_EQ(floats, "0.1 1.1 0.1");
+    core_free(c_allocator(), (void*)floats.data);
+
+    String str = string_format(c_allocator(), "{}{}", (u8)255, "");
+    EXPECT_EQ(str, "255");
+    EXPECT_EQ(str.data[str.size], '\0');
+    core_free(c_allocator(), (void*)str.data);
+
+    String empty = string_format(c_allocator(), "");
+    EXPECT_EQ(empty, "");
+    core_free(c_allocator(), (void*)empty.data);
+
+    StringBuilder heap = string_builder_make(c_allocator());
+    for (i32 i = 0; i < 1000; i++) {
+        string_builder_append_i64(&heap, i % 10);
+    }
+    EXPECT_EQ(heap.size, 1000);
+    EXPECT_EQ(heap.data[999], '9');
+    string_builder_free(&heap);
+}
+
 TEST(Core, RuneIteration) {
     String str = string_from_cstr("Hello 世界");
     RuneIterator it = string_to_runes(str);
@@ -486,6 +2037,201 @@ TEST(Core, ReadFileFull) {
     EXPECT_EQ(data, "Hello, World!\n");
 }
 
+TEST(Core, ReadFileFullPread) {
+    Result<Slice<u8>, FileReadError> file_data =
+        file_read_full_pread(string_from_cstr("../testfile.txt"),
+                             c_allocator());
+    EXPECT_TRUE(file_data.is_ok);
+    core_assert(file_data.is_ok);
+    defer(core_free(c_allocator(), file_data.value.data));
+    EXPECT_EQ(string_from_slice(file_data.value), "Hello, World!\n");
+
+    Result<Slice<u8>, FileReadError> too_large = file_read_full_pread(
+        string_from_cstr("../testfile.txt"), c_allocator(), 10);
+    EXPECT_FALSE(too_large.is_ok);
+    EXPECT_EQ(too_large.error, FileReadError::SizeTooLarge);
+
+    Result<Slice<u8>, FileReadError> missing = file_read_full_pread(
+        string_from_cstr("../does_not_exist.txt"), c_allocator());
+    EXPECT_FALSE(missing.is_ok);
+    EXPECT_EQ(missing.error, FileReadError::FileNotFound);
+
+    // Non zeroed allocations still come back writable and the right size
+    DynamicArena arena = dynamic_arena_make(1024);
+    defer(dynamic_arena_free(&arena));
+    Allocator allocators[] = {c_allocator(), dynamic_arena_allocator(&arena)};
+    for (Allocator alloc : allocators) {
+        u8* data = core_alloc_non_zeroed<u8>(alloc, 4096);
+        memset(data, 0xAB, 4096);
+        EXPECT_EQ(data[4095], 0xAB);
+        core_free(alloc, data);
+    }
+}
+
+TEST(Core, FileMap) {
+    for (bool populate : {false, true}) {
+        FileMapOptions options;
+        options.will_need = true;
+        options.populate = populate;
+        Result<MappedFile, FileReadError> file =
+            file_map(string_from_cstr("../testfile.txt"), options);
+        EXPECT_TRUE(file.is_ok);
+        core_assert(file.is_ok);
+        EXPECT_EQ(string_from_slice(file.value.data), "Hello, World!\n");
+        file_unmap(&file.value);
+        EXPECT_EQ(file.value.data.data, nullptr);
+    }
+
+    Result<MappedFile, FileReadError> missing =
+        file_map(string_from_cstr("../does_not_exist.txt"));
+    EXPECT_FALSE(missing.is_ok);
+    EXPECT_EQ(missing.error, FileReadError::FileNotFound);
+
+#if !defined(_WIN32)
+    Result<MappedFile, FileReadError> directory =
+        file_map(string_from_cstr(".."));
+    EXPECT_FALSE(directory.is_ok);
+    EXPECT_EQ(directory.error, FileReadError::InvalidFile);
+#endif
+}
+
+#if !defined(_WIN32)
+TEST(Core, FileReadMany) {
+    char dir[] = "/tmp/core_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+
+    // More files than one batch, sizes around the chunk size and empty ones
+    const isize file_count = FILE_READ_MANY_BATCH + 44;
+    std::vector<std::string> names;
+    std::vector<std::string> contents;
+    u64 state = 1;
+    for (isize i = 0; i < file_count; i++) {
+        isize size = i % 50 == 0 ? 0 : (isize)(i * 131 % 3000);
+        if (i == 7) {
+            size = FILE_READ_CHUNK_SIZE * 2 + 1;
+        }
+        std::string content(size, '\0');
+        for (char& c : content) {
+            c = (char)test_random_u64(&state);
+        }
+        std::string name = std::string(dir) + "/" + std::to_string(i);
+        FILE* file = fopen(name.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fwrite(content.data(), 1, content.size(), file);
+        fclose(file);
+        names.push_back(name);
+        contents.push_back(content);
+    }
+    names.push_back(std::string(dir) + "/missing");
+    names.push_back(dir);
+
+    std::vector<String> paths;
+    for (const std::string& name : names) {
+        paths.push_back(string_from_parts(name.data(), (isize)name.size()));
+    }
+
+    for (bool use_io_uring : {true, false}) {
+        FileReadMany many = file_read_many(
+            slice_from_parts(paths.data(), (isize)paths.size()),
+            c_allocator(), use_io_uring);
+        ASSERT_EQ(many.files.size, (isize)paths.size());
+        for (isize i = 0; i < file_count; i++) {
+            ASSERT_TRUE(many.files[i].is_ok);
+            Slice<u8> data = many.files[i].value;
+            ASSERT_EQ(std::string_view((const char*)data.data, data.size),
+                      contents[i]);
+        }
+        EXPECT_FALSE(many.files[file_count].is_ok);
+        EXPECT_EQ(many.files[file_count].error, FileReadError::FileNotFound);
+        EXPECT_FALSE(many.files[file_count + 1].is_ok);
+        EXPECT_EQ(many.files[file_count + 1].error, FileReadError::InvalidFile);
+        file_read_many_free(&many);
+    }
+
+    for (isize i = 0; i < file_count; i++) {
+        remove(names[i].c_str());
+    }
+    rmdir(dir);
+}
+#endif
+
+TEST(Core, Rope) {
+    Slice<u8> buff = slice_make<u8>(1024 * 1024, c_allocator());
+    defer(core_free(c_allocator(), buff.data));
+    Arena arena = arena_make(buff);
+    Allocator alloc = arena_allocator(&arena);
+
+    const char* source = "the quick brown fox jumps over the lazy dog";
+    isize source_size = (isize)strlen(source);
+    Rope rope = rope_make(alloc);
+    defer(rope_free(&rope));
+    std::string model;
+
+    // Random edits checked against std::string
+    u64 state = 12345;
+    auto next = [&](u64 bound) {
+        return (isize)(test_random_u64(&state) % bound);
+    };
+    for (i32 step = 0; step < 2000; step++) {
+        isize size = rope_size(&rope);
+        isize op = next(4);
+        if (op < 2 || size == 0) {
+            isize start = next(source_size);
+            isize count = 1 + next(source_size - start);
+            isize index = next(size + 1);
+            rope_insert(&rope, index, string_from_parts(source + start, count));
+            model.insert(index, source + start, count);
+        } else if (op == 2) {
+            isize index = next(size);
+            isize count = next(std::min<isize>(size - index, 16) + 1);
+            rope_delete(&rope, index, count);
+            model.erase(index, count);
+        } else {
+            isize index = next(size);
+            EXPECT_EQ(rope_get(&rope, index), model[index]);
+        }
+        ASSERT_EQ(rope_size(&rope), (isize)model.size());
+    }
+    EXPECT_LT(rope.root->height, 2 * 20);
+
+    std::string joined;
+    RopeIterator it = rope_chunks(&rope);
+    while (!rope_iter_done(&it)) {
+        String chunk = rope_iter_next(&it);
+        joined.append(chunk.data, chunk.size);
+    }
+    EXPECT_EQ(joined, model);
+
+    String flat = rope_to_string(&rope, alloc);
+    EXPECT_EQ(std::string_view(flat.data, flat.size), model);
+
+    // Split and concatenate back
+    isize half = rope_size(&rope) / 2;
+    Rope tail = rope_split(&rope, half);
+    EXPECT_EQ(rope_size(&rope), half);
+    EXPECT_EQ(rope_size(&tail), (isize)model.size() - half);
+    rope_append(&rope, string_from_cstr("|"));
+    rope_concat(&rope, &tail);
+    EXPECT_EQ(rope_size(&tail), 0);
+    model = model.substr(0, half) + "|" + model.substr(half);
+    for (isize i = 0; i < rope_size(&rope); i++) {
+        ASSERT_EQ(rope_get(&rope, i), model[i]);
+    }
+
+#if !defined(_WIN32)
+    FILE* file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    defer(fclose(file));
+    Result<isize, FileWriteError> written = rope_writev(&rope, fileno(file));
+    ASSERT_TRUE(written.is_ok);
+    EXPECT_EQ(written.value, (isize)model.size());
+    std::string read_back(model.size(), '\0');
+    EXPECT_EQ(pread(fileno(file), read_back.data(), read_back.size(), 0),
+              (ssize_t)model.size());
+    EXPECT_EQ(read_back, model);
+#endif
+}
+
 TEST(Core, VMRingBuffer) {
     isize page_size = os_page_size();
     VMRingBuffer<u8> ring = vm_ring_buffer_make<u8>(page_size);
@@ -565,6 +2311,305 @@ TEST(Core, VMRingBuffer) {
     EXPECT_EQ(slice_all_equals(second_half, (u8)0xBB), true);
 }
 
+#if !defined(_WIN32)
+TEST(Core, DecompressReader) {
+    // Compressible text, larger than one ring buffer
+    std::string text;
+    u64 state = 7;
+    while (text.size() < 3 * 1024 * 1024) {
+        u64 random = test_random_u64(&state);
+        text += std::to_string((i64)(random >> 40) - (1 << 23));
+        text += (random & 7) == 0 ? " 0\n" : " ";
+    }
+
+    char dir[] = "/tmp/core_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::vector<std::string> created;
+    auto write_file = [&](const char* name, const void* data, isize size) {
+        std::string path = std::string(dir) + "/" + name;
+        FILE* file = fopen(path.c_str(), "wb");
+        fwrite(data, 1, size, file);
+        fclose(file);
+        created.push_back(path);
+        return path;
+    };
+
+    std::vector<std::string> paths;
+    std::vector<CompressionFormat> formats;
+    paths.push_back(write_file("plain", text.data(), (isize)text.size()));
+    formats.push_back(CompressionFormat::None);
+#if defined(CORE_WITH_ZLIB)
+    // Two gzip members, like pigz or appended files produce
+    std::string gzip_path = std::string(dir) + "/text.gz";
+    isize half = (isize)text.size() / 2;
+    for (isize part = 0; part < 2; part++) {
+        gzFile gz = gzopen(gzip_path.c_str(), part == 0 ? "wb" : "ab");
+        const char* data = text.data() + part * half;
+        isize size = part == 0 ? half : (isize)text.size() - half;
+        gzwrite(gz, data, (unsigned)size);
+        gzclose(gz);
+    }
+    paths.push_back(gzip_path);
+    created.push_back(gzip_path);
+    formats.push_back(CompressionFormat::Gzip);
+#endif
+#if defined(CORE_WITH_LZMA)
+    std::string xz(text.size() + 1024, '\0');
+    size_t xz_size = 0;
+    ASSERT_EQ(lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr,
+                                      (const u8*)text.data(), text.size(),
+                                      (u8*)xz.data(), &xz_size, xz.size()),
+              LZMA_OK);
+    paths.push_back(write_file("text.xz", xz.data(), (isize)xz_size));
+    formats.push_back(CompressionFormat::Xz);
+
+    std::string truncated_path =
+        write_file("truncated.xz", xz.data(), (isize)xz_size / 2);
+#endif
+
+    DecompressOptions options;
+    options.buffer_size = 1024 * 1024;
+    for (bool threaded : {false, true}) {
+        options.threaded = threaded;
+        for (isize i = 0; i < (isize)paths.size(); i++) {
+            Result<DecompressReader*, DecompressError> reader =
+                decompress_reader_open(
+                    string_from_parts(paths[i].data(), paths[i].size()),
+                    c_allocator(), options);
+            ASSERT_TRUE(reader.is_ok);
+            EXPECT_EQ(decompress_reader_format(reader.value), formats[i]);
+
+            // Ask for more than is left at the end, consume a bit less than
+            // what's there to keep a tail across the wrap around
+            std::string result;
+            while (true) {
+                Result<Slice<u8>, DecompressError> data =
+                    decompress_reader_fill(reader.value, 4096);
+                ASSERT_TRUE(data.is_ok);
+                if (data.value.size == 0) {
+                    break;
+                }
+                isize remaining = (isize)text.size() - (isize)result.size();
+                EXPECT_GE(data.value.size, std::min<isize>(4096, remaining));
+                isize count = data.value.size > 100 ? data.value.size - 100
+                                                    : data.value.size;
+                result.append((const char*)data.value.data, count);
+                decompress_reader_consume(reader.value, count);
+            }
+            EXPECT_EQ(result.size(), text.size());
+            EXPECT_TRUE(result == text);
+            decompress_reader_close(reader.value);
+        }
+
+#if defined(CORE_WITH_LZMA)
+        Result<DecompressReader*, DecompressError> truncated =
+            decompress_reader_open(
+                string_from_parts(truncated_path.data(),
+                                  truncated_path.size()),
+                c_allocator(), options);
+        ASSERT_TRUE(truncated.is_ok);
+        Result<Slice<u8>, DecompressError> data = result_ok(Slice<u8>{});
+        do {
+            data = decompress_reader_fill(truncated.value);
+            if (data.is_ok) {
+                decompress_reader_consume(truncated.value, data.value.size);
+            }
+        } while (data.is_ok && data.value.size > 0);
+        EXPECT_FALSE(data.is_ok);
+        EXPECT_EQ(data.error, DecompressError::TruncatedData);
+        decompress_reader_close(truncated.value);
+#endif
+    }
+
+    Result<DecompressReader*, DecompressError> missing =
+        decompress_reader_open(string_from_cstr("/does/not/exist"),
+                               c_allocator());
+    EXPECT_FALSE(missing.is_ok);
+    EXPECT_EQ(missing.error, DecompressError::FileNotFound);
+
+    EXPECT_EQ(compression_detect(slice_from_parts(
+                  (u8*)const_cast<char*>("\x28\xB5\x2F\xFD"), 4)),
+              CompressionFormat::Zstd);
+#if !defined(CORE_WITH_ZSTD)
+    std::string zstd_path = write_file("text.zst", "\x28\xB5\x2F\xFD\0", 5);
+    Result<DecompressReader*, DecompressError> unsupported =
+        decompress_reader_open(
+            string_from_parts(zstd_path.data(), zstd_path.size()),
+            c_allocator());
+    EXPECT_FALSE(unsupported.is_ok);
+    EXPECT_EQ(unsupported.error, DecompressError::UnsupportedFormat);
+#endif
+
+    for (const std::string& path : created) {
+        remove(path.c_str());
+    }
+    rmdir(dir);
+}
+#endif
+
+TEST(Core, DimacsParse) {
+    u32 all_features = cpu_get_features();
+    defer(cpu_set_features(all_features));
+    auto parse = [](const char* text) {
+        return dimacs_parse(
+            slice_from_parts((u8*)const_cast<char*>(text),
+                             (isize)strlen(text)),
+            c_allocator());
+    };
+
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+
+        Result<CnfFormula, DimacsError> result =
+            parse("c example\r\n"
+                  "c   p cnf 1 1\n"
+                  "p cnf 4 3\r\n"
+                  "1 -3 0\r\n"
+                  "  2 3\t-1 0 4\n"
+                  "-4 -2\n"
+                  "0\n"
+                  "c trailing comment\n"
+                  "%\n"
+                  "0\n");
+        ASSERT_TRUE(result.is_ok);
+        CnfFormula formula = result.value;
+        EXPECT_EQ(formula.variable_count, 4);
+        EXPECT_EQ(formula.clause_count, 3);
+        std::vector<std::vector<i32>> expected = {
+            {1, -3}, {2, 3, -1}, {4, -4, -2}};
+        for (isize i = 0; i < 3; i++) {
+            Slice<i32> clause = cnf_clause(&formula, i);
+            EXPECT_EQ(std::vector<i32>(clause.data, clause.data + clause.size),
+                      expected[i]);
+        }
+        cnf_formula_free(&formula);
+
+        struct {
+            const char* text;
+            DimacsErrorKind kind;
+            isize offset;
+        } errors[] = {
+            {"1 2 0\n", DimacsErrorKind::MissingHeader, 0},
+            {"c only comments\n", DimacsErrorKind::MissingHeader, 16},
+            {"p dnf 2 1\n1 0\n", DimacsErrorKind::InvalidHeader, 0},
+            {"p cnf 2\n1 0\n", DimacsErrorKind::InvalidHeader, 0},
+            {"p cnf 2 1\np cnf 2 1\n", DimacsErrorKind::InvalidHeader, 10},
+            {"p cnf 2 1\n1 3 0\n", DimacsErrorKind::VariableOutOfRange, 12},
+            {"p cnf 2 1\n1 2a 0\n", DimacsErrorKind::InvalidLiteral, 12},
+            {"p cnf 2 1\n1 - 0\n", DimacsErrorKind::InvalidLiteral, 12},
+            {"p cnf 2 1\n1 x 0\n", DimacsErrorKind::InvalidLiteral, 12},
+            {"p cnf 2 1\n99999999999 0\n",
+             DimacsErrorKind::InvalidLiteral, 10},
+            {"p cnf 2 1\n1 2\n", DimacsErrorKind::UnterminatedClause, 14},
+            {"p cnf 2 2\n1 2 0\n", DimacsErrorKind::ClauseCountMismatch, 16},
+        };
+        for (auto error : errors) {
+            Result<CnfFormula, DimacsError> failed = parse(error.text);
+            EXPECT_FALSE(failed.is_ok) << error.text;
+            if (!failed.is_ok) {
+                EXPECT_EQ(failed.error.kind, error.kind) << error.text;
+                EXPECT_EQ(failed.error.offset, error.offset) << error.text;
+            }
+        }
+    }
+
+    // Random formula, parsed whole, in chunks and through a reader
+    const i32 variables = 100000;
+    std::string text = "c random\np cnf 100000 20000\n";
+    std::vector<i32> literals;
+    std::vector<isize> offsets = {0};
+    u64 state = 3;
+    for (isize i = 0; i < 20000; i++) {
+        isize size = 1 + i % 7;
+        for (isize j = 0; j < size; j++) {
+            u64 random = test_random_u64(&state);
+            i32 literal = 1 + (i32)((random >> 33) % variables);
+            literal = (random & 1) ? -literal : literal;
+            literals.push_back(literal);
+            text += std::to_string(literal);
+            text += (random >> 20) % 5 == 0 ? "\n" : " ";
+        }
+        text += "0\n";
+        offsets.push_back((isize)literals.size());
+    }
+    auto check = [&](Result<CnfFormula, DimacsError> result) {
+        ASSERT_TRUE(result.is_ok);
+        CnfFormula formula = result.value;
+        ASSERT_EQ(formula.literals.items.size, (isize)literals.size());
+        EXPECT_EQ(memcmp(formula.literals.items.data, literals.data(),
+                         literals.size() * sizeof(i32)),
+                  0);
+        ASSERT_EQ(formula.clause_offsets.items.size, (isize)offsets.size());
+        EXPECT_EQ(memcmp(formula.clause_offsets.items.data, offsets.data(),
+                         offsets.size() * sizeof(isize)),
+                  0);
+        cnf_formula_free(&formula);
+    };
+    Slice<u8> bytes = slice_from_parts((u8*)text.data(), (isize)text.size());
+
+    for (u32 features : {0u, all_features}) {
+        cpu_set_features(features);
+        check(dimacs_parse(bytes, c_allocator()));
+
+        // Unconsumed bytes are fed again with the next chunk
+        DimacsParser parser;
+        dimacs_parser_init(&parser, c_allocator());
+        isize start = 0;
+        isize end = 0;
+        while (end < bytes.size) {
+            end = std::min(end + (isize)(test_random_u64(&state) % 300),
+                           bytes.size);
+            bool last = end == bytes.size;
+            Result<isize, DimacsError> consumed = dimacs_parser_feed(
+                &parser, slice_from_parts(bytes.data + start, end - start),
+                last);
+            ASSERT_TRUE(consumed.is_ok);
+            start += consumed.value;
+        }
+        EXPECT_EQ(start, bytes.size);
+        check(dimacs_parser_finish(&parser));
+    }
+
+#if !defined(_WIN32)
+    char dir[] = "/tmp/core_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::string path = std::string(dir) + "/formula.cnf";
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(text.data(), 1, text.size(), file);
+    fputs("c a comment longer than the reader's buffer ", file);
+    for (isize i = 0; i < 1000; i++) {
+        fputs("0123456789", file);
+    }
+    fclose(file);
+
+    // Small buffer to make lines straddle the ring's end, the long comment
+    // at the end can't fit
+    DecompressOptions options;
+    options.buffer_size = 2 * os_page_size();
+    Result<DecompressReader*, DecompressError> reader =
+        decompress_reader_open(string_from_cstr(path.c_str()), c_allocator(),
+                               options);
+    ASSERT_TRUE(reader.is_ok);
+    Result<CnfFormula, DimacsError> streamed =
+        dimacs_parse_reader(reader.value, c_allocator());
+    EXPECT_FALSE(streamed.is_ok);
+    EXPECT_EQ(streamed.error.kind, DimacsErrorKind::LineTooLong);
+    EXPECT_EQ(streamed.error.offset, (isize)text.size());
+    decompress_reader_close(reader.value);
+
+    ASSERT_EQ(truncate(path.c_str(), (off_t)text.size()), 0);
+    reader = decompress_reader_open(string_from_cstr(path.c_str()),
+                                    c_allocator(), options);
+    ASSERT_TRUE(reader.is_ok);
+    check(dimacs_parse_reader(reader.value, c_allocator()));
+    decompress_reader_close(reader.value);
+
+    remove(path.c_str());
+    rmdir(dir);
+#endif
+}
+
 TEST(Core, MatrixMultiplySquare) {
     using Mat3x3 = Matrix<f32, 3, 3>;
 